@@ -0,0 +1,288 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/app/async_image_optimizer_client.h"
+
+#include <algorithm>
+
+#include "squim/app/image_stream_parts.h"
+#include "squim/app/request_builder.h"
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+
+using squim::ImageRequestPart;
+using squim::ImageResponsePart;
+
+namespace {
+
+// Channels with equal arguments share the connection, a distinct value of
+// this argument gives each channel its own one.
+const char kChannelIndexArg[] = "squim.channel_index";
+
+std::vector<std::shared_ptr<grpc::Channel>> CreateChannels(
+    const std::string& target,
+    size_t num_channels) {
+  std::vector<std::shared_ptr<grpc::Channel>> channels;
+  for (size_t i = 0; i < std::max<size_t>(1, num_channels); ++i) {
+    grpc::ChannelArguments args;
+    args.SetInt(kChannelIndexArg, i);
+    channels.push_back(grpc::CreateCustomChannel(
+        target, grpc::InsecureChannelCredentials(), args));
+  }
+  return channels;
+}
+
+}  // namespace
+
+// A single OptimizeImage call. Writing of the request and reading of the
+// response run concurrently, the call is finished when both are done. Deletes
+// itself after the callback is run.
+class AsyncImageOptimizerClient::Call {
+  MAKE_NONCOPYABLE(Call);
+
+ public:
+  Call(AsyncImageOptimizerClient* client,
+       ImageRequestPart header,
+       io::ChunkList image,
+       size_t chunk_size,
+       Callback callback)
+      : client_(client),
+        header_(std::move(header)),
+        image_(std::move(image)),
+        splitter_(&image_, chunk_size),
+        callback_(std::move(callback)) {}
+
+  void Start(squim::ImageOptimizer::Stub* stub, grpc::CompletionQueue* cq) {
+    // The start may complete before the stream is assigned.
+    std::lock_guard<std::mutex> lock(mutex_);
+    stream_ = stub->AsyncOptimizeImage(&context_, cq, &start_op_);
+  }
+
+  // Handles completion of |tag|, which is an operation of some call.
+  static void OnEvent(void* tag, bool ok) {
+    auto* operation = static_cast<Operation*>(tag);
+    auto* call = operation->call;
+    bool finished;
+    {
+      std::lock_guard<std::mutex> lock(call->mutex_);
+      finished = call->HandleEvent(operation->type, ok);
+    }
+    if (finished)
+      call->Complete();
+  }
+
+ private:
+  enum class OperationType { kStart, kWrite, kRead, kFinish };
+
+  struct Operation {
+    Call* call;
+    OperationType type;
+  };
+
+  // Returns true when the call is finished.
+  bool HandleEvent(OperationType type, bool ok) {
+    switch (type) {
+      case OperationType::kStart:
+        OnStarted(ok);
+        break;
+      case OperationType::kWrite:
+        OnWritten(ok);
+        break;
+      case OperationType::kRead:
+        OnRead(ok);
+        break;
+      case OperationType::kFinish:
+        return true;
+    }
+    return false;
+  }
+
+  void OnStarted(bool ok) {
+    if (!ok) {
+      writing_done_ = true;
+      reading_done_ = true;
+      MaybeFinish();
+      return;
+    }
+
+    stream_->Write(header_, &write_op_);
+    stream_->Read(&response_part_, &read_op_);
+  }
+
+  void OnWritten(bool ok) {
+    // A failed write means the call is over, its status tells why.
+    if (!ok || writes_done_sent_) {
+      writing_done_ = true;
+      MaybeFinish();
+      return;
+    }
+
+    if (splitter_.Next(&request_part_)) {
+      stream_->Write(request_part_, &write_op_);
+    } else {
+      writes_done_sent_ = true;
+      stream_->WritesDone(&write_op_);
+    }
+  }
+
+  void OnRead(bool ok) {
+    if (!ok) {
+      reading_done_ = true;
+      MaybeFinish();
+      return;
+    }
+
+    collector_.Add(&response_part_);
+    response_part_.Clear();
+    stream_->Read(&response_part_, &read_op_);
+  }
+
+  void MaybeFinish() {
+    if (writing_done_ && reading_done_)
+      stream_->Finish(&result_.status, &finish_op_);
+  }
+
+  void Complete() {
+    if (result_.status.ok())
+      collector_.Finish();
+    result_.code = collector_.code();
+    result_.message = collector_.message();
+    result_.image = collector_.TakeImage();
+    result_.stats = collector_.stats();
+
+    auto result = std::move(result_);
+    auto callback = std::move(callback_);
+    auto* client = client_;
+    delete this;
+
+    callback(std::move(result));
+    client->OnCallComplete();
+  }
+
+  AsyncImageOptimizerClient* client_;
+  ImageRequestPart header_;
+  io::ChunkList image_;
+  RequestPartSplitter splitter_;
+  Callback callback_;
+
+  std::mutex mutex_;
+  grpc::ClientContext context_;
+  std::unique_ptr<
+      grpc::ClientAsyncReaderWriter<ImageRequestPart, ImageResponsePart>>
+      stream_;
+  Operation start_op_{this, OperationType::kStart};
+  Operation write_op_{this, OperationType::kWrite};
+  Operation read_op_{this, OperationType::kRead};
+  Operation finish_op_{this, OperationType::kFinish};
+
+  ImageRequestPart request_part_;
+  ImageResponsePart response_part_;
+  bool writes_done_sent_ = false;
+  bool writing_done_ = false;
+  bool reading_done_ = false;
+  ResponsePartCollector collector_;
+  AsyncOptimizationResult result_;
+};
+
+// A channel with the completion queue for its calls and the thread polling
+// it.
+class AsyncImageOptimizerClient::Shard {
+  MAKE_NONCOPYABLE(Shard);
+
+ public:
+  explicit Shard(std::shared_ptr<grpc::Channel> channel)
+      : stub_(squim::ImageOptimizer::NewStub(channel)),
+        thread_([this]() { Poll(); }) {}
+
+  // All calls must be complete.
+  ~Shard() {
+    cq_.Shutdown();
+    thread_.join();
+  }
+
+  void StartCall(Call* call) { call->Start(stub_.get(), &cq_); }
+
+ private:
+  void Poll() {
+    void* tag;
+    bool ok;
+    while (cq_.Next(&tag, &ok))
+      Call::OnEvent(tag, ok);
+  }
+
+  std::unique_ptr<squim::ImageOptimizer::Stub> stub_;
+  grpc::CompletionQueue cq_;
+  // Must be the last, it uses the members above.
+  std::thread thread_;
+};
+
+AsyncImageOptimizerClient::AsyncImageOptimizerClient(const std::string& target,
+                                                     size_t num_channels)
+    : AsyncImageOptimizerClient(CreateChannels(target, num_channels)) {}
+
+AsyncImageOptimizerClient::AsyncImageOptimizerClient(
+    std::vector<std::shared_ptr<grpc::Channel>> channels) {
+  CHECK(!channels.empty());
+  for (auto& channel : channels)
+    shards_.push_back(base::make_unique<Shard>(std::move(channel)));
+}
+
+AsyncImageOptimizerClient::~AsyncImageOptimizerClient() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_complete_.wait(lock, [this]() { return calls_in_flight_ == 0; });
+  lock.unlock();
+  shards_.clear();
+}
+
+void AsyncImageOptimizerClient::OptimizeImage(RequestBuilder* request_builder,
+                                              io::ChunkList image,
+                                              size_t chunk_size,
+                                              Callback callback) {
+  DCHECK_GT(chunk_size, 0u);
+  auto header = request_builder->Build();
+  size_t size = 0;
+  for (const auto& chunk : image)
+    size += chunk->size();
+  header.mutable_meta()->set_content_length(size);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++calls_in_flight_;
+  }
+
+  auto* shard = shards_[next_shard_++ % shards_.size()].get();
+  shard->StartCall(new Call(this, std::move(header), std::move(image),
+                            chunk_size, std::move(callback)));
+}
+
+std::future<AsyncOptimizationResult> AsyncImageOptimizerClient::OptimizeImage(
+    RequestBuilder* request_builder,
+    io::ChunkList image,
+    size_t chunk_size) {
+  auto promise = std::make_shared<std::promise<AsyncOptimizationResult>>();
+  auto future = promise->get_future();
+  OptimizeImage(request_builder, std::move(image), chunk_size,
+                [promise](AsyncOptimizationResult result) {
+                  promise->set_value(std::move(result));
+                });
+  return future;
+}
+
+void AsyncImageOptimizerClient::OnCallComplete() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--calls_in_flight_ == 0)
+    all_complete_.notify_all();
+}
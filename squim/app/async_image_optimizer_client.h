@@ -0,0 +1,99 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_APP_ASYNC_IMAGE_OPTIMIZER_CLIENT_H_
+#define SQUIM_APP_ASYNC_IMAGE_OPTIMIZER_CLIENT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grpc++/grpc++.h"
+#include "proto/image_optimizer.grpc.pb.h"
+#include "squim/base/make_noncopyable.h"
+#include "squim/io/chunk.h"
+
+class RequestBuilder;
+
+struct AsyncOptimizationResult {
+  bool ok() const {
+    return status.ok() && code == squim::ImageResponsePart::OK;
+  }
+
+  // Status of the call itself, |code| and the rest are valid only if it's OK.
+  // |image| is empty unless |code| is OK.
+  grpc::Status status;
+  squim::ImageResponsePart::Result code = squim::ImageResponsePart::OK;
+  std::string message;
+  io::ChunkList image;
+  squim::ImageResponsePart_Stats stats;
+};
+
+// Client which keeps many optimizations in flight without a thread per call.
+//
+// Calls are spread round-robin over a pool of channels, each with its own
+// HTTP/2 connection, completion queue and a thread which drives the calls of
+// the channel. An image is sent from memory, and request messages are written
+// while the response is being read. Callbacks are run on the completion queue
+// threads, so they must not block.
+class AsyncImageOptimizerClient {
+  MAKE_NONCOPYABLE(AsyncImageOptimizerClient);
+
+ public:
+  using Callback = std::function<void(AsyncOptimizationResult result)>;
+
+  // Creates |num_channels| channels to |target|.
+  AsyncImageOptimizerClient(const std::string& target, size_t num_channels);
+  explicit AsyncImageOptimizerClient(
+      std::vector<std::shared_ptr<grpc::Channel>> channels);
+  // Waits for the calls in flight to complete.
+  ~AsyncImageOptimizerClient();
+
+  // Starts optimization of |image|, sending it in |chunk_size| messages.
+  // |callback| is called exactly once when the call is complete. The content
+  // length of the request is set to the size of |image|.
+  void OptimizeImage(RequestBuilder* request_builder,
+                     io::ChunkList image,
+                     size_t chunk_size,
+                     Callback callback);
+
+  // Same as above, but the result is delivered through the future.
+  std::future<AsyncOptimizationResult> OptimizeImage(
+      RequestBuilder* request_builder,
+      io::ChunkList image,
+      size_t chunk_size);
+
+ private:
+  class Call;
+  class Shard;
+
+  void OnCallComplete();
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<size_t> next_shard_{0};
+
+  std::mutex mutex_;
+  std::condition_variable all_complete_;
+  size_t calls_in_flight_ = 0;
+};
+
+#endif  // SQUIM_APP_ASYNC_IMAGE_OPTIMIZER_CLIENT_H_
@@ -27,10 +27,14 @@
 #include "squim/io/chunk.h"
 #include "squim/os/file_system.h"
 #include "squim/os/file.h"
+#include "squim/os/file_info.h"
 
 DEFINE_string(in, "test.png", "input image file");
 DEFINE_string(out, "test.webp", "output file");
 DEFINE_string(service, "localhost:50051", "service endpoint");
+DEFINE_string(target, "webp", "target image type: webp, jpeg, png or gif");
+DEFINE_bool(progressive, false, "write progressive jpeg (jpeg target only)");
+DEFINE_int32(png_level, 0, "png optimization level 1..3 (png target only)");
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
@@ -52,6 +56,21 @@ int main(int argc, char** argv) {
   }
 
   auto request_builder = RequestBuilder().SetRecordStats(true);
+  os::FileInfo in_info;
+  if (in->Stat(&in_info).ok())
+    request_builder.SetContentLength(in_info.size);
+  if (FLAGS_target == "jpeg") {
+    request_builder.SetTargetType(squim::JPEG)
+        .SetJpegProgressive(FLAGS_progressive);
+  } else if (FLAGS_target == "png") {
+    request_builder.SetTargetType(squim::PNG)
+        .SetPngOptimizationLevel(FLAGS_png_level);
+  } else if (FLAGS_target == "gif") {
+    request_builder.SetTargetType(squim::GIF);
+  } else if (FLAGS_target != "webp") {
+    LOG(ERROR) << "Unsupported target type " << FLAGS_target;
+    return 1;
+  }
   ImageOptimizerClient client(
       grpc::CreateChannel(FLAGS_service, grpc::InsecureChannelCredentials()));
   if (!client.OptimizeImage(&request_builder, in.get(), 1024, out.get(),
@@ -72,6 +72,11 @@ class GRPCStreamReader : public io::Reader {
           continue;
         }
 
+        // The optimization failed after some data has been sent.
+        if (response_part_->has_meta())
+          return io::IoResult::Error("Optimization failed: " +
+                                     response_part_->meta().message());
+
         if (!response_part_->has_image_data())
           return io::IoResult::Error("Unexpected gRPC message");
 
@@ -144,6 +149,8 @@ bool ImageOptimizerClient::OptimizeImage(RequestBuilder* request_builder,
 
   GRPCStreamReader reader(stream, &response_part);
   auto result = ioutil::Copy(webp_writer, &reader);
+  if (!result.ok())
+    LOG(ERROR) << "Image receive error: " << result.message();
 
   if (stats)
     *stats = reader.stats();
@@ -156,3 +163,14 @@ bool ImageOptimizerClient::OptimizeImage(RequestBuilder* request_builder,
 
   return result.ok();
 }
+
+bool ImageOptimizerClient::OptimizeBatch(const squim::BatchRequest& request,
+                                         squim::BatchResponse* response) {
+  grpc::ClientContext context;
+  auto status = stub_->OptimizeBatch(&context, request, response);
+  if (!status.ok()) {
+    LOG(ERROR) << "Batch RPC failed: " << status.error_message();
+    return false;
+  }
+  return true;
+}
@@ -36,12 +36,20 @@ class ImageOptimizerClient {
  public:
   ImageOptimizerClient(std::shared_ptr<grpc::Channel> channel);
 
+  // Returns false if the optimization failed. The output is streamed, so
+  // |webp_writer| may have got part of the image then, which must be
+  // discarded.
   bool OptimizeImage(RequestBuilder* request_builder,
                      io::Reader* image_reader,
                      size_t chunk_size,
                      io::Writer* webp_writer,
                      squim::ImageResponsePart_Stats* stats);
 
+  // Optimizes all images of |request| in a single call. Returns false if the
+  // call itself failed, results of the items are in |response|.
+  bool OptimizeBatch(const squim::BatchRequest& request,
+                     squim::BatchResponse* response);
+
  private:
   std::unique_ptr<squim::ImageOptimizer::Stub> stub_;
 };
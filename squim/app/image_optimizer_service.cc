@@ -16,14 +16,18 @@
 
 #include "squim/app/image_optimizer_service.h"
 
+#include <algorithm>
+#include <chrono>
+#include <string>
+
 #include "squim/app/optimization.h"
 #include "squim/base/defer.h"
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
-#include "squim/base/strings/string_util.h"
+#include "squim/base/threading/thread_pool.h"
+#include "squim/image/optimization/decode_trigger.h"
 #include "squim/image/optimization/image_optimizer.h"
 #include "squim/io/buf_reader.h"
-#include "squim/io/buf_writer.h"
 #include "squim/io/buffered_source.h"
 #include "squim/io/chunk.h"
 #include "squim/io/writer.h"
@@ -31,62 +35,193 @@
 using grpc::Status;
 using grpc::ServerContext;
 using grpc::ServerReaderWriter;
+using squim::BatchRequest;
+using squim::BatchResponse;
 using squim::ImageRequestPart;
 using squim::ImageResponsePart;
 
 namespace {
 
-class ChunkBuffer : public io::VectorWriter {
+// Inputs up to this size declared in the request are received into a few large
+// buffers. Buffers are allocated as the data arrives, so the declared size
+// alone doesn't make the server allocate anything.
+const uint64_t kMaxReservedInputSize = 64 * 1024 * 1024;
+
+// Batches are meant for small images. Larger ones and larger batches are
+// rejected, so that a single call can't occupy the shared pool for long.
+const size_t kMaxBatchItems = 64;
+const size_t kMaxBatchItemSize = 256 * 1024;
+
+// Sends encoded data to the client as soon as a message worth of it is
+// produced, so that at most one message is buffered per request. The OK meta
+// goes out with the first message, and a failure after it is reported with an
+// error meta at the end of the stream, as described in the proto. Write() on
+// the synchronous stream blocks while the client's flow control window is
+// full, which pauses the encoder until the client catches up.
+//
+// Messages start at kMinMessageSize and double up to kMaxMessageSize while
+// the client accepts them without delay. A write that blocks for long drops
+// the size back, so slow clients don't make the server hold large buffers.
+class ResponseWriter : public io::VectorWriter {
  public:
-  ChunkBuffer(size_t chunk_size) {
-    auto receiver = base::make_unique<Receiver>(this);
-    writer_ = base::make_unique<io::BufWriter>(chunk_size, std::move(receiver));
+  static const size_t kMinMessageSize = 16 * 1024;
+  static const size_t kMaxMessageSize = 256 * 1024;
+
+  explicit ResponseWriter(
+      ServerReaderWriter<ImageResponsePart, ImageRequestPart>* stream)
+      : stream_(stream) {
+    pending_.reserve(message_size_);
   }
 
   io::IoResult WriteV(io::ChunkList chunks) override {
-    auto nwrite = 0;
-    for (auto& chunk : chunks) {
-      auto result = writer_->Write(chunk.get());
-      DCHECK(result.ok());
-      DCHECK_EQ(chunk->size(), result.n());
-      nwrite += result.n();
+    size_t nwrite = 0;
+    for (const auto& chunk : chunks) {
+      auto* data = reinterpret_cast<const char*>(chunk->data());
+      auto size = chunk->size();
+      while (size > 0) {
+        auto n = std::min(size, message_size_ - pending_.size());
+        pending_.append(data, n);
+        data += n;
+        size -= n;
+        if (pending_.size() == message_size_ && !SendPending())
+          return io::IoResult::Error("client has gone");
+      }
+      nwrite += chunk->size();
     }
     return io::IoResult::Write(nwrite);
   }
 
-  void Flush() {
-    auto result = writer_->Flush();
-    DCHECK(!result.pending());
+  // Sends the buffered data. Returns false if the stream is broken.
+  bool Flush() { return pending_.empty() || SendPending(); }
+
+ private:
+  // Writes that take less are considered fast.
+  static constexpr std::chrono::milliseconds kFastWrite{1};
+  // Writes that take longer mean the client can't keep up.
+  static constexpr std::chrono::milliseconds kSlowWrite{20};
+
+  bool SendPending() {
+    if (!started_) {
+      started_ = true;
+      ImageResponsePart response;
+      auto* meta = response.mutable_meta();
+      meta->set_code(ImageResponsePart::OK);
+      if (!stream_->Write(response))
+        return false;
+    }
+
+    ImageResponsePart response;
+    response.mutable_image_data()->mutable_bytes()->swap(pending_);
+    auto start = std::chrono::steady_clock::now();
+    if (!stream_->Write(response))
+      return false;
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (elapsed < kFastWrite) {
+      message_size_ = std::min(message_size_ * 2, kMaxMessageSize);
+    } else if (elapsed > kSlowWrite) {
+      message_size_ = kMinMessageSize;
+    }
+    pending_.clear();
+    pending_.reserve(message_size_);
+    return true;
   }
 
-  bool Empty() const { return buf_chain_.empty(); }
+  ServerReaderWriter<ImageResponsePart, ImageRequestPart>* stream_;
+  size_t message_size_ = kMinMessageSize;
+  std::string pending_;
+  bool started_ = false;
+};
+
+const size_t ResponseWriter::kMinMessageSize;
+const size_t ResponseWriter::kMaxMessageSize;
+constexpr std::chrono::milliseconds ResponseWriter::kFastWrite;
+constexpr std::chrono::milliseconds ResponseWriter::kSlowWrite;
+
+void FillStats(const image::ImageOptimizationStats& optimization_stats,
+               ImageResponsePart::Stats* stats) {
+  stats->set_psnr(optimization_stats.psnr);
+  stats->set_coded_size(optimization_stats.coded_size);
+  stats->set_num_process_calls(optimization_stats.num_process_calls);
+  stats->set_num_suspensions(optimization_stats.num_suspensions);
+}
 
-  io::ChunkPtr PopChunk() {
-    DCHECK(!Empty());
-    auto chunk = std::move(buf_chain_.front());
-    buf_chain_.pop_front();
-    return chunk;
+class StringWriter : public io::VectorWriter {
+ public:
+  explicit StringWriter(std::string* out) : out_(out) {}
+
+  io::IoResult WriteV(io::ChunkList chunks) override {
+    size_t nwrite = 0;
+    for (const auto& chunk : chunks) {
+      out_->append(reinterpret_cast<const char*>(chunk->data()),
+                   chunk->size());
+      nwrite += chunk->size();
+    }
+    return io::IoResult::Write(nwrite);
   }
 
  private:
-  class Receiver : public io::Writer {
-   public:
-    Receiver(ChunkBuffer* chunk_buffer) : chunk_buffer_(chunk_buffer) {}
+  std::string* out_;
+};
 
-    io::IoResult Write(io::Chunk* chunk) override {
-      chunk_buffer_->AddChunk(chunk->Clone());
-      return io::IoResult::Write(chunk->size());
-    }
+// Optimizes a single image of a batch, the whole image is in |request|.
+void OptimizeBatchItem(Optimization* optimization,
+                       const BatchRequest::Item& request,
+                       BatchResponse::Item* response) {
+  auto* meta = response->mutable_meta();
+  if (!request.has_meta()) {
+    meta->set_code(ImageResponsePart::CONTRACT_ERROR);
+    return;
+  }
 
-   private:
-    ChunkBuffer* chunk_buffer_;
-  };
+  if (request.image_data().size() > kMaxBatchItemSize) {
+    meta->set_code(ImageResponsePart::CONTRACT_ERROR);
+    meta->set_message("Image is too large for a batch");
+    return;
+  }
 
-  void AddChunk(io::ChunkPtr chunk) { buf_chain_.push_back(std::move(chunk)); }
+  // Items are already spread over the shared pool, codec threads would only
+  // compete with them.
+  Optimization::Options options;
+  options.single_threaded = true;
+  auto strategy =
+      optimization->CreateOptimizationStrategy(request.meta(), options);
+  if (!strategy) {
+    meta->set_code(ImageResponsePart::REJECTED);
+    return;
+  }
 
-  io::ChunkList buf_chain_;
-  std::unique_ptr<io::BufWriter> writer_;
-};
+  // The request outlives the optimizer, so its data is not copied.
+  const auto& data = request.image_data();
+  auto src = io::BufReader::CreateEmpty();
+  src->source()->AddChunk(io::Chunk::View(
+      reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+      data.size()));
+  src->source()->SendEof();
+  auto* output = response->mutable_image_data();
+  image::ImageOptimizer optimizer(
+      image::ImageOptimizer::DefaultImageTypeSelector, std::move(strategy),
+      std::move(src), base::make_unique<StringWriter>(output));
+
+  auto result = optimizer.Process();
+  if (!result.finished() || result.error()) {
+    output->clear();
+    meta->set_code(ImageResponsePart::ENCODE_ERROR);
+    meta->set_message(image::Result::CodeToString(result.code()));
+    return;
+  }
+
+  // Finished without producing an image, e.g. no size win.
+  if (!result.ok()) {
+    output->clear();
+    meta->set_code(ImageResponsePart::REJECTED);
+    meta->set_message(image::Result::CodeToString(result.code()));
+    return;
+  }
+
+  meta->set_code(ImageResponsePart::OK);
+  FillStats(optimizer.stats(), response->mutable_stats());
+}
 
 class SyncRequestHandler {
  public:
@@ -123,7 +258,7 @@ class SyncRequestHandler {
           return Status::OK;
         }
 
-        auto result = ProcessData(request_part);
+        auto result = ProcessData(&request_part);
         if (result.error()) {
           stream_->Write(CreateError(ImageResponsePart::ENCODE_ERROR));
           return Status::OK;
@@ -132,60 +267,55 @@ class SyncRequestHandler {
         if (result.finished()) {
           break;
         }
-
-        DrainOutput();
       }
     }
 
+    if (!optimizer_) {
+      stream_->Write(CreateError(ImageResponsePart::CONTRACT_ERROR));
+      return Status::OK;
+    }
+
+    // Data deferred by |decode_trigger_| is processed here, and truncated
+    // images fail instead of waiting for more data.
+    input_->source()->SendEof();
     auto result = optimizer_->Process();
     if (!result.finished()) {
       stream_->Write(CreateError(ImageResponsePart::ENCODE_ERROR));
       return Status::OK;
     }
 
-    output_->Flush();
-    DrainOutput();
+    // Finished without producing an image, e.g. no size win.
+    if (!result.ok()) {
+      stream_->Write(CreateError(ImageResponsePart::REJECTED));
+      return Status::OK;
+    }
+
+    if (!output_->Flush())
+      return Status::OK;
 
     ImageResponsePart trailer;
-    const auto& optimization_stats = optimizer_->stats();
-    auto* stats = trailer.mutable_stats();
-    stats->set_psnr(optimization_stats.psnr);
-    stats->set_coded_size(optimization_stats.coded_size);
-    // TODO: send stats.
+    FillStats(optimizer_->stats(), trailer.mutable_stats());
     stream_->Write(trailer);
 
     return Status::OK;
   }
 
  private:
-  void DrainOutput() {
-    while (!output_->Empty()) {
-      if (!response_started_) {
-        response_started_ = true;
-        ImageResponsePart response;
-        auto* meta = response.mutable_meta();
-        meta->set_code(ImageResponsePart::OK);
-        stream_->Write(response);
-      }
-      auto chunk = output_->PopChunk();
-      ImageResponsePart response;
-      auto* image_data = response.mutable_image_data();
-      image_data->set_bytes(
-          base::StringFromBytes(chunk->data(), chunk->size()).as_string());
-      stream_->Write(response);
-    }
-  }
-
   // TODO: more error description.
   bool ProcessHeader(const ImageRequestPart& header) {
     const auto& meta = header.meta();
-    if (meta.target_type() != squim::WEBP)
+    auto strategy = optimization_->CreateOptimizationStrategy(
+        meta, Optimization::Options());
+    if (!strategy)
       return false;
 
-    auto strategy = optimization_->CreateOptimizationStrategy(meta);
     auto src = io::BufReader::CreateEmpty();
     input_ = src.get();
-    auto dst = base::make_unique<ChunkBuffer>(16384);
+    if (meta.content_length() <= kMaxReservedInputSize)
+      input_->source()->Reserve(meta.content_length());
+    decode_trigger_ =
+        base::make_unique<image::DecodeTrigger>(meta.content_length());
+    auto dst = base::make_unique<ResponseWriter>(stream_);
     output_ = dst.get();
     optimizer_.reset(new image::ImageOptimizer(
         image::ImageOptimizer::DefaultImageTypeSelector, std::move(strategy),
@@ -193,11 +323,21 @@ class SyncRequestHandler {
     return true;
   }
 
-  image::Result ProcessData(const ImageRequestPart& data) {
+  image::Result ProcessData(ImageRequestPart* data) {
     DCHECK(optimizer_);
     DCHECK(input_);
-    std::string copy(data.image_data().bytes());
-    input_->source()->AddChunk(io::Chunk::FromString(std::move(copy)));
+    auto* bytes = data->mutable_image_data()->mutable_bytes();
+    auto size = bytes->size();
+    // Falls back to separate chunks if content length was wrong or not set.
+    if (!input_->source()->AppendToReserved(
+            reinterpret_cast<const uint8_t*>(bytes->data()), bytes->size())) {
+      std::string owned;
+      owned.swap(*bytes);
+      input_->source()->AddChunk(io::Chunk::FromString(std::move(owned)));
+    }
+    // Decoders suspend on small chunks and partly redo the work later.
+    if (!decode_trigger_->AddInput(size))
+      return image::Result::Pending();
     return optimizer_->Process();
   }
 
@@ -211,9 +351,9 @@ class SyncRequestHandler {
   Optimization* optimization_;
   ServerReaderWriter<ImageResponsePart, ImageRequestPart>* stream_;
   std::unique_ptr<image::ImageOptimizer> optimizer_;
+  std::unique_ptr<image::DecodeTrigger> decode_trigger_;
   io::BufReader* input_ = nullptr;
-  ChunkBuffer* output_ = nullptr;
-  bool response_started_ = false;
+  ResponseWriter* output_ = nullptr;
 };
 
 }  // namespace
@@ -227,3 +367,28 @@ Status ImageOptimizerService::OptimizeImage(
     ServerReaderWriter<ImageResponsePart, ImageRequestPart>* stream) {
   return SyncRequestHandler(optimization_.get(), stream).Handle();
 }
+
+Status ImageOptimizerService::OptimizeBatch(ServerContext* context,
+                                            const BatchRequest* request,
+                                            BatchResponse* response) {
+  auto num_items = static_cast<size_t>(request->items_size());
+  for (size_t i = 0; i < num_items; ++i)
+    response->add_items();
+
+  if (num_items > kMaxBatchItems) {
+    for (auto& item : *response->mutable_items()) {
+      item.mutable_meta()->set_code(ImageResponsePart::CONTRACT_ERROR);
+      item.mutable_meta()->set_message("Too many items in the batch");
+    }
+    return Status::OK;
+  }
+
+  // Concurrent batches share the pool, so the number of threads stays the
+  // same however many calls are in flight.
+  base::ThreadPool::Default()->ParallelFor(
+      num_items, 0, [this, request, response](size_t index) {
+        OptimizeBatchItem(optimization_.get(), request->items(index),
+                          response->mutable_items(index));
+      });
+  return Status::OK;
+}
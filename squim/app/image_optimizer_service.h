@@ -36,6 +36,10 @@ class ImageOptimizerService final : public squim::ImageOptimizer::Service {
       grpc::ServerReaderWriter<squim::ImageResponsePart,
                                squim::ImageRequestPart>* stream) override;
 
+  grpc::Status OptimizeBatch(grpc::ServerContext* context,
+                             const squim::BatchRequest* request,
+                             squim::BatchResponse* response) override;
+
   std::unique_ptr<Optimization> optimization_;
 };
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/app/image_stream_parts.h"
+
+#include <algorithm>
+
+using squim::ImageRequestPart;
+using squim::ImageResponsePart;
+
+RequestPartSplitter::RequestPartSplitter(const io::ChunkList* image,
+                                         size_t part_size)
+    : image_(image), current_chunk_(image->begin()), part_size_(part_size) {}
+
+bool RequestPartSplitter::Next(ImageRequestPart* part) {
+  while (current_chunk_ != image_->end() &&
+         offset_in_chunk_ == (*current_chunk_)->size()) {
+    ++current_chunk_;
+    offset_in_chunk_ = 0;
+  }
+  if (current_chunk_ == image_->end())
+    return false;
+
+  const auto& chunk = *current_chunk_;
+  auto size = std::min(part_size_, chunk->size() - offset_in_chunk_);
+  part->mutable_image_data()->set_bytes(chunk->data() + offset_in_chunk_,
+                                        size);
+  offset_in_chunk_ += size;
+  return true;
+}
+
+ResponsePartCollector::ResponsePartCollector() {}
+
+void ResponsePartCollector::Add(ImageResponsePart* part) {
+  if (part->has_meta()) {
+    if (got_meta_)
+      image_.clear();
+    got_meta_ = true;
+    code_ = part->meta().code();
+    message_ = part->meta().message();
+  } else if (part->has_image_data()) {
+    std::string bytes;
+    bytes.swap(*part->mutable_image_data()->mutable_bytes());
+    image_.push_back(io::Chunk::FromString(std::move(bytes)));
+  } else if (part->has_stats()) {
+    stats_ = part->stats();
+  }
+}
+
+void ResponsePartCollector::Finish() {
+  if (!got_meta_) {
+    code_ = ImageResponsePart::CONTRACT_ERROR;
+    message_ = "No status part";
+  }
+}
+
+io::ChunkList ResponsePartCollector::TakeImage() {
+  io::ChunkList image;
+  if (code_ == ImageResponsePart::OK)
+    image.swap(image_);
+  return image;
+}
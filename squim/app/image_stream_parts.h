@@ -0,0 +1,76 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_APP_IMAGE_STREAM_PARTS_H_
+#define SQUIM_APP_IMAGE_STREAM_PARTS_H_
+
+#include <string>
+
+#include "proto/image_optimizer.pb.h"
+#include "squim/base/make_noncopyable.h"
+#include "squim/io/chunk.h"
+
+// Cuts an image held in memory into image_data request parts.
+class RequestPartSplitter {
+  MAKE_NONCOPYABLE(RequestPartSplitter);
+
+ public:
+  // |image| must outlive the splitter. Parts hold at most |part_size| bytes
+  // and never span two chunks.
+  RequestPartSplitter(const io::ChunkList* image, size_t part_size);
+
+  // Puts the next part into |part|. Returns false if everything is taken.
+  bool Next(squim::ImageRequestPart* part);
+
+ private:
+  const io::ChunkList* image_;
+  io::ChunkList::const_iterator current_chunk_;
+  size_t offset_in_chunk_ = 0;
+  const size_t part_size_;
+};
+
+// Collects the response parts of an OptimizeImage call. See ImageResponsePart
+// for the order they come in.
+class ResponsePartCollector {
+  MAKE_NONCOPYABLE(ResponsePartCollector);
+
+ public:
+  ResponsePartCollector();
+
+  // Takes in the next part, image bytes are moved out of |part|. A meta part
+  // after the image data reports a failure, the data received so far is
+  // dropped then.
+  void Add(squim::ImageResponsePart* part);
+
+  // Must be called once the stream has ended successfully. Turns a response
+  // without a meta part into CONTRACT_ERROR.
+  void Finish();
+
+  squim::ImageResponsePart::Result code() const { return code_; }
+  const std::string& message() const { return message_; }
+  const squim::ImageResponsePart_Stats& stats() const { return stats_; }
+  // Empty unless code() is OK.
+  io::ChunkList TakeImage();
+
+ private:
+  bool got_meta_ = false;
+  squim::ImageResponsePart::Result code_ = squim::ImageResponsePart::OK;
+  std::string message_;
+  io::ChunkList image_;
+  squim::ImageResponsePart_Stats stats_;
+};
+
+#endif  // SQUIM_APP_IMAGE_STREAM_PARTS_H_
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/app/image_stream_parts.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using squim::ImageRequestPart;
+using squim::ImageResponsePart;
+
+namespace {
+
+ImageResponsePart MetaPart(ImageResponsePart::Result code,
+                           const std::string& message) {
+  ImageResponsePart part;
+  part.mutable_meta()->set_code(code);
+  part.mutable_meta()->set_message(message);
+  return part;
+}
+
+ImageResponsePart DataPart(const std::string& bytes) {
+  ImageResponsePart part;
+  part.mutable_image_data()->set_bytes(bytes);
+  return part;
+}
+
+ImageResponsePart StatsPart(uint32_t coded_size) {
+  ImageResponsePart part;
+  part.mutable_stats()->set_coded_size(coded_size);
+  return part;
+}
+
+std::string ToString(const io::ChunkList& chunks) {
+  std::string result;
+  for (const auto& chunk : chunks)
+    result.append(reinterpret_cast<const char*>(chunk->data()), chunk->size());
+  return result;
+}
+
+std::vector<std::string> Split(const io::ChunkList& image, size_t part_size) {
+  RequestPartSplitter splitter(&image, part_size);
+  std::vector<std::string> parts;
+  ImageRequestPart part;
+  while (splitter.Next(&part)) {
+    EXPECT_TRUE(part.has_image_data());
+    parts.push_back(part.image_data().bytes());
+    part.Clear();
+  }
+  // Stays at the end.
+  EXPECT_FALSE(splitter.Next(&part));
+  return parts;
+}
+
+}  // namespace
+
+TEST(RequestPartSplitterTest, SplitsChunks) {
+  io::ChunkList image;
+  image.push_back(io::Chunk::FromString("abcde"));
+  image.push_back(io::Chunk::FromString(""));
+  image.push_back(io::Chunk::FromString("0123456789"));
+
+  EXPECT_EQ((std::vector<std::string>{"abcd", "e", "0123", "4567", "89"}),
+            Split(image, 4));
+  EXPECT_EQ((std::vector<std::string>{"abcde", "0123456789"}),
+            Split(image, 100));
+  EXPECT_EQ(15u, Split(image, 1).size());
+}
+
+TEST(RequestPartSplitterTest, HandlesEmptyImage) {
+  io::ChunkList image;
+  EXPECT_TRUE(Split(image, 4).empty());
+  image.push_back(io::Chunk::FromString(""));
+  EXPECT_TRUE(Split(image, 4).empty());
+}
+
+TEST(ResponsePartCollectorTest, CollectsImage) {
+  ResponsePartCollector collector;
+  for (auto part : {MetaPart(ImageResponsePart::OK, ""), DataPart("abc"),
+                    DataPart("def"), StatsPart(6)}) {
+    collector.Add(&part);
+  }
+  collector.Finish();
+
+  EXPECT_EQ(ImageResponsePart::OK, collector.code());
+  EXPECT_EQ(6u, collector.stats().coded_size());
+  EXPECT_EQ("abcdef", ToString(collector.TakeImage()));
+}
+
+TEST(ResponsePartCollectorTest, DropsImageOnMetaAfterData) {
+  ResponsePartCollector collector;
+  for (auto part : {MetaPart(ImageResponsePart::OK, ""), DataPart("abc"),
+                    MetaPart(ImageResponsePart::ENCODE_ERROR, "Failed")}) {
+    collector.Add(&part);
+  }
+  collector.Finish();
+
+  EXPECT_EQ(ImageResponsePart::ENCODE_ERROR, collector.code());
+  EXPECT_EQ("Failed", collector.message());
+  EXPECT_TRUE(collector.TakeImage().empty());
+}
+
+TEST(ResponsePartCollectorTest, ReportsError) {
+  ResponsePartCollector collector;
+  auto part = MetaPart(ImageResponsePart::DECODE_ERROR, "Bad image");
+  collector.Add(&part);
+  collector.Finish();
+
+  EXPECT_EQ(ImageResponsePart::DECODE_ERROR, collector.code());
+  EXPECT_EQ("Bad image", collector.message());
+  EXPECT_TRUE(collector.TakeImage().empty());
+}
+
+TEST(ResponsePartCollectorTest, RequiresMeta) {
+  ResponsePartCollector collector;
+  auto part = DataPart("abc");
+  collector.Add(&part);
+  collector.Finish();
+
+  EXPECT_EQ(ImageResponsePart::CONTRACT_ERROR, collector.code());
+  EXPECT_TRUE(collector.TakeImage().empty());
+}
@@ -18,11 +18,17 @@
 
 #include "squim/app/optimizers/check_is_photo.h"
 #include "squim/app/optimizers/metadata_handler.h"
+#include "squim/app/optimizers/single_threaded.h"
+#include "squim/app/optimizers/squim_jpeg.h"
+#include "squim/app/optimizers/squim_png.h"
 #include "squim/app/optimizers/squim_webp.h"
 #include "squim/app/optimizers/try_strip_alpha.h"
 #include "squim/image/optimization/convert_to_webp_strategy.h"
 #include "squim/image/optimization/strategy_builder.h"
 #include "squim/image/optimization/default_codec_factory.h"
+#include "squim/image/optimization/recompress_gif_strategy.h"
+#include "squim/image/optimization/recompress_png_strategy.h"
+#include "squim/image/optimization/transcode_jpeg_strategy.h"
 
 WebPOptimization::WebPOptimization() {}
 
@@ -30,10 +36,17 @@ WebPOptimization::~WebPOptimization() {}
 
 std::unique_ptr<image::OptimizationStrategy>
 WebPOptimization::CreateOptimizationStrategy(
-    const squim::ImageRequestPart_Meta& request) {
+    const squim::ImageRequestPart_Meta& request,
+    const Options& options) {
+  auto min_recompression_gain =
+      image::ConvertToWebPStrategy::kDefaultMinRecompressionGain;
+  if (request.min_recompression_gain() > 0 &&
+      request.min_recompression_gain() < 1)
+    min_recompression_gain = request.min_recompression_gain();
+
   image::StrategyBuilder builder;
   builder.UseCodecFactoryBuilder(image::DefaultCodecFactory::Builder)
-      .SetBaseStrategy<image::ConvertToWebPStrategy>()
+      .SetBaseStrategy<image::ConvertToWebPStrategy>(min_recompression_gain)
       .AddLayer<SquimWebP>(request)
       .AddLayer<MetadataHandler>(request);
   if (request.try_strip_alpha())
@@ -42,5 +55,78 @@ WebPOptimization::CreateOptimizationStrategy(
   if (request.min_photo_metric() > 0)
     builder.AddLayer<CheckIsPhoto>(request);
 
+  if (options.single_threaded)
+    builder.AddLayer<SingleThreaded>();
+
+  return builder.Build();
+}
+
+JpegOptimization::JpegOptimization() {}
+
+JpegOptimization::~JpegOptimization() {}
+
+std::unique_ptr<image::OptimizationStrategy>
+JpegOptimization::CreateOptimizationStrategy(
+    const squim::ImageRequestPart_Meta& request,
+    const Options& options) {
+  image::StrategyBuilder builder;
+  builder.UseCodecFactoryBuilder(image::DefaultCodecFactory::Builder)
+      .SetBaseStrategy<image::TranscodeJpegStrategy>()
+      .AddLayer<SquimJpeg>(request);
   return builder.Build();
 }
+
+PngOptimization::PngOptimization() {}
+
+PngOptimization::~PngOptimization() {}
+
+std::unique_ptr<image::OptimizationStrategy>
+PngOptimization::CreateOptimizationStrategy(
+    const squim::ImageRequestPart_Meta& request,
+    const Options& options) {
+  image::StrategyBuilder builder;
+  builder.UseCodecFactoryBuilder(image::DefaultCodecFactory::Builder)
+      .SetBaseStrategy<image::RecompressPngStrategy>()
+      .AddLayer<SquimPng>(request);
+  if (options.single_threaded)
+    builder.AddLayer<SingleThreaded>();
+  return builder.Build();
+}
+
+GifOptimization::GifOptimization() {}
+
+GifOptimization::~GifOptimization() {}
+
+std::unique_ptr<image::OptimizationStrategy>
+GifOptimization::CreateOptimizationStrategy(
+    const squim::ImageRequestPart_Meta& request,
+    const Options& options) {
+  image::StrategyBuilder builder;
+  builder.UseCodecFactoryBuilder(image::DefaultCodecFactory::Builder)
+      .SetBaseStrategy<image::RecompressGifStrategy>();
+  if (options.single_threaded)
+    builder.AddLayer<SingleThreaded>();
+  return builder.Build();
+}
+
+DefaultOptimization::DefaultOptimization() {}
+
+DefaultOptimization::~DefaultOptimization() {}
+
+std::unique_ptr<image::OptimizationStrategy>
+DefaultOptimization::CreateOptimizationStrategy(
+    const squim::ImageRequestPart_Meta& request,
+    const Options& options) {
+  switch (request.target_type()) {
+    case squim::WEBP:
+      return webp_.CreateOptimizationStrategy(request, options);
+    case squim::JPEG:
+      return jpeg_.CreateOptimizationStrategy(request, options);
+    case squim::PNG:
+      return png_.CreateOptimizationStrategy(request, options);
+    case squim::GIF:
+      return gif_.CreateOptimizationStrategy(request, options);
+    default:
+      return std::unique_ptr<image::OptimizationStrategy>();
+  }
+}
@@ -24,8 +24,15 @@
 
 class Optimization {
  public:
+  struct Options {
+    // Run codecs on the calling thread only. Set when many images are
+    // optimized in parallel anyway, e.g. items of a batch.
+    bool single_threaded = false;
+  };
+
   virtual std::unique_ptr<image::OptimizationStrategy>
-  CreateOptimizationStrategy(const squim::ImageRequestPart_Meta& request) = 0;
+  CreateOptimizationStrategy(const squim::ImageRequestPart_Meta& request,
+                             const Options& options) = 0;
 
   virtual ~Optimization() {}
 };
@@ -36,7 +43,60 @@ class WebPOptimization : public Optimization {
   ~WebPOptimization() override;
 
   std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
-      const squim::ImageRequestPart_Meta& request) override;
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override;
+};
+
+// Lossless JPEG to JPEG optimization.
+class JpegOptimization : public Optimization {
+ public:
+  JpegOptimization();
+  ~JpegOptimization() override;
+
+  std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override;
+};
+
+// Lossless PNG to PNG optimization.
+class PngOptimization : public Optimization {
+ public:
+  PngOptimization();
+  ~PngOptimization() override;
+
+  std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override;
+};
+
+// GIF to GIF optimization: frames are cropped to changed areas, duplicates are
+// merged and color tables are trimmed.
+class GifOptimization : public Optimization {
+ public:
+  GifOptimization();
+  ~GifOptimization() override;
+
+  std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override;
+};
+
+// Selects optimization by request's target type. Returns null strategy for
+// unsupported targets.
+class DefaultOptimization : public Optimization {
+ public:
+  DefaultOptimization();
+  ~DefaultOptimization() override;
+
+  std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override;
+
+ private:
+  WebPOptimization webp_;
+  JpegOptimization jpeg_;
+  PngOptimization png_;
+  GifOptimization gif_;
 };
 
 #endif  // SQUIM_APP_OPTIMIZATION_H_
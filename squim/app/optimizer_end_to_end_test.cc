@@ -19,16 +19,27 @@
 #include <atomic>
 #include <iterator>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "grpc++/grpc++.h"
+#include "squim/app/async_image_optimizer_client.h"
 #include "squim/app/image_optimizer_client.h"
 #include "squim/app/optimization.h"
 #include "squim/app/request_builder.h"
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/gif_decoder.h"
+#include "squim/image/decoding_reader.h"
+#include "squim/image/image_writer.h"
+#include "squim/image/optimization/optimization_strategy.h"
+#include "squim/image/result.h"
+#include "squim/io/buf_reader.h"
 #include "squim/io/chunk.h"
+#include "squim/io/writer.h"
 #include "squim/ioutil/file_util.h"
 #include "squim/ioutil/chunk_reader.h"
 #include "squim/ioutil/chunk_writer.h"
@@ -45,6 +56,8 @@ using grpc::InsecureChannelCredentials;
 using grpc::InsecureServerCredentials;
 using grpc::Server;
 using grpc::ServerBuilder;
+using squim::BatchRequest;
+using squim::BatchResponse;
 using squim::ImageOptimizer;
 using squim::ImageRequestPart;
 using squim::ImageResponsePart;
@@ -52,6 +65,208 @@ using squim::ImageResponsePart_Stats;
 
 namespace {
 const char kServerAddress[] = "0.0.0.0:50051";
+
+// Writes a few response messages worth of data for the first frame, then
+// fails, like an encoder failing after its output has been streamed.
+class FailingWriter : public image::ImageWriter {
+ public:
+  static const size_t kOutputSize = 256 * 1024;
+
+  explicit FailingWriter(std::unique_ptr<io::VectorWriter> dest)
+      : dest_(std::move(dest)) {}
+
+  image::Result Initialize(const image::ImageInfo* image_info) override {
+    return image::Result::Ok();
+  }
+
+  void SetMetadata(const image::ImageMetadata* metadata) override {}
+
+  image::Result WriteFrame(image::ImageFrame* frame) override {
+    num_frames_++;
+    io::ChunkList chunks;
+    chunks.push_back(io::Chunk::FromString(std::string(kOutputSize, 'x')));
+    return image::Result::FromIoResult(dest_->WriteV(std::move(chunks)),
+                                       false);
+  }
+
+  image::Result FinishWrite(image::ImageOptimizationStats* stats) override {
+    return image::Result::Error(image::Result::Code::kEncodeError);
+  }
+
+  size_t GetNumberOfFramesConsumed() const override { return num_frames_; }
+
+ private:
+  std::unique_ptr<io::VectorWriter> dest_;
+  size_t num_frames_ = 0;
+};
+
+const size_t FailingWriter::kOutputSize;
+
+// WebP optimization with FailingWriter instead of the encoder.
+class FailingStrategy : public image::OptimizationStrategy {
+ public:
+  explicit FailingStrategy(std::unique_ptr<image::OptimizationStrategy> base)
+      : base_(std::move(base)) {}
+
+  image::Result ShouldEvenBother() override {
+    return base_->ShouldEvenBother();
+  }
+
+  image::Result CreateImageReader(
+      image::ImageType image_type,
+      std::unique_ptr<io::BufReader> src,
+      std::unique_ptr<image::ImageReader>* reader) override {
+    return base_->CreateImageReader(image_type, std::move(src), reader);
+  }
+
+  image::Result CreateImageWriter(
+      std::unique_ptr<io::VectorWriter> dest,
+      image::ImageReader* reader,
+      std::unique_ptr<image::ImageWriter>* writer) override {
+    writer->reset(new FailingWriter(std::move(dest)));
+    return image::Result::Ok();
+  }
+
+  image::Result AdjustImageReaderAfterInfoReady(
+      std::unique_ptr<image::ImageReader>* reader) override {
+    return base_->AdjustImageReaderAfterInfoReady(reader);
+  }
+
+  bool ShouldWaitForMetadata() override {
+    return base_->ShouldWaitForMetadata();
+  }
+
+ private:
+  std::unique_ptr<image::OptimizationStrategy> base_;
+};
+
+class FailingOptimization : public Optimization {
+ public:
+  std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override {
+    auto strategy = webp_.CreateOptimizationStrategy(request, options);
+    if (!strategy)
+      return nullptr;
+    return base::make_unique<FailingStrategy>(std::move(strategy));
+  }
+
+ private:
+  WebPOptimization webp_;
+};
+
+// Passes everything to |writer|. Stores the number of GIF frames |decoder| has
+// decoded in parallel when the image is finished.
+class DeferredFramesWriter : public image::ImageWriter {
+ public:
+  DeferredFramesWriter(std::unique_ptr<image::ImageWriter> writer,
+                       const image::GifDecoder* decoder,
+                       std::atomic<size_t>* num_deferred_frames)
+      : writer_(std::move(writer)),
+        decoder_(decoder),
+        num_deferred_frames_(num_deferred_frames) {}
+
+  image::Result Initialize(const image::ImageInfo* image_info) override {
+    return writer_->Initialize(image_info);
+  }
+
+  void SetMetadata(const image::ImageMetadata* metadata) override {
+    writer_->SetMetadata(metadata);
+  }
+
+  image::Result WriteFrame(image::ImageFrame* frame) override {
+    return writer_->WriteFrame(frame);
+  }
+
+  image::Result FinishWrite(image::ImageOptimizationStats* stats) override {
+    *num_deferred_frames_ = decoder_->num_deferred_frames();
+    return writer_->FinishWrite(stats);
+  }
+
+  size_t GetNumberOfFramesConsumed() const override {
+    return writer_->GetNumberOfFramesConsumed();
+  }
+
+ private:
+  std::unique_ptr<image::ImageWriter> writer_;
+  const image::GifDecoder* decoder_;
+  std::atomic<size_t>* num_deferred_frames_;
+};
+
+// WebP optimization decoding GIFs on all threads, with DeferredFramesWriter
+// around the encoder.
+class DeferredFramesStrategy : public image::OptimizationStrategy {
+ public:
+  DeferredFramesStrategy(std::unique_ptr<image::OptimizationStrategy> base,
+                         std::atomic<size_t>* num_deferred_frames)
+      : base_(std::move(base)), num_deferred_frames_(num_deferred_frames) {}
+
+  image::Result ShouldEvenBother() override {
+    return base_->ShouldEvenBother();
+  }
+
+  image::Result CreateImageReader(
+      image::ImageType image_type,
+      std::unique_ptr<io::BufReader> src,
+      std::unique_ptr<image::ImageReader>* reader) override {
+    if (image_type != image::ImageType::kGif)
+      return base_->CreateImageReader(image_type, std::move(src), reader);
+
+    auto params = image::GifDecoder::Params::Default();
+    params.max_decode_threads = 0;
+    auto decoder = base::make_unique<image::GifDecoder>(params, std::move(src));
+    decoder_ = decoder.get();
+    reader->reset(new image::DecodingReader(std::move(decoder)));
+    return image::Result::Ok();
+  }
+
+  image::Result CreateImageWriter(
+      std::unique_ptr<io::VectorWriter> dest,
+      image::ImageReader* reader,
+      std::unique_ptr<image::ImageWriter>* writer) override {
+    auto result = base_->CreateImageWriter(std::move(dest), reader, writer);
+    if (result.ok() && decoder_) {
+      writer->reset(new DeferredFramesWriter(std::move(*writer), decoder_,
+                                             num_deferred_frames_));
+    }
+    return result;
+  }
+
+  image::Result AdjustImageReaderAfterInfoReady(
+      std::unique_ptr<image::ImageReader>* reader) override {
+    return base_->AdjustImageReaderAfterInfoReady(reader);
+  }
+
+  bool ShouldWaitForMetadata() override {
+    return base_->ShouldWaitForMetadata();
+  }
+
+ private:
+  std::unique_ptr<image::OptimizationStrategy> base_;
+  std::atomic<size_t>* num_deferred_frames_;
+  const image::GifDecoder* decoder_ = nullptr;
+};
+
+class DeferredFramesOptimization : public Optimization {
+ public:
+  explicit DeferredFramesOptimization(std::atomic<size_t>* num_deferred_frames)
+      : num_deferred_frames_(num_deferred_frames) {}
+
+  std::unique_ptr<image::OptimizationStrategy> CreateOptimizationStrategy(
+      const squim::ImageRequestPart_Meta& request,
+      const Options& options) override {
+    auto strategy = webp_.CreateOptimizationStrategy(request, options);
+    if (!strategy)
+      return nullptr;
+    return base::make_unique<DeferredFramesStrategy>(std::move(strategy),
+                                                     num_deferred_frames_);
+  }
+
+ private:
+  WebPOptimization webp_;
+  std::atomic<size_t>* num_deferred_frames_;
+};
+
 }  // namespace
 
 class OptimizerEndToEndTest : public testing::Test {
@@ -59,8 +274,11 @@ class OptimizerEndToEndTest : public testing::Test {
   void TearDown() override { StopServerIfNecessary(); }
 
   bool StartServer() {
-    service_.reset(
-        new ImageOptimizerService(base::make_unique<WebPOptimization>()));
+    return StartServer(base::make_unique<WebPOptimization>());
+  }
+
+  bool StartServer(std::unique_ptr<Optimization> optimization) {
+    service_.reset(new ImageOptimizerService(std::move(optimization)));
     ServerBuilder builder;
     builder.AddListeningPort(kServerAddress, InsecureServerCredentials());
     builder.RegisterService(service_.get());
@@ -100,6 +318,182 @@ TEST_F(OptimizerEndToEndTest, SimpleTest) {
   EXPECT_LT(merged_out->size(), merged_in->size());
 }
 
+TEST_F(OptimizerEndToEndTest, Async) {
+  ASSERT_TRUE(StartServer());
+
+  io::ChunkList jpeg;
+  ASSERT_TRUE(ioutil::ReadFile("squim/app/testdata/test.jpg", &jpeg).ok());
+  auto merged_in = io::Chunk::Merge(jpeg);
+
+  const size_t kNumImages = 8;
+  std::vector<std::future<AsyncOptimizationResult>> results;
+  {
+    AsyncImageOptimizerClient client(kServerAddress, 2);
+    auto request_builder = RequestBuilder().SetRecordStats(true).SetQuality(40);
+    for (size_t i = 0; i < kNumImages; ++i) {
+      io::ChunkList image;
+      image.push_back(io::Chunk::Copy(merged_in->data(), merged_in->size()));
+      results.push_back(
+          client.OptimizeImage(&request_builder, std::move(image), 512));
+    }
+
+    io::ChunkList not_an_image;
+    not_an_image.push_back(io::Chunk::FromString("not an image"));
+    std::promise<AsyncOptimizationResult> failed;
+    client.OptimizeImage(&request_builder, std::move(not_an_image), 512,
+                         [&failed](AsyncOptimizationResult result) {
+                           failed.set_value(std::move(result));
+                         });
+    auto failed_result = failed.get_future().get();
+    EXPECT_TRUE(failed_result.status.ok());
+    EXPECT_FALSE(failed_result.ok());
+  }
+
+  for (auto& future : results) {
+    auto result = future.get();
+    ASSERT_TRUE(result.ok()) << result.status.error_message();
+    EXPECT_LT(30, result.stats.psnr());
+    EXPECT_LT(io::Chunk::Merge(result.image)->size(), merged_in->size());
+  }
+}
+
+TEST_F(OptimizerEndToEndTest, ErrorAfterImageData) {
+  ASSERT_TRUE(StartServer(base::make_unique<FailingOptimization>()));
+
+  io::ChunkList jpeg;
+  ASSERT_TRUE(ioutil::ReadFile("squim/app/testdata/test.jpg", &jpeg).ok());
+  auto merged_in = io::Chunk::Merge(jpeg);
+  auto request = RequestBuilder().SetQuality(40).Build();
+
+  // The server sends OK meta and data, then an error meta instead of stats.
+  auto channel = CreateChannel(kServerAddress, InsecureChannelCredentials());
+  auto stub = ImageOptimizer::NewStub(channel);
+  ClientContext context;
+  auto stream = stub->OptimizeImage(&context);
+  ASSERT_TRUE(stream->Write(request));
+  ImageRequestPart data;
+  data.mutable_image_data()->set_bytes(merged_in->data(), merged_in->size());
+  ASSERT_TRUE(stream->Write(data));
+  ASSERT_TRUE(stream->WritesDone());
+
+  std::vector<ImageResponsePart> parts;
+  ImageResponsePart part;
+  while (stream->Read(&part))
+    parts.push_back(part);
+  EXPECT_TRUE(stream->Finish().ok());
+  ASSERT_LE(3u, parts.size());
+  ASSERT_TRUE(parts.front().has_meta());
+  EXPECT_EQ(ImageResponsePart::OK, parts.front().meta().code());
+  EXPECT_TRUE(parts[1].has_image_data());
+  ASSERT_TRUE(parts.back().has_meta());
+  EXPECT_EQ(ImageResponsePart::ENCODE_ERROR, parts.back().meta().code());
+  for (const auto& part : parts)
+    EXPECT_FALSE(part.has_stats());
+
+  // Clients report the failure and drop the data.
+  ImageOptimizerClient client(channel);
+  io::ChunkList out;
+  ioutil::ChunkListReader in(&jpeg);
+  ioutil::ChunkListWriter writer(&out);
+  auto request_builder = RequestBuilder().SetQuality(40);
+  EXPECT_FALSE(client.OptimizeImage(&request_builder, &in, 512, &writer,
+                                    nullptr));
+
+  AsyncImageOptimizerClient async_client(kServerAddress, 1);
+  io::ChunkList image;
+  image.push_back(io::Chunk::Copy(merged_in->data(), merged_in->size()));
+  auto result =
+      async_client.OptimizeImage(&request_builder, std::move(image), 512).get();
+  EXPECT_TRUE(result.status.ok());
+  EXPECT_EQ(ImageResponsePart::ENCODE_ERROR, result.code);
+  EXPECT_TRUE(result.image.empty());
+}
+
+TEST_F(OptimizerEndToEndTest, GifWithContentLengthIsDecodedInParallel) {
+  std::atomic<size_t> num_deferred_frames(0);
+  ASSERT_TRUE(StartServer(
+      base::make_unique<DeferredFramesOptimization>(&num_deferred_frames)));
+
+  io::ChunkList gif;
+  ASSERT_TRUE(ioutil::ReadFile("squim/app/testdata/animated.gif", &gif).ok());
+  // The client sets content_length. The server gets the end of the stream
+  // only after the last message, which is when it decodes the whole image.
+  AsyncImageOptimizerClient client(kServerAddress, 1);
+  auto request_builder = RequestBuilder().SetQuality(40);
+  auto result =
+      client.OptimizeImage(&request_builder, std::move(gif), 512).get();
+  ASSERT_TRUE(result.status.ok()) << result.status.error_message();
+  // Frames not parsed from the first message are decoded in parallel.
+  EXPECT_LT(0u, num_deferred_frames.load());
+}
+
+TEST_F(OptimizerEndToEndTest, Batch) {
+  ASSERT_TRUE(StartServer());
+
+  ImageOptimizerClient client(
+      CreateChannel(kServerAddress, InsecureChannelCredentials()));
+
+  io::ChunkList jpeg;
+  ASSERT_TRUE(ioutil::ReadFile("squim/app/testdata/test.jpg", &jpeg).ok());
+  auto merged_in = io::Chunk::Merge(jpeg);
+  auto meta =
+      RequestBuilder().SetRecordStats(true).SetQuality(40).Build().meta();
+
+  const int kNumImages = 3;
+  BatchRequest request;
+  for (int i = 0; i < kNumImages; ++i) {
+    auto* item = request.add_items();
+    *item->mutable_meta() = meta;
+    item->set_image_data(merged_in->data(), merged_in->size());
+  }
+  auto* not_an_image = request.add_items();
+  *not_an_image->mutable_meta() = meta;
+  not_an_image->set_image_data("not an image");
+
+  BatchResponse response;
+  ASSERT_TRUE(client.OptimizeBatch(request, &response));
+  ASSERT_EQ(kNumImages + 1, response.items_size());
+  for (int i = 0; i < kNumImages; ++i) {
+    const auto& item = response.items(i);
+    EXPECT_EQ(ImageResponsePart::OK, item.meta().code());
+    EXPECT_LT(item.image_data().size(), merged_in->size());
+    EXPECT_LT(30, item.stats().psnr());
+  }
+  const auto& failed = response.items(kNumImages);
+  EXPECT_EQ(ImageResponsePart::ENCODE_ERROR, failed.meta().code());
+  EXPECT_TRUE(failed.image_data().empty());
+}
+
+TEST_F(OptimizerEndToEndTest, BatchLimits) {
+  ASSERT_TRUE(StartServer());
+
+  ImageOptimizerClient client(
+      CreateChannel(kServerAddress, InsecureChannelCredentials()));
+  auto meta = RequestBuilder().SetQuality(40).Build().meta();
+
+  BatchRequest large_item;
+  auto* item = large_item.add_items();
+  *item->mutable_meta() = meta;
+  item->set_image_data(std::string(1024 * 1024, 'x'));
+  BatchResponse response;
+  ASSERT_TRUE(client.OptimizeBatch(large_item, &response));
+  ASSERT_EQ(1, response.items_size());
+  EXPECT_EQ(ImageResponsePart::CONTRACT_ERROR,
+            response.items(0).meta().code());
+
+  BatchRequest many_items;
+  for (int i = 0; i < 1000; ++i) {
+    auto* item = many_items.add_items();
+    *item->mutable_meta() = meta;
+    item->set_image_data("not an image");
+  }
+  response.Clear();
+  ASSERT_TRUE(client.OptimizeBatch(many_items, &response));
+  ASSERT_EQ(1000, response.items_size());
+  for (const auto& item : response.items())
+    EXPECT_EQ(ImageResponsePart::CONTRACT_ERROR, item.meta().code());
+}
+
 TEST_F(OptimizerEndToEndTest, DISABLED_Regressions) {
   ASSERT_TRUE(StartServer());
   ImageOptimizerClient client(
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2016 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_APP_OPTIMIZERS_SINGLE_THREADED_H_
+#define SQUIM_APP_OPTIMIZERS_SINGLE_THREADED_H_
+
+#include "squim/image/optimization/layered_adjuster.h"
+
+// Makes codecs do all the work on the calling thread: GIF frames are decoded
+// one by one and PNG trials are run in turn.
+class SingleThreaded : public image::LayeredAdjuster::Layer {
+ public:
+  void AdjustGifDecoderParams(image::GifDecoder::Params* params) override;
+  void AdjustPngEncoderParams(image::PngEncoder::Params* params) override;
+};
+
+#endif  // SQUIM_APP_OPTIMIZERS_SINGLE_THREADED_H_
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/app/optimizers/squim_jpeg.h"
+
+SquimJpeg::SquimJpeg(const squim::ImageRequestPart_Meta& request)
+    : request_(request) {}
+
+void SquimJpeg::AdjustJpegTranscoderParams(
+    image::JpegTranscoder::Params* params) {
+  params->progressive = request_.jpeg_params().progressive();
+  params->write_iccp = !request_.strip_iccp();
+  params->write_exif = !request_.strip_exif();
+  params->write_xmp = !request_.strip_xmp();
+}
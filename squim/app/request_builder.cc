@@ -17,6 +17,7 @@
 #include "squim/app/request_builder.h"
 
 RequestBuilder::RequestBuilder() {
+  request_.mutable_meta()->set_target_type(squim::WEBP);
   auto* webp_params = request_.mutable_meta()->mutable_webp_params();
   webp_params->set_quality(50.0);
 }
@@ -43,7 +44,26 @@ RequestBuilder& RequestBuilder::SetRecordStats(bool record_stats) {
   return *this;
 }
 
+RequestBuilder& RequestBuilder::SetTargetType(squim::ImageType type) {
+  request_.mutable_meta()->set_target_type(type);
+  return *this;
+}
+
+RequestBuilder& RequestBuilder::SetJpegProgressive(bool progressive) {
+  request_.mutable_meta()->mutable_jpeg_params()->set_progressive(progressive);
+  return *this;
+}
+
+RequestBuilder& RequestBuilder::SetPngOptimizationLevel(int level) {
+  request_.mutable_meta()->mutable_png_params()->set_optimization_level(level);
+  return *this;
+}
+
+RequestBuilder& RequestBuilder::SetContentLength(uint64_t content_length) {
+  request_.mutable_meta()->set_content_length(content_length);
+  return *this;
+}
+
 squim::ImageRequestPart RequestBuilder::Build() {
-  request_.mutable_meta()->set_target_type(squim::WEBP);
   return request_;
 }
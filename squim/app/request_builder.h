@@ -28,6 +28,10 @@ class RequestBuilder {
   RequestBuilder& SetWebPCompression(
       squim::ImageRequestPart::WebPCompressionType type);
   RequestBuilder& SetRecordStats(bool record_stats);
+  RequestBuilder& SetTargetType(squim::ImageType type);
+  RequestBuilder& SetJpegProgressive(bool progressive);
+  RequestBuilder& SetPngOptimizationLevel(int level);
+  RequestBuilder& SetContentLength(uint64_t content_length);
 
   squim::ImageRequestPart Build();
 
@@ -30,7 +30,7 @@ int main(int argc, char** argv) {
   google::InstallFailureSignalHandler();
   google::InitGoogleLogging(argv[0]);
 
-  ImageOptimizerService service(base::make_unique<WebPOptimization>());
+  ImageOptimizerService service(base::make_unique<DefaultOptimization>());
   grpc::ServerBuilder builder;
   builder.AddListeningPort(FLAGS_listen, grpc::InsecureServerCredentials());
   builder.RegisterService(&service);
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2016 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/base/threading/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "squim/base/logging.h"
+
+namespace base {
+
+namespace {
+
+// Progress of a single ParallelFor() call. Shared with the pool tasks, which
+// may start after the call returned and must find nothing left to do.
+struct ParallelForState {
+  explicit ParallelForState(size_t n) : n(n) {}
+
+  const size_t n;
+  std::atomic<size_t> next_index{0};
+  std::mutex mutex;
+  std::condition_variable done_cond;
+  size_t num_done = 0;
+};
+
+void RunParallelFor(ParallelForState* state,
+                    const std::function<void(size_t)>& fn) {
+  size_t num_done = 0;
+  for (size_t i = state->next_index++; i < state->n; i = state->next_index++) {
+    fn(i);
+    num_done++;
+  }
+  if (!num_done)
+    return;
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->num_done += num_done;
+  if (state->num_done == state->n)
+    state->done_cond.notify_all();
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  CHECK_GT(num_threads, 0u);
+  threads_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i)
+    threads_.emplace_back(&ThreadPool::Run, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+// static
+ThreadPool* ThreadPool::Default() {
+  static ThreadPool* pool =
+      new ThreadPool(std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  cond_.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t n,
+                             size_t max_parallelism,
+                             const std::function<void(size_t)>& fn) {
+  if (n == 0)
+    return;
+  if (max_parallelism == 0)
+    max_parallelism = threads_.size() + 1;
+  size_t num_helpers = std::min(max_parallelism, n) - 1;
+
+  auto state = std::make_shared<ParallelForState>(n);
+  // Helpers reference |fn| only while they own an index, and the call doesn't
+  // return before all the indices are done.
+  const auto* fn_ptr = &fn;
+  for (size_t i = 0; i < num_helpers; ++i)
+    Schedule([state, fn_ptr]() { RunParallelFor(state.get(), *fn_ptr); });
+  RunParallelFor(state.get(), fn);
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done_cond.wait(lock,
+                        [&state]() { return state->num_done == state->n; });
+}
+
+void ThreadPool::Run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace base
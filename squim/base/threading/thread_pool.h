@@ -0,0 +1,73 @@
+/*
+ * Copyright 2016 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_BASE_THREADING_THREAD_POOL_H_
+#define SQUIM_BASE_THREADING_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "squim/base/make_noncopyable.h"
+
+namespace base {
+
+// Fixed set of worker threads running queued tasks. Codecs which split work
+// into independent pieces (GIF frames, PNG trials) and the service running
+// batch items share the process-wide pool returned by Default(), so the number
+// of threads stays bounded no matter how many images are processed at once.
+class ThreadPool {
+  MAKE_NONCOPYABLE(ThreadPool);
+
+ public:
+  explicit ThreadPool(size_t num_threads);
+  // Waits for the queued tasks to finish.
+  ~ThreadPool();
+
+  // Returns the process-wide pool with a thread per hardware thread. It is
+  // created on first use and never destroyed.
+  static ThreadPool* Default();
+
+  void Schedule(std::function<void()> task);
+
+  // Calls |fn| for every index in [0, n) on up to |max_parallelism| threads
+  // (0 - as many as the pool has plus the calling thread) and returns when
+  // all the calls are done. The calling thread takes part in the work, and
+  // the pool threads only pick indices nobody has taken yet, so it's safe to
+  // call from a task running on the same pool.
+  void ParallelFor(size_t n,
+                   size_t max_parallelism,
+                   const std::function<void(size_t)>& fn);
+
+  size_t num_threads() const { return threads_.size(); }
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace base
+
+#endif  // SQUIM_BASE_THREADING_THREAD_POOL_H_
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2016 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/base/threading/thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace base {
+
+TEST(ThreadPoolTest, RunsAllScheduledTasks) {
+  std::atomic<int> counter(0);
+  {
+    ThreadPool pool(3);
+    for (int i = 0; i < 100; ++i)
+      pool.Schedule([&counter]() { counter++; });
+  }
+  EXPECT_EQ(100, counter);
+}
+
+TEST(ThreadPoolTest, ParallelForCallsEveryIndexOnce) {
+  ThreadPool pool(4);
+  for (size_t max_parallelism : {0, 1, 2, 16}) {
+    std::vector<std::atomic<int>> calls(1000);
+    pool.ParallelFor(calls.size(), max_parallelism,
+                     [&calls](size_t i) { calls[i]++; });
+    for (size_t i = 0; i < calls.size(); ++i)
+      ASSERT_EQ(1, calls[i]) << i << " " << max_parallelism;
+  }
+}
+
+TEST(ThreadPoolTest, ParallelForWithoutWork) {
+  ThreadPool pool(2);
+  pool.ParallelFor(0, 0, [](size_t) { FAIL(); });
+}
+
+TEST(ThreadPoolTest, ParallelForFromPoolThreads) {
+  // Every pool thread is busy with an outer task, the inner loops still
+  // finish on the calling threads.
+  ThreadPool pool(2);
+  std::atomic<int> counter(0);
+  pool.ParallelFor(4, 0, [&pool, &counter](size_t) {
+    pool.ParallelFor(10, 0, [&counter](size_t) { counter++; });
+  });
+  EXPECT_EQ(40, counter);
+}
+
+}  // namespace base
@@ -62,6 +62,16 @@ uint8_t GifImage::Frame::GetPixel(uint16_t x, uint16_t y) const {
   return data_[width_ * y + x];
 }
 
+const uint8_t* GifImage::Frame::GetRow(uint16_t y) const {
+  DCHECK_GT(height_, y);
+  return data_.get() + static_cast<size_t>(width_) * y;
+}
+
+void GifImage::Frame::ReleaseData() {
+  data_.reset();
+  local_color_table_.reset();
+}
+
 GifImage::GifImage() {}
 
 GifImage::~GifImage() {}
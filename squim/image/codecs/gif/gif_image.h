@@ -68,6 +68,12 @@ class GifImage {
 
     const ColorTable* GetColorTable() const;
     uint8_t GetPixel(uint16_t x, uint16_t y) const;
+    // Color indices of the row |y|, |width()| bytes.
+    const uint8_t* GetRow(uint16_t y) const;
+
+    // Frees color indices and the local color table, e.g. after the frame
+    // has been converted. Geometry, timing and disposal are kept.
+    void ReleaseData();
 
     uint16_t width() const { return width_; }
     uint16_t height() const { return height_; }
@@ -61,14 +61,43 @@ void GifImage::Frame::Parser::SetDisposalMethod(DisposalMethod method) {
 
 bool GifImage::Frame::Parser::InitDecoder(uint8_t minimum_code_size) {
   lzw_reader_ = base::make_unique<LZWReader>();
-  auto output = [this](uint8_t* data, size_t size) -> bool {
-    return OutputRow(data, size);
-  };
-  return lzw_reader_->Init(minimum_code_size, frame_->width_, output);
+  return lzw_reader_->Init(minimum_code_size, frame_->width_);
+}
+
+void GifImage::Frame::Parser::SetDeferredDecoding(bool deferred) {
+  deferred_decoding_ = deferred;
+}
+
+void GifImage::Frame::Parser::HoldData(io::ChunkPtr chunk) {
+  DCHECK(deferred_decoding_);
+  held_chunks_.push_back(std::move(chunk));
+}
+
+Result GifImage::Frame::Parser::DecodeCollectedData() {
+  DCHECK(deferred_decoding_);
+  deferred_decoding_ = false;
+  // Spans are decoded as they came, the same way as if decoded inline.
+  auto result = Result::Ok();
+  for (const auto& span : collected_spans_) {
+    result = ProcessImageData(span.data, span.size);
+    if (!result.ok())
+      break;
+  }
+  collected_spans_.clear();
+  held_chunks_.clear();
+  return result;
 }
 
 Result GifImage::Frame::Parser::ProcessImageData(uint8_t* data, size_t size) {
-  auto result = lzw_reader_->Decode(data, size);
+  if (deferred_decoding_) {
+    collected_spans_.push_back({data, size});
+    return Result::Ok();
+  }
+
+  auto output = [this](uint8_t* row, size_t row_size) -> bool {
+    return OutputRow(row, row_size);
+  };
+  auto result = lzw_reader_->Decode(data, size, output);
   if (result.ok() && result.n() != size) {
     LOG(WARNING) << "Bad LZW block, junk left after read. nread=" << result.n()
                  << ", size=" << size;
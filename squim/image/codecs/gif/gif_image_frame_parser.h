@@ -18,9 +18,12 @@
 #define SQUIM_IMAGE_CODECS_GIF_GIF_IMAGE_FRAME_PARSER_H_
 
 #include <memory>
+#include <vector>
 
 #include "squim/image/codecs/gif/gif_image.h"
 #include "squim/image/result.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/chunk.h"
 
 namespace image {
 
@@ -43,6 +46,16 @@ class GifImage::Frame::Parser {
   bool InitDecoder(uint8_t minimum_code_size);
   Result ProcessImageData(uint8_t* data, size_t size);
 
+  // With deferred decoding ProcessImageData() only records where the LZW data
+  // is, and the data is decoded later by DecodeCollectedData(). The data is
+  // not copied, the chunks holding it must be passed to HoldData(). The
+  // latter touches nothing but this parser and its frame, so frames may be
+  // decoded on different threads.
+  void SetDeferredDecoding(bool deferred);
+  bool deferred_decoding() const { return deferred_decoding_; }
+  void HoldData(io::ChunkPtr chunk);
+  Result DecodeCollectedData();
+
   void CreateLocalColorTable(size_t size);
   ColorTable* GetLocalColorTable();
 
@@ -55,6 +68,9 @@ class GifImage::Frame::Parser {
   std::unique_ptr<LZWReader> lzw_reader_;
   uint16_t current_row_ = 0;
   size_t interlace_pass_ = 0;
+  bool deferred_decoding_ = false;
+  std::vector<io::BufReader::Span> collected_spans_;
+  io::ChunkList held_chunks_;
 };
 
 }  // namespace image
@@ -16,11 +16,13 @@
 
 #include "squim/image/codecs/gif/gif_image_parser.h"
 
+#include <algorithm>
 #include <cstring>
 #include <limits>
 
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
+#include "squim/base/threading/thread_pool.h"
 #include "squim/image/codecs/gif/gif_image_frame_parser.h"
 #include "squim/io/buf_reader.h"
 #include "squim/io/buffer_writer.h"
@@ -28,8 +30,6 @@
 
 namespace image {
 
-#define HANDLER(func) std::bind(&GifImage::Parser::func, this)
-
 namespace {
 
 class Reader {
@@ -48,16 +48,10 @@ class Reader {
   uint8_t* data_;
 };
 
-Result FinishParse() {
-  return Result::Finish(Result::Code::kOk);
-}
-
 }  // namespace
 
 GifImage::Parser::Parser(io::BufReader* source, GifImage* image)
-    : source_(source), image_(image) {
-  handler_ = HANDLER(ParseVersion);
-}
+    : source_(source), image_(image) {}
 
 GifImage::Parser::~Parser() {}
 
@@ -68,26 +62,27 @@ GifImage::Frame::Parser* GifImage::Parser::GetFrameParser() {
   return active_frame_builder_.get();
 }
 
-GifImage::Parser::Handler GifImage::Parser::BlockHandler(Handler handler) {
-  return std::bind(&GifImage::Parser::ParseSubBlockLength, this, handler);
-}
-
-void GifImage::Parser::SetupHandlers(Handler start_of_subblock,
-                                     Handler data_handler,
-                                     Handler end_of_block) {
-  start_of_subblock_handler_ = start_of_subblock;
-  handler_ = BlockHandler(data_handler);
-  end_of_block_handler_ = end_of_block;
-}
-
 Result GifImage::Parser::BuildColorTable(ColorTable* color_table) {
   DCHECK(color_table);
-  while (color_table->size() < color_table->expected_size()) {
-    uint8_t rgb[ColorTable::kNumBytesPerEntry];
-    auto result = source_->ReadNInto(rgb);
-    if (!result.ok())
-      return Result::FromIoResult(result, false);
-    color_table->AddColor(rgb[0], rgb[1], rgb[2]);
+  DCHECK_EQ(0u, color_table->size());
+  // Wait for the whole table and take it in pieces as the source stores it,
+  // entries may straddle the pieces.
+  std::vector<io::BufReader::Span> spans;
+  auto result = source_->ReadV(
+      color_table->expected_size() * ColorTable::kNumBytesPerEntry, &spans);
+  if (!result.ok())
+    return Result::FromIoResult(result, false);
+
+  uint8_t rgb[ColorTable::kNumBytesPerEntry];
+  size_t nrgb = 0;
+  for (const auto& span : spans) {
+    for (size_t i = 0; i < span.size; ++i) {
+      rgb[nrgb++] = span.data[i];
+      if (nrgb == ColorTable::kNumBytesPerEntry) {
+        color_table->AddColor(rgb[0], rgb[1], rgb[2]);
+        nrgb = 0;
+      }
+    }
   }
   DCHECK_EQ(color_table->expected_size(), color_table->size());
   return Result::Ok();
@@ -107,21 +102,99 @@ Result GifImage::Parser::ParseInternal() {
   if (!parser_error_.ok())
     return parser_error_;
 
-  if ((header_only_ && header_complete_) || complete_)
+  if ((header_only_ && header_complete_) || complete())
     return Result::Finish(Result::Code::kOk);
   auto result = Result::Ok();
   while (result.ok() && !result.finished()) {
-    result = handler_();
+    // States never unread data consumed by the previous ones, and image data
+    // is either decoded right away or kept alive by its frame.
+    source_->FreeBefore(source_->offset());
+    switch (state_) {
+      case State::kVersion:
+        result = ParseVersion();
+        break;
+      case State::kLogicalScreenDescriptor:
+        result = ParseLogicalScreenDescriptor();
+        break;
+      case State::kGlobalColorTable:
+        result = ParseGlobalColorTable();
+        break;
+      case State::kBlockType:
+        result = ParseBlockType();
+        break;
+      case State::kExtensionType:
+        result = ParseExtensionType();
+        break;
+      case State::kImageDescriptor:
+        result = ParseImageDescriptor();
+        break;
+      case State::kLocalColorTable:
+        result = ParseLocalColorTable();
+        break;
+      case State::kMinimumCodeSize:
+        result = ParseMinimumCodeSize();
+        break;
+      case State::kSubBlocks:
+        result = ParseSubBlocks();
+        break;
+      case State::kSkipSubBlock:
+        result = SkipSubBlock();
+        break;
+      case State::kComplete:
+        result = Result::Finish(Result::Code::kOk);
+        break;
+    }
     if (result.error())
       parser_error_ = result;
   }
+
+  // Frames read so far are published whenever parsing stops, so waiting for
+  // more input doesn't hold back the ones already collected.
+  auto decode_result = DecodePendingFrames();
+  if (decode_result.error()) {
+    parser_error_ = decode_result;
+    return decode_result;
+  }
+  return result;
+}
+
+Result GifImage::Parser::DecodePendingFrames() {
+  if (pending_frames_.empty())
+    return Result::Ok();
+
+  // A single frame is decoded right here, several ones are spread over the
+  // shared pool. Frames take very different time to decode, so they are
+  // handed out one by one rather than in fixed shares.
+  size_t num_frames = pending_frames_.size();
+  num_deferred_frames_ += num_frames;
+  std::vector<Result> results(num_frames, Result::Ok());
+  base::ThreadPool::Default()->ParallelFor(
+      num_frames, max_decode_threads_, [this, &results](size_t i) {
+        results[i] = pending_frames_[i]->DecodeCollectedData();
+      });
+
+  auto result = Result::Ok();
+  for (size_t i = 0; i < num_frames; i++) {
+    result = results[i];
+    if (!result.ok())
+      break;
+    image_->frames_.push_back(pending_frames_[i]->ReleaseFrame());
+  }
+  pending_frames_.clear();
   return result;
 }
 
+bool GifImage::Parser::ShouldDeferDecoding() const {
+  // Collecting LZW data of streaming input would only delay its frames, so
+  // frames are put aside only when the rest of the image is already here:
+  // after EOF, or once the input size given to Reserve() has arrived.
+  return max_decode_threads_ != 1 && source_->source()->AllDataReceived();
+}
+
 Result GifImage::Parser::ParseVersion() {
   const size_t kLength = 6;
-  uint8_t* data;
-  auto result = source_->ReadN(&data, kLength);
+  uint8_t data[kLength];
+  auto result = source_->ReadNInto(data);
   if (!result.ok())
     return Result::FromIoResult(result, false);
 
@@ -133,14 +206,14 @@ Result GifImage::Parser::ParseVersion() {
     return Result::Error(Result::Code::kDecodeError, "Unknown GIF version");
   }
 
-  handler_ = HANDLER(ParseLogicalScreenDescriptor);
+  state_ = State::kLogicalScreenDescriptor;
   return Result::Ok();
 }
 
 Result GifImage::Parser::ParseLogicalScreenDescriptor() {
   const size_t kLength = 7;
-  uint8_t* data;
-  auto result = source_->ReadN(&data, kLength);
+  uint8_t data[kLength];
+  auto result = source_->ReadNInto(data);
   if (!result.ok())
     return Result::FromIoResult(result, false);
 
@@ -151,9 +224,9 @@ Result GifImage::Parser::ParseLogicalScreenDescriptor() {
   auto global_table_size = 1 << ((packed & 0x07) + 1);
   if (packed & 0x80 && global_table_size > 0) {
     image_->global_color_table_.reset(new ColorTable(global_table_size));
-    handler_ = HANDLER(ParseGlobalColorTable);
+    state_ = State::kGlobalColorTable;
   } else {
-    handler_ = HANDLER(ParseBlockType);
+    state_ = State::kBlockType;
   }
   auto background_color = reader.ReadByte();
   if (background_color) {
@@ -172,7 +245,7 @@ Result GifImage::Parser::ParseGlobalColorTable() {
   if (!result.ok())
     return result;
 
-  handler_ = HANDLER(ParseBlockType);
+  state_ = State::kBlockType;
   return Result::Ok();
 }
 
@@ -182,21 +255,19 @@ Result GifImage::Parser::ParseBlockType() {
   if (!result.ok()) {
     if (!image_->frames_.empty() && result.eof()) {
       // End of block is valid EOF if at least one frame present.
-      handler_ = FinishParse;
-      complete_ = true;
+      state_ = State::kComplete;
       return Result::Ok();
     }
     return Result::FromIoResult(result, false);
   }
   auto block_type = static_cast<char>(*data);
   if (block_type == '!') {
-    handler_ = HANDLER(ParseExtensionType);
+    state_ = State::kExtensionType;
   } else if (block_type == ',') {
-    handler_ = HANDLER(ParseImageDescriptor);
+    state_ = State::kImageDescriptor;
   } else if (block_type == ';') {
     // End of image.
-    handler_ = FinishParse;
-    complete_ = true;
+    state_ = State::kComplete;
   } else {
     // From blink GIFImageReader.cpp:
     //
@@ -207,8 +278,7 @@ Result GifImage::Parser::ParseBlockType() {
     // a file is corrupt. We follow Mozilla's implementation and
     // proceed as if the file were correctly terminated, so the
     // GIF will display.
-    handler_ = FinishParse;
-    complete_ = true;
+    state_ = State::kComplete;
     LOG(WARNING) << "Corrupt GIF format";
   }
   return Result::Ok();
@@ -222,7 +292,7 @@ Result GifImage::Parser::ParseExtensionType() {
 
   switch (*data) {
     case 0xF9:
-      handler_ = BlockHandler(HANDLER(ParseControlExtension));
+      block_ = Block::kControlExtension;
       break;
     // From blink GIFImageReader.cpp:
     //
@@ -235,46 +305,160 @@ Result GifImage::Parser::ParseExtensionType() {
     // headers that are both shorter and longer than 11 bytes.
     case 0x01:
       // Ignore plain text extension.
-      handler_ = BlockHandler(HANDLER(SkipBlock));
+      block_ = Block::kSkip;
       break;
     case 0xff:
-      handler_ = BlockHandler(HANDLER(ParseApplicationExtension));
+      block_ = Block::kApplicationExtension;
       break;
     case 0xfe:
     // Ignore comments.
     default:
-      handler_ = BlockHandler(HANDLER(SkipBlock));
+      block_ = Block::kSkip;
       break;
   }
+  state_ = State::kSubBlocks;
   return Result::Ok();
 }
 
-Result GifImage::Parser::ParseSubBlockLength(Handler block_handler) {
-  // First, read block length.
+Result GifImage::Parser::ParseSubBlocks() {
+  switch (block_) {
+    case Block::kControlExtension:
+    case Block::kApplicationExtension:
+    case Block::kNetscapeExtension:
+      return ParseExtensionSubBlock();
+    default:
+      return ReadSubBlocks();
+  }
+}
+
+Result GifImage::Parser::ParseExtensionSubBlock() {
+  if (remaining_block_length_ == 0) {
+    uint8_t* data;
+    auto io_result = source_->ReadN(&data, 1);
+    if (!io_result.ok())
+      return Result::FromIoResult(io_result, false);
+    // 0-length means end of the block.
+    if (*data == 0)
+      return FinishBlock();
+    remaining_block_length_ = *data;
+  }
+
+  switch (block_) {
+    case Block::kControlExtension:
+      return ParseControlExtension();
+    case Block::kApplicationExtension:
+      return ParseApplicationExtension();
+    case Block::kNetscapeExtension:
+      return ParseNetscapeApplicationExtension();
+    default:
+      NOTREACHED();
+      return Result::Error(Result::Code::kFailed);
+  }
+}
+
+Result GifImage::Parser::ReadSubBlocks() {
+  // Image data and metadata are mostly a long run of 255-byte sub-blocks, so
+  // walk through as many of them as the source has in one piece.
   uint8_t* data;
-  auto io_result = source_->ReadN(&data, 1);
+  auto io_result = io::IoResult::Pending();
+  if (block_ == Block::kImageData && GetFrameParser()->deferred_decoding()) {
+    // Deferred frames refer to their data in the source until decoded.
+    io::ChunkPtr chunk;
+    io_result = source_->ReadSomeShared(&chunk);
+    if (io_result.ok()) {
+      data = chunk->data();
+      GetFrameParser()->HoldData(std::move(chunk));
+    }
+  } else {
+    io_result = source_->ReadSome(&data);
+  }
   if (!io_result.ok())
     return Result::FromIoResult(io_result, false);
-  remaining_block_length_ = *data;
-  if (remaining_block_length_ == 0) {
-    if (end_of_block_handler_) {
-      auto result = end_of_block_handler_();
-      end_of_block_handler_ = Handler();
-      start_of_subblock_handler_ = Handler();
-      if (!result.ok())
-        return result;
+
+  uint8_t* end = data + io_result.n();
+  while (data < end) {
+    if (remaining_block_length_ == 0) {
+      remaining_block_length_ = *data++;
+      if (remaining_block_length_ == 0) {
+        // End of the block, the rest belongs to the following ones.
+        size_t nunread = source_->UnreadN(end - data);
+        DCHECK_EQ(static_cast<size_t>(end - data), nunread);
+        return FinishBlock();
+      }
+      StartSubBlock(data - 1);
+      continue;
     }
-    // 0-length means end of the block. Start reading new one.
-    handler_ = HANDLER(ParseBlockType);
-  } else {
-    if (start_of_subblock_handler_) {
-      auto result = start_of_subblock_handler_();
-      if (!result.ok())
-        return result;
+
+    size_t size =
+        std::min(remaining_block_length_, static_cast<size_t>(end - data));
+    auto result = ProcessSubBlockData(data, size);
+    if (!result.ok())
+      return result;
+    data += size;
+    remaining_block_length_ -= size;
+  }
+  return Result::Ok();
+}
+
+void GifImage::Parser::StartSubBlock(uint8_t* length_byte) {
+  if (block_ != Block::kICCMetadata && block_ != Block::kXMPMetadata)
+    return;
+
+  if (!metadata_writer_)
+    metadata_writer_ =
+        base::make_unique<io::BufferWriter>(remaining_block_length_);
+
+  // Special case for XMP data: In each sub-block, the first byte is also part
+  // of the XMP payload. XMP in GIF also has a 257 byte padding data. See the
+  // XMP specification for details.
+  if (block_ == Block::kXMPMetadata)
+    metadata_writer_->Write(length_byte, 1);
+}
+
+Result GifImage::Parser::ProcessSubBlockData(uint8_t* data, size_t size) {
+  switch (block_) {
+    case Block::kImageData:
+      return GetFrameParser()->ProcessImageData(data, size);
+    case Block::kICCMetadata:
+    case Block::kXMPMetadata:
+      metadata_writer_->Write(data, size);
+      return Result::Ok();
+    default:
+      return Result::Ok();
+  }
+}
+
+Result GifImage::Parser::FinishBlock() {
+  switch (block_) {
+    case Block::kImageData:
+      if (GetFrameParser()->deferred_decoding()) {
+        pending_frames_.push_back(std::move(active_frame_builder_));
+      } else {
+        image_->frames_.push_back(GetFrameParser()->ReleaseFrame());
+        active_frame_builder_.reset();
+      }
+      break;
+    case Block::kICCMetadata:
+      for (auto& chunk : metadata_writer_->ReleaseChunks())
+        image_->metadata_.Append(ImageMetadata::Type::kICC, std::move(chunk));
+      metadata_writer_.reset();
+      break;
+    case Block::kXMPMetadata: {
+      const size_t kXMPMagicTrailerSize = 257;
+      if (metadata_writer_->total_size() > kXMPMagicTrailerSize)
+        metadata_writer_->UnwriteN(kXMPMagicTrailerSize);
+
+      for (auto& chunk : metadata_writer_->ReleaseChunks())
+        image_->metadata_.Append(ImageMetadata::Type::kXMP, std::move(chunk));
+      metadata_writer_.reset();
+      break;
     }
-    // Otherwise, set up provided |block_handler|.
-    handler_ = block_handler;
+    default:
+      break;
   }
+
+  block_ = Block::kSkip;
+  state_ = State::kBlockType;
   return Result::Ok();
 }
 
@@ -293,8 +477,8 @@ Result GifImage::Parser::ParseControlExtension() {
         "Graphics Control Extension MUST be at least 4 bytes long");
   }
 
-  uint8_t* data;
-  auto result = source_->ReadN(&data, kLength);
+  uint8_t data[kLength];
+  auto result = source_->ReadNInto(data);
   if (!result.ok())
     return Result::FromIoResult(result, false);
 
@@ -322,8 +506,9 @@ Result GifImage::Parser::ParseControlExtension() {
   }
 
   remaining_block_length_ -= kLength;
-
-  return SkipSubBlockHandler(HANDLER(SkipBlock));
+  block_ = Block::kSkip;
+  state_ = State::kSkipSubBlock;
+  return Result::Ok();
 }
 
 Result GifImage::Parser::ParseApplicationExtension() {
@@ -331,72 +516,32 @@ Result GifImage::Parser::ParseApplicationExtension() {
   if (remaining_block_length_ < kLength) {
     LOG(WARNING)
         << "Application Extension header MUST be 11 bytes long, skipping block";
-    handler_ = HANDLER(SkipBlock);
+    block_ = Block::kSkip;
+    state_ = State::kSkipSubBlock;
     return Result::Ok();
   }
 
-  uint8_t* data;
-  auto result = source_->ReadN(&data, kLength);
+  uint8_t data[kLength];
+  auto result = source_->ReadNInto(data);
   if (!result.ok())
     return Result::FromIoResult(result, false);
 
+  remaining_block_length_ -= kLength;
+  block_ = Block::kSkip;
+  state_ = State::kSkipSubBlock;
+
   if (std::memcmp(data, "NETSCAPE2.0", kLength) ||
       std::memcmp(data, "ANIMEXTS1.0", kLength)) {
-    handler_ = BlockHandler(HANDLER(ParseNetscapeApplicationExtension));
+    block_ = Block::kNetscapeExtension;
   } else if (std::memcmp(data, "ICCRGBG1012", kLength) &&
              !image_->metadata_.Has(ImageMetadata::Type::kICC)) {
     // Store only first metadata chunk of each type.
-    SetupHandlers(
-        [this]() -> Result {
-          if (!metadata_writer_)
-            metadata_writer_ =
-                base::make_unique<io::BufferWriter>(remaining_block_length_);
-          return Result::Ok();
-        },
-        [this]() -> Result { return ConsumeMetadata(); },
-        [this]() -> Result {
-          for (auto& chunk : metadata_writer_->ReleaseChunks())
-            image_->metadata_.Append(ImageMetadata::Type::kICC,
-                                     std::move(chunk));
-
-          metadata_writer_.reset();
-          return Result::Ok();
-        });
+    block_ = Block::kICCMetadata;
   } else if (std::memcmp(data, "XMP DataXMP", kLength) &&
              !image_->metadata_.Has(ImageMetadata::Type::kXMP)) {
-    // Store only first metadata chunk of each type.
-    SetupHandlers(
-        [this]() -> Result {
-          if (!metadata_writer_)
-            metadata_writer_ =
-                base::make_unique<io::BufferWriter>(remaining_block_length_);
-
-          // Special case for XMP data: In each sub-block, the first byte
-          // is also part of the XMP payload. XMP in GIF also has a 257
-          // byte padding data. See the XMP specification for details.
-          source_->UnreadN(1);
-          uint8_t* first_byte;
-          auto result = source_->ReadN(&first_byte, 1);
-          DCHECK(result.ok());
-          metadata_writer_->Write(first_byte, 1);
-          return Result::Ok();
-        },
-        [this]() -> Result { return ConsumeMetadata(); },
-        [this]() -> Result {
-          const size_t kXMPMagicTrailerSize = 257;
-          if (metadata_writer_->total_size() > kXMPMagicTrailerSize)
-            metadata_writer_->UnwriteN(kXMPMagicTrailerSize);
-
-          for (auto& chunk : metadata_writer_->ReleaseChunks())
-            image_->metadata_.Append(ImageMetadata::Type::kXMP,
-                                     std::move(chunk));
-
-          metadata_writer_.reset();
-          return Result::Ok();
-        });
+    block_ = Block::kXMPMetadata;
   } else {
     LOG(WARNING) << "Unsupported Application Extension";
-    handler_ = BlockHandler(HANDLER(SkipBlock));
   }
 
   return Result::Ok();
@@ -407,12 +552,13 @@ Result GifImage::Parser::ParseNetscapeApplicationExtension() {
   if (remaining_block_length_ < kLength) {
     LOG(WARNING)
         << "Netscape Extension MUST be at least 3 bytes long, skipping";
-    handler_ = HANDLER(SkipBlock);
+    block_ = Block::kSkip;
+    state_ = State::kSkipSubBlock;
     return Result::Ok();
   }
 
-  uint8_t* data;
-  auto result = source_->ReadN(&data, kLength);
+  uint8_t data[kLength];
+  auto result = source_->ReadNInto(data);
   if (!result.ok())
     return Result::FromIoResult(result, false);
 
@@ -439,26 +585,12 @@ Result GifImage::Parser::ParseNetscapeApplicationExtension() {
     LOG(INFO) << "Unknown netscape extension: " << netscape_extension;
   }
 
-  return SkipSubBlockHandler(HANDLER(ParseNetscapeApplicationExtension));
-}
-
-Result GifImage::Parser::ConsumeMetadata() {
-  DCHECK(metadata_writer_);
-  while (remaining_block_length_ > 0) {
-    uint8_t* data;
-    auto result = source_->ReadAtMostN(&data, remaining_block_length_);
-    if (!result.ok())
-      return Result::FromIoResult(result, false);
-
-    metadata_writer_->Write(data, result.n());
-    remaining_block_length_ -= result.n();
-  }
-
-  handler_ = BlockHandler(HANDLER(ConsumeMetadata));
+  // Every sub-block of the extension is parsed the same way.
+  state_ = State::kSkipSubBlock;
   return Result::Ok();
 }
 
-Result GifImage::Parser::SkipSubBlockHandler(Handler handler) {
+Result GifImage::Parser::SkipSubBlock() {
   // Consume the remaining sub-block, if anything left.
   while (remaining_block_length_ > 0) {
     uint8_t* nothing;
@@ -469,19 +601,14 @@ Result GifImage::Parser::SkipSubBlockHandler(Handler handler) {
     remaining_block_length_ -= result.n();
   }
 
-  // Setup new sub-block handler.
-  handler_ = BlockHandler(handler);
+  state_ = State::kSubBlocks;
   return Result::Ok();
 }
 
-Result GifImage::Parser::SkipBlock() {
-  return SkipSubBlockHandler(HANDLER(SkipBlock));
-}
-
 Result GifImage::Parser::ParseImageDescriptor() {
   const size_t kLength = 9;
-  uint8_t* data;
-  auto result = source_->ReadN(&data, kLength);
+  uint8_t data[kLength];
+  auto result = source_->ReadNInto(data);
   if (!result.ok())
     return Result::FromIoResult(result, false);
 
@@ -539,9 +666,9 @@ Result GifImage::Parser::ParseImageDescriptor() {
 
   if (packed & 0x80) {
     builder->CreateLocalColorTable(1 << ((packed & 0x07) + 1));
-    handler_ = HANDLER(ParseLocalColorTable);
+    state_ = State::kLocalColorTable;
   } else {
-    handler_ = HANDLER(ParseMinimumCodeSize);
+    state_ = State::kMinimumCodeSize;
   }
 
   header_complete_ = true;
@@ -556,25 +683,7 @@ Result GifImage::Parser::ParseLocalColorTable() {
   if (!result.ok())
     return result;
 
-  handler_ = HANDLER(ParseMinimumCodeSize);
-  return Result::Ok();
-}
-
-Result GifImage::Parser::ReadLZWData() {
-  while (remaining_block_length_ > 0) {
-    uint8_t* data;
-    auto io_result = source_->ReadAtMostN(&data, remaining_block_length_);
-    if (!io_result.ok())
-      return Result::FromIoResult(io_result, false);
-
-    auto result = GetFrameParser()->ProcessImageData(data, io_result.n());
-    if (!result.ok())
-      return result;
-
-    remaining_block_length_ -= io_result.n();
-  }
-
-  handler_ = BlockHandler(HANDLER(ReadLZWData));
+  state_ = State::kMinimumCodeSize;
   return Result::Ok();
 }
 
@@ -587,15 +696,10 @@ Result GifImage::Parser::ParseMinimumCodeSize() {
   if (!GetFrameParser()->InitDecoder(*data))
     return Result::Error(Result::Code::kDecodeError,
                          "Too big minimum code size");
+  GetFrameParser()->SetDeferredDecoding(ShouldDeferDecoding());
 
-  SetupHandlers(Handler(), [this]() -> Result { return ReadLZWData(); },
-                [this]() -> Result {
-                  auto frame = GetFrameParser()->ReleaseFrame();
-                  active_frame_builder_.reset();
-                  image_->frames_.push_back(std::move(frame));
-                  return Result::Ok();
-                });
-
+  block_ = Block::kImageData;
+  state_ = State::kSubBlocks;
   return Result::Ok();
 }
 
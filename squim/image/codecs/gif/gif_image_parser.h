@@ -17,8 +17,8 @@
 #ifndef SQUIM_IMAGE_CODECS_GIF_GIF_IMAGE_PARSER_H_
 #define SQUIM_IMAGE_CODECS_GIF_GIF_IMAGE_PARSER_H_
 
-#include <functional>
 #include <memory>
+#include <vector>
 
 #include "squim/image/codecs/gif/gif_image.h"
 #include "squim/image/result.h"
@@ -39,51 +39,91 @@ class GifImage::Parser {
   Result Parse();
 
   bool header_complete() const { return header_complete_; }
-  bool complete() const { return complete_; }
+  bool complete() const { return state_ == State::kComplete; }
+
+  // Any value other than 1 enables parallel decoding once the whole input is
+  // buffered (see io::BufferedSource::AllDataReceived()): LZW data of the
+  // remaining frames is only collected while parsing, and the collected
+  // frames are decoded on up to |max_threads| threads of
+  // base::ThreadPool::Default() (0 - all of them) when parsing stops. Frames
+  // of streaming input are decoded inline as their data arrives. Frames are
+  // still added to the image in order.
+  void set_max_decode_threads(size_t max_threads) {
+    max_decode_threads_ = max_threads;
+  }
+
+  // Number of frames decoded after parsing rather than inline.
+  size_t num_deferred_frames() const { return num_deferred_frames_; }
 
  private:
-  using Handler = std::function<Result()>;
+  // Every state parses a single piece of the GIF grammar. Sequences of
+  // sub-blocks are read in kSubBlocks state, |block_| tells what they carry.
+  enum class State {
+    kVersion,
+    kLogicalScreenDescriptor,
+    kGlobalColorTable,
+    kBlockType,
+    kExtensionType,
+    kImageDescriptor,
+    kLocalColorTable,
+    kMinimumCodeSize,
+    kSubBlocks,
+    kSkipSubBlock,
+    kComplete,
+  };
+
+  enum class Block {
+    kSkip,
+    kControlExtension,
+    kApplicationExtension,
+    kNetscapeExtension,
+    kICCMetadata,
+    kXMPMetadata,
+    kImageData,
+  };
 
   Result ParseInternal();
+  Result DecodePendingFrames();
+  // True if the frame starting now should be decoded later with the others.
+  bool ShouldDeferDecoding() const;
 
   Result ParseVersion();
   Result ParseLogicalScreenDescriptor();
   Result ParseGlobalColorTable();
   Result ParseBlockType();
   Result ParseExtensionType();
-  Result ParseControlExtension();
-  Result ParseApplicationExtension();
-  Result ParseSubBlockLength(Handler block_handler);
-  Result SkipBlock();
   Result ParseImageDescriptor();
   Result ParseLocalColorTable();
   Result ParseMinimumCodeSize();
-  Result ReadLZWData();
+  Result ParseSubBlocks();
+  Result ParseExtensionSubBlock();
+  Result ParseControlExtension();
+  Result ParseApplicationExtension();
   Result ParseNetscapeApplicationExtension();
-  Result ParseICCPApplicationExtension();
-  Result ParseXMPApplicationExtension();
+  Result ReadSubBlocks();
+  Result SkipSubBlock();
 
   Result BuildColorTable(ColorTable* color_table);
-  Result ConsumeMetadata();
-  Result SkipSubBlockHandler(Handler handler);
+  void StartSubBlock(uint8_t* length_byte);
+  Result ProcessSubBlockData(uint8_t* data, size_t size);
+  Result FinishBlock();
   Frame::Parser* GetFrameParser();
-  Handler BlockHandler(Handler handler);
-
-  void SetupHandlers(Handler start_of_subblock,
-                     Handler data_handler,
-                     Handler end_of_block);
 
-  Handler handler_;
-  Handler end_of_block_handler_;
-  Handler start_of_subblock_handler_;
+  State state_ = State::kVersion;
+  Block block_ = Block::kSkip;
   io::BufReader* source_;
   GifImage* image_;
   bool header_only_ = false;
   bool header_complete_ = false;
-  bool complete_ = false;
   Result parser_error_ = Result::Ok();
+  // Bytes left in the current sub-block, 0 when the next byte is a sub-block
+  // length.
   size_t remaining_block_length_ = 0;
   std::unique_ptr<Frame::Parser> active_frame_builder_;
+  // Frames with all LZW data collected but not decoded yet.
+  std::vector<std::unique_ptr<Frame::Parser>> pending_frames_;
+  size_t max_decode_threads_ = 1;
+  size_t num_deferred_frames_ = 0;
   std::unique_ptr<io::BufferWriter> metadata_writer_;
 };
 
@@ -16,10 +16,14 @@
 
 #include "squim/image/codecs/gif/gif_image_parser.h"
 
+#include <cstring>
+
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
+#include "squim/image/optimization/decode_trigger.h"
 #include "squim/image/test/image_test_util.h"
 #include "squim/io/buf_reader.h"
+#include "squim/io/buffered_source.h"
 #include "squim/io/chunk.h"
 
 #include "gtest/gtest.h"
@@ -27,7 +31,32 @@
 namespace image {
 
 namespace {
+const char kGifDir[] = "gif";
 const char kPngSuiteGifDir[] = "pngsuite/gif";
+
+void ExpectSameFrames(const GifImage& expected, const GifImage& actual) {
+  EXPECT_EQ(expected.loop_count(), actual.loop_count());
+  ASSERT_EQ(expected.frames().size(), actual.frames().size());
+  for (size_t i = 0; i < actual.frames().size(); ++i) {
+    const auto& expected_frame = expected.frames()[i];
+    const auto& frame = actual.frames()[i];
+    ASSERT_EQ(expected_frame->width(), frame->width());
+    ASSERT_EQ(expected_frame->height(), frame->height());
+    EXPECT_EQ(expected_frame->duration(), frame->duration());
+    EXPECT_EQ(expected_frame->disposal_method(), frame->disposal_method());
+    for (uint16_t y = 0; y < frame->height(); ++y) {
+      ASSERT_EQ(0, memcmp(expected_frame->GetRow(y), frame->GetRow(y),
+                          frame->width()));
+    }
+  }
+}
+
+void ParseAtOnce(const std::vector<uint8_t>& data, GifImage* image) {
+  auto reader = io::BufReader::CreateEmpty();
+  reader->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+  GifImage::Parser parser(reader.get(), image);
+  EXPECT_TRUE(parser.Parse().finished());
+}
 }
 
 class GifImageParserTest : public ::testing::Test {
@@ -71,4 +100,64 @@ TEST_F(GifImageParserTest, ParseOneImage) {
   EXPECT_EQ(32, frame->height());
 }
 
+TEST_F(GifImageParserTest, ParseByteByByte) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kGifDir, "animated", "gif", &data));
+  auto result = Result::Pending();
+  for (size_t i = 0; i < data.size(); ++i) {
+    EXPECT_TRUE(result.pending()) << i;
+    reader_->source()->AddChunk(io::Chunk::Copy(&data[i], 1));
+    result = parser_->Parse();
+  }
+  EXPECT_TRUE(result.finished());
+  EXPECT_TRUE(parser_->complete());
+
+  // Same as parsing it at once.
+  GifImage expected;
+  ParseAtOnce(data, &expected);
+  ASSERT_EQ(8, expected.frames().size());
+  ExpectSameFrames(expected, image_);
+}
+
+// The server reserves the content length of the request and attempts decoding
+// as DecodeTrigger says. It sends EOF only after the last message.
+TEST_F(GifImageParserTest, DefersDecodingOnceReservedInputArrives) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kGifDir, "animated", "gif", &data));
+  parser_->set_max_decode_threads(0);
+  reader_->source()->Reserve(data.size());
+  DecodeTrigger trigger(data.size());
+  const size_t kMessageSize = 1024;
+  auto result = Result::Pending();
+  for (size_t i = 0; i < data.size(); i += kMessageSize) {
+    size_t size = std::min(kMessageSize, data.size() - i);
+    ASSERT_TRUE(reader_->source()->AppendToReserved(&data[i], size));
+    if (trigger.AddInput(size))
+      result = parser_->Parse();
+  }
+  EXPECT_TRUE(result.finished());
+  EXPECT_FALSE(reader_->source()->EofReached());
+
+  // Frames parsed from the first message are decoded inline.
+  EXPECT_LT(0u, parser_->num_deferred_frames());
+  EXPECT_GT(image_.frames().size(), parser_->num_deferred_frames());
+  GifImage expected;
+  ParseAtOnce(data, &expected);
+  ExpectSameFrames(expected, image_);
+}
+
+TEST_F(GifImageParserTest, DecodesStreamingInputInline) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kGifDir, "animated", "gif", &data));
+  parser_->set_max_decode_threads(0);
+  const size_t kMessageSize = 64;
+  for (size_t i = 0; i < data.size(); i += kMessageSize) {
+    size_t size = std::min(kMessageSize, data.size() - i);
+    reader_->source()->AddChunk(io::Chunk::Copy(&data[i], size));
+    parser_->Parse();
+  }
+  EXPECT_TRUE(parser_->complete());
+  EXPECT_EQ(0u, parser_->num_deferred_frames());
+}
+
 }  // namespace image
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures LZWReader and LZWWriter throughput on the image data of GIF files.
+//
+// Usage: lzw_benchmark [file.gif ...]
+// Without arguments all *.gif files from squim/image/testdata/gif are used.
+// Reports megabytes of color indices decoded and encoded per second for every
+// file.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "squim/image/codecs/gif/lzw_reader.h"
+#include "squim/image/codecs/gif/lzw_writer.h"
+#include "squim/image/test/image_test_util.h"
+#include "squim/os/dir_util.h"
+#include "squim/os/fs_result.h"
+
+namespace {
+
+const char kDefaultDir[] = "squim/image/testdata/gif";
+
+// Minimum time spent decoding (encoding) every file.
+const std::chrono::milliseconds kMinDuration(200);
+
+// LZW-compressed image data of a single GIF frame, with sub-block framing
+// already stripped.
+struct LZWFrame {
+  uint8_t minimum_code_size;
+  size_t width;
+  std::vector<uint8_t> data;
+};
+
+// Skips a sequence of GIF data sub-blocks starting at |pos|, appending their
+// payload to |out| (if not null). Returns false on truncated input.
+bool ReadSubBlocks(const std::vector<uint8_t>& gif,
+                   size_t* pos,
+                   std::vector<uint8_t>* out) {
+  while (*pos < gif.size()) {
+    size_t size = gif[(*pos)++];
+    if (size == 0)
+      return true;
+    if (*pos + size > gif.size())
+      return false;
+    if (out)
+      out->insert(out->end(), &gif[*pos], &gif[*pos] + size);
+    *pos += size;
+  }
+  return false;
+}
+
+// Minimal GIF walker, it only knows enough about the format to dig out
+// image data blocks.
+bool ExtractFrames(const std::vector<uint8_t>& gif,
+                   std::vector<LZWFrame>* frames) {
+  const size_t kHeaderSize = 6 + 7;  // Signature + logical screen descriptor.
+  if (gif.size() < kHeaderSize || gif[0] != 'G' || gif[1] != 'I' ||
+      gif[2] != 'F')
+    return false;
+
+  size_t pos = kHeaderSize;
+  uint8_t flags = gif[10];
+  if (flags & 0x80)
+    pos += 3 << ((flags & 0x07) + 1);
+
+  while (pos < gif.size()) {
+    switch (gif[pos++]) {
+      case 0x21:  // Extension.
+        if (++pos > gif.size() || !ReadSubBlocks(gif, &pos, nullptr))
+          return false;
+        break;
+      case 0x2C: {  // Image descriptor.
+        if (pos + 10 > gif.size())
+          return false;
+        LZWFrame frame;
+        frame.width = gif[pos + 4] | (gif[pos + 5] << 8);
+        flags = gif[pos + 8];
+        pos += 9;
+        if (flags & 0x80)
+          pos += 3 << ((flags & 0x07) + 1);
+        if (pos >= gif.size())
+          return false;
+        frame.minimum_code_size = gif[pos++];
+        if (!ReadSubBlocks(gif, &pos, &frame.data))
+          return false;
+        if (frame.width > 0)
+          frames->push_back(std::move(frame));
+        break;
+      }
+      case 0x3B:  // Trailer.
+        return true;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+// Decodes all |frames| once, returns number of decoded bytes or 0 on error.
+// Decoded indices are appended to |indices| if it's not null.
+size_t DecodeFrames(const std::vector<LZWFrame>& frames,
+                    image::LZWReader* reader,
+                    std::vector<std::vector<uint8_t>>* indices) {
+  size_t decoded = 0;
+  std::vector<uint8_t>* out = nullptr;
+  auto output = [&decoded, &out](uint8_t* data, size_t size) -> bool {
+    decoded += size;
+    if (out)
+      out->insert(out->end(), data, data + size);
+    return true;
+  };
+  for (const auto& frame : frames) {
+    if (indices) {
+      indices->emplace_back();
+      out = &indices->back();
+    }
+    if (!reader->Init(frame.minimum_code_size, frame.width))
+      return 0;
+    if (reader->Decode(&frame.data[0], frame.data.size(), output).error())
+      return 0;
+  }
+  return decoded;
+}
+
+// Encodes all |indices| once, returns number of encoded bytes or 0 on error.
+size_t EncodeFrames(const std::vector<LZWFrame>& frames,
+                    const std::vector<std::vector<uint8_t>>& indices,
+                    image::LZWWriter* writer) {
+  size_t encoded = 0;
+  auto output = [&encoded](uint8_t* data, size_t size) -> bool {
+    encoded += size;
+    return true;
+  };
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (!writer->Init(frames[i].minimum_code_size, 255, output))
+      return 0;
+    if (!indices[i].empty() &&
+        writer->Write(&indices[i][0], indices[i].size()).error())
+      return 0;
+    if (writer->Finish().error())
+      return 0;
+  }
+  return encoded;
+}
+
+// Runs |func| repeatedly for at least kMinDuration, returns megabytes per
+// second given that every run processes |size| bytes, or 0 on error.
+template <typename Func>
+double Measure(size_t size, Func func) {
+  size_t iterations = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::steady_clock::duration::zero();
+  while (elapsed < kMinDuration) {
+    if (func() == 0)
+      return 0;
+    iterations++;
+    elapsed = std::chrono::steady_clock::now() - start;
+  }
+
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  return size * iterations / seconds / (1 << 20);
+}
+
+void RunBenchmark(const std::string& path) {
+  std::vector<uint8_t> gif;
+  std::vector<LZWFrame> frames;
+  if (!image::ReadFile(path, &gif) || !ExtractFrames(gif, &frames) ||
+      frames.empty()) {
+    printf("%-60s skipped: can't extract image data\n", path.c_str());
+    return;
+  }
+
+  image::LZWReader reader;
+  std::vector<std::vector<uint8_t>> indices;
+  size_t size = DecodeFrames(frames, &reader, &indices);
+  if (size == 0) {
+    printf("%-60s skipped: decoding failed\n", path.c_str());
+    return;
+  }
+
+  double decode_speed = Measure(size, [&frames, &reader]() {
+    return DecodeFrames(frames, &reader, nullptr);
+  });
+  image::LZWWriter writer;
+  double encode_speed = Measure(size, [&frames, &indices, &writer]() {
+    return EncodeFrames(frames, indices, &writer);
+  });
+  printf("%-60s %3zu frames %8zu bytes decode %9.2f MB/s encode %9.2f MB/s\n",
+         path.c_str(), frames.size(), size, decode_speed, encode_speed);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i)
+    paths.push_back(argv[i]);
+
+  if (paths.empty()) {
+    std::vector<std::string> names;
+    auto result = os::ReaddirnamesRecursively(kDefaultDir, 1, &names);
+    if (!result.ok()) {
+      fprintf(stderr, "%s\n", result.ToString().c_str());
+      return 1;
+    }
+    for (const auto& name : names) {
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".gif") == 0)
+        paths.push_back(name);
+    }
+  }
+
+  for (const auto& path : paths)
+    RunBenchmark(path);
+  return 0;
+}
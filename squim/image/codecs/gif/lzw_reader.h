@@ -17,31 +17,41 @@
 #ifndef SQUIM_IMAGE_CODECS_GIF_LZW_READER_H_
 #define SQUIM_IMAGE_CODECS_GIF_LZW_READER_H_
 
-#include <functional>
-#include <stack>
-#include <vector>
+#include <array>
+#include <cstring>
+#include <memory>
 
+#include "squim/base/logging.h"
+#include "squim/io/chunk.h"
 #include "squim/io/io_result.h"
 
-namespace io {
-class Chunk;
-}
-
 namespace image {
 
 // See http://www.matthewflickinger.com/lab/whatsinagif/lzw_image_data.asp
 // for details.
+//
+// The reader owns all of its state: the dictionary is a fixed-size table and
+// the output buffer is allocated once in Init(), so decoding itself never
+// touches the heap. Decoded bytes are written straight into the output buffer
+// and handed to the |output| callable of Decode() in pieces of
+// |output_chunk_size| bytes (the last piece before end-of-information may be
+// shorter). |output| is a template parameter, so that the per-row callback
+// is inlined into the decoding loop instead of going through std::function.
 class LZWReader {
  public:
   LZWReader();
   ~LZWReader();
 
-  bool Init(size_t data_size,
-            size_t output_chunk_size,
-            std::function<bool(uint8_t*, size_t)> output_cb);
+  bool Init(size_t data_size, size_t output_chunk_size);
 
-  io::IoResult Decode(io::Chunk* chunk);
-  io::IoResult Decode(const uint8_t* data, size_t size);
+  // |output| must be callable as bool(uint8_t* data, size_t size). Returning
+  // false from it stops decoding with an error.
+  template <typename Output>
+  io::IoResult Decode(io::Chunk* chunk, Output&& output) {
+    return Decode(chunk->data(), chunk->size(), output);
+  }
+  template <typename Output>
+  io::IoResult Decode(const uint8_t* data, size_t size, Output&& output);
 
  private:
   static const size_t kMaxCodeSize = 12;
@@ -49,8 +59,15 @@ class LZWReader {
   static const uint16_t kNoCode = 0xFFFF;
 
   void Clear();
-  bool OutputCodeToStream(uint16_t code);
-  void UpdateDictionary();
+
+  // Appends the byte sequence coded by |code| to |output_| and adds a new
+  // dictionary entry. Returns false if |code| is invalid.
+  bool OutputCode(uint16_t code);
+
+  // Hands all complete |output_chunk_size_| pieces of |output_| to |output|
+  // and moves the remainder to the beginning of the buffer.
+  template <typename Output>
+  bool FlushChunks(Output& output);
 
   // Reads varable-length codes from byte stream.
   class CodeStream {
@@ -59,7 +76,7 @@ class LZWReader {
 
     void SetupBuffer(const uint8_t* buffer, size_t size);
 
-    bool ReadNext(uint16_t* code);
+    inline bool ReadNext(uint16_t* code);
 
     bool CodeFitsCurrentCodesize(size_t code) const;
     void IncreaseCodesize();
@@ -82,6 +99,11 @@ class LZWReader {
   // entry can be stored as (reference_to_prev, new_byte) pair. There can
   // up to 4096 entries, so |prefix_code|:uint16_t is enough to address them.
   // |suffix|:uint8_t is the new byte.
+  // Every entry also caches the |length| of the byte sequence it codes and
+  // its |first_byte|: knowing the length, the sequence is written backwards
+  // right into its final place in the output buffer while following
+  // |prefix_code| references, and knowing the first byte, the next dictionary
+  // entry is built without walking the chain once more.
   // The dictionary as an array contains static trivial part (which contains
   // 2 ^ |data_size_| trivial symbols, 2 empty entries (for clear-code and
   // end-of-information code), and dynamically constructed entries. Value of the
@@ -91,18 +113,14 @@ class LZWReader {
   struct Entry {
     uint16_t prefix_code;
     uint8_t suffix;
+    uint8_t first_byte;
+    uint16_t length;
   };
-  std::vector<Entry> dictionary_;
+  std::array<Entry, kMaxDictionarySize> dictionary_;
   size_t next_entry_idx_ = 0;
 
-  // Previous code and its first byte. Used for dictionary construction.
-  // |prev_code_first_byte_| is here for optimization only, we can as well
-  // reconstruct it from |prev_code_| walking through prefixes in |dictionary_|.
-  uint16_t prev_code_ = 0;
-  uint8_t prev_code_first_byte_ = 0;
-
-  // The stack is a perfect thing to read stuff in reverse-inserted order from.
-  std::stack<uint8_t> byte_sequence_;
+  // Previous code, used for dictionary construction.
+  uint16_t prev_code_ = kNoCode;
 
   // Gif LZW special codes.
   uint16_t clear_code_ = 0;
@@ -112,14 +130,138 @@ class LZWReader {
 
   size_t data_size_ = 0;
 
+  // Holds up to |output_chunk_size_| - 1 bytes not yet handed out, plus room
+  // for the longest possible byte sequence of a single code.
   size_t output_chunk_size_ = 0;
-  std::function<bool(uint8_t*, size_t)> output_cb_;
-  std::vector<uint8_t> output_;
-  std::vector<uint8_t>::iterator output_it_;
+  std::unique_ptr<uint8_t[]> output_;
+  size_t output_capacity_ = 0;
+  size_t output_size_ = 0;
 
   bool eoi_seen_ = false;
 };
 
+bool LZWReader::CodeStream::ReadNext(uint16_t* code) {
+  // Simple read example:
+  //
+  // Here is our uint32_t |buffer_| as a 4-byte buffer:
+  // [byte0][byte1][byte2][byte3]
+  //
+  // Here is it empty (dots mean bits):
+  // [........][........][........][........]
+  //
+  // Now, reading the first byte (b mean non-empty bit).
+  // |unread_bits_| is 0, |buffer_| is 0, so we literally just cast input byte
+  // to uint32_t:
+  // [........][........][........][b0 b1 b2 b3 b4 b5 b6 b7]
+  // 8 bits are now in the input buffer, so we increase |unread_bits_| by 8.
+  //
+  // After that, say, we read 5-bit codes:
+  // |codesize_| is 5, Codemask for 5-bit code is:
+  // [00000000][00000000][00000000][00011111]
+  // thus we use last 5 bits of the input to create new code by applying
+  // |codemask_| to |buffer_|. Thus |code| is
+  // [. . . . . . . .][. . . b3 b4 b5 b6 b7].
+  //
+  // Finally, we consume 5 bits from the input by shifting it right by
+  // |codesize_|, so 3 first bits from the input byte left in |buffer_|:
+  // [........][........][........][. . . . . b0 b1 b2].
+  // We also decrease |unread_bits_| by 5, so now it is 3.
+  //
+  // If we had smaller |codesize_| we would repeat reading next code. But now,
+  // only 3 bits left in |buffer_|, we need  at least 2 more bits to get next
+  // code, so we go and read next byte from the |input_|.
+  // What we want to get is:
+  // [........][........][..... nb0 nb1 nb2][nb3 nb4 nb5 nb6 nb7 b0 b1 b2].
+  // (nb0..nb7 - bits from next byte read)
+  //
+  // This is exactly what we do:
+  // After casting |*input_:uint8_t| to uint32_t we have:
+  // [........][........][........][nb0 nb1 nb2 nb3 nb4 nb5 nb6 nb7]
+  //
+  // Now all we need to do is shift those bits left by 3 (i.e. |unread_bits_|)
+  // to get smth like this:
+  // [........][........][..... nb0 nb1 nb2][nb3 nb4 nb5 nb6 nb7 . . .],
+  //
+  // and place it into our buffer (either by ADDing or by XORing).
+  // Finally, we increase |unread_bits_| by another 8 an proceed consuming.
+  // Loop until the end.
+  while (unread_bits_ < codesize_ && input_size_ > 0) {
+    buffer_ |= (static_cast<uint32_t>(*input_)) << unread_bits_;
+    unread_bits_ += 8;
+    input_++;
+    input_size_--;
+  }
+
+  if (unread_bits_ < codesize_) {
+    DCHECK_EQ(0, input_size_);
+    return false;
+  }
+
+  *code = static_cast<uint16_t>(buffer_ & codemask_);
+  buffer_ >>= codesize_;
+  unread_bits_ -= codesize_;
+
+  return true;
+}
+
+template <typename Output>
+io::IoResult LZWReader::Decode(const uint8_t* data,
+                               size_t size,
+                               Output&& output) {
+  if (eoi_seen_) {
+    return io::IoResult::Eof();
+  }
+  DCHECK(output_);
+  code_stream_.SetupBuffer(data, size);
+  uint16_t code;
+  while (code_stream_.ReadNext(&code)) {
+    // clear code means we have to clean all our state - dictionary,
+    // code size, etc.
+    if (code == clear_code_) {
+      Clear();
+      continue;
+    }
+
+    // End of information, i.e. image. Signal to the client.
+    if (code == eoi_) {
+      if (!FlushChunks(output))
+        return io::IoResult::Error();
+      if (output_size_ > 0 && !output(&output_[0], output_size_))
+        return io::IoResult::Error();
+
+      output_size_ = 0;
+      eoi_seen_ = true;
+      break;
+    }
+
+    if (!OutputCode(code))
+      return io::IoResult::Error();
+
+    // Output to the client as much as we can by chunks of |output_chunk_size_|.
+    if (output_size_ >= output_chunk_size_ && !FlushChunks(output))
+      return io::IoResult::Error();
+  }
+  return io::IoResult::Read(size - code_stream_.available());
+}
+
+template <typename Output>
+bool LZWReader::FlushChunks(Output& output) {
+  size_t chunk_start = 0;
+  for (; chunk_start + output_chunk_size_ <= output_size_;
+       chunk_start += output_chunk_size_) {
+    if (!output(&output_[chunk_start], output_chunk_size_))
+      return false;
+  }
+
+  // If something was consumed, move remaining data to the beginning of the
+  // buffer.
+  if (chunk_start != 0) {
+    output_size_ -= chunk_start;
+    memmove(&output_[0], &output_[chunk_start], output_size_);
+  }
+  return true;
+}
+
 }  // namespace image
 
 #endif  // SQUIM_IMAGE_CODECS_GIF_LZW_READER_H_
@@ -16,6 +16,7 @@
 
 #include "squim/image/codecs/gif/lzw_reader.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "squim/image/codecs/gif/lzw_writer.h"
@@ -44,12 +45,12 @@ class LZWReaderTest : public testing::Test {
 
     std::vector<uint8_t> decoded;
     LZWReader reader;
-    ASSERT_TRUE(reader.Init(data_size, chunk_size,
-                            [&decoded](uint8_t* data, size_t len) -> bool {
-                              decoded.insert(decoded.end(), data, data + len);
-                              return true;
-                            }));
-    result = reader.Decode(&encoded[0], encoded.size());
+    ASSERT_TRUE(reader.Init(data_size, chunk_size));
+    auto output = [&decoded](uint8_t* data, size_t len) -> bool {
+      decoded.insert(decoded.end(), data, data + len);
+      return true;
+    };
+    result = reader.Decode(&encoded[0], encoded.size(), output);
     EXPECT_TRUE(result.ok());
     EXPECT_EQ(encoded.size(), result.n());
     EXPECT_GT(decoded.size(), encoded.size());
@@ -89,4 +90,175 @@ TEST_F(LZWReaderTest, SuccessLarge) {
   CheckEncodeDecodeCycle(input, 8, 1024);
 }
 
+TEST_F(LZWReaderTest, SuccessByteByByte) {
+  std::vector<uint8_t> input;
+  for (size_t i = 0; i < 5000; ++i)
+    input.push_back((i * i / 7) % 16);
+
+  std::vector<uint8_t> encoded;
+  LZWWriter writer;
+  ASSERT_TRUE(writer.Init(4, 100, [&encoded](uint8_t* data, size_t len) {
+    encoded.insert(encoded.end(), data, data + len);
+    return true;
+  }));
+  ASSERT_TRUE(writer.Write(&input[0], input.size()).ok());
+  ASSERT_TRUE(writer.Finish().ok());
+
+  std::vector<uint8_t> decoded;
+  size_t calls = 0;
+  auto output = [&decoded, &calls](uint8_t* data, size_t len) -> bool {
+    EXPECT_LE(len, 100u);
+    decoded.insert(decoded.end(), data, data + len);
+    calls++;
+    return true;
+  };
+  LZWReader reader;
+  ASSERT_TRUE(reader.Init(4, 100));
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    auto result = reader.Decode(&encoded[i], 1, output);
+    ASSERT_TRUE(result.ok()) << i;
+    EXPECT_EQ(1u, result.n());
+  }
+  EXPECT_TRUE(reader.Decode(&encoded[0], 1, output).eof());
+  EXPECT_EQ(50u, calls);
+  EXPECT_EQ(input, decoded);
+}
+
+TEST_F(LZWReaderTest, FailsOnUnknownCode) {
+  // Clear code (4), then code 7 which is not in the dictionary yet.
+  // 3-bit codes, LSB first: 100 111 -> 0b00111100.
+  std::vector<uint8_t> encoded{0x3C, 0x00};
+  LZWReader reader;
+  ASSERT_TRUE(reader.Init(2, 16));
+  auto output = [](uint8_t* data, size_t len) -> bool { return true; };
+  EXPECT_FALSE(reader.Decode(&encoded[0], encoded.size(), output).ok());
+}
+
+TEST_F(LZWReaderTest, StopsWhenOutputFails) {
+  std::vector<uint8_t> input(1000, 1);
+  std::vector<uint8_t> encoded;
+  LZWWriter writer;
+  ASSERT_TRUE(writer.Init(2, 10, [&encoded](uint8_t* data, size_t len) {
+    encoded.insert(encoded.end(), data, data + len);
+    return true;
+  }));
+  ASSERT_TRUE(writer.Write(&input[0], input.size()).ok());
+  ASSERT_TRUE(writer.Finish().ok());
+
+  LZWReader reader;
+  ASSERT_TRUE(reader.Init(2, 10));
+  auto output = [](uint8_t* data, size_t len) -> bool { return false; };
+  EXPECT_FALSE(reader.Decode(&encoded[0], encoded.size(), output).ok());
+}
+
+TEST_F(LZWReaderTest, ReusedAfterInit) {
+  std::vector<uint8_t> input(1000, 3);
+  std::vector<uint8_t> encoded;
+  LZWWriter writer;
+  ASSERT_TRUE(writer.Init(2, 10, [&encoded](uint8_t* data, size_t len) {
+    encoded.insert(encoded.end(), data, data + len);
+    return true;
+  }));
+  ASSERT_TRUE(writer.Write(&input[0], input.size()).ok());
+  ASSERT_TRUE(writer.Finish().ok());
+
+  LZWReader reader;
+  for (int i = 0; i < 2; ++i) {
+    std::vector<uint8_t> decoded;
+    auto output = [&decoded](uint8_t* data, size_t len) -> bool {
+      decoded.insert(decoded.end(), data, data + len);
+      return true;
+    };
+    ASSERT_TRUE(reader.Init(2, 10));
+    ASSERT_TRUE(reader.Decode(&encoded[0], encoded.size(), output).ok());
+    EXPECT_EQ(input, decoded);
+  }
+}
+
+TEST_F(LZWReaderTest, WriterAcceptsInputByPieces) {
+  std::vector<uint8_t> input;
+  for (size_t i = 0; i < 20000; ++i)
+    input.push_back((i * i / 13) % 64);
+
+  auto encode = [&input](size_t piece) {
+    std::vector<uint8_t> encoded;
+    LZWWriter writer;
+    EXPECT_TRUE(writer.Init(6, 255, [&encoded](uint8_t* data, size_t len) {
+      encoded.insert(encoded.end(), data, data + len);
+      return true;
+    }));
+    for (size_t pos = 0; pos < input.size(); pos += piece) {
+      size_t len = std::min(piece, input.size() - pos);
+      auto result = writer.Write(&input[pos], len);
+      EXPECT_TRUE(result.ok());
+      EXPECT_EQ(len, result.n());
+    }
+    EXPECT_TRUE(writer.Finish().ok());
+    return encoded;
+  };
+
+  // Splitting the input must not change the produced code stream.
+  auto expected = encode(input.size());
+  EXPECT_EQ(expected, encode(1));
+  EXPECT_EQ(expected, encode(777));
+
+  std::vector<uint8_t> decoded;
+  LZWReader reader;
+  ASSERT_TRUE(reader.Init(6, 255));
+  auto output = [&decoded](uint8_t* data, size_t len) -> bool {
+    decoded.insert(decoded.end(), data, data + len);
+    return true;
+  };
+  ASSERT_TRUE(reader.Decode(&expected[0], expected.size(), output).ok());
+  EXPECT_EQ(input, decoded);
+}
+
+TEST_F(LZWReaderTest, WriterSurvivesDictionaryResets) {
+  // Pseudo-random data fills the dictionary many times over.
+  std::vector<uint8_t> input;
+  uint32_t state = 1;
+  for (size_t i = 0; i < 300000; ++i) {
+    state = state * 1103515245 + 12345;
+    input.push_back((state >> 16) % 8);
+  }
+  CheckEncodeDecodeCycle(input, 8, 255);
+}
+
+TEST_F(LZWReaderTest, WriterRejectsBadInput) {
+  LZWWriter writer;
+  auto output = [](uint8_t* data, size_t len) -> bool { return true; };
+  EXPECT_FALSE(writer.Init(9, 10, output));
+  EXPECT_FALSE(writer.Init(8, 0, output));
+  ASSERT_TRUE(writer.Init(2, 10, output));
+  std::vector<uint8_t> input{0, 1, 2, 3, 4};
+  EXPECT_TRUE(writer.Write(&input[0], 4).ok());
+  EXPECT_FALSE(writer.Write(&input[4], 1).ok());
+}
+
+TEST_F(LZWReaderTest, WriterReusedAfterInit) {
+  std::vector<uint8_t> input;
+  for (size_t i = 0; i < 3000; ++i)
+    input.push_back((i / 3) % 16);
+
+  LZWWriter writer;
+  std::vector<uint8_t> encoded[2];
+  for (int i = 0; i < 2; ++i) {
+    std::vector<uint8_t>* out = &encoded[i];
+    ASSERT_TRUE(writer.Init(4, 100, [out](uint8_t* data, size_t len) {
+      out->insert(out->end(), data, data + len);
+      return true;
+    }));
+    ASSERT_TRUE(writer.Write(&input[0], input.size()).ok());
+    ASSERT_TRUE(writer.Finish().ok());
+  }
+  EXPECT_EQ(encoded[0], encoded[1]);
+}
+
+TEST_F(LZWReaderTest, RejectsBadParams) {
+  LZWReader reader;
+  EXPECT_FALSE(reader.Init(12, 10));
+  EXPECT_FALSE(reader.Init(8, 0));
+  EXPECT_TRUE(reader.Init(8, 10));
+}
+
 }  // namespace image
@@ -26,6 +26,8 @@
 
 namespace image {
 
+const uint32_t LZWWriter::kEmptySlot;
+
 LZWWriter::CodeStream::CodeStream() {}
 
 void LZWWriter::CodeStream::Init(
@@ -36,6 +38,8 @@ void LZWWriter::CodeStream::Init(
   output_.resize(output_chunk_size);
   output_it_ = output_.begin();
   output_cb_ = output_cb;
+  buffer_ = 0;
+  bits_in_buffer_ = 0;
   ResetCodesize(data_size);
 }
 
@@ -86,13 +90,14 @@ LZWWriter::~LZWWriter() {}
 bool LZWWriter::Init(size_t data_size,
                      size_t output_chunk_size,
                      std::function<bool(uint8_t*, size_t)> output_cb) {
-  if (data_size > kMaxCodeSize)
+  // Indices are bytes.
+  if (data_size > 8 || output_chunk_size == 0)
     return false;
 
   data_size_ = data_size;
   clear_code_ = 1 << data_size_;
   eoi_ = clear_code_ + 1;
-  code_table_.reserve(kMaxDictionarySize);
+  started_ = false;
 
   code_stream_.Init(data_size_, output_chunk_size, output_cb);
   Clear();
@@ -101,16 +106,10 @@ bool LZWWriter::Init(size_t data_size,
 }
 
 void LZWWriter::Clear() {
-  code_table_.clear();
+  // Trivial codes, i.e. colors, are implicit.
+  keys_.fill(kEmptySlot);
   next_code_ = eoi_ + 1;
   code_stream_.ResetCodesize(data_size_);
-
-  // Fill trivial codes, i.e. colors.
-  for (size_t i = 0; i < clear_code_; ++i) {
-    IndexBuffer buf;
-    buf.push_back(i);
-    code_table_.insert({buf, i});
-  }
 }
 
 io::IoResult LZWWriter::Write(io::Chunk* chunk) {
@@ -119,49 +118,51 @@ io::IoResult LZWWriter::Write(io::Chunk* chunk) {
 
 io::IoResult LZWWriter::Write(const uint8_t* data, size_t len) {
   const uint8_t* end = data + len;
-  if (!started_) {
+  if (!started_ && data < end) {
     started_ = true;
     if (!code_stream_.Write(clear_code_))
       return io::IoResult::Error();
 
-    index_buffer_.push_back(*data++);
-    auto it = code_table_.find(index_buffer_);
-    DCHECK(it != code_table_.end());
-    last_code_in_index_buffer_ = it->second;
+    if (*data >= clear_code_)
+      return io::IoResult::Error();
+    current_code_ = *data++;
   }
 
-  DCHECK_GT(kMaxDictionarySize, code_table_.size());
   while (data < end) {
     auto index = *data++;
-    index_buffer_.push_back(index);
-    if (code_table_.find(index_buffer_) == code_table_.end()) {
-      if (!code_stream_.Write(last_code_in_index_buffer_))
-        return io::IoResult::Error();
+    if (index >= clear_code_)
+      return io::IoResult::Error();
 
-      if (!code_stream_.CodeFitsCurrentCodesize(next_code_))
-        code_stream_.IncreaseCodesize();
-
-      code_table_.insert({std::move(index_buffer_), next_code_++});
-      index_buffer_.clear();
-      if (next_code_ == kMaxDictionarySize) {
-        if (!code_stream_.Write(clear_code_))
-          return io::IoResult::Error();
-        Clear();
-      }
-      index_buffer_.push_back(index);
+    uint32_t key = (static_cast<uint32_t>(current_code_) << 8) | index;
+    size_t slot = FindSlot(key);
+    if (keys_[slot] == key) {
+      current_code_ = codes_[slot];
+      continue;
     }
 
-    auto it = code_table_.find(index_buffer_);
-    DCHECK(it != code_table_.end());
-    last_code_in_index_buffer_ = it->second;
+    if (!code_stream_.Write(current_code_))
+      return io::IoResult::Error();
+
+    if (!code_stream_.CodeFitsCurrentCodesize(next_code_))
+      code_stream_.IncreaseCodesize();
+
+    keys_[slot] = key;
+    codes_[slot] = next_code_++;
+    if (next_code_ == kMaxDictionarySize) {
+      if (!code_stream_.Write(clear_code_))
+        return io::IoResult::Error();
+      Clear();
+    }
+    current_code_ = index;
   }
-  if (!code_stream_.Write(last_code_in_index_buffer_))
-    return io::IoResult::Error();
 
   return io::IoResult::Write(len);
 }
 
 io::IoResult LZWWriter::Finish() {
+  if (started_ && !code_stream_.Write(current_code_))
+    return io::IoResult::Error();
+
   if (!code_stream_.Write(eoi_) || !code_stream_.Finish())
     return io::IoResult::Error();
 
@@ -17,8 +17,8 @@
 #ifndef SQUIM_IMAGE_CODECS_GIF_LZW_WRITER_H_
 #define SQUIM_IMAGE_CODECS_GIF_LZW_WRITER_H_
 
+#include <array>
 #include <functional>
-#include <unordered_map>
 #include <vector>
 
 #include "squim/base/logging.h"
@@ -28,32 +28,23 @@ namespace io {
 class Chunk;
 }
 
-namespace std {
-template <>
-struct hash<std::vector<uint8_t>> {
-  size_t operator()(const std::vector<uint8_t>& x) const {
-    // FNV-1a hash
-    const size_t kFNV32Prime = 0x01000193;
-    size_t hval = 0x811c9dc5;
-    for (uint8_t c : x) {
-      hval ^= static_cast<size_t>(c);
-      hval *= kFNV32Prime;
-    }
-    return hval;
-  }
-};
-}
-
 namespace image {
 
 // See http://www.matthewflickinger.com/lab/whatsinagif/lzw_image_data.asp
 // for details.
-// No comments here, since it is test-only class.
+//
+// GIF LZW encoder. The dictionary is a fixed open-addressed hash table keyed
+// by (prefix code, next index), so encoding does no allocations and costs a
+// single table probe per input byte. Input may be passed by pieces with
+// multiple Write() calls, the last code is emitted by Finish().
 class LZWWriter {
  public:
   LZWWriter();
   ~LZWWriter();
 
+  // |data_size| is GIF minimum code size, all written indices must be smaller
+  // than 1 << |data_size|. Encoded data is passed to |output_cb| by pieces of
+  // |output_chunk_size| bytes. Can be called again to encode another image.
   bool Init(size_t data_size,
             size_t output_chunk_size,
             std::function<bool(uint8_t*, size_t)> output_cb);
@@ -65,6 +56,10 @@ class LZWWriter {
  private:
   static const size_t kMaxCodeSize = 12;
   static constexpr size_t kMaxDictionarySize = 1 << kMaxCodeSize;  // 4096
+  // Twice the dictionary size keeps probe sequences short.
+  static const size_t kHashBits = kMaxCodeSize + 1;
+  static constexpr size_t kHashSize = 1 << kHashBits;
+  static const uint32_t kEmptySlot = 0xFFFFFFFF;
 
   class CodeStream {
    public:
@@ -94,13 +89,21 @@ class LZWWriter {
 
   void Clear();
 
-  using IndexBuffer = std::vector<uint8_t>;
-  using CodeTable = std::unordered_map<IndexBuffer, uint16_t>;
-  IndexBuffer index_buffer_;
-  CodeTable code_table_;
+  // Returns the slot holding |key|, or the empty slot where it belongs.
+  size_t FindSlot(uint32_t key) const {
+    size_t slot = (key * 2654435761u) >> (32 - kHashBits);
+    while (keys_[slot] != kEmptySlot && keys_[slot] != key)
+      slot = (slot + 1) & (kHashSize - 1);
+    return slot;
+  }
+
+  // Keys are (prefix code << 8) | index.
+  std::array<uint32_t, kHashSize> keys_;
+  std::array<uint16_t, kHashSize> codes_;
   CodeStream code_stream_;
 
-  uint16_t last_code_in_index_buffer_ = 0;
+  // Code of the longest string seen so far which is in the dictionary.
+  uint16_t current_code_ = 0;
   uint16_t next_code_ = 0;
   uint16_t clear_code_ = 0;
   uint16_t eoi_ = 0;
@@ -16,6 +16,11 @@
 
 #include "squim/image/codecs/gif_decoder.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
 #include "squim/image/codecs/gif/gif_image_parser.h"
@@ -40,8 +45,75 @@ ImageFrame::DisposalMethod GifDisposalToDisposalMethod(
       return ImageFrame::DisposalMethod::kNone;
   }
 }
+
+// GIF color table unpacked into output pixels, 4 bytes per entry in memory
+// order (RGBA), with the transparent color already applied. Converting a
+// pixel is then a single table lookup and a fixed-size copy.
+using PackedPalette = std::array<uint32_t, 256>;
+
+void PackPalette(const GifImage::ColorTable& color_table,
+                 size_t transparent_pixel,
+                 PackedPalette* palette) {
+  palette->fill(0);
+  for (size_t i = 0; i < color_table.size() && i < palette->size(); ++i) {
+    auto color = color_table.GetColor(i);
+    uint8_t rgba[] = {color.r(), color.g(), color.b(), 0xFF};
+    memcpy(&(*palette)[i], rgba, sizeof(rgba));
+  }
+  if (transparent_pixel < palette->size()) {
+    uint8_t rgba[] = {0xFF, 0xFF, 0xFF, 0x00};
+    memcpy(&(*palette)[transparent_pixel], rgba, sizeof(rgba));
+  }
+}
+
+// Color index is valid if it is either in the color table or is the
+// transparent one.
+bool RowIndicesValid(const uint8_t* indices,
+                     size_t width,
+                     size_t num_colors,
+                     size_t transparent_pixel) {
+  if (num_colors >= 256)
+    return true;
+
+  // Fast path: single pass looking for the largest index.
+  uint8_t max_idx = 0;
+  for (size_t x = 0; x < width; ++x)
+    max_idx = std::max(max_idx, indices[x]);
+  if (max_idx < num_colors)
+    return true;
+
+  for (size_t x = 0; x < width; ++x) {
+    if (indices[x] >= num_colors && indices[x] != transparent_pixel)
+      return false;
+  }
+  return true;
+}
+
+void ConvertRowRGBA(const uint8_t* indices,
+                    size_t width,
+                    const PackedPalette& palette,
+                    uint8_t* out) {
+  for (size_t x = 0; x < width; ++x)
+    memcpy(out + x * 4, &palette[indices[x]], 4);
 }
 
+void ConvertRowRGB(const uint8_t* indices,
+                   size_t width,
+                   const PackedPalette& palette,
+                   uint8_t* out) {
+  if (width == 0)
+    return;
+  // Every packed entry is copied whole, its 4th byte is overwritten by the
+  // next pixel. The last pixel doesn't have the next one, so it is copied
+  // separately to stay within the row.
+  size_t last = width - 1;
+  for (size_t x = 0; x < last; ++x)
+    memcpy(out + x * 3, &palette[indices[x]], 4);
+  memcpy(out + last * 3, &palette[indices[last]], 3);
+}
+
+}  // namespace
+
 // static
 GifDecoder::Params GifDecoder::Params::Default() {
   Params params;
@@ -57,6 +129,7 @@ class GifDecoder::Impl {
   Impl(GifDecoder* decoder) : decoder_(decoder) {
     gif_parser_ = base::make_unique<GifImage::Parser>(decoder_->source_.get(),
                                                       &gif_image_);
+    gif_parser_->set_max_decode_threads(decoder_->params_.max_decode_threads);
   }
 
   ~Impl() {}
@@ -111,7 +184,15 @@ class GifDecoder::Impl {
       frame->set_offset(gif_frame->x_offset(), gif_frame->y_offset());
       frame->set_size(gif_frame->width(), gif_frame->height());
       frame->set_is_progressive(gif_frame->is_progressive());
-      if (gif_frame->transparent_pixel() != GifImage::kNoTransparentPixel) {
+      // Palette frames keep GIF color indices as is, so that encoders can
+      // expand them right into their own buffers.
+      bool keep_palette =
+          decoder_->params_.color_scheme_allowed(ColorScheme::kPalette);
+      bool has_alpha =
+          gif_frame->transparent_pixel() != GifImage::kNoTransparentPixel;
+      if (keep_palette) {
+        frame->set_color_scheme(ColorScheme::kPalette);
+      } else if (has_alpha) {
         frame->set_color_scheme(ColorScheme::kRGBA);
       } else {
         frame->set_color_scheme(ColorScheme::kRGB);
@@ -122,36 +203,47 @@ class GifDecoder::Impl {
       frame->set_status(ImageFrame::Status::kHeaderComplete);
 
       frame->Init();
-      Bitmap bitmap(frame.get());
+      PackPalette(*color_table, gif_frame->transparent_pixel(), &palette_);
+      if (keep_palette) {
+        size_t palette_size = color_table->size();
+        if (has_alpha) {
+          palette_size =
+              std::max(palette_size, gif_frame->transparent_pixel() + 1);
+        }
+        palette_size = std::min(palette_.size(), palette_size);
+        std::vector<ImageFrame::PaletteEntry> palette(palette_size);
+        memcpy(&palette[0], &palette_[0], palette_size * sizeof(palette_[0]));
+        frame->set_palette(std::move(palette));
+      }
       for (auto y = 0; y < gif_frame->height(); ++y) {
-        for (auto x = 0; x < gif_frame->width(); ++x) {
-          auto idx = gif_frame->GetPixel(x, y);
-          if (idx > color_table->size()) {
-            decoder_->Fail(Result::Error(Result::Code::kDecodeError,
-                                         "Invalid color index"));
-            return false;
-          }
-
-          auto color = color_table->GetColor(idx);
-          if (frame->color_scheme() == ColorScheme::kRGBA) {
-            if (idx == gif_frame->transparent_pixel()) {
-              bitmap.GetPixel<RGBAPixel>(x, y).set(0xFF, 0xFF, 0xFF, 0x00);
-            } else {
-              bitmap.GetPixel<RGBAPixel>(x, y)
-                  .set(color.r(), color.g(), color.b(), 0xFF);
-            }
-          } else {
-            bitmap.GetPixel<RGBPixel>(x, y)
-                .set(color.r(), color.g(), color.b());
-          }
+        const uint8_t* indices = gif_frame->GetRow(y);
+        if (!RowIndicesValid(indices, gif_frame->width(), color_table->size(),
+                             gif_frame->transparent_pixel())) {
+          decoder_->Fail(Result::Error(Result::Code::kDecodeError,
+                                       "Invalid color index"));
+          return false;
+        }
+        uint8_t* out = frame->GetPixel(0, y);
+        if (keep_palette) {
+          memcpy(out, indices, gif_frame->width());
+        } else if (has_alpha) {
+          ConvertRowRGBA(indices, gif_frame->width(), palette_, out);
+        } else {
+          ConvertRowRGB(indices, gif_frame->width(), palette_, out);
         }
       }
 
+      // Color indices are not needed once converted, only the frame itself
+      // is kept (until the client releases it).
+      gif_frame->ReleaseData();
       frame->set_status(ImageFrame::Status::kComplete);
       decoder_->image_frames_.push_back(std::move(frame));
       num_frames_ready_++;
     }
 
+    if (gif_parser_->complete() && decoder_->image_info_.size == 0)
+      decoder_->image_info_.size = decoder_->source()->offset();
+
     return true;
   }
 
@@ -163,11 +255,16 @@ class GifDecoder::Impl {
 
   ImageMetadata* GetMetadata() { return gif_image_.GetMetadata(); }
 
+  size_t num_deferred_frames() const {
+    return gif_parser_->num_deferred_frames();
+  }
+
  private:
   GifDecoder* decoder_;
   GifImage gif_image_;
   size_t num_frames_ready_ = 0;
   bool header_complete_reported_ = false;
+  PackedPalette palette_;
   std::unique_ptr<GifImage::Parser> gif_parser_;
 };
 
@@ -206,6 +303,12 @@ ImageFrame* GifDecoder::GetFrameAtIndex(size_t index) {
   return image_frames_[index].get();
 }
 
+void GifDecoder::ReleaseFrameAtIndex(size_t index) {
+  CHECK_GT(image_frames_.size(), index);
+  DCHECK(IsFrameCompleteAtIndex(index));
+  image_frames_[index]->ReleasePixels();
+}
+
 size_t GifDecoder::GetFrameCount() const {
   return image_frames_.size();
 }
@@ -242,6 +345,10 @@ bool GifDecoder::HasError() const {
   return decode_error_.error();
 }
 
+size_t GifDecoder::num_deferred_frames() const {
+  return impl_->num_deferred_frames();
+}
+
 void GifDecoder::Fail(Result error) {
   decode_error_ = error;
 }
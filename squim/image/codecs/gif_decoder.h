@@ -39,6 +39,11 @@ class GifDecoder : public ImageDecoder {
  public:
   struct Params : public DecodeParams {
     static Params Default();
+
+    // Number of threads LZW data of frames is decoded on once the whole
+    // input is buffered. The threads come from base::ThreadPool::Default(), 0
+    // means all of them. 1 decodes frames one by one as they arrive.
+    size_t max_decode_threads = 1;
   };
 
   GifDecoder(Params params, std::unique_ptr<io::BufReader> source);
@@ -50,6 +55,7 @@ class GifDecoder : public ImageDecoder {
   bool IsFrameHeaderCompleteAtIndex(size_t index) const override;
   bool IsFrameCompleteAtIndex(size_t index) const override;
   ImageFrame* GetFrameAtIndex(size_t index) override;
+  void ReleaseFrameAtIndex(size_t index) override;
   size_t GetFrameCount() const override;
   ImageMetadata* GetMetadata() override;
   bool IsAllMetadataComplete() const override;
@@ -59,6 +65,9 @@ class GifDecoder : public ImageDecoder {
   Result DecodeImageInfo() override;
   bool HasError() const override;
 
+  // Number of frames decoded in parallel, see Params::max_decode_threads.
+  size_t num_deferred_frames() const;
+
  private:
   class Impl;
 
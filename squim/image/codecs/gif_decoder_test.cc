@@ -16,6 +16,8 @@
 
 #include "squim/image/codecs/gif_decoder.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -79,6 +81,21 @@ class GifDecoderTest : public testing::Test {
                                read_spec, read_type);
   }
 
+  std::unique_ptr<GifDecoder> DecodeFile(const std::string& filename,
+                                         GifDecoder::Params params) {
+    std::vector<uint8_t> data;
+    if (!ReadTestFileWithExt(kGifTestDir, filename, &data))
+      return nullptr;
+    auto source = base::make_unique<io::BufReader>(
+        base::make_unique<io::BufferedSource>());
+    source->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+    source->source()->SendEof();
+    auto decoder = base::make_unique<GifDecoder>(params, std::move(source));
+    if (!decoder->Decode().ok())
+      return nullptr;
+    return decoder;
+  }
+
   void CheckInvalidRead(const std::string& filename) {
     std::vector<uint8_t> data;
     ASSERT_TRUE(ReadTestFileWithExt(kGifTestDir, filename, &data));
@@ -173,4 +190,115 @@ TEST_F(GifDecoderTest, ReadAnimated) {
   }
 }
 
+TEST_F(GifDecoderTest, ReadPalette) {
+  auto palette_params = GifDecoder::Params::Default();
+  palette_params.allowed_color_schemes.insert(ColorScheme::kPalette);
+  for (auto pic : {"animated.gif", "interlaced.gif", "transparent.gif",
+                   "frame_smaller_than_screen.gif"}) {
+    auto rgb = DecodeFile(pic, GifDecoder::Params::Default());
+    auto palette = DecodeFile(pic, palette_params);
+    ASSERT_TRUE(rgb && palette) << pic;
+    ASSERT_EQ(rgb->GetFrameCount(), palette->GetFrameCount()) << pic;
+    for (size_t i = 0; i < rgb->GetFrameCount(); ++i) {
+      auto* rgb_frame = rgb->GetFrameAtIndex(i);
+      auto* palette_frame = palette->GetFrameAtIndex(i);
+      ASSERT_EQ(ColorScheme::kPalette, palette_frame->color_scheme()) << pic;
+      ASSERT_EQ(rgb_frame->width(), palette_frame->width()) << pic;
+      ASSERT_EQ(rgb_frame->height(), palette_frame->height()) << pic;
+      EXPECT_EQ(rgb_frame->has_alpha(), palette_frame->has_alpha()) << pic;
+      const auto& colors = palette_frame->palette();
+      for (uint32_t y = 0; y < rgb_frame->height(); ++y) {
+        for (uint32_t x = 0; x < rgb_frame->width(); ++x) {
+          auto idx = *palette_frame->GetPixel(x, y);
+          ASSERT_LT(idx, colors.size()) << pic;
+          const uint8_t* expected = rgb_frame->GetPixel(x, y);
+          for (size_t c = 0; c < rgb_frame->bpp(); ++c)
+            ASSERT_EQ(expected[c], colors[idx][c]) << pic << " " << x << ","
+                                                    << y;
+        }
+      }
+    }
+  }
+}
+
+TEST_F(GifDecoderTest, ParallelDecode) {
+  auto parallel_params = GifDecoder::Params::Default();
+  parallel_params.max_decode_threads = 4;
+  for (auto pic : {"animated.gif", "animated_interlaced.gif",
+                   "full2loop.gif", "square2loop.gif", "transparent.gif",
+                   "frame_smaller_than_screen.gif"}) {
+    auto serial = DecodeFile(pic, GifDecoder::Params::Default());
+    auto parallel = DecodeFile(pic, parallel_params);
+    ASSERT_TRUE(serial && parallel) << pic;
+    EXPECT_TRUE(parallel->IsImageComplete()) << pic;
+    ASSERT_EQ(serial->GetFrameCount(), parallel->GetFrameCount()) << pic;
+    EXPECT_EQ(0u, serial->num_deferred_frames()) << pic;
+    EXPECT_EQ(parallel->GetFrameCount(), parallel->num_deferred_frames())
+        << pic;
+    for (size_t i = 0; i < serial->GetFrameCount(); ++i) {
+      auto* serial_frame = serial->GetFrameAtIndex(i);
+      auto* parallel_frame = parallel->GetFrameAtIndex(i);
+      ASSERT_EQ(serial_frame->width(), parallel_frame->width()) << pic;
+      ASSERT_EQ(serial_frame->height(), parallel_frame->height()) << pic;
+      ASSERT_EQ(serial_frame->color_scheme(), parallel_frame->color_scheme());
+      size_t row_size = serial_frame->width() * serial_frame->bpp();
+      for (uint32_t y = 0; y < serial_frame->height(); ++y) {
+        ASSERT_EQ(0, memcmp(serial_frame->GetPixel(0, y),
+                            parallel_frame->GetPixel(0, y), row_size))
+            << pic << " frame " << i << " row " << y;
+      }
+    }
+  }
+}
+
+TEST_F(GifDecoderTest, ParallelDecodeChunked) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kGifTestDir, "animated", "gif", &data));
+  auto params = GifDecoder::Params::Default();
+  params.max_decode_threads = 0;
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  auto* buffered_source = source->source();
+  auto testee = base::make_unique<GifDecoder>(params, std::move(source));
+  const size_t kChunkSize = 100;
+  size_t frame_count = 0;
+  for (size_t offset = 0; offset < data.size(); offset += kChunkSize) {
+    size_t size = std::min(kChunkSize, data.size() - offset);
+    buffered_source->AddChunk(io::Chunk::Copy(&data[offset], size));
+    auto result = testee->Decode();
+    ASSERT_FALSE(result.error());
+    // Streaming input is decoded inline, frames are published as soon as
+    // their data arrives.
+    EXPECT_LE(frame_count, testee->GetFrameCount());
+    frame_count = testee->GetFrameCount();
+  }
+  EXPECT_LT(0u, frame_count);
+  buffered_source->SendEof();
+  EXPECT_TRUE(testee->Decode().ok());
+  EXPECT_TRUE(testee->IsImageComplete());
+  EXPECT_EQ(8, testee->GetFrameCount());
+}
+
+TEST_F(GifDecoderTest, ReleaseFrame) {
+  auto testee = DecodeFile("animated.gif", GifDecoder::Params::Default());
+  ASSERT_TRUE(testee);
+  ASSERT_EQ(8, testee->GetFrameCount());
+  auto* frame = testee->GetFrameAtIndex(0);
+  auto width = frame->width();
+  auto duration = frame->duration();
+  auto disposal_method = frame->disposal_method();
+  testee->ReleaseFrameAtIndex(0);
+  // Frame header is still there.
+  EXPECT_TRUE(testee->IsFrameCompleteAtIndex(0));
+  EXPECT_EQ(width, frame->width());
+  EXPECT_EQ(duration, frame->duration());
+  EXPECT_EQ(disposal_method, frame->disposal_method());
+  EXPECT_EQ(8, testee->GetFrameCount());
+}
+
+TEST_F(GifDecoderTest, InvalidColorIndex) {
+  CheckInvalidRead("bad_pixel_global_palette.gif");
+  CheckInvalidRead("bad_pixel_local_palette.gif");
+}
+
 }  // namespace image
@@ -0,0 +1,498 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/gif_encoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/gif/gif_image.h"
+#include "squim/image/codecs/gif/lzw_writer.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_info.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/io/chunk.h"
+#include "squim/io/writer.h"
+
+namespace image {
+
+namespace {
+
+const uint8_t kExtensionIntroducer = 0x21;
+const uint8_t kApplicationExtensionLabel = 0xFF;
+const uint8_t kGraphicControlLabel = 0xF9;
+const uint8_t kImageSeparator = 0x2C;
+const uint8_t kTrailer = 0x3B;
+
+const size_t kMaxColors = 256;
+const size_t kMaxSubBlockSize = 255;
+const uint32_t kMaxDimension = 0xFFFF;
+// Largest delay a graphic control extension can hold, in hundredths of a
+// second.
+const uint32_t kMaxDelay = 0xFFFF;
+
+// Canvas pixels are RGBA in memory order. All transparent pixels are stored
+// as kTransparent, so that pixels can be compared as integers.
+const uint32_t kTransparent = 0;
+
+uint32_t PackOpaque(const uint8_t* rgb) {
+  uint8_t rgba[] = {rgb[0], rgb[1], rgb[2], 0xFF};
+  uint32_t pixel;
+  memcpy(&pixel, rgba, sizeof(pixel));
+  return pixel;
+}
+
+// Area of the canvas, [x0, x1) x [y0, y1).
+struct Rect {
+  uint32_t x0 = 0;
+  uint32_t y0 = 0;
+  uint32_t x1 = 0;
+  uint32_t y1 = 0;
+
+  bool empty() const { return x0 >= x1 || y0 >= y1; }
+  uint32_t width() const { return x1 - x0; }
+  uint32_t height() const { return y1 - y0; }
+
+  void Add(uint32_t x, uint32_t y) {
+    if (empty()) {
+      x0 = x;
+      y0 = y;
+      x1 = x + 1;
+      y1 = y + 1;
+      return;
+    }
+    x0 = std::min(x0, x);
+    y0 = std::min(y0, y);
+    x1 = std::max(x1, x + 1);
+    y1 = std::max(y1, y + 1);
+  }
+
+  void Add(const Rect& other) {
+    if (other.empty())
+      return;
+    Add(other.x0, other.y0);
+    Add(other.x1 - 1, other.y1 - 1);
+  }
+};
+
+void PutUint16(uint32_t value, std::vector<uint8_t>* out) {
+  out->push_back(value & 0xFF);
+  out->push_back((value >> 8) & 0xFF);
+}
+
+}  // namespace
+
+class GifEncoder::Impl {
+  MAKE_NONCOPYABLE(Impl);
+
+ public:
+  Impl(const Params* params, const ImageInfo* image_info, io::VectorWriter* dst)
+      : params_(params),
+        image_info_(image_info),
+        dst_(dst),
+        width_(image_info->width),
+        height_(image_info->height),
+        canvas_(width_ * height_, kTransparent),
+        shown_(width_ * height_, kTransparent) {}
+
+  size_t coded_size() const { return coded_size_; }
+
+  Result AddFrame(ImageFrame* frame) {
+    auto result = Composite(frame);
+    if (!result.ok())
+      return result;
+
+    if (!has_pending_) {
+      pending_ = canvas_;
+      pending_duration_ = frame->duration();
+      has_pending_ = true;
+      return Result::Ok();
+    }
+
+    if (params_->merge_duplicate_frames && canvas_ == pending_) {
+      pending_duration_ += frame->duration();
+      return Result::Ok();
+    }
+
+    result = WritePending(false);
+    if (!result.ok())
+      return result;
+
+    pending_ = canvas_;
+    pending_duration_ = frame->duration();
+    return Result::Ok();
+  }
+
+  Result Finish() {
+    if (!has_pending_)
+      return Result::Error(Result::Code::kEncodeError, "Nothing to write");
+
+    auto result = WritePending(true);
+    if (!result.ok())
+      return result;
+
+    has_pending_ = false;
+    std::vector<uint8_t> out{kTrailer};
+    return Write(&out);
+  }
+
+ private:
+  // Draws |frame| over the canvas, as a GIF viewer would.
+  Result Composite(ImageFrame* frame) {
+    switch (prev_disposal_) {
+      case ImageFrame::DisposalMethod::kBackground:
+        Fill(&canvas_, prev_rect_, kTransparent);
+        break;
+      case ImageFrame::DisposalMethod::kRestorePrevious:
+        canvas_ = saved_;
+        break;
+      case ImageFrame::DisposalMethod::kNone:
+        break;
+    }
+    if (frame->disposal_method() ==
+        ImageFrame::DisposalMethod::kRestorePrevious)
+      saved_ = canvas_;
+
+    Rect rect;
+    rect.x0 = std::min(frame->x_offset(), width_);
+    rect.y0 = std::min(frame->y_offset(), height_);
+    rect.x1 = std::min(frame->x_offset() + frame->width(), width_);
+    rect.y1 = std::min(frame->y_offset() + frame->height(), height_);
+    prev_disposal_ = frame->disposal_method();
+    prev_rect_ = rect;
+    if (rect.empty())
+      return Result::Ok();
+
+    uint32_t palette[kMaxColors];
+    if (frame->is_palette()) {
+      std::fill(palette, palette + kMaxColors, kTransparent);
+      const auto& entries = frame->palette();
+      for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i][3] != 0)
+          palette[i] = PackOpaque(entries[i].data());
+      }
+    } else if (!frame->is_rgb()) {
+      return Result::Error(Result::Code::kDunnoHowToEncode,
+                           "Unsupported color scheme for GIF");
+    }
+
+    bool has_alpha = frame->has_alpha();
+    for (uint32_t y = rect.y0; y < rect.y1; ++y) {
+      const uint8_t* in = frame->GetPixel(0, y - frame->y_offset());
+      uint32_t* out = &canvas_[y * width_];
+      for (uint32_t x = rect.x0; x < rect.x1; ++x) {
+        const uint8_t* pixel = in + (x - frame->x_offset()) * frame->bpp();
+        if (frame->is_palette()) {
+          if (palette[*pixel] != kTransparent)
+            out[x] = palette[*pixel];
+        } else if (!has_alpha || pixel[3] != 0) {
+          out[x] = PackOpaque(pixel);
+        }
+      }
+    }
+    return Result::Ok();
+  }
+
+  void Fill(std::vector<uint32_t>* canvas, const Rect& rect, uint32_t value) {
+    for (uint32_t y = rect.y0; y < rect.y1; ++y) {
+      auto row = canvas->begin() + y * width_;
+      std::fill(row + rect.x0, row + rect.x1, value);
+    }
+  }
+
+  // Writes the pending frame. Unless it is the last one, |canvas_| holds the
+  // next frame: if some pixels turn transparent there, the pending frame is
+  // extended over them and disposed to background, since drawing a frame
+  // never makes a pixel transparent.
+  Result WritePending(bool last) {
+    Rect rect;
+    Rect cleared;
+    for (uint32_t y = 0; y < height_; ++y) {
+      const uint32_t* pending = &pending_[y * width_];
+      const uint32_t* shown = &shown_[y * width_];
+      const uint32_t* next = &canvas_[y * width_];
+      bool changed = memcmp(pending, shown, width_ * sizeof(uint32_t)) != 0;
+      for (uint32_t x = 0; x < width_; ++x) {
+        if (changed && pending[x] != shown[x])
+          rect.Add(x, y);
+        if (!last && pending[x] != kTransparent && next[x] == kTransparent)
+          cleared.Add(x, y);
+      }
+    }
+    rect.Add(cleared);
+
+    if (!params_->crop_frames) {
+      rect.x0 = rect.y0 = 0;
+      rect.x1 = width_;
+      rect.y1 = height_;
+    } else if (rect.empty()) {
+      // Nothing changed, but a frame still needs to be written to hold the
+      // duration.
+      rect.Add(0, 0);
+    }
+
+    auto result = WriteFrame(rect, !cleared.empty(), last);
+    if (!result.ok())
+      return result;
+
+    shown_.swap(pending_);
+    if (!cleared.empty())
+      Fill(&shown_, rect, kTransparent);
+    frames_written_++;
+    return Result::Ok();
+  }
+
+  // Collects colors of |rect| of the pending frame into |colors_|. Pixels that
+  // are already shown are made transparent if |keep_shown| is true. Returns
+  // false if the colors don't fit a color table.
+  bool CollectColors(const Rect& rect, bool keep_shown) {
+    colors_.clear();
+    has_transparent_ = false;
+    for (uint32_t y = rect.y0; y < rect.y1; ++y) {
+      const uint32_t* pending = &pending_[y * width_];
+      const uint32_t* shown = &shown_[y * width_];
+      uint32_t last_color = kTransparent;
+      for (uint32_t x = rect.x0; x < rect.x1; ++x) {
+        uint32_t color = pending[x];
+        if (color == kTransparent || (keep_shown && color == shown[x])) {
+          has_transparent_ = true;
+          continue;
+        }
+        if (color == last_color)
+          continue;
+        last_color = color;
+        if (colors_.emplace(color, colors_.size()).second &&
+            colors_.size() > kMaxColors)
+          return false;
+      }
+    }
+    return colors_.size() + (has_transparent_ ? 1 : 0) <= kMaxColors;
+  }
+
+  Result WriteFrame(const Rect& rect, bool dispose, bool last) {
+    bool keep_shown = params_->crop_frames;
+    if (!CollectColors(rect, keep_shown)) {
+      // Transparent pixels may not be allowed a color table entry, try to
+      // draw all pixels as is.
+      keep_shown = false;
+      // The frame can't be drawn with a single color table. Splitting it
+      // into several frames is not supported.
+      if (!CollectColors(rect, keep_shown))
+        return Result::Error(Result::Code::kDunnoHowToEncode,
+                             "Too many colors for a GIF frame");
+    }
+
+    size_t num_colors = colors_.size() + (has_transparent_ ? 1 : 0);
+    size_t transparent_index = colors_.size();
+    size_t table_bits = 1;
+    while ((1u << table_bits) < num_colors)
+      table_bits++;
+
+    std::vector<uint8_t> out;
+    if (frames_written_ == 0)
+      WriteHeader(last, &out);
+
+    bool animated = frames_written_ > 0 || !last;
+    if (animated || has_transparent_ || pending_duration_ > 0) {
+      auto disposal = dispose ? GifImage::DisposalMethod::kOverwriteBgcolor
+                              : GifImage::DisposalMethod::kKeep;
+      uint32_t delay = std::min((pending_duration_ + 5) / 10, kMaxDelay);
+      out.push_back(kExtensionIntroducer);
+      out.push_back(kGraphicControlLabel);
+      out.push_back(4);
+      out.push_back((static_cast<uint8_t>(disposal) << 2) |
+                    (has_transparent_ ? 1 : 0));
+      PutUint16(delay, &out);
+      out.push_back(has_transparent_ ? transparent_index : 0);
+      out.push_back(0);
+    }
+
+    out.push_back(kImageSeparator);
+    PutUint16(rect.x0, &out);
+    PutUint16(rect.y0, &out);
+    PutUint16(rect.width(), &out);
+    PutUint16(rect.height(), &out);
+    // Local color table, not interlaced.
+    out.push_back(0x80 | (table_bits - 1));
+    size_t table_start = out.size();
+    out.resize(table_start + (3 << table_bits), 0);
+    for (const auto& color : colors_)
+      memcpy(&out[table_start + color.second * 3], &color.first, 3);
+
+    size_t code_size = std::max<size_t>(2, table_bits);
+    out.push_back(code_size);
+    auto output = [&out](uint8_t* data, size_t size) -> bool {
+      out.push_back(size);
+      out.insert(out.end(), data, data + size);
+      return true;
+    };
+    if (!lzw_writer_.Init(code_size, kMaxSubBlockSize, output))
+      return Result::Error(Result::Code::kEncodeError, "LZW init failed");
+
+    std::vector<uint8_t> row(rect.width());
+    uint32_t last_color = kTransparent;
+    uint8_t last_index = 0;
+    for (uint32_t y = rect.y0; y < rect.y1; ++y) {
+      const uint32_t* pending = &pending_[y * width_];
+      const uint32_t* shown = &shown_[y * width_];
+      for (uint32_t x = rect.x0; x < rect.x1; ++x) {
+        uint32_t color = pending[x];
+        if (color == kTransparent || (keep_shown && color == shown[x])) {
+          row[x - rect.x0] = transparent_index;
+          continue;
+        }
+        if (color != last_color) {
+          last_color = color;
+          last_index = colors_[color];
+        }
+        row[x - rect.x0] = last_index;
+      }
+      if (lzw_writer_.Write(&row[0], row.size()).error())
+        return Result::Error(Result::Code::kEncodeError, "LZW encoding failed");
+    }
+    if (lzw_writer_.Finish().error())
+      return Result::Error(Result::Code::kEncodeError, "LZW encoding failed");
+    out.push_back(0);
+
+    return Write(&out);
+  }
+
+  void WriteHeader(bool single_frame, std::vector<uint8_t>* out) {
+    const char kSignature[] = "GIF89a";
+    out->insert(out->end(), kSignature, kSignature + 6);
+    PutUint16(width_, out);
+    PutUint16(height_, out);
+    // No global color table, 8 bit color resolution.
+    out->push_back(0x70);
+    out->push_back(0);  // Background color index.
+    out->push_back(0);  // Pixel aspect ratio.
+
+    // No loop count means the animation is played once.
+    auto loop_count = image_info_->loop_count;
+    if (single_frame || loop_count == 0)
+      return;
+
+    if (loop_count == GifImage::kInifiniteLoop)
+      loop_count = 0;
+    const char kNetscape[] = "NETSCAPE2.0";
+    out->push_back(kExtensionIntroducer);
+    out->push_back(kApplicationExtensionLabel);
+    out->push_back(11);
+    out->insert(out->end(), kNetscape, kNetscape + 11);
+    out->push_back(3);
+    out->push_back(1);
+    PutUint16(std::min<size_t>(loop_count, 0xFFFF), out);
+    out->push_back(0);
+  }
+
+  Result Write(std::vector<uint8_t>* out) {
+    coded_size_ += out->size();
+    io::ChunkList chunks;
+    chunks.push_back(io::Chunk::Copy(&(*out)[0], out->size()));
+    return Result::FromIoResult(dst_->WriteV(std::move(chunks)), false);
+  }
+
+  const Params* params_;
+  const ImageInfo* image_info_;
+  io::VectorWriter* dst_;
+  const uint32_t width_;
+  const uint32_t height_;
+
+  // Input frames composited so far.
+  std::vector<uint32_t> canvas_;
+  // Canvas to restore when the last frame is disposed to previous.
+  std::vector<uint32_t> saved_;
+  ImageFrame::DisposalMethod prev_disposal_ = ImageFrame::DisposalMethod::kNone;
+  Rect prev_rect_;
+
+  // Canvas of the output frame waiting for the next one to differ.
+  std::vector<uint32_t> pending_;
+  uint32_t pending_duration_ = 0;
+  bool has_pending_ = false;
+
+  // What a viewer shows after the last written frame is disposed.
+  std::vector<uint32_t> shown_;
+  size_t frames_written_ = 0;
+  size_t coded_size_ = 0;
+
+  // Color to its index in the color table of the frame being written.
+  std::unordered_map<uint32_t, size_t> colors_;
+  bool has_transparent_ = false;
+  LZWWriter lzw_writer_;
+};
+
+// static
+GifEncoder::Params GifEncoder::Params::Default() {
+  return Params();
+}
+
+GifEncoder::GifEncoder(Params params, std::unique_ptr<io::VectorWriter> dst)
+    : params_(params), dst_(std::move(dst)) {}
+
+GifEncoder::~GifEncoder() {}
+
+Result GifEncoder::Initialize(const ImageInfo* image_info) {
+  image_info_ = image_info;
+  return Result::Ok();
+}
+
+Result GifEncoder::EncodeFrame(ImageFrame* frame, bool last_frame) {
+  if (!error_.ok())
+    return error_;
+
+  if (!impl_) {
+    if (!image_info_ || image_info_->width == 0 || image_info_->height == 0 ||
+        image_info_->width > kMaxDimension ||
+        image_info_->height > kMaxDimension) {
+      error_ = Result::Error(Result::Code::kDunnoHowToEncode,
+                             "Bad image size for GIF");
+      return error_;
+    }
+    impl_ = base::make_unique<Impl>(&params_, image_info_, dst_.get());
+  }
+
+  auto result = Result::Ok();
+  if (frame)
+    result = impl_->AddFrame(frame);
+  if (result.ok() && last_frame)
+    result = impl_->Finish();
+
+  if (result.error())
+    error_ = result;
+  return result;
+}
+
+void GifEncoder::SetMetadata(const ImageMetadata* metadata) {}
+
+Result GifEncoder::FinishWrite(ImageOptimizationStats* stats) {
+  if (!error_.ok())
+    return error_;
+
+  if (!impl_) {
+    error_ = Result::Error(Result::Code::kEncodeError, "Nothing to write");
+    return error_;
+  }
+
+  if (stats)
+    stats->coded_size = impl_->coded_size();
+  return Result::Ok();
+}
+
+}  // namespace image
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_CODECS_GIF_ENCODER_H_
+#define SQUIM_IMAGE_CODECS_GIF_ENCODER_H_
+
+#include <memory>
+
+#include "squim/base/make_noncopyable.h"
+#include "squim/image/image_encoder.h"
+
+namespace io {
+class VectorWriter;
+}
+
+namespace image {
+
+// GIF encoder built for re-encoding animated GIFs. Incoming frames are
+// composited onto a canvas and every output frame covers only the area that
+// changed since the previous one, with unchanged pixels inside it made
+// transparent. Frames identical to the previous one are dropped and their
+// duration is added to it. Color table of every frame holds only the colors
+// it actually uses. A frame is written out as soon as the next one is known to
+// differ from it, so at most one output frame is held in memory.
+//
+// Every output frame has a single color table, so the changed pixels it draws
+// must have at most 256 colors (255 if some pixels are left transparent).
+// Input frames fit that, but disposal may not: a frame drawn over the canvas
+// restored by kRestorePrevious can change pixels of both its own colors and
+// the restored ones. If there are still too many colors with all pixels of the
+// frame drawn, encoding fails with kDunnoHowToEncode.
+class GifEncoder : public ImageEncoder {
+  MAKE_NONCOPYABLE(GifEncoder);
+
+ public:
+  struct Params {
+    // Crop every frame to the bounding box of changed pixels and make
+    // unchanged pixels transparent.
+    bool crop_frames = true;
+    // Merge frames identical to the previous one into it.
+    bool merge_duplicate_frames = true;
+
+    static Params Default();
+  };
+
+  GifEncoder(Params params, std::unique_ptr<io::VectorWriter> dst);
+  ~GifEncoder() override;
+
+  // ImageEncoder implementation:
+  Result Initialize(const ImageInfo* image_info) override;
+  Result EncodeFrame(ImageFrame* frame, bool last_frame) override;
+  void SetMetadata(const ImageMetadata* metadata) override;
+  Result FinishWrite(ImageOptimizationStats* stats) override;
+
+ private:
+  class Impl;
+
+  std::unique_ptr<Impl> impl_;
+  Params params_;
+  std::unique_ptr<io::VectorWriter> dst_;
+  const ImageInfo* image_info_ = nullptr;
+  Result error_ = Result::Ok();
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_CODECS_GIF_ENCODER_H_
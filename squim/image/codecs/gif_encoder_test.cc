@@ -0,0 +1,280 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/gif_encoder.h"
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/gif_decoder.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_info.h"
+#include "squim/image/test/image_test_util.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+const char kGifTestDir[] = "gif";
+
+const char* kGifFiles[] = {
+    "animated", "animated_interlaced", "completely_transparent",
+    "frame_smaller_than_screen", "full2loop", "interlaced", "square2loop",
+    "transparent",
+};
+
+using RGBA = std::array<uint8_t, 4>;
+
+// Composited animation frame and the time it is shown for.
+struct Screen {
+  std::vector<RGBA> pixels;
+  uint32_t duration;
+};
+
+std::unique_ptr<GifDecoder> Decode(const std::vector<uint8_t>& data,
+                                   bool palette) {
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+  source->source()->SendEof();
+  auto params = GifDecoder::Params::Default();
+  if (palette)
+    params.allowed_color_schemes.insert(ColorScheme::kPalette);
+  auto decoder = base::make_unique<GifDecoder>(params, std::move(source));
+  EXPECT_TRUE(decoder->Decode().ok());
+  EXPECT_TRUE(decoder->IsImageComplete());
+  return decoder;
+}
+
+Result Encode(GifDecoder* decoder,
+              GifEncoder::Params params,
+              std::vector<uint8_t>* out) {
+  GifEncoder encoder(params, base::make_unique<VectorTestWriter>(out));
+  std::vector<ImageFrame*> frames;
+  for (size_t i = 0; i < decoder->GetFrameCount(); ++i)
+    frames.push_back(decoder->GetFrameAtIndex(i));
+  return EncodeFrames(&encoder, &decoder->GetImageInfo(), nullptr, frames,
+                      *out);
+}
+
+// Renders all frames of |decoder| the way a browser does. Consecutive
+// identical screens are merged.
+std::vector<Screen> Render(GifDecoder* decoder) {
+  const auto& info = decoder->GetImageInfo();
+  std::vector<RGBA> canvas(info.width * info.height, RGBA{{0, 0, 0, 0}});
+  std::vector<RGBA> saved;
+  std::vector<Screen> screens;
+  for (size_t i = 0; i < decoder->GetFrameCount(); ++i) {
+    auto* frame = decoder->GetFrameAtIndex(i);
+    EXPECT_TRUE(frame->is_rgb());
+    if (frame->disposal_method() ==
+        ImageFrame::DisposalMethod::kRestorePrevious)
+      saved = canvas;
+    for (uint32_t y = 0; y < frame->height(); ++y) {
+      for (uint32_t x = 0; x < frame->width(); ++x) {
+        uint32_t cx = x + frame->x_offset();
+        uint32_t cy = y + frame->y_offset();
+        if (cx >= info.width || cy >= info.height)
+          continue;
+        const uint8_t* pixel = frame->GetPixel(x, y);
+        if (frame->has_alpha() && pixel[3] == 0)
+          continue;
+        canvas[cy * info.width + cx] =
+            RGBA{{pixel[0], pixel[1], pixel[2], 0xFF}};
+      }
+    }
+
+    if (!screens.empty() && screens.back().pixels == canvas) {
+      screens.back().duration += frame->duration();
+    } else {
+      screens.push_back(Screen{canvas, frame->duration()});
+    }
+
+    if (frame->disposal_method() == ImageFrame::DisposalMethod::kBackground) {
+      for (uint32_t y = 0; y < frame->height(); ++y) {
+        for (uint32_t x = 0; x < frame->width(); ++x) {
+          uint32_t cx = x + frame->x_offset();
+          uint32_t cy = y + frame->y_offset();
+          if (cx < info.width && cy < info.height)
+            canvas[cy * info.width + cx] = RGBA{{0, 0, 0, 0}};
+        }
+      }
+    } else if (frame->disposal_method() ==
+               ImageFrame::DisposalMethod::kRestorePrevious) {
+      canvas = saved;
+    }
+  }
+  return screens;
+}
+
+void CheckSameAnimation(GifDecoder* expected, GifDecoder* actual) {
+  EXPECT_EQ(expected->GetImageInfo().width, actual->GetImageInfo().width);
+  EXPECT_EQ(expected->GetImageInfo().height, actual->GetImageInfo().height);
+  auto expected_screens = Render(expected);
+  auto actual_screens = Render(actual);
+  ASSERT_EQ(expected_screens.size(), actual_screens.size());
+  for (size_t i = 0; i < expected_screens.size(); ++i) {
+    EXPECT_TRUE(expected_screens[i].pixels == actual_screens[i].pixels) << i;
+    EXPECT_EQ(expected_screens[i].duration, actual_screens[i].duration) << i;
+  }
+}
+
+// Palette frame filled with |color| index, with given geometry.
+std::unique_ptr<ImageFrame> MakeFrame(uint32_t x,
+                                      uint32_t y,
+                                      uint32_t width,
+                                      uint32_t height,
+                                      uint8_t color,
+                                      uint32_t duration) {
+  auto frame = base::make_unique<ImageFrame>();
+  frame->set_offset(x, y);
+  frame->set_size(width, height);
+  frame->set_color_scheme(ColorScheme::kPalette);
+  frame->set_duration(duration);
+  frame->set_palette({{{0xFF, 0, 0, 0xFF}},
+                      {{0, 0xFF, 0, 0xFF}},
+                      {{0, 0, 0xFF, 0xFF}},
+                      {{0xFF, 0xFF, 0xFF, 0}}});
+  frame->Init();
+  memset(frame->GetData(0), color, width * height);
+  return frame;
+}
+
+}  // namespace
+
+class GifEncoderTest : public testing::Test {
+ protected:
+  GifEncoderTest() {
+    image_info_.type = ImageType::kGif;
+    image_info_.width = 10;
+    image_info_.height = 10;
+    image_info_.multiframe = true;
+  }
+
+  Result EncodeFrames(std::vector<std::unique_ptr<ImageFrame>> frames,
+                      std::vector<uint8_t>* out) {
+    GifEncoder encoder(GifEncoder::Params::Default(),
+                       base::make_unique<VectorTestWriter>(out));
+    std::vector<ImageFrame*> raw_frames;
+    for (auto& frame : frames)
+      raw_frames.push_back(frame.get());
+    return image::EncodeFrames(&encoder, &image_info_, nullptr, raw_frames,
+                               *out);
+  }
+
+  ImageInfo image_info_;
+};
+
+TEST_F(GifEncoderTest, RecompressTestFiles) {
+  for (auto* name : kGifFiles) {
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadTestFile(kGifTestDir, name, "gif", &data)) << name;
+    auto original = Decode(data, true);
+    for (bool crop : {true, false}) {
+      std::vector<uint8_t> out;
+      auto params = GifEncoder::Params::Default();
+      params.crop_frames = crop;
+      ASSERT_TRUE(Encode(original.get(), params, &out).ok()) << name;
+
+      auto reference = Decode(data, false);
+      auto recompressed = Decode(out, false);
+      EXPECT_EQ(reference->GetImageInfo().loop_count,
+                recompressed->GetImageInfo().loop_count)
+          << name;
+      SCOPED_TRACE(name);
+      CheckSameAnimation(reference.get(), recompressed.get());
+    }
+  }
+}
+
+TEST_F(GifEncoderTest, ShrinksAnimations) {
+  for (auto* name : {"animated", "animated_interlaced", "transparent"}) {
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadTestFile(kGifTestDir, name, "gif", &data)) << name;
+    auto original = Decode(data, true);
+    std::vector<uint8_t> out;
+    ASSERT_TRUE(
+        Encode(original.get(), GifEncoder::Params::Default(), &out).ok());
+    EXPECT_LT(out.size(), data.size()) << name;
+  }
+}
+
+TEST_F(GifEncoderTest, CropsAndMergesFrames) {
+  std::vector<std::unique_ptr<ImageFrame>> frames;
+  frames.push_back(MakeFrame(0, 0, 10, 10, 0, 100));
+  // Same picture drawn with a smaller frame.
+  frames.push_back(MakeFrame(2, 2, 3, 3, 0, 50));
+  frames.push_back(MakeFrame(4, 5, 2, 1, 1, 100));
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(EncodeFrames(std::move(frames), &out).ok());
+
+  auto decoder = Decode(out, true);
+  ASSERT_EQ(2u, decoder->GetFrameCount());
+  auto* first = decoder->GetFrameAtIndex(0);
+  EXPECT_EQ(150u, first->duration());
+  EXPECT_EQ(10u, first->width());
+  EXPECT_EQ(10u, first->height());
+  // Single color, color table is trimmed to the minimum.
+  EXPECT_EQ(2u, first->palette().size());
+  EXPECT_FALSE(first->has_alpha());
+
+  auto* second = decoder->GetFrameAtIndex(1);
+  EXPECT_EQ(100u, second->duration());
+  EXPECT_EQ(4u, second->x_offset());
+  EXPECT_EQ(5u, second->y_offset());
+  EXPECT_EQ(2u, second->width());
+  EXPECT_EQ(1u, second->height());
+  EXPECT_EQ(ImageFrame::DisposalMethod::kNone, second->disposal_method());
+}
+
+TEST_F(GifEncoderTest, ClearsPixelsTurningTransparent) {
+  std::vector<std::unique_ptr<ImageFrame>> frames;
+  frames.push_back(MakeFrame(0, 0, 10, 10, 2, 100));
+  frames.back()->set_disposal_method(ImageFrame::DisposalMethod::kBackground);
+  frames.push_back(MakeFrame(1, 1, 1, 1, 1, 100));
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(EncodeFrames(std::move(frames), &out).ok());
+
+  auto decoder = Decode(out, false);
+  ASSERT_EQ(2u, decoder->GetFrameCount());
+  EXPECT_EQ(ImageFrame::DisposalMethod::kBackground,
+            decoder->GetFrameAtIndex(0)->disposal_method());
+  auto screens = Render(decoder.get());
+  ASSERT_EQ(2u, screens.size());
+  for (uint32_t i = 0; i < 100; ++i) {
+    RGBA expected{{0, 0, 0, 0}};
+    if (i == 11)
+      expected = RGBA{{0, 0xFF, 0, 0xFF}};
+    EXPECT_TRUE(expected == screens[1].pixels[i]) << i;
+  }
+}
+
+TEST_F(GifEncoderTest, FailsWithoutFrames) {
+  std::vector<uint8_t> out;
+  GifEncoder encoder(GifEncoder::Params::Default(),
+                     base::make_unique<VectorTestWriter>(&out));
+  ASSERT_TRUE(encoder.Initialize(&image_info_).ok());
+  EXPECT_TRUE(encoder.EncodeFrame(nullptr, true).error());
+  EXPECT_TRUE(encoder.FinishWrite(nullptr).error());
+  EXPECT_TRUE(out.empty());
+}
+
+}  // namespace image
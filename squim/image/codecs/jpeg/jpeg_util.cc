@@ -0,0 +1,212 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/jpeg/jpeg_util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "squim/base/logging.h"
+#include "squim/base/strings/string_piece.h"
+
+namespace image {
+
+namespace {
+
+const char kICCPSignature[] = "ICC_PROFILE";
+const size_t kICCPSignatureLength = sizeof(kICCPSignature);
+
+struct Metadata {
+  int marker;
+  const char* signature;
+  size_t signature_length;
+  ImageMetadata::Type type;
+};
+
+const Metadata kJPEGMetadataMap[] = {
+    // Exif 2.2 Section 4.7.2 Interoperability Structure of APP1 ...
+    {JPEG_APP0 + 1, "Exif\0", 6, ImageMetadata::Type::kEXIF},
+    // XMP Specification Part 3 Section 3 Embedding XMP Metadata ... #JPEG
+    // TODO(jzern) Add support for 'ExtendedXMP'
+    {JPEG_APP0 + 1, "http://ns.adobe.com/xap/1.0/", 29,
+     ImageMetadata::Type::kXMP},
+    // ICC profile segments are reassembled by ExtractICCP.
+    {JPEG_APP0 + 2, kICCPSignature, kICCPSignatureLength,
+     ImageMetadata::Type::kICC},
+};
+
+const Metadata* FindMetadata(jpeg_saved_marker_ptr marker) {
+  auto it =
+      std::find_if(std::begin(kJPEGMetadataMap), std::end(kJPEGMetadataMap),
+                   [marker](const Metadata& e) {
+                     return marker->marker == e.marker &&
+                            marker->data_length > e.signature_length &&
+                            std::memcmp(marker->data, e.signature,
+                                        e.signature_length) == 0;
+                   });
+  return it != std::end(kJPEGMetadataMap) ? it : nullptr;
+}
+
+}  // namespace
+
+void EmitMessage(j_common_ptr cinfo, int msg_level) {
+  if (msg_level > 0 && !VLOG_IS_ON(msg_level))
+    return;
+
+  if (msg_level < 0) {
+    // It's a warning message.  Since corrupt files may generate many
+    // warnings,
+    // the policy implemented here is to show only the first warning,
+    // unless trace_level >= 3 (as in default libjpeg emitter).
+    auto* err = cinfo->err;
+    if (err->num_warnings == 0 || err->trace_level >= 3) {
+      char buffer[JMSG_LENGTH_MAX];
+      (*cinfo->err->format_message)(cinfo, buffer);
+
+      if (msg_level == 0) {
+        LOG(INFO) << buffer;
+      } else {
+        LOG(WARNING) << buffer;
+      }
+    }
+
+    err->num_warnings++;
+  } else {
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    VLOG(msg_level) << buffer;
+  }
+}
+
+void SaveMetadataMarkers(j_decompress_ptr dinfo) {
+  const unsigned int kMaxMarkerLength = 0xffff;
+  // Exif/XMP.
+  jpeg_save_markers(dinfo, JPEG_APP0 + 1, kMaxMarkerLength);
+  // ICC profile.
+  jpeg_save_markers(dinfo, JPEG_APP0 + 2, kMaxMarkerLength);
+}
+
+io::ChunkList ExtractICCP(j_decompress_ptr dinfo) {
+  static const size_t kICCPSkipLength = kICCPSignatureLength + 2;
+  struct ICCPSegment {
+    const uint8_t* data;
+    size_t data_length;
+  };
+  size_t expected_count = 0;
+  // Key is segment's sequence number [1, 255] for use in reassembly.
+  std::map<size_t, ICCPSegment> iccp_segments;
+  for (jpeg_saved_marker_ptr marker = dinfo->marker_list; marker != NULL;
+       marker = marker->next) {
+    if (marker->marker != JPEG_APP0 + 2 ||
+        marker->data_length <= kICCPSignatureLength ||
+        std::memcmp(marker->data, kICCPSignature, kICCPSignatureLength) != 0)
+      continue;
+
+    // ICC_PROFILE\0<seq><count>; 'seq' starts at 1.
+    const size_t seq = marker->data[kICCPSignatureLength];
+    const size_t count = marker->data[kICCPSignatureLength + 1];
+    const size_t segment_size = marker->data_length - kICCPSkipLength;
+
+    if (segment_size == 0 || count == 0 || seq == 0) {
+      LOG(ERROR) << "[ICCP] size (" << segment_size << ") / count (" << seq
+                 << ") / sequence number (" << count << ") cannot be 0!";
+      return io::ChunkList();
+    }
+
+    if (expected_count == 0) {
+      expected_count = count;
+    } else if (count != expected_count) {
+      LOG(ERROR) << "[ICCP] Inconsistent segment count (" << expected_count
+                 << " / " << count << ")!";
+      return io::ChunkList();
+    }
+
+    if (iccp_segments.find(seq) != iccp_segments.end()) {
+      LOG(ERROR) << "[ICCP] Duplicate segment number (" << seq << ")!";
+      return io::ChunkList();
+    }
+
+    ICCPSegment segment{marker->data + kICCPSkipLength, segment_size};
+    iccp_segments[seq] = segment;
+  }
+
+  if (iccp_segments.empty())
+    return io::ChunkList();
+
+  if (iccp_segments.size() != iccp_segments.rbegin()->first) {
+    LOG(ERROR) << "[ICCP] Discontinuous segments, expected: "
+               << iccp_segments.size()
+               << " actual: " << iccp_segments.rbegin()->first << "!";
+    return io::ChunkList();
+  }
+
+  if (iccp_segments.size() != expected_count) {
+    LOG(ERROR) << "[ICCP] Segment count: " << iccp_segments.size()
+               << " does not match expected: " << expected_count << "!";
+    return io::ChunkList();
+  }
+
+  io::ChunkList ret;
+  for (const auto& kv : iccp_segments) {
+    ret.push_back(io::Chunk::Copy(kv.second.data, kv.second.data_length));
+  }
+
+  return ret;
+}
+
+bool GetMarkerMetadataType(jpeg_saved_marker_ptr marker,
+                           ImageMetadata::Type* type) {
+  auto* metadata = FindMetadata(marker);
+  if (!metadata)
+    return false;
+
+  *type = metadata->type;
+  return true;
+}
+
+void ExtractMetadata(j_decompress_ptr dinfo, ImageMetadata* metadata) {
+  auto chunks = ExtractICCP(dinfo);
+  while (!chunks.empty()) {
+    auto chunk = std::move(chunks.front());
+    metadata->Append(ImageMetadata::Type::kICC, std::move(chunk));
+    chunks.pop_front();
+  }
+
+  for (jpeg_saved_marker_ptr marker = dinfo->marker_list; marker != nullptr;
+       marker = marker->next) {
+    auto* meta = FindMetadata(marker);
+    if (!meta || meta->type == ImageMetadata::Type::kICC)
+      continue;
+
+    if (metadata->Has(meta->type)) {
+      LOG(WARNING) << "Ignoring additional '"
+                   << base::StringPiece(meta->signature,
+                                        meta->signature_length)
+                   << "'";
+      continue;
+    }
+
+    auto chunk = io::Chunk::View(marker->data, marker->data_length)
+                     ->Slice(meta->signature_length)
+                     ->Clone();
+    metadata->Append(meta->type, std::move(chunk));
+  }
+
+  metadata->FreezeAll();
+}
+
+}  // namespace image
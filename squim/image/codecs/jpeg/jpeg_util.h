@@ -0,0 +1,54 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_CODECS_JPEG_JPEG_UTIL_H_
+#define SQUIM_IMAGE_CODECS_JPEG_JPEG_UTIL_H_
+
+extern "C" {
+#include <stdio.h>  // jpeglib.h needs stdio FILE.
+}
+
+#include "squim/image/image_metadata.h"
+#include "squim/io/chunk.h"
+
+extern "C" {
+#include "third_party/libjpeg_turbo/upstream/jpeglib.h"
+}
+
+namespace image {
+
+// libjpeg message emitter that logs via glog. As the default emitter, shows
+// only the first warning unless trace_level >= 3.
+void EmitMessage(j_common_ptr cinfo, int msg_level);
+
+// Asks libjpeg to keep APP1 (Exif/XMP) and APP2 (ICC profile) markers.
+void SaveMetadataMarkers(j_decompress_ptr dinfo);
+
+// Reassembles ICC profile from the saved APP2 markers.
+io::ChunkList ExtractICCP(j_decompress_ptr dinfo);
+
+// Returns true if the saved |marker| carries metadata, |type| is set to its
+// type. Every segment of a (possibly split) ICC profile is reported.
+bool GetMarkerMetadataType(jpeg_saved_marker_ptr marker,
+                           ImageMetadata::Type* type);
+
+// Copies all the metadata from the saved markers to |metadata| and freezes
+// it.
+void ExtractMetadata(j_decompress_ptr dinfo, ImageMetadata* metadata);
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_CODECS_JPEG_JPEG_UTIL_H_
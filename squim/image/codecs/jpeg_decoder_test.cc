@@ -16,12 +16,14 @@
 
 #include "squim/image/codecs/jpeg_decoder.h"
 
+#include <cstring>
 #include <memory>
 #include <vector>
 
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
 #include "squim/image/image_info.h"
+#include "squim/image/image_metadata.h"
 #include "squim/image/test/image_test_util.h"
 
 #include "gtest/gtest.h"
@@ -171,4 +173,36 @@ TEST_F(JpegDecoderTest, ReadExpandGrayScale) {
                              read_spec, ReadType::kReadHeaderOnly);
 }
 
+TEST_F(JpegDecoderTest, ReadMetadata) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt(kJpegTestDir, "app_segments.jpg", &data));
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(
+      base::make_unique<io::Chunk>(&data[0], data.size()));
+  source->source()->SendEof();
+  JpegDecoder testee(JpegDecoder::Params::Default(), std::move(source));
+  ASSERT_TRUE(testee.Decode().ok());
+  ASSERT_TRUE(testee.IsAllMetadataComplete());
+
+  auto* metadata = testee.GetMetadata();
+  // Exif follows "Exif\0\0" and starts with a big-endian TIFF header.
+  ASSERT_TRUE(metadata->Has(ImageMetadata::Type::kEXIF));
+  auto exif = io::Chunk::Merge(metadata->Get(ImageMetadata::Type::kEXIF));
+  ASSERT_EQ(5735u, exif->size());
+  EXPECT_EQ(0, std::memcmp(exif->data(), "MM\0*", 4));
+  // XMP packet follows the namespace URI.
+  ASSERT_TRUE(metadata->Has(ImageMetadata::Type::kXMP));
+  auto xmp = io::Chunk::Merge(metadata->Get(ImageMetadata::Type::kXMP));
+  ASSERT_EQ(6118u, xmp->size());
+  EXPECT_EQ('<', xmp->data()[0]);
+  // ICC profile follows "ICC_PROFILE\0<seq><count>" and starts with its own
+  // big-endian size, with the "acsp" signature at offset 36.
+  ASSERT_TRUE(metadata->Has(ImageMetadata::Type::kICC));
+  auto icc = io::Chunk::Merge(metadata->Get(ImageMetadata::Type::kICC));
+  ASSERT_EQ(552u, icc->size());
+  EXPECT_EQ(0, std::memcmp(icc->data(), "\0\0\x02\x28", 4));
+  EXPECT_EQ(0, std::memcmp(icc->data() + 36, "acsp", 4));
+}
+
 }  // namespace image
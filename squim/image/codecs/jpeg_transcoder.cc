@@ -0,0 +1,414 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/jpeg_transcoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <setjmp.h>
+#include <stdio.h>  // jpeglib.h needs stdio FILE.
+}
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/jpeg/jpeg_util.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/writer.h"
+
+extern "C" {
+#include "third_party/libjpeg_turbo/upstream/jpeglib.h"
+}
+
+namespace image {
+
+// static
+JpegTranscoder::Params JpegTranscoder::Params::Default() {
+  return Params();
+}
+
+class JpegTranscoder::Impl {
+  MAKE_NONCOPYABLE(Impl);
+
+ public:
+  Impl(JpegTranscoder* transcoder) : transcoder_(transcoder) {
+    memset(&decompress_, 0, sizeof(jpeg_decompress_struct));
+    memset(&compress_, 0, sizeof(jpeg_compress_struct));
+    memset(&error_handler_, 0, sizeof(ErrorHandler));
+    memset(&source_, 0, sizeof(Source));
+    memset(&destination_, 0, sizeof(Destination));
+
+    decompress_.err = jpeg_std_error(&error_handler_.pub);
+    error_handler_.pub.error_exit = ErrorExit;
+    error_handler_.pub.emit_message = EmitMessage;
+    error_handler_.transcoder = this;
+
+    jpeg_create_decompress(&decompress_);
+
+    DCHECK(!decompress_.src);
+    decompress_.src = reinterpret_cast<jpeg_source_mgr*>(&source_);
+    source_.pub.init_source = InitSource;
+    source_.pub.fill_input_buffer = FillInputBuffer;
+    source_.pub.skip_input_data = SkipInputData;
+    source_.pub.resync_to_restart = jpeg_resync_to_restart;  // Default.
+    source_.pub.term_source = TermSource;
+    source_.transcoder = this;
+
+    destination_.pub.init_destination = InitDestination;
+    destination_.pub.empty_output_buffer = EmptyOutputBuffer;
+    destination_.pub.term_destination = TermDestination;
+    destination_.transcoder = this;
+
+    SaveMetadataMarkers(&decompress_);
+  }
+
+  ~Impl() {
+    if (compress_created_) {
+      compress_.dest = nullptr;
+      jpeg_destroy_compress(&compress_);
+    }
+    decompress_.src = nullptr;
+    jpeg_destroy_decompress(&decompress_);
+  }
+
+  bool HeaderComplete() const { return state_ > State::kHeader; }
+
+  bool ReadComplete() const { return state_ >= State::kReadComplete; }
+
+  Result Read(bool header_only) {
+    if (setjmp(error_handler_.setjmp_buffer))
+      return error_;
+
+    while (true) {
+      switch (state_) {
+        case State::kHeader:
+          if (jpeg_read_header(&decompress_, true) == JPEG_SUSPENDED)
+            break;  // I/O suspension.
+
+          transcoder_->image_info_.width = decompress_.image_width;
+          transcoder_->image_info_.height = decompress_.image_height;
+          state_ = State::kCoefficients;
+          if (header_only)
+            return Result::Ok();
+          continue;
+        case State::kCoefficients:
+          if (header_only)
+            return Result::Ok();
+
+          coefficients_ = jpeg_read_coefficients(&decompress_);
+          if (!coefficients_)
+            break;  // I/O suspension.
+
+          transcoder_->image_info_.size = bytes_read_;
+          ExtractMetadata(&decompress_, &transcoder_->metadata_);
+          ReleaseData();
+          state_ = State::kReadComplete;
+          return Result::Ok();
+        case State::kReadComplete:
+        case State::kDone:
+          return Result::Ok();
+      }
+
+      auto result = ReadMoreData();
+      if (!result.ok())
+        return result;
+    }
+  }
+
+  Result Write(io::VectorWriter* dest, ImageOptimizationStats* stats) {
+    DCHECK_EQ(State::kReadComplete, state_);
+    error_code_ = Result::Code::kEncodeError;
+    if (setjmp(error_handler_.setjmp_buffer)) {
+      output_.clear();
+      return error_;
+    }
+
+    compress_.err = &error_handler_.pub;
+    jpeg_create_compress(&compress_);
+    compress_created_ = true;
+    compress_.dest = reinterpret_cast<jpeg_destination_mgr*>(&destination_);
+
+    // Keep quantization tables and sampling, the rest is up to us.
+    jpeg_copy_critical_parameters(&decompress_, &compress_);
+    compress_.optimize_coding = true;
+    if (transcoder_->params_.progressive || decompress_.progressive_mode)
+      jpeg_simple_progression(&compress_);
+
+    jpeg_write_coefficients(&compress_, coefficients_);
+    WriteMetadataMarkers();
+    jpeg_finish_compress(&compress_);
+    jpeg_finish_decompress(&decompress_);
+    state_ = State::kDone;
+
+    size_t coded_size = 0;
+    for (const auto& chunk : output_)
+      coded_size += chunk->size();
+    if (stats)
+      stats->coded_size = coded_size;
+
+    return Result::FromIoResult(dest->WriteV(std::move(output_)), false);
+  }
+
+ private:
+  enum class State {
+    kHeader,
+    kCoefficients,
+    kReadComplete,
+    kDone,
+  };
+
+  struct ErrorHandler {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmp_buffer;
+    Impl* transcoder;
+  };
+
+  struct Source {
+    struct jpeg_source_mgr pub;
+    Impl* transcoder;
+  };
+
+  struct Destination {
+    struct jpeg_destination_mgr pub;
+    Impl* transcoder;
+  };
+
+  static const size_t kOutputChunkSize = 16 * 1024;
+
+  static void InitSource(j_decompress_ptr dinfo) {}
+
+  static boolean FillInputBuffer(j_decompress_ptr dinfo) {
+    // Always suspend, more data is provided by ReadMoreData().
+    return false;
+  }
+
+  static void SkipInputData(j_decompress_ptr dinfo, long num_bytes) {
+    if (num_bytes <= 0)
+      return;
+
+    auto* src = reinterpret_cast<Source*>(dinfo->src);
+    auto to_skip = static_cast<size_t>(num_bytes);
+    if (to_skip <= src->pub.bytes_in_buffer) {
+      src->pub.bytes_in_buffer -= to_skip;
+      src->pub.next_input_byte += to_skip;
+    } else {
+      src->transcoder->pending_skip_ += to_skip - src->pub.bytes_in_buffer;
+      src->pub.next_input_byte += src->pub.bytes_in_buffer;
+      src->pub.bytes_in_buffer = 0;
+    }
+  }
+
+  static void TermSource(j_decompress_ptr dinfo) {}
+
+  static void InitDestination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<Destination*>(cinfo->dest);
+    dest->transcoder->NewOutputChunk();
+  }
+
+  static boolean EmptyOutputBuffer(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<Destination*>(cinfo->dest);
+    // The whole buffer must be flushed regardless of free_in_buffer.
+    dest->transcoder->output_.push_back(
+        std::move(dest->transcoder->output_chunk_));
+    dest->transcoder->NewOutputChunk();
+    return true;
+  }
+
+  static void TermDestination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<Destination*>(cinfo->dest);
+    auto* impl = dest->transcoder;
+    size_t size = kOutputChunkSize - dest->pub.free_in_buffer;
+    if (size > 0) {
+      impl->output_.push_back(
+          io::Chunk::Wrap(std::move(impl->output_chunk_), 0, size));
+    }
+    impl->output_chunk_.reset();
+  }
+
+  static void ErrorExit(j_common_ptr cinfo) {
+    auto* err = reinterpret_cast<ErrorHandler*>(cinfo->err);
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    LOG(ERROR) << buffer;
+    err->transcoder->error_ =
+        Result::Error(err->transcoder->error_code_, buffer);
+    longjmp(err->setjmp_buffer, 1);
+  }
+
+  // Appends all the available input to |data_| and points libjpeg source to
+  // the unconsumed part of it. Everything libjpeg has already consumed is
+  // dropped (coefficients are stored by libjpeg itself).
+  Result ReadMoreData() {
+    size_t position = source_.pub.next_input_byte
+                          ? source_.pub.next_input_byte - data_.data()
+                          : 0;
+    if (position > 0 && position >= data_.size() / 2) {
+      data_.erase(data_.begin(), data_.begin() + position);
+      position = 0;
+    }
+
+    const size_t old_size = data_.size();
+    while (true) {
+      uint8_t* out;
+      auto io_result = transcoder_->source()->ReadSome(&out);
+      if (io_result.pending())
+        break;
+
+      if (io_result.eof()) {
+        if (data_.size() == old_size)
+          return Result::Error(Result::Code::kUnexpectedEof);
+        break;
+      }
+
+      if (!io_result.ok())
+        return Result::FromIoResult(io_result, false);
+
+      data_.insert(data_.end(), out, out + io_result.n());
+      bytes_read_ += io_result.n();
+    }
+
+    // Keep libjpeg's view valid even if nothing has been read since |data_|
+    // could be compacted above.
+    auto skip = std::min(pending_skip_, data_.size() - position);
+    pending_skip_ -= skip;
+    position += skip;
+    source_.pub.next_input_byte = data_.data() + position;
+    source_.pub.bytes_in_buffer = data_.size() - position;
+
+    if (data_.size() == old_size)
+      return Result::Pending();
+
+    return Result::Ok();
+  }
+
+  void ReleaseData() {
+    source_.pub.next_input_byte = nullptr;
+    source_.pub.bytes_in_buffer = 0;
+    std::vector<JOCTET>().swap(data_);
+  }
+
+  void NewOutputChunk() {
+    output_chunk_ = io::Chunk::New(kOutputChunkSize);
+    destination_.pub.next_output_byte = output_chunk_->data();
+    destination_.pub.free_in_buffer = output_chunk_->size();
+  }
+
+  bool ShouldWriteMetadata(ImageMetadata::Type type) const {
+    const auto& params = transcoder_->params_;
+    switch (type) {
+      case ImageMetadata::Type::kICC:
+        return params.write_iccp;
+      case ImageMetadata::Type::kEXIF:
+        return params.write_exif;
+      case ImageMetadata::Type::kXMP:
+        return params.write_xmp;
+    }
+    return false;
+  }
+
+  void WriteMetadataMarkers() {
+    for (auto marker = decompress_.marker_list; marker;
+         marker = marker->next) {
+      ImageMetadata::Type type;
+      if (!GetMarkerMetadataType(marker, &type) || !ShouldWriteMetadata(type))
+        continue;
+
+      jpeg_write_marker(&compress_, marker->marker, marker->data,
+                        marker->data_length);
+    }
+  }
+
+  jpeg_decompress_struct decompress_;
+  jpeg_compress_struct compress_;
+  bool compress_created_ = false;
+  ErrorHandler error_handler_;
+  Source source_;
+  Destination destination_;
+  State state_ = State::kHeader;
+  JpegTranscoder* transcoder_;
+  // Input which has not been consumed by libjpeg yet.
+  std::vector<JOCTET> data_;
+  size_t pending_skip_ = 0;
+  uint64_t bytes_read_ = 0;
+  jvirt_barray_ptr* coefficients_ = nullptr;
+  io::ChunkPtr output_chunk_;
+  io::ChunkList output_;
+  Result::Code error_code_ = Result::Code::kDecodeError;
+  Result error_ = Result::Ok();
+};
+
+JpegTranscoder::JpegTranscoder(Params params,
+                               std::unique_ptr<io::BufReader> source)
+    : source_(std::move(source)), params_(params) {
+  impl_ = base::make_unique<Impl>(this);
+  image_info_.type = ImageType::kJpeg;
+}
+
+JpegTranscoder::~JpegTranscoder() {}
+
+Result JpegTranscoder::ReadImageInfo() {
+  if (error_.error())
+    return error_;
+
+  return ProcessResult(impl_->Read(true));
+}
+
+bool JpegTranscoder::IsImageInfoComplete() const {
+  return impl_->HeaderComplete();
+}
+
+const ImageInfo& JpegTranscoder::GetImageInfo() const {
+  return image_info_;
+}
+
+ImageMetadata* JpegTranscoder::GetMetadata() {
+  return &metadata_;
+}
+
+Result JpegTranscoder::Read() {
+  if (error_.error())
+    return error_;
+
+  return ProcessResult(impl_->Read(false));
+}
+
+bool JpegTranscoder::IsReadComplete() const {
+  return impl_->ReadComplete();
+}
+
+Result JpegTranscoder::Write(io::VectorWriter* dest,
+                             ImageOptimizationStats* stats) {
+  if (error_.error())
+    return error_;
+
+  if (!IsReadComplete()) {
+    return ProcessResult(
+        Result::Error(Result::Code::kEncodeError, "Image is not read yet"));
+  }
+
+  return ProcessResult(impl_->Write(dest, stats));
+}
+
+Result JpegTranscoder::ProcessResult(Result result) {
+  if (result.error())
+    error_ = result;
+  return result;
+}
+
+}  // namespace image
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_CODECS_JPEG_TRANSCODER_H_
+#define SQUIM_IMAGE_CODECS_JPEG_TRANSCODER_H_
+
+#include <memory>
+
+#include "squim/base/make_noncopyable.h"
+#include "squim/image/image_info.h"
+#include "squim/image/image_metadata.h"
+#include "squim/image/image_transcoder.h"
+
+namespace io {
+class BufReader;
+}
+
+namespace image {
+
+// Lossless JPEG to JPEG transcoder. Reads DCT coefficients without pixel
+// decode and writes them back with optimized Huffman tables (and optionally
+// as progressive JPEG), as jpegtran does.
+class JpegTranscoder : public ImageTranscoder {
+  MAKE_NONCOPYABLE(JpegTranscoder);
+
+ public:
+  struct Params {
+    // Use the default progressive scan script. Progressive JPEGs are usually
+    // smaller for images larger than ~10K. Input which is already progressive
+    // stays progressive regardless of this flag.
+    bool progressive = false;
+    bool write_iccp = true;
+    bool write_exif = false;
+    bool write_xmp = false;
+
+    static Params Default();
+  };
+
+  JpegTranscoder(Params params, std::unique_ptr<io::BufReader> source);
+  ~JpegTranscoder() override;
+
+  // ImageTranscoder implementation:
+  Result ReadImageInfo() override;
+  bool IsImageInfoComplete() const override;
+  const ImageInfo& GetImageInfo() const override;
+  ImageMetadata* GetMetadata() override;
+  Result Read() override;
+  bool IsReadComplete() const override;
+  Result Write(io::VectorWriter* dest, ImageOptimizationStats* stats) override;
+
+ private:
+  class Impl;
+
+  Result ProcessResult(Result result);
+
+  io::BufReader* source() { return source_.get(); }
+
+  ImageInfo image_info_;
+  ImageMetadata metadata_;
+  std::unique_ptr<io::BufReader> source_;
+  std::unique_ptr<Impl> impl_;
+  Result error_ = Result::Ok();
+  Params params_;
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_CODECS_JPEG_TRANSCODER_H_
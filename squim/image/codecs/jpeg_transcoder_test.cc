@@ -0,0 +1,199 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/jpeg_transcoder.h"
+
+#include <memory>
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/jpeg_decoder.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/image/test/image_test_util.h"
+#include "squim/io/writer.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+const char kJpegTestDir[] = "jpeg";
+
+const char* kValidJpegImages[] = {
+    "test411.jpg",  "test420.jpg",           "test422.jpg",
+    "test444.jpg",  "testgray.jpg",          "progressive.jpg",
+    "sjpeg3.jpg",   "already_optimized.jpg", "app_segments.jpg",
+};
+
+// Feeds |data| to the transcoder by |chunk_size| pieces (all at once if 0) and
+// writes the result to |out|.
+Result Transcode(const std::vector<uint8_t>& data,
+                 JpegTranscoder::Params params,
+                 size_t chunk_size,
+                 std::vector<uint8_t>* out,
+                 ImageOptimizationStats* stats) {
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  auto* buffered_source = source->source();
+  JpegTranscoder transcoder(params, std::move(source));
+  if (chunk_size == 0)
+    chunk_size = data.size();
+
+  size_t offset = 0;
+  Result result = Result::Pending();
+  while (result.pending()) {
+    if (offset < data.size()) {
+      size_t size = std::min(chunk_size, data.size() - offset);
+      buffered_source->AddChunk(io::Chunk::Copy(&data[offset], size));
+      offset += size;
+    }
+    if (offset == data.size())
+      buffered_source->SendEof();
+
+    result = transcoder.Read();
+  }
+
+  if (!result.ok())
+    return result;
+
+  EXPECT_TRUE(transcoder.IsReadComplete());
+  EXPECT_TRUE(transcoder.IsImageInfoComplete());
+  EXPECT_EQ(data.size(), transcoder.GetImageInfo().size);
+
+  VectorTestWriter writer(out);
+  return transcoder.Write(&writer, stats);
+}
+
+std::unique_ptr<JpegDecoder> Decode(const std::vector<uint8_t>& data) {
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+  source->source()->SendEof();
+  auto decoder = base::make_unique<JpegDecoder>(JpegDecoder::Params::Default(),
+                                                std::move(source));
+  EXPECT_TRUE(decoder->Decode().ok());
+  EXPECT_TRUE(decoder->IsImageComplete());
+  return decoder;
+}
+
+void CheckLossless(const std::string& filename,
+                   JpegTranscoder::Params params,
+                   size_t chunk_size) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt(kJpegTestDir, filename, &data));
+
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Transcode(data, params, chunk_size, &out, &stats);
+  ASSERT_TRUE(result.ok()) << filename << " " << result.code();
+  EXPECT_EQ(out.size(), stats.coded_size);
+
+  auto reference = Decode(data);
+  auto transcoded = Decode(out);
+  auto* frame = transcoded->GetFrameAtIndex(0);
+  CheckImageFrame(filename, reference->GetFrameAtIndex(0), frame);
+  // Progressive input stays progressive.
+  bool progressive =
+      params.progressive || reference->GetFrameAtIndex(0)->is_progressive();
+  EXPECT_EQ(progressive, frame->is_progressive()) << filename;
+}
+
+}  // namespace
+
+TEST(JpegTranscoderTest, TranscodeIsLossless) {
+  for (auto pic : kValidJpegImages)
+    CheckLossless(pic, JpegTranscoder::Params::Default(), 0);
+}
+
+TEST(JpegTranscoderTest, TranscodeIsLosslessSmallReads) {
+  for (auto pic : kValidJpegImages)
+    CheckLossless(pic, JpegTranscoder::Params::Default(), 100);
+}
+
+TEST(JpegTranscoderTest, TranscodeToProgressive) {
+  JpegTranscoder::Params params;
+  params.progressive = true;
+  for (auto pic : kValidJpegImages)
+    CheckLossless(pic, params, 1000);
+}
+
+TEST(JpegTranscoderTest, OptimizesHuffmanTables) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt(kJpegTestDir, "sjpeg3.jpg", &data));
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(Transcode(data, JpegTranscoder::Params::Default(), 0, &out,
+                        nullptr)
+                  .ok());
+  EXPECT_LT(out.size(), data.size());
+}
+
+TEST(JpegTranscoderTest, WritesOnlyRequestedMetadata) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt(kJpegTestDir, "app_segments.jpg", &data));
+
+  JpegTranscoder::Params params;
+  params.write_iccp = true;
+  params.write_exif = false;
+  params.write_xmp = true;
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(Transcode(data, params, 0, &out, nullptr).ok());
+
+  auto decoder = Decode(out);
+  auto* metadata = decoder->GetMetadata();
+  EXPECT_TRUE(metadata->Has(ImageMetadata::Type::kICC));
+  EXPECT_FALSE(metadata->Has(ImageMetadata::Type::kEXIF));
+  EXPECT_TRUE(metadata->Has(ImageMetadata::Type::kXMP));
+
+  auto original = Decode(data);
+  auto expected_iccp = io::Chunk::Merge(
+      original->GetMetadata()->Get(ImageMetadata::Type::kICC));
+  auto iccp = io::Chunk::Merge(metadata->Get(ImageMetadata::Type::kICC));
+  EXPECT_EQ(expected_iccp->ToString(), iccp->ToString());
+}
+
+TEST(JpegTranscoderTest, InvalidInput) {
+  const struct {
+    const char* filename;
+    Result::Code code;
+  } kInvalidFiles[] = {
+      {"notajpeg.png", Result::Code::kDecodeError},
+      {"notajpeg.gif", Result::Code::kDecodeError},
+      {"emptyfile.jpg", Result::Code::kUnexpectedEof},
+  };
+  for (const auto& test : kInvalidFiles) {
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadTestFileWithExt(kJpegTestDir, test.filename, &data));
+    std::vector<uint8_t> out;
+    auto result = Transcode(data, JpegTranscoder::Params::Default(), 0, &out,
+                            nullptr);
+    EXPECT_EQ(test.code, result.code()) << test.filename;
+    EXPECT_TRUE(out.empty());
+  }
+}
+
+TEST(JpegTranscoderTest, TruncatedInput) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt(kJpegTestDir, "test420.jpg", &data));
+  data.resize(data.size() / 2);
+  std::vector<uint8_t> out;
+  auto result =
+      Transcode(data, JpegTranscoder::Params::Default(), 100, &out, nullptr);
+  EXPECT_EQ(Result::Code::kUnexpectedEof, result.code());
+}
+
+}  // namespace image
@@ -158,6 +158,8 @@ class PngDecoder::Impl {
 
     uint8_t* out;
     do {
+      // libpng buffers whatever it needs from the data it has been given.
+      decoder_->source()->FreeBefore(decoder_->source()->offset());
       auto result = decoder_->source()->ReadSome(&out);
 
       if (result.pending())
@@ -196,6 +198,7 @@ class PngDecoder::Impl {
     // Protect against large PNGs. See http://bugzil.la/251381 for more details.
     const unsigned long kMaxPngSize = 1000000ul;
     if (width > kMaxPngSize || height > kMaxPngSize) {
+      error_ = Result::Error(Result::Code::kDecodeError, "Image is too large");
       longjmp(png_jmpbuf(png_), 1);
       return;
     }
@@ -262,15 +265,22 @@ class PngDecoder::Impl {
     }
 
     if (frame->color_scheme() == ColorScheme::kUnknown) {
-      decoder_->Fail(Result::Error(Result::Code::kDecodeError,
-                                   "Unsupported color scheme"));
+      error_ = Result::Error(Result::Code::kDecodeError,
+                             "Unsupported color scheme");
       longjmp(png_jmpbuf(png_), 1);
       return;
     }
 
     // 16-bit color depth not supported yet.
-    if (bit_depth == 16)
+    if (bit_depth == 16) {
+      if (!decoder_->params_.scale_16_bit) {
+        error_ = Result::Error(Result::Code::kUnsupportedFormat,
+                               "16-bit PNG cannot be decoded losslessly");
+        longjmp(png_jmpbuf(png_), 1);
+        return;
+      }
       png_set_scale_16(png_);
+    }
 
     png_charp name;
     int comp_type;
@@ -437,6 +447,9 @@ class PngDecoder::Impl {
     }
     decoder_->metadata_.FreezeAll();
 
+    // Whatever was read after IEND is counted too, that's fine for estimating
+    // recompression gain.
+    decoder_->image_info_.size = decoder_->source()->offset();
     decoder_->frame()->set_status(ImageFrame::Status::kComplete);
     state_ = State::kDone;
   }
@@ -507,6 +520,12 @@ ImageFrame* PngDecoder::GetFrameAtIndex(size_t index) {
   return &image_frame_;
 }
 
+void PngDecoder::ReleaseFrameAtIndex(size_t index) {
+  CHECK_EQ(0, index);
+  DCHECK(IsFrameCompleteAtIndex(index));
+  image_frame_.ReleasePixels();
+}
+
 size_t PngDecoder::GetFrameCount() const {
   return impl_->DecodingComplete() ? 1 : 0;
 }
@@ -37,6 +37,10 @@ class PngDecoder : public ImageDecoder {
 
  public:
   struct Params : public DecodeParams {
+    // 16-bit samples are scaled down to 8 bits, which is lossy. If disabled,
+    // 16-bit images are rejected with kUnsupportedFormat.
+    bool scale_16_bit = true;
+
     static Params Default();
   };
 
@@ -49,6 +53,7 @@ class PngDecoder : public ImageDecoder {
   bool IsFrameHeaderCompleteAtIndex(size_t index) const override;
   bool IsFrameCompleteAtIndex(size_t index) const override;
   ImageFrame* GetFrameAtIndex(size_t index) override;
+  void ReleaseFrameAtIndex(size_t index) override;
   size_t GetFrameCount() const override;
   ImageMetadata* GetMetadata() override;
   bool IsAllMetadataComplete() const override;
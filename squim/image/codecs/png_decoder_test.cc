@@ -184,4 +184,17 @@ TEST_F(PngDecoderTest, ReadExpandGray) {
   }
 }
 
+TEST_F(PngDecoderTest, Reject16BitIfNotScaled) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kPngSuiteDir, "basn0g16", "png", &data));
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+  source->source()->SendEof();
+  auto params = PngDecoder::Params::Default();
+  params.scale_16_bit = false;
+  PngDecoder decoder(params, std::move(source));
+  EXPECT_EQ(Result::Code::kUnsupportedFormat, decoder.Decode().code());
+}
+
 }  // namespace image
@@ -0,0 +1,681 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/png_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <setjmp.h>
+}
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/base/threading/thread_pool.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_info.h"
+#include "squim/image/image_metadata.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/io/chunk.h"
+#include "squim/io/writer.h"
+
+extern "C" {
+#include "third_party/libpng/upstream/png.h"
+#include "third_party/zlib/upstream/zlib.h"
+}
+
+namespace image {
+
+namespace {
+
+const char kExifProfileName[] = "Raw profile type exif";
+const char kXmpKeyword[] = "XML:com.adobe.xmp";
+const char kIccProfileName[] = "ICC Profile";
+
+// Single compression attempt: candidate image index, filter mask for
+// png_set_filter and zlib strategy.
+struct Trial {
+  size_t image;
+  int filters;
+  int strategy;
+};
+
+std::vector<Trial> GetTrials(size_t image,
+                             int optimization_level,
+                             bool prefer_no_filter) {
+  if (optimization_level <= 1) {
+    // Same choice libpng makes by default.
+    return {{image, prefer_no_filter ? PNG_FILTER_NONE : PNG_ALL_FILTERS,
+             Z_DEFAULT_STRATEGY}};
+  }
+
+  static const int kStrategies[] = {
+      Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE, Z_HUFFMAN_ONLY,
+  };
+  std::vector<int> filters = {PNG_FILTER_NONE, PNG_ALL_FILTERS};
+  if (optimization_level >= 3) {
+    filters = {PNG_FILTER_NONE, PNG_FILTER_SUB,   PNG_FILTER_UP,
+               PNG_FILTER_AVG,  PNG_FILTER_PAETH, PNG_ALL_FILTERS};
+  }
+
+  std::vector<Trial> trials;
+  for (int filter : filters) {
+    for (int strategy : kStrategies)
+      trials.push_back({image, filter, strategy});
+  }
+  return trials;
+}
+
+// Packs pixel of any supported color scheme as 0xAABBGGRR.
+uint32_t PackColor(const uint8_t* pixel, size_t channels) {
+  switch (channels) {
+    case 1:
+      return 0xff000000u | pixel[0] << 16 | pixel[0] << 8 | pixel[0];
+    case 2:
+      return static_cast<uint32_t>(pixel[1]) << 24 | pixel[0] << 16 |
+             pixel[0] << 8 | pixel[0];
+    case 3:
+      return 0xff000000u | pixel[2] << 16 | pixel[1] << 8 | pixel[0];
+    default:
+      return static_cast<uint32_t>(pixel[3]) << 24 | pixel[2] << 16 |
+             pixel[1] << 8 | pixel[0];
+  }
+}
+
+uint8_t Alpha(uint32_t color) {
+  return color >> 24;
+}
+
+int PaletteBitDepth(size_t colors) {
+  if (colors <= 2)
+    return 1;
+  if (colors <= 4)
+    return 2;
+  if (colors <= 16)
+    return 4;
+  return 8;
+}
+
+// Writes samples of |bit_depth| < 8 bits into the row, most significant bits
+// first, as PNG requires.
+class BitPacker {
+ public:
+  BitPacker(uint8_t* row, int bit_depth) : row_(row), bit_depth_(bit_depth) {}
+
+  void Put(uint8_t sample) {
+    shift_ -= bit_depth_;
+    *row_ |= sample << shift_;
+    if (shift_ == 0) {
+      ++row_;
+      shift_ = 8;
+    }
+  }
+
+ private:
+  uint8_t* row_;
+  int bit_depth_;
+  int shift_ = 8;
+};
+
+// Formats |data| as ImageMagick 'raw profile', the way PngDecoder expects it:
+// '\n<name>\n<length>(%8lu)\n<hex payload>\n'.
+std::string MakeRawProfile(const char* name, const io::Chunk& data) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  const size_t kBytesPerLine = 36;
+
+  char length[32];
+  snprintf(length, sizeof(length), "%8lu",
+           static_cast<unsigned long>(data.size()));
+
+  std::string profile;
+  profile.reserve(data.size() * 2 + data.size() / kBytesPerLine + 64);
+  profile.append("\n").append(name).append("\n").append(length);
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (i % kBytesPerLine == 0)
+      profile.push_back('\n');
+    profile.push_back(kHexDigits[data.data()[i] >> 4]);
+    profile.push_back(kHexDigits[data.data()[i] & 0xf]);
+  }
+  profile.push_back('\n');
+  return profile;
+}
+
+// Metadata prepared for writing, shared by all the trials.
+struct PngMetadata {
+  io::ChunkPtr iccp;
+  std::string exif;
+  io::ChunkPtr xmp;
+};
+
+// Reduced and packed image, ready to be passed to libpng.
+struct PackedImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  int color_type = PNG_COLOR_TYPE_RGB;
+  int bit_depth = 8;
+  std::vector<png_color> palette;
+  std::vector<png_byte> trns;
+  size_t row_bytes = 0;
+  std::vector<uint8_t> data;
+};
+
+// State of a single trial, accessed from the libpng callbacks. Lives outside
+// of the setjmp frame, so nothing is lost after longjmp.
+struct TrialState {
+  png_structp png = nullptr;
+  png_infop info = nullptr;
+  std::vector<uint8_t> output;
+  // Smallest output produced so far by any of the trials.
+  const std::atomic<size_t>* best_size = nullptr;
+  bool aborted = false;
+  std::string error;
+};
+
+void OnPngError(png_structp png, png_const_charp msg) {
+  auto* state = static_cast<TrialState*>(png_get_error_ptr(png));
+  if (!state->aborted)
+    state->error = msg;
+  longjmp(png_jmpbuf(png), 1);
+}
+
+void OnPngWarning(png_structp png, png_const_charp msg) {
+  VLOG(1) << msg;
+}
+
+void OnPngWrite(png_structp png, png_bytep data, png_size_t length) {
+  auto* state = static_cast<TrialState*>(png_get_io_ptr(png));
+  state->output.insert(state->output.end(), data, data + length);
+  // There is no point to continue if some other trial has already produced
+  // smaller output.
+  if (state->output.size() > state->best_size->load()) {
+    state->aborted = true;
+    png_error(png, "Output is larger than the best one");
+  }
+}
+
+void OnPngFlush(png_structp png) {}
+
+// Writes the whole PNG into |state->output|. Returns false if it failed or was
+// aborted.
+bool WritePng(const PackedImage& image,
+              const PngMetadata& metadata,
+              const Trial& trial,
+              TrialState* state) {
+  // Everything with a destructor must be created before setjmp.
+  std::vector<png_bytep> rows(image.height);
+  for (uint32_t y = 0; y < image.height; ++y) {
+    rows[y] = const_cast<png_bytep>(&image.data[y * image.row_bytes]);
+  }
+
+  std::vector<png_text> text;
+  if (!metadata.exif.empty()) {
+    png_text exif = {};
+    exif.compression = PNG_TEXT_COMPRESSION_zTXt;
+    exif.key = const_cast<png_charp>(kExifProfileName);
+    exif.text = const_cast<png_charp>(metadata.exif.c_str());
+    exif.text_length = metadata.exif.size();
+    text.push_back(exif);
+  }
+  if (metadata.xmp) {
+    png_text xmp = {};
+    xmp.compression = PNG_ITXT_COMPRESSION_NONE;
+    xmp.key = const_cast<png_charp>(kXmpKeyword);
+    xmp.text = reinterpret_cast<png_charp>(metadata.xmp->data());
+    xmp.itxt_length = metadata.xmp->size();
+    text.push_back(xmp);
+  }
+
+  state->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, state,
+                                       OnPngError, OnPngWarning);
+  if (!state->png) {
+    state->error = "Failed to create PNG write struct";
+    return false;
+  }
+
+  state->info = png_create_info_struct(state->png);
+  if (!state->info) {
+    png_destroy_write_struct(&state->png, nullptr);
+    state->error = "Failed to create PNG info struct";
+    return false;
+  }
+
+  if (setjmp(png_jmpbuf(state->png))) {
+    png_destroy_write_struct(&state->png, &state->info);
+    return false;
+  }
+
+  png_set_write_fn(state->png, state, OnPngWrite, OnPngFlush);
+  png_set_compression_level(state->png, Z_BEST_COMPRESSION);
+  png_set_compression_mem_level(state->png, MAX_MEM_LEVEL);
+  png_set_compression_strategy(state->png, trial.strategy);
+  png_set_filter(state->png, PNG_FILTER_TYPE_BASE, trial.filters);
+
+  png_set_IHDR(state->png, state->info, image.width, image.height,
+               image.bit_depth, image.color_type, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+  if (!image.palette.empty()) {
+    png_set_PLTE(state->png, state->info, image.palette.data(),
+                 image.palette.size());
+  }
+  if (!image.trns.empty()) {
+    png_set_tRNS(state->png, state->info, image.trns.data(), image.trns.size(),
+                 nullptr);
+  }
+  if (metadata.iccp) {
+    png_set_iCCP(state->png, state->info, kIccProfileName,
+                 PNG_COMPRESSION_TYPE_BASE, metadata.iccp->data(),
+                 metadata.iccp->size());
+  }
+  if (!text.empty())
+    png_set_text(state->png, state->info, text.data(), text.size());
+
+  png_write_info(state->png, state->info);
+  png_write_image(state->png, rows.data());
+  png_write_end(state->png, nullptr);
+
+  png_destroy_write_struct(&state->png, &state->info);
+  return true;
+}
+
+}  // namespace
+
+class PngEncoder::Impl {
+ public:
+  explicit Impl(const Params* params) : params_(params) {}
+
+  // Reduces and packs the pixels of |frame| into one or more candidate images,
+  // so that |frame| does not have to outlive this call.
+  Result Prepare(ImageFrame* frame) {
+    auto scheme = frame->color_scheme();
+    if (scheme != ColorScheme::kGrayScale &&
+        scheme != ColorScheme::kGrayScaleAlpha &&
+        scheme != ColorScheme::kRGB && scheme != ColorScheme::kRGBA) {
+      return Result::Error(Result::Code::kDunnoHowToEncode,
+                           "Unsupported color scheme");
+    }
+
+    if (frame->width() == 0 || frame->height() == 0)
+      return Result::Error(Result::Code::kEncodeError, "Empty frame");
+
+    if (!params_->reduce) {
+      static const int kColorTypes[] = {
+          PNG_COLOR_TYPE_GRAY, PNG_COLOR_TYPE_GRAY_ALPHA, PNG_COLOR_TYPE_RGB,
+          PNG_COLOR_TYPE_RGB_ALPHA,
+      };
+      AddTruecolor(frame, kColorTypes[frame->bpp() - 1], 8);
+      return Result::Ok();
+    }
+
+    Analyze(frame);
+
+    // Palette is not always better than truecolor: smooth images compress
+    // better with filters, which do not make sense for palette indices. So
+    // both are tried if optimization level allows.
+    auto palette_bit_depth = PaletteBitDepth(colors_.size());
+    bool use_palette = fits_palette_ &&
+                       !(gray_ && opaque_ &&
+                         gray_bit_depth_ <= palette_bit_depth);
+    if (use_palette) {
+      AddPalette(frame, palette_bit_depth, PaletteOrder::kFirstSeen);
+      if (params_->optimization_level >= 3)
+        AddPalette(frame, palette_bit_depth, PaletteOrder::kLuminance);
+    }
+
+    if (!use_palette || params_->optimization_level >= 2) {
+      if (gray_ && opaque_) {
+        AddTruecolor(frame, PNG_COLOR_TYPE_GRAY, gray_bit_depth_);
+      } else if (gray_) {
+        AddTruecolor(frame, PNG_COLOR_TYPE_GRAY_ALPHA, 8);
+      } else if (opaque_) {
+        AddTruecolor(frame, PNG_COLOR_TYPE_RGB, 8);
+      } else {
+        AddTruecolor(frame, PNG_COLOR_TYPE_RGB_ALPHA, 8);
+      }
+    }
+
+    return Result::Ok();
+  }
+
+  // Runs all the trials and returns the smallest output in |out|.
+  Result Encode(const ImageMetadata* metadata, io::ChunkPtr* out) {
+    PngMetadata png_metadata;
+    if (metadata)
+      PrepareMetadata(*metadata, &png_metadata);
+
+    std::vector<Trial> trials;
+    for (size_t i = 0; i < images_.size(); ++i) {
+      const auto& image = images_[i];
+      auto image_trials =
+          GetTrials(i, params_->optimization_level,
+                    image.color_type == PNG_COLOR_TYPE_PALETTE ||
+                        image.bit_depth < 8);
+      trials.insert(trials.end(), image_trials.begin(), image_trials.end());
+    }
+
+    std::vector<TrialState> states(trials.size());
+    std::atomic<size_t> best_size(std::numeric_limits<size_t>::max());
+
+    // Trials share the process-wide pool with the other requests, so the
+    // number of threads doesn't grow with the number of images encoded at
+    // once.
+    auto run_trial = [&](size_t index) {
+      auto* state = &states[index];
+      state->best_size = &best_size;
+      const auto& trial = trials[index];
+      if (!WritePng(images_[trial.image], png_metadata, trial, state)) {
+        std::vector<uint8_t>().swap(state->output);
+        return;
+      }
+
+      auto size = state->output.size();
+      auto best = best_size.load();
+      while (size < best && !best_size.compare_exchange_weak(best, size)) {
+      }
+    };
+    base::ThreadPool::Default()->ParallelFor(trials.size(),
+                                             params_->max_threads, run_trial);
+
+    // The earliest of the smallest outputs wins, so the result does not depend
+    // on the thread scheduling.
+    TrialState* best = nullptr;
+    for (size_t i = 0; i < states.size(); ++i) {
+      auto* state = &states[i];
+      if (state->output.empty())
+        continue;
+      if (!best || state->output.size() < best->output.size())
+        best = state;
+      VLOG(2) << "Trial " << i << " (image " << trials[i].image << ", filters "
+              << trials[i].filters << ", strategy " << trials[i].strategy
+              << "): " << state->output.size() << " bytes";
+    }
+
+    if (!best) {
+      auto failed = std::find_if(
+          states.begin(), states.end(),
+          [](const TrialState& state) { return !state.error.empty(); });
+      return Result::Error(Result::Code::kEncodeError,
+                           failed != states.end() ? failed->error : "");
+    }
+
+    *out = io::Chunk::Copy(best->output.data(), best->output.size());
+    return Result::Ok();
+  }
+
+ private:
+  enum class PaletteOrder {
+    // As colors appear in the image.
+    kFirstSeen,
+    // Similar colors get close indices, which helps filters a bit.
+    kLuminance,
+  };
+
+  PackedImage* AddImage(ImageFrame* frame, int color_type, int bit_depth) {
+    images_.emplace_back();
+    auto* image = &images_.back();
+    image->width = frame->width();
+    image->height = frame->height();
+    image->color_type = color_type;
+    image->bit_depth = bit_depth;
+    size_t channels = 1;
+    if (color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+      channels = 2;
+    else if (color_type == PNG_COLOR_TYPE_RGB)
+      channels = 3;
+    else if (color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+      channels = 4;
+    image->row_bytes = (image->width * channels * bit_depth + 7) / 8;
+    image->data.assign(image->row_bytes * image->height, 0);
+
+    VLOG(1) << "Candidate with " << frame->bpp()
+            << " channels reduced to color type " << color_type
+            << " with bit depth " << bit_depth;
+    return image;
+  }
+
+  // Finds out if the image is opaque, gray, how many colors it has and how
+  // many bits its gray samples really need.
+  void Analyze(ImageFrame* frame) {
+    const auto channels = frame->bpp();
+    // Gray samples fit N bits if all of them are multiples of 255/(2^N - 1).
+    bool fits_1_bit = true;
+    bool fits_2_bits = true;
+    bool fits_4_bits = true;
+    // Neighbouring pixels are often the same, do not look them up twice.
+    bool have_last_color = false;
+    uint32_t last_color = 0;
+
+    for (uint32_t y = 0; y < frame->height(); ++y) {
+      const uint8_t* pixel = frame->GetPixel(0, y);
+      for (uint32_t x = 0; x < frame->width(); ++x, pixel += channels) {
+        auto color = PackColor(pixel, channels);
+        if (have_last_color && color == last_color)
+          continue;
+        have_last_color = true;
+        last_color = color;
+
+        opaque_ &= Alpha(color) == 0xff;
+        if (channels > 2)
+          gray_ &= pixel[0] == pixel[1] && pixel[1] == pixel[2];
+        fits_1_bit &= pixel[0] % 255 == 0;
+        fits_2_bits &= pixel[0] % 85 == 0;
+        fits_4_bits &= pixel[0] % 17 == 0;
+
+        if (fits_palette_ && colors_.emplace(color, colors_.size()).second &&
+            colors_.size() > 256) {
+          fits_palette_ = false;
+          colors_.clear();
+        }
+      }
+    }
+
+    if (fits_1_bit)
+      gray_bit_depth_ = 1;
+    else if (fits_2_bits)
+      gray_bit_depth_ = 2;
+    else if (fits_4_bits)
+      gray_bit_depth_ = 4;
+    else
+      gray_bit_depth_ = 8;
+  }
+
+  // Translucent colors always go first, so that tRNS chunk is as short as
+  // possible.
+  void AddPalette(ImageFrame* frame, int bit_depth, PaletteOrder order) {
+    std::vector<uint32_t> palette(colors_.size());
+    for (const auto& entry : colors_)
+      palette[entry.second] = entry.first;
+
+    if (order == PaletteOrder::kLuminance) {
+      auto luminance = [](uint32_t color) {
+        return 299 * (color & 0xff) + 587 * (color >> 8 & 0xff) +
+               114 * (color >> 16 & 0xff);
+      };
+      std::stable_sort(palette.begin(), palette.end(),
+                       [&luminance](uint32_t a, uint32_t b) {
+                         return luminance(a) < luminance(b);
+                       });
+    }
+    std::stable_partition(palette.begin(), palette.end(),
+                          [](uint32_t color) { return Alpha(color) != 0xff; });
+
+    auto* image = AddImage(frame, PNG_COLOR_TYPE_PALETTE, bit_depth);
+    std::unordered_map<uint32_t, uint8_t> indices;
+    for (size_t i = 0; i < palette.size(); ++i) {
+      auto color = palette[i];
+      indices[color] = i;
+      image->palette.push_back({static_cast<png_byte>(color),
+                                static_cast<png_byte>(color >> 8),
+                                static_cast<png_byte>(color >> 16)});
+      if (Alpha(color) != 0xff)
+        image->trns.push_back(Alpha(color));
+    }
+
+    const auto channels = frame->bpp();
+    uint32_t last_color = 0;
+    uint8_t last_index = 0;
+    bool have_last_color = false;
+    for (uint32_t y = 0; y < image->height; ++y) {
+      const uint8_t* pixel = frame->GetPixel(0, y);
+      uint8_t* row = &image->data[y * image->row_bytes];
+      BitPacker packer(row, bit_depth);
+      for (uint32_t x = 0; x < image->width; ++x, pixel += channels) {
+        auto color = PackColor(pixel, channels);
+        if (!have_last_color || color != last_color) {
+          have_last_color = true;
+          last_color = color;
+          last_index = indices[color];
+        }
+        if (bit_depth == 8)
+          *row++ = last_index;
+        else
+          packer.Put(last_index);
+      }
+    }
+  }
+
+  void AddTruecolor(ImageFrame* frame, int color_type, int bit_depth) {
+    auto* image = AddImage(frame, color_type, bit_depth);
+    const auto channels = frame->bpp();
+    const auto gray_scale = 255 / ((1 << bit_depth) - 1);
+
+    for (uint32_t y = 0; y < image->height; ++y) {
+      const uint8_t* pixel = frame->GetPixel(0, y);
+      uint8_t* row = &image->data[y * image->row_bytes];
+      BitPacker packer(row, bit_depth);
+      for (uint32_t x = 0; x < image->width; ++x, pixel += channels) {
+        switch (color_type) {
+          case PNG_COLOR_TYPE_GRAY:
+            if (bit_depth == 8)
+              *row++ = pixel[0];
+            else
+              packer.Put(pixel[0] / gray_scale);
+            break;
+          case PNG_COLOR_TYPE_GRAY_ALPHA:
+            *row++ = pixel[0];
+            *row++ = pixel[channels - 1];
+            break;
+          case PNG_COLOR_TYPE_RGB:
+            *row++ = pixel[0];
+            *row++ = pixel[1];
+            *row++ = pixel[2];
+            break;
+          case PNG_COLOR_TYPE_RGB_ALPHA:
+            *row++ = pixel[0];
+            *row++ = pixel[1];
+            *row++ = pixel[2];
+            *row++ = pixel[3];
+            break;
+        }
+      }
+    }
+  }
+
+  void PrepareMetadata(const ImageMetadata& metadata, PngMetadata* out) {
+    if (params_->write_iccp && metadata.Has(ImageMetadata::Type::kICC))
+      out->iccp = io::Chunk::Merge(metadata.Get(ImageMetadata::Type::kICC));
+
+    if (params_->write_exif && metadata.Has(ImageMetadata::Type::kEXIF)) {
+      auto exif = io::Chunk::Merge(metadata.Get(ImageMetadata::Type::kEXIF));
+      out->exif = MakeRawProfile("exif", *exif);
+    }
+
+    if (params_->write_xmp && metadata.Has(ImageMetadata::Type::kXMP))
+      out->xmp = io::Chunk::Merge(metadata.Get(ImageMetadata::Type::kXMP));
+  }
+
+  const Params* params_;
+  // Candidates in the order of preference.
+  std::vector<PackedImage> images_;
+
+  bool opaque_ = true;
+  bool gray_ = true;
+  int gray_bit_depth_ = 8;
+  bool fits_palette_ = true;
+  // Color to the order of its first appearance.
+  std::unordered_map<uint32_t, size_t> colors_;
+};
+
+// static
+PngEncoder::Params PngEncoder::Params::Default() {
+  return Params();
+}
+
+PngEncoder::PngEncoder(Params params, std::unique_ptr<io::VectorWriter> dst)
+    : params_(params), dst_(std::move(dst)) {}
+
+PngEncoder::~PngEncoder() {}
+
+Result PngEncoder::Initialize(const ImageInfo* image_info) {
+  image_info_ = image_info;
+  return Result::Ok();
+}
+
+Result PngEncoder::EncodeFrame(ImageFrame* frame, bool last_frame) {
+  if (!error_.ok())
+    return error_;
+
+  if (!frame)
+    return Result::Ok();
+
+  if (impl_ || !last_frame || (image_info_ && image_info_->multiframe)) {
+    error_ = Result::Error(Result::Code::kDunnoHowToEncode,
+                           "Animated PNG is not supported");
+    return error_;
+  }
+
+  impl_ = base::make_unique<Impl>(&params_);
+  auto result = impl_->Prepare(frame);
+  if (result.error())
+    error_ = result;
+
+  return result;
+}
+
+void PngEncoder::SetMetadata(const ImageMetadata* metadata) {
+  metadata_ = metadata;
+}
+
+Result PngEncoder::FinishWrite(ImageOptimizationStats* stats) {
+  if (!error_.ok())
+    return error_;
+
+  if (!impl_) {
+    error_ = Result::Error(Result::Code::kEncodeError, "Nothing to write");
+    return error_;
+  }
+
+  io::ChunkPtr output;
+  auto result = impl_->Encode(metadata_, &output);
+  if (result.error()) {
+    error_ = result;
+    return result;
+  }
+
+  if (stats)
+    stats->coded_size = output->size();
+
+  io::ChunkList chunks;
+  chunks.push_back(std::move(output));
+  return Result::FromIoResult(dst_->WriteV(std::move(chunks)), false);
+}
+
+}  // namespace image
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_CODECS_PNG_ENCODER_H_
+#define SQUIM_IMAGE_CODECS_PNG_ENCODER_H_
+
+#include <memory>
+
+#include "squim/base/make_noncopyable.h"
+#include "squim/image/image_encoder.h"
+
+namespace io {
+class VectorWriter;
+}
+
+namespace image {
+
+// Lossless PNG encoder. Reduces color type and bit depth of the frame when it
+// can be done without loss (RGBA to RGB, RGB to grayscale, up to 256 colors to
+// palette, narrow grayscale to 1-2-4 bits), then compresses it with several
+// filter and zlib strategy combinations in parallel and keeps the smallest
+// result, as optipng does.
+class PngEncoder : public ImageEncoder {
+  MAKE_NONCOPYABLE(PngEncoder);
+
+ public:
+  struct Params {
+    // 1 - single trial with libpng default filtering,
+    // 2 - no filtering and adaptive filtering, each with every zlib strategy,
+    // 3 - every single filter and adaptive filtering with every zlib strategy.
+    int optimization_level = 2;
+    // Number of threads trials are run on, taken from
+    // base::ThreadPool::Default(). 0 means all of them.
+    size_t max_threads = 0;
+    // Reduce color type and bit depth of the image.
+    bool reduce = true;
+    bool write_iccp = true;
+    bool write_exif = false;
+    bool write_xmp = false;
+
+    static Params Default();
+  };
+
+  PngEncoder(Params params, std::unique_ptr<io::VectorWriter> dst);
+  ~PngEncoder() override;
+
+  // ImageEncoder implementation:
+  Result Initialize(const ImageInfo* image_info) override;
+  Result EncodeFrame(ImageFrame* frame, bool last_frame) override;
+  void SetMetadata(const ImageMetadata* metadata) override;
+  Result FinishWrite(ImageOptimizationStats* stats) override;
+
+ private:
+  class Impl;
+
+  std::unique_ptr<Impl> impl_;
+  Params params_;
+  std::unique_ptr<io::VectorWriter> dst_;
+  const ImageMetadata* metadata_ = nullptr;
+  const ImageInfo* image_info_ = nullptr;
+  Result error_ = Result::Ok();
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_CODECS_PNG_ENCODER_H_
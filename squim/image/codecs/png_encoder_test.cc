@@ -0,0 +1,320 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/codecs/png_encoder.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/png_decoder.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_info.h"
+#include "squim/image/image_metadata.h"
+#include "squim/image/test/image_test_util.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+const char kPngSuiteDir[] = "pngsuite";
+const char kPngTestDir[] = "png";
+
+const char* kPngSuiteFiles[] = {
+    "basn0g01", "basn0g02", "basn0g04", "basn0g08", "basn2c08", "basn3p01",
+    "basn3p02", "basn3p04", "basn3p08", "basn4a08", "basn6a08", "basi0g04",
+    "basi3p02", "basi6a08", "bgai4a08", "ccwn3p08", "f04n2c08", "s07n3p02",
+    "tbbn3p08", "tbrn2c08", "tm3n3p02", "tp0n3p08", "tp1n3p08", "z09n2c08",
+};
+
+const char* kPngFiles[] = {
+    "gray_alpha", "pagespeed-128", "pagespeed-33x34", "rgb_alpha",
+    "this_is_a_test",
+};
+
+// IHDR fields offsets in PNG file.
+const size_t kBitDepthOffset = 24;
+const size_t kColorTypeOffset = 25;
+
+const uint8_t kColorTypeGray = 0;
+const uint8_t kColorTypeRGB = 2;
+const uint8_t kColorTypePalette = 3;
+const uint8_t kColorTypeRGBA = 6;
+
+std::unique_ptr<PngDecoder> Decode(const std::vector<uint8_t>& data) {
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+  source->source()->SendEof();
+  auto params = PngDecoder::Params::Default();
+  params.scale_16_bit = false;
+  auto decoder = base::make_unique<PngDecoder>(params, std::move(source));
+  EXPECT_TRUE(decoder->Decode().ok());
+  EXPECT_TRUE(decoder->IsImageComplete());
+  return decoder;
+}
+
+Result Encode(ImageFrame* frame,
+              const ImageMetadata* metadata,
+              PngEncoder::Params params,
+              std::vector<uint8_t>* out) {
+  ImageInfo image_info;
+  image_info.type = ImageType::kPng;
+  image_info.width = frame->width();
+  image_info.height = frame->height();
+
+  PngEncoder encoder(params, base::make_unique<VectorTestWriter>(out));
+  return EncodeFrames(&encoder, &image_info, metadata, {frame}, *out);
+}
+
+std::array<uint8_t, 4> GetRGBA(ImageFrame* frame, uint32_t x, uint32_t y) {
+  const uint8_t* pixel = frame->GetPixel(x, y);
+  switch (frame->bpp()) {
+    case 1:
+      return {{pixel[0], pixel[0], pixel[0], 0xff}};
+    case 2:
+      return {{pixel[0], pixel[0], pixel[0], pixel[1]}};
+    case 3:
+      return {{pixel[0], pixel[1], pixel[2], 0xff}};
+    default:
+      return {{pixel[0], pixel[1], pixel[2], pixel[3]}};
+  }
+}
+
+// Compares pixels regardless of the color schemes of the frames.
+void ExpectSamePixels(const std::string& filename,
+                      ImageFrame* expected,
+                      ImageFrame* actual) {
+  ASSERT_EQ(expected->width(), actual->width()) << filename;
+  ASSERT_EQ(expected->height(), actual->height()) << filename;
+  for (uint32_t y = 0; y < expected->height(); ++y) {
+    for (uint32_t x = 0; x < expected->width(); ++x) {
+      ASSERT_EQ(GetRGBA(expected, x, y), GetRGBA(actual, x, y))
+          << filename << " at " << x << "x" << y;
+    }
+  }
+}
+
+void CheckRoundTrip(const std::string& dir,
+                    const std::string& filename,
+                    PngEncoder::Params params) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(dir, filename, "png", &data));
+  auto original = Decode(data);
+  EXPECT_EQ(data.size(), original->GetImageInfo().size);
+
+  std::vector<uint8_t> out;
+  auto result = Encode(original->GetFrameAtIndex(0), nullptr, params, &out);
+  ASSERT_TRUE(result.ok()) << filename << " " << result.code();
+
+  auto recompressed = Decode(out);
+  ExpectSamePixels(filename, original->GetFrameAtIndex(0),
+                   recompressed->GetFrameAtIndex(0));
+}
+
+// Single trial on the most reduced candidate only.
+PngEncoder::Params ReduceOnlyParams() {
+  auto params = PngEncoder::Params::Default();
+  params.optimization_level = 1;
+  return params;
+}
+
+// Creates RGBA frame with pixels taken from |colors| one by one.
+void FillFrame(uint32_t width,
+               uint32_t height,
+               const std::vector<std::array<uint8_t, 4>>& colors,
+               ImageFrame* frame) {
+  frame->set_size(width, height);
+  frame->set_color_scheme(ColorScheme::kRGBA);
+  frame->Init();
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      const auto& color = colors[(y * width + x) % colors.size()];
+      std::copy(color.begin(), color.end(), frame->GetPixel(x, y));
+    }
+  }
+}
+
+}  // namespace
+
+TEST(PngEncoderTest, RoundTripPngSuite) {
+  for (auto filename : kPngSuiteFiles)
+    CheckRoundTrip(kPngSuiteDir, filename, PngEncoder::Params::Default());
+}
+
+TEST(PngEncoderTest, RoundTripPng) {
+  for (auto filename : kPngFiles)
+    CheckRoundTrip(kPngTestDir, filename, PngEncoder::Params::Default());
+}
+
+TEST(PngEncoderTest, RoundTripAllTrials) {
+  auto params = PngEncoder::Params::Default();
+  params.optimization_level = 3;
+  for (auto filename : kPngFiles)
+    CheckRoundTrip(kPngTestDir, filename, params);
+}
+
+TEST(PngEncoderTest, RoundTripWithoutReduction) {
+  auto params = PngEncoder::Params::Default();
+  params.reduce = false;
+  for (auto filename : kPngSuiteFiles)
+    CheckRoundTrip(kPngSuiteDir, filename, params);
+}
+
+TEST(PngEncoderTest, ReducesToGray) {
+  ImageFrame frame;
+  FillFrame(64, 64, {{{0, 0, 0, 255}}, {{255, 255, 255, 255}}}, &frame);
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(Encode(&frame, nullptr, ReduceOnlyParams(), &out).ok());
+  EXPECT_EQ(kColorTypeGray, out[kColorTypeOffset]);
+  EXPECT_EQ(1, out[kBitDepthOffset]);
+  ExpectSamePixels("gray", &frame, Decode(out)->GetFrameAtIndex(0));
+}
+
+TEST(PngEncoderTest, ReducesToPalette) {
+  ImageFrame frame;
+  FillFrame(33, 17, {{{255, 0, 0, 255}}, {{0, 255, 0, 128}}, {{0, 0, 255, 0}}},
+            &frame);
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(Encode(&frame, nullptr, ReduceOnlyParams(), &out).ok());
+  EXPECT_EQ(kColorTypePalette, out[kColorTypeOffset]);
+  EXPECT_EQ(2, out[kBitDepthOffset]);
+  ExpectSamePixels("palette", &frame, Decode(out)->GetFrameAtIndex(0));
+
+  // All rows are the same, so truecolor with filtering should win over
+  // palette when both are tried.
+  std::vector<uint8_t> truecolor_out;
+  ASSERT_TRUE(
+      Encode(&frame, nullptr, PngEncoder::Params::Default(), &truecolor_out)
+          .ok());
+  EXPECT_EQ(kColorTypeRGBA, truecolor_out[kColorTypeOffset]);
+  EXPECT_LT(truecolor_out.size(), out.size());
+  ExpectSamePixels("palette", &frame,
+                   Decode(truecolor_out)->GetFrameAtIndex(0));
+}
+
+TEST(PngEncoderTest, DropsOpaqueAlpha) {
+  std::vector<std::array<uint8_t, 4>> colors;
+  for (int i = 0; i < 1000; ++i) {
+    colors.push_back({{static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 2),
+                       static_cast<uint8_t>(i * 7), 255}});
+  }
+  ImageFrame frame;
+  FillFrame(40, 30, colors, &frame);
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(Encode(&frame, nullptr, ReduceOnlyParams(), &out).ok());
+  EXPECT_EQ(kColorTypeRGB, out[kColorTypeOffset]);
+  EXPECT_EQ(8, out[kBitDepthOffset]);
+  ExpectSamePixels("rgb", &frame, Decode(out)->GetFrameAtIndex(0));
+
+  auto params = ReduceOnlyParams();
+  params.reduce = false;
+  out.clear();
+  ASSERT_TRUE(Encode(&frame, nullptr, params, &out).ok());
+  EXPECT_EQ(kColorTypeRGBA, out[kColorTypeOffset]);
+}
+
+TEST(PngEncoderTest, MoreTrialsAreNotWorse) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kPngTestDir, "pagespeed-128", "png", &data));
+  auto decoder = Decode(data);
+
+  size_t previous_size = 0;
+  for (int level = 1; level <= 3; ++level) {
+    auto params = PngEncoder::Params::Default();
+    params.optimization_level = level;
+    std::vector<uint8_t> out;
+    ASSERT_TRUE(
+        Encode(decoder->GetFrameAtIndex(0), nullptr, params, &out).ok());
+    if (previous_size) {
+      EXPECT_LE(out.size(), previous_size) << level;
+    }
+    previous_size = out.size();
+  }
+}
+
+TEST(PngEncoderTest, OutputDoesNotDependOnThreads) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kPngTestDir, "rgb_alpha", "png", &data));
+  auto decoder = Decode(data);
+
+  auto params = PngEncoder::Params::Default();
+  params.optimization_level = 3;
+  params.max_threads = 1;
+  std::vector<uint8_t> single_threaded;
+  ASSERT_TRUE(Encode(decoder->GetFrameAtIndex(0), nullptr, params,
+                     &single_threaded).ok());
+
+  params.max_threads = 4;
+  std::vector<uint8_t> multi_threaded;
+  ASSERT_TRUE(Encode(decoder->GetFrameAtIndex(0), nullptr, params,
+                     &multi_threaded).ok());
+
+  EXPECT_EQ(single_threaded, multi_threaded);
+}
+
+TEST(PngEncoderTest, WritesMetadata) {
+  ImageFrame frame;
+  FillFrame(8, 8, {{{10, 20, 30, 255}}, {{40, 50, 60, 255}}}, &frame);
+
+  const std::string kExif = std::string("Exif\0\0MM", 8) + std::string(300, 7);
+  const std::string kXmp = "<x:xmpmeta xmlns:x='adobe:ns:meta/'/>";
+  ImageMetadata metadata;
+  metadata.Append(ImageMetadata::Type::kEXIF, io::Chunk::FromString(kExif));
+  metadata.Append(ImageMetadata::Type::kXMP, io::Chunk::FromString(kXmp));
+  metadata.FreezeAll();
+
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(Encode(&frame, &metadata, PngEncoder::Params::Default(), &out)
+                  .ok());
+  auto decoder = Decode(out);
+  EXPECT_FALSE(decoder->GetMetadata()->Has(ImageMetadata::Type::kEXIF));
+  EXPECT_FALSE(decoder->GetMetadata()->Has(ImageMetadata::Type::kXMP));
+
+  auto params = PngEncoder::Params::Default();
+  params.write_exif = true;
+  params.write_xmp = true;
+  out.clear();
+  ASSERT_TRUE(Encode(&frame, &metadata, params, &out).ok());
+  decoder = Decode(out);
+  auto* decoded = decoder->GetMetadata();
+  ASSERT_TRUE(decoded->Has(ImageMetadata::Type::kEXIF));
+  ASSERT_TRUE(decoded->Has(ImageMetadata::Type::kXMP));
+  EXPECT_EQ(kExif, io::Chunk::Merge(decoded->Get(ImageMetadata::Type::kEXIF))
+                       ->ToString()
+                       .as_string());
+  EXPECT_EQ(kXmp, io::Chunk::Merge(decoded->Get(ImageMetadata::Type::kXMP))
+                      ->ToString()
+                      .as_string());
+}
+
+TEST(PngEncoderTest, RejectsAnimation) {
+  ImageFrame frame;
+  FillFrame(8, 8, {{{10, 20, 30, 255}}}, &frame);
+  ImageInfo image_info;
+  image_info.multiframe = true;
+  std::vector<uint8_t> out;
+  PngEncoder encoder(PngEncoder::Params::Default(),
+                     base::make_unique<VectorTestWriter>(&out));
+  ASSERT_TRUE(encoder.Initialize(&image_info).ok());
+  EXPECT_EQ(Result::Code::kDunnoHowToEncode,
+            encoder.EncodeFrame(&frame, false).code());
+}
+
+}  // namespace image
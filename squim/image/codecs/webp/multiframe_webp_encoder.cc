@@ -17,6 +17,7 @@
 #include "squim/image/codecs/webp/multiframe_webp_encoder.h"
 
 #include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
 #include "squim/image/codecs/webp/webp_util.h"
 #include "squim/image/image_frame.h"
 #include "squim/image/image_info.h"
@@ -63,45 +64,9 @@ Result MultiframeWebPEncoder::EncodeFrame(ImageFrame* frame) {
     return Result::Error(Result::Code::kEncodeError,
                          WebPError("WebPPictureView: ", &webp_image_));
 
-  auto* where = webp_frame_.argb;
-  Bitmap bitmap(frame);
-  switch (frame->color_scheme()) {
-    case ColorScheme::kGrayScale:
-      for (uint32_t y = 0; y < frame->height(); ++y) {
-        for (uint32_t x = 0; x < frame->width(); ++x) {
-          auto px = bitmap.GetPixel<GrayScalePixel>(x, y);
-          *where++ = PackAsARGB(px.g(), px.g(), px.g(), 0xFF);
-        }
-      }
-      break;
-    case ColorScheme::kGrayScaleAlpha:
-      for (uint32_t y = 0; y < frame->height(); ++y) {
-        for (uint32_t x = 0; x < frame->width(); ++x) {
-          auto px = bitmap.GetPixel<GrayScaleAlphaPixel>(x, y);
-          *where++ = PackAsARGB(px.g(), px.g(), px.g(), px.a());
-        }
-      }
-      break;
-    case ColorScheme::kRGB:
-      for (uint32_t y = 0; y < frame->height(); ++y) {
-        for (uint32_t x = 0; x < frame->width(); ++x) {
-          auto px = bitmap.GetPixel<RGBPixel>(x, y);
-          *where++ = PackAsARGB(px.r(), px.g(), px.b(), 0xFF);
-        }
-      }
-      break;
-    case ColorScheme::kRGBA:
-      for (uint32_t y = 0; y < frame->height(); ++y) {
-        for (uint32_t x = 0; x < frame->width(); ++x) {
-          auto px = bitmap.GetPixel<RGBAPixel>(x, y);
-          *where++ = PackAsARGB(px.r(), px.g(), px.b(), px.a());
-        }
-      }
-      break;
-    default:
-      return Result::Error(Result::Code::kEncodeError,
-                           "WebP encode: unsupported color scheme");
-  }
+  if (!WebPPictureFromFrameARGB(frame, &webp_frame_))
+    return Result::Error(Result::Code::kEncodeError,
+                         "WebP encode: unsupported color scheme");
 
   // We need to pass image to add frame.
   WebPFrameRect frame_rect = {
@@ -154,13 +119,11 @@ Result MultiframeWebPEncoder::FinishEncoding() {
     return Result::Error(Result::Code::kEncodeError,
                          WebPError("WebPMuxAssemble: ", &webp_image_));
 
-  auto chunk = io::Chunk::Copy(webp_data.bytes, webp_data.size);
+  // The assembled animation may be large, hand it over without copying.
   io::ChunkList chunks;
-  chunks.push_back(std::move(chunk));
+  chunks.push_back(base::make_unique<WebPDataChunk>(webp_data));
   auto write_result = output_->WriteV(std::move(chunks));
 
-  WebPDataClear(&webp_data);
-
   return Result::FromIoResult(write_result, false);
 }
 
@@ -18,6 +18,7 @@
 
 #include <cstring>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 
@@ -29,9 +30,7 @@
 #include "squim/image/image_metadata.h"
 #include "squim/image/image_optimization_stats.h"
 #include "squim/image/pixel.h"
-#include "squim/io/buf_reader.h"
 #include "squim/io/buf_writer.h"
-#include "squim/io/buffered_source.h"
 #include "squim/io/writer.h"
 #include "squim/ioutil/chunk_writer.h"
 
@@ -41,6 +40,19 @@ namespace {
 
 const size_t kTagSize = 4;
 const size_t kChunkHeaderSize = 8;
+const size_t kRiffHeaderSize = 12;
+const size_t kVP8XChunkSize = 18;
+
+// Bounds of the output buffer block size, which is otherwise estimated as
+// 2 bits per pixel.
+const size_t kMinOutputBlockSize = 4096;
+const size_t kMaxOutputBlockSize = 1024 * 1024;
+
+size_t EstimateOutputBlockSize(const WebPPicture& picture) {
+  size_t estimate = static_cast<size_t>(picture.width) * picture.height / 4;
+  return std::max(kMinOutputBlockSize,
+                  std::min(kMaxOutputBlockSize, estimate));
+}
 
 class LEWriter {
  public:
@@ -158,6 +170,12 @@ Result SimpleWebPEncoder::EncodeFrame(ImageFrame* frame) {
   if (!conf_result.ok())
     return conf_result;
 
+  // Palette images (typically still GIFs) are almost always smaller and
+  // cheaper to encode losslessly.
+  if (params_->compression == WebPEncoder::Compression::kMixed &&
+      frame->is_palette())
+    webp_config_.lossless = 1;
+
   std::unique_ptr<ImageFrame> transformed_frame;
   if (frame->is_grayscale()) {
     // TODO: transform to RGB(A).
@@ -166,7 +184,7 @@ Result SimpleWebPEncoder::EncodeFrame(ImageFrame* frame) {
     frame = transformed_frame.get();
   }
 
-  if (!frame->is_yuv() && !frame->is_rgb())
+  if (!frame->is_yuv() && !frame->is_rgb() && !frame->is_palette())
     return Result::Error(Result::Code::kEncodeError,
                          "Invalid color scheme for webp encoding");
 
@@ -189,6 +207,13 @@ Result SimpleWebPEncoder::EncodeFrame(ImageFrame* frame) {
     case ColorScheme::kYUVA:
       result = WebPPictureFromYUVAFrame(frame, &picture_);
       break;
+    case ColorScheme::kPalette:
+      // Expand indices straight into the picture's own ARGB buffer.
+      picture_.use_argb = true;
+      result = WebPPictureAlloc(&picture_) &&
+               WebPPictureFromFrameARGB(frame, &picture_);
+      owns_data_ = true;
+      break;
     default:
       NOTREACHED();
   }
@@ -197,6 +222,9 @@ Result SimpleWebPEncoder::EncodeFrame(ImageFrame* frame) {
     return Result::Error(Result::Code::kEncodeError,
                          WebPError("WebP picture import error: ", &picture_));
 
+  output_block_size_ = EstimateOutputBlockSize(picture_);
+  output_buffer_ = base::make_unique<io::BufferWriter>(output_block_size_);
+  streaming_ = !params_->should_write_metadata();
   picture_.writer = ChunkWriter;
   picture_.custom_ptr = this;
   picture_.progress_hook = WebPProgressHook;
@@ -210,6 +238,9 @@ Result SimpleWebPEncoder::EncodeFrame(ImageFrame* frame) {
   // Now take picture and WebP encode it.
   result = WebPEncode(&webp_config_, &picture_);
 
+  if (!result && picture_.error_code == VP8_ENC_ERROR_BAD_WRITE)
+    return Result::Error(Result::Code::kFailed, "WebP output write error");
+
   if (!result)
     return Result::Error(Result::Code::kEncodeError,
                          WebPError("WebP encode error: ", &picture_));
@@ -218,12 +249,14 @@ Result SimpleWebPEncoder::EncodeFrame(ImageFrame* frame) {
 }
 
 Result SimpleWebPEncoder::FinishEncoding() {
-  if (chunks_.empty())
+  if (!output_buffer_ || output_buffer_->total_size() == 0)
     return Result::Ok();
 
-  if (!params_->should_write_metadata() || metadata_->Empty()) {
-    auto io_result = output_->WriteV(std::move(chunks_));
-    chunks_ = io::ChunkList();
+  auto webp_size = output_buffer_->total_size();
+  auto chunks = output_buffer_->ReleaseChunks();
+
+  if (streaming_ || metadata_->Empty()) {
+    auto io_result = output_->WriteV(std::move(chunks));
     return Result::FromIoResult(io_result, false);
   }
 
@@ -231,8 +264,6 @@ Result SimpleWebPEncoder::FinishEncoding() {
   const uint32_t kEXIFFlag = 0x08;
   const uint32_t kICCPFlag = 0x20;
   const uint32_t kXMPFlag = 0x04;
-  const size_t kVP8XChunkSize = 18;
-  const size_t kRiffHeaderSize = 12;
   const char kVP8XHeader[] = "VP8X\x0a\x00\x00\x00";
 
   size_t metadata_total_size = 0;
@@ -248,16 +279,13 @@ Result SimpleWebPEncoder::FinishEncoding() {
                                  ImageMetadata::Type::kXMP, kXMPFlag, &flags,
                                  &metadata_total_size);
 
-  auto source = base::make_unique<io::BufferedSource>(std::move(chunks_));
-  auto reader = base::make_unique<io::BufReader>(std::move(source));
-  chunks_ = io::ChunkList();
-
-  auto webp_size = reader->source()->size();
-  auto result = reader->SkipN(kRiffHeaderSize);
-  DCHECK(!result.pending());
-  uint8_t vp8_tag[kTagSize];
-  result = reader->PeekNInto(vp8_tag);
-  DCHECK(!result.pending());
+  // The first block is large enough to hold all the headers, so they are
+  // parsed in place. The image data is passed on without copying.
+  auto head = std::move(chunks.front());
+  chunks.pop_front();
+  DCHECK_GE(head->size(), kRiffHeaderSize + kChunkHeaderSize + 4);
+  const uint8_t* vp8_tag = head->data() + kRiffHeaderSize;
+  size_t header_size = kRiffHeaderSize;
   bool has_vp8x = std::memcmp(vp8_tag, "VP8X", kTagSize) == 0;
   auto riff_size = webp_size - kChunkHeaderSize + metadata_total_size;
   if (!has_vp8x)
@@ -270,20 +298,17 @@ Result SimpleWebPEncoder::FinishEncoding() {
   writer.WriteLE32(riff_size);
   writer.WriteBytes("WEBP", kTagSize);
   if (has_vp8x) {
-    uint8_t* vp8x;
-    result = reader->ReadN(&vp8x, kVP8XChunkSize);
-    DCHECK(!result.pending());
-    DCHECK_EQ(kVP8XChunkSize, result.n());
+    DCHECK_GE(head->size(), kRiffHeaderSize + kVP8XChunkSize);
+    uint8_t* vp8x = head->data() + kRiffHeaderSize;
     vp8x[kChunkHeaderSize] |= static_cast<uint8_t>(flags & 0xFF);
     writer.WriteBytes(vp8x, kVP8XChunkSize);
+    header_size += kVP8XChunkSize;
   } else {
     bool is_lossless = std::memcmp(vp8_tag, "VP8L", kTagSize) == 0;
     if (is_lossless) {
       // Presence of alpha is stored in the 29th bit of VP8L data.
-      // Thus we read chunk header + 32 bits == 8 + 4 bytes.
-      uint8_t vp8l[kChunkHeaderSize + 4];
-      result = reader->PeekNInto(vp8l);
-      DCHECK(!result.pending());
+      // Thus we look at chunk header + 32 bits == 8 + 4 bytes.
+      const uint8_t* vp8l = vp8_tag;
       if (vp8l[kChunkHeaderSize + 3] & (1 << 5))
         flags |= kAlphaFlag;
     }
@@ -299,8 +324,10 @@ Result SimpleWebPEncoder::FinishEncoding() {
     auto iccp_data = CreateMetadataPayload("ICCP", std::move(iccp));
     final_webp.splice(final_webp.end(), iccp_data);
   }
-  auto webp_body = reader->source()->ReleaseRest();
-  final_webp.splice(final_webp.end(), webp_body);
+  auto head_size = head->size();
+  final_webp.push_back(io::Chunk::Wrap(std::move(head), header_size,
+                                       head_size - header_size));
+  final_webp.splice(final_webp.end(), chunks);
   if (exif) {
     auto exif_data = CreateMetadataPayload("EXIF", std::move(exif));
     final_webp.splice(final_webp.end(), exif_data);
@@ -327,8 +354,14 @@ int SimpleWebPEncoder::ChunkWriter(const uint8_t* data,
                                    size_t data_size,
                                    const WebPPicture* const picture) {
   auto* encoder = static_cast<SimpleWebPEncoder*>(picture->custom_ptr);
-  auto chunk = io::Chunk::Copy(data, data_size);
-  encoder->chunks_.push_back(std::move(chunk));
+  auto* buffer = encoder->output_buffer_.get();
+  buffer->Write(const_cast<uint8_t*>(data), data_size);
+  if (encoder->streaming_ &&
+      buffer->total_size() >= encoder->output_block_size_) {
+    auto io_result = encoder->output_->WriteV(buffer->ReleaseChunks());
+    if (io_result.error())
+      return 0;
+  }
   return 1;
 }
 
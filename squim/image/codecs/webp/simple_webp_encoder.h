@@ -17,8 +17,11 @@
 #ifndef SQUIM_IMAGE_CODECS_WEBP_SIMPLE_WEBP_ENCODER_H_
 #define SQUIM_IMAGE_CODECS_WEBP_SIMPLE_WEBP_ENCODER_H_
 
+#include <memory>
+
 #include "google/libwebp/upstream/src/webp/encode.h"
 #include "squim/image/codecs/webp_encoder.h"
+#include "squim/io/buffer_writer.h"
 
 namespace image {
 
@@ -47,7 +50,12 @@ class SimpleWebPEncoder : public WebPEncoder::Impl {
   WebPPicture picture_;
   bool owns_data_ = false;
   std::unique_ptr<WebPAuxStats> stats_;
-  io::ChunkList chunks_;
+  // Encoded image, in a few large blocks sized from the picture dimensions.
+  std::unique_ptr<io::BufferWriter> output_buffer_;
+  size_t output_block_size_ = 0;
+  // Without metadata to insert the headers are never rewritten, so blocks
+  // are passed to |output_| as soon as they are filled.
+  bool streaming_ = false;
 };
 
 }  // namespace image
@@ -46,17 +46,25 @@ std::string WebPError(const std::string& prefix, WebPPicture* picture) {
   return prefix + kErrorMessages[picture->error_code];
 }
 
+WebPDataChunk::WebPDataChunk(WebPData data)
+    : io::Chunk(data.bytes, data.size), data_(data) {}
+
+WebPDataChunk::~WebPDataChunk() {
+  WebPDataClear(&data_);
+}
+
 YUVAReader::YUVAReader(ImageFrame* frame) {
   uint8_t* mem = frame->GetData(0);
   y_stride_ = frame->width();
   y_ = mem;
-  mem += y_stride_;
+  mem += y_stride_ * frame->height();
 
   uv_stride_ = (frame->width() + 1) >> 1;
+  const uint32_t uv_height = (frame->height() + 1) >> 1;
   u_ = mem;
-  mem += uv_stride_;
+  mem += uv_stride_ * uv_height;
   v_ = mem;
-  mem += uv_stride_;
+  mem += uv_stride_ * uv_height;
 
   if (frame->has_alpha()) {
     a_ = mem;
@@ -197,6 +205,69 @@ bool WebPPictureFromYUVAFrame(ImageFrame* frame, WebPPicture* picture) {
   return true;
 }
 
+bool WebPPictureFromFrameARGB(ImageFrame* frame, WebPPicture* picture) {
+  DCHECK(picture->use_argb);
+  DCHECK_EQ(frame->width(), static_cast<uint32_t>(picture->width));
+  DCHECK_EQ(frame->height(), static_cast<uint32_t>(picture->height));
+  Bitmap bitmap(frame);
+  switch (frame->color_scheme()) {
+    case ColorScheme::kGrayScale:
+      for (uint32_t y = 0; y < frame->height(); ++y) {
+        auto* where = picture->argb + y * picture->argb_stride;
+        for (uint32_t x = 0; x < frame->width(); ++x) {
+          auto px = bitmap.GetPixel<GrayScalePixel>(x, y);
+          *where++ = PackAsARGB(px.g(), px.g(), px.g(), 0xFF);
+        }
+      }
+      return true;
+    case ColorScheme::kGrayScaleAlpha:
+      for (uint32_t y = 0; y < frame->height(); ++y) {
+        auto* where = picture->argb + y * picture->argb_stride;
+        for (uint32_t x = 0; x < frame->width(); ++x) {
+          auto px = bitmap.GetPixel<GrayScaleAlphaPixel>(x, y);
+          *where++ = PackAsARGB(px.g(), px.g(), px.g(), px.a());
+        }
+      }
+      return true;
+    case ColorScheme::kRGB:
+      for (uint32_t y = 0; y < frame->height(); ++y) {
+        auto* where = picture->argb + y * picture->argb_stride;
+        for (uint32_t x = 0; x < frame->width(); ++x) {
+          auto px = bitmap.GetPixel<RGBPixel>(x, y);
+          *where++ = PackAsARGB(px.r(), px.g(), px.b(), 0xFF);
+        }
+      }
+      return true;
+    case ColorScheme::kRGBA:
+      for (uint32_t y = 0; y < frame->height(); ++y) {
+        auto* where = picture->argb + y * picture->argb_stride;
+        for (uint32_t x = 0; x < frame->width(); ++x) {
+          auto px = bitmap.GetPixel<RGBAPixel>(x, y);
+          *where++ = PackAsARGB(px.r(), px.g(), px.b(), px.a());
+        }
+      }
+      return true;
+    case ColorScheme::kPalette: {
+      // Indices outside of the palette map to transparent black.
+      uint32_t argb[256] = {0};
+      const auto& palette = frame->palette();
+      for (size_t i = 0; i < palette.size(); ++i) {
+        const auto& c = palette[i];
+        argb[i] = PackAsARGB(c[0], c[1], c[2], c[3]);
+      }
+      for (uint32_t y = 0; y < frame->height(); ++y) {
+        const uint8_t* indices = frame->GetPixel(0, y);
+        auto* where = picture->argb + y * picture->argb_stride;
+        for (uint32_t x = 0; x < frame->width(); ++x)
+          where[x] = argb[indices[x]];
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
 Result EncoderParamsToWebPConfig(const WebPEncoder::Params& params,
                                  WebPConfig* webp_config,
                                  double image_quality) {
@@ -211,6 +282,8 @@ Result EncoderParamsToWebPConfig(const WebPEncoder::Params& params,
                          "WebP config preset error");
 
   webp_config->method = params.method;
+  webp_config->lossless =
+      params.compression == WebPEncoder::Compression::kLossless;
 
   if (!WebPValidateConfig(webp_config))
     return Result::Error(Result::Code::kEncodeError,
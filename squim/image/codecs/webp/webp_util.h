@@ -18,9 +18,11 @@
 #define SQUIM_IMAGE_CODECS_WEBP_WEBP_UTIL_H_
 
 #include "google/libwebp/upstream/src/webp/encode.h"
+#include "google/libwebp/upstream/src/webp/mux_types.h"
 #include "google/libwebp/upstream/examples/gif2webp_util.h"
 #include "squim/image/codecs/webp_encoder.h"
 #include "squim/image/image_frame.h"
+#include "squim/io/chunk.h"
 
 namespace image {
 
@@ -50,6 +52,17 @@ class YUVAReader {
   uint32_t a_stride_;
 };
 
+// Chunk adopting the buffer of |WebPData| allocated by libwebp, e.g. by
+// WebPMuxAssemble(). The buffer is released with WebPDataClear().
+class WebPDataChunk : public io::Chunk {
+ public:
+  explicit WebPDataChunk(WebPData data);
+  ~WebPDataChunk() override;
+
+ private:
+  WebPData data_;
+};
+
 WebPImageHint HintToWebPImageHint(WebPEncoder::Hint hint);
 
 WebPPreset PresetToWebPPreset(WebPEncoder::Preset preset);
@@ -67,6 +80,11 @@ void ConvertGrayToRGB(ImageFrame* in, ImageFrame* out);
 
 bool WebPPictureFromYUVAFrame(ImageFrame* frame, WebPPicture* picture);
 
+// Writes pixels of |frame| into ARGB |picture| of the same size, which may be
+// a view into a larger canvas. Palette frames are expanded through an ARGB
+// table built once per frame. Returns false on unsupported color scheme.
+bool WebPPictureFromFrameARGB(ImageFrame* frame, WebPPicture* picture);
+
 Result EncoderParamsToWebPConfig(const WebPEncoder::Params& params,
                                  WebPConfig* webp_config,
                                  double image_quality);
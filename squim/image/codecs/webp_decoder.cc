@@ -20,41 +20,377 @@
 #include "squim/base/memory/make_unique.h"
 #include "google/libwebp/upstream/src/webp/decode.h"
 #include "google/libwebp/upstream/src/webp/demux.h"
-#include "squim/image/scanline_reader.h"
+#include "squim/image/codecs/webp/webp_util.h"
 #include "squim/io/buf_reader.h"
 
 namespace image {
 
+namespace {
+
+// WebPBitstreamFeatures::format value for the lossless bitstream.
+const int kLosslessFormat = 2;
+
+ImageFrame::DisposalMethod WebPDisposalToDisposalMethod(
+    WebPMuxAnimDispose dispose) {
+  switch (dispose) {
+    case WEBP_MUX_DISPOSE_NONE:
+      return ImageFrame::DisposalMethod::kNone;
+    case WEBP_MUX_DISPOSE_BACKGROUND:
+      return ImageFrame::DisposalMethod::kBackground;
+    default:
+      NOTREACHED();
+      return ImageFrame::DisposalMethod::kNone;
+  }
+}
+
+}  // namespace
+
 // static
 WebPDecoder::Params WebPDecoder::Params::Default() {
   Params params;
+  params.allowed_color_schemes.insert(ColorScheme::kRGB);
+  params.allowed_color_schemes.insert(ColorScheme::kRGBA);
   params.allowed_color_schemes.insert(ColorScheme::kYUV);
   params.allowed_color_schemes.insert(ColorScheme::kYUVA);
   return params;
 }
 
+// WebP container can not be parsed in a streaming manner without keeping the
+// whole file in memory (WebPDemux needs a continuous buffer), so the data read
+// from the source is accumulated in |data_|. The demuxer is recreated every
+// time new data arrives and each frame is fed to its own WebPIDecoder, which
+// writes pixels directly into the ImageFrame memory.
 class WebPDecoder::Impl {
   MAKE_NONCOPYABLE(Impl);
 
  public:
-  Impl(WebPDecoder* decoder) : decoder_(decoder) {}
-  ~Impl() {}
+  Impl(WebPDecoder* decoder) : decoder_(decoder) {
+    WebPInitDecBuffer(&decoder_buffer_);
+  }
+
+  ~Impl() {
+    DeleteFrameDecoder();
+    if (demuxer_)
+      WebPDemuxDelete(demuxer_);
+  }
+
+  bool Decode(bool header_only) {
+    for (;;) {
+      if (!UpdateDemuxer())
+        return false;
+
+      if (header_only && HeaderComplete())
+        return true;
+
+      if (HeaderComplete()) {
+        auto result = DecodeFrames();
+        if (result.error()) {
+          decoder_->Fail(result);
+          return false;
+        }
+        UpdateMetadata();
+      }
+
+      if (DecodingComplete()) {
+        ReleaseData();
+        return true;
+      }
+
+      if (eof_) {
+        decoder_->Fail(Result::Error(Result::Code::kUnexpectedEof));
+        return false;
+      }
+
+      if (!ReadData())
+        return false;
+
+      if (!data_changed_ && !eof_)
+        return false;  // IO suspend.
+    }
+  }
+
+  bool HeaderComplete() const { return header_complete_; }
+
+  bool ImageComplete() const { return frames_complete_; }
+
+  bool DecodingComplete() const {
+    return frames_complete_ && decoder_->metadata_.IsAllCompleted();
+  }
 
-  bool Decode(bool header_only) { return true; }
+ private:
+  // Appends all the data available in the source to |data_|.
+  bool ReadData() {
+    for (;;) {
+      // Everything read so far has been copied to |data_|.
+      decoder_->source()->FreeBefore(decoder_->source()->offset());
+      uint8_t* out;
+      auto result = decoder_->source()->ReadSome(&out);
+
+      if (result.pending())
+        return true;
+
+      if (result.eof()) {
+        eof_ = true;
+        return true;
+      }
+
+      if (!result.ok()) {
+        decoder_->Fail(Result::FromIoResult(result, false));
+        return false;
+      }
+
+      data_.insert(data_.end(), out, out + result.n());
+      data_changed_ = true;
+    }
+  }
+
+  // Demuxer keeps pointers into |data_|, so it has to be recreated each time
+  // the data changes.
+  bool UpdateDemuxer() {
+    if (!data_changed_)
+      return true;
+    data_changed_ = false;
+
+    if (demuxer_)
+      WebPDemuxDelete(demuxer_);
+
+    WebPData data = {data_.data(), data_.size()};
+    demuxer_ = WebPDemuxPartial(&data, &demux_state_);
+    if (!demuxer_ || demux_state_ == WEBP_DEMUX_PARSE_ERROR) {
+      if (demux_state_ == WEBP_DEMUX_PARSING_HEADER)
+        return true;  // Not enough data for the RIFF header yet.
+
+      decoder_->Fail(Result::Error(Result::Code::kDecodeError,
+                                   "Invalid WebP container"));
+      return false;
+    }
+
+    if (demux_state_ < WEBP_DEMUX_PARSED_HEADER || header_complete_)
+      return true;
+
+    // Animation parameters (ANIM chunk) precede the first frame, so the header
+    // is complete only after the first frame is seen.
+    if (WebPDemuxGetI(demuxer_, WEBP_FF_FRAME_COUNT) == 0 &&
+        demux_state_ != WEBP_DEMUX_DONE)
+      return true;
+
+    auto& image_info = decoder_->image_info_;
+    // RIFF size field does not include the 8-byte RIFF chunk header.
+    const uint8_t* riff_size = &data_[4];
+    image_info.size = 8 + (riff_size[0] | (riff_size[1] << 8) |
+                           (riff_size[2] << 16) |
+                           (static_cast<uint32_t>(riff_size[3]) << 24));
+    image_info.width = WebPDemuxGetI(demuxer_, WEBP_FF_CANVAS_WIDTH);
+    image_info.height = WebPDemuxGetI(demuxer_, WEBP_FF_CANVAS_HEIGHT);
+    auto flags = WebPDemuxGetI(demuxer_, WEBP_FF_FORMAT_FLAGS);
+    if (flags & ANIMATION_FLAG) {
+      image_info.multiframe = true;
+      image_info.loop_count = WebPDemuxGetI(demuxer_, WEBP_FF_LOOP_COUNT);
+      // Stored as [Blue, Green, Red, Alpha] byte sequence.
+      auto bg_color = WebPDemuxGetI(demuxer_, WEBP_FF_BACKGROUND_COLOR);
+      image_info.bg_color = {{static_cast<uint8_t>((bg_color >> 16) & 0xFF),
+                              static_cast<uint8_t>((bg_color >> 8) & 0xFF),
+                              static_cast<uint8_t>(bg_color & 0xFF),
+                              static_cast<uint8_t>((bg_color >> 24) & 0xFF)}};
+    }
+
+    header_complete_ = true;
+    return true;
+  }
+
+  Result DecodeFrames() {
+    while (!frames_complete_) {
+      WebPIterator iter;
+      if (!WebPDemuxGetFrame(demuxer_, next_frame_ + 1, &iter)) {
+        if (demux_state_ == WEBP_DEMUX_DONE)
+          frames_complete_ = true;
+        return Result::Pending();
+      }
+
+      auto result = DecodeFrame(iter);
+      WebPDemuxReleaseIterator(&iter);
+      if (!result.ok())
+        return result;
+    }
 
-  bool HeaderComplete() const { return true; }
+    return Result::Ok();
+  }
+
+  Result DecodeFrame(const WebPIterator& iter) {
+    auto& image_frames = decoder_->image_frames_;
+    if (image_frames.size() == next_frame_) {
+      WebPBitstreamFeatures features;
+      auto status = WebPGetFeatures(iter.fragment.bytes, iter.fragment.size,
+                                    &features);
+      if (status == VP8_STATUS_NOT_ENOUGH_DATA && !iter.complete)
+        return Result::Pending();
+
+      if (status != VP8_STATUS_OK)
+        return Result::Error(Result::Code::kDecodeError,
+                             "Invalid WebP frame header");
+
+      auto frame = base::make_unique<ImageFrame>();
+      frame->set_offset(iter.x_offset, iter.y_offset);
+      frame->set_size(iter.width, iter.height);
+      frame->set_duration(iter.duration);
+      frame->set_disposal_method(
+          WebPDisposalToDisposalMethod(iter.dispose_method));
+      auto color_scheme =
+          SelectColorScheme(iter.has_alpha, features.format == kLosslessFormat);
+      if (color_scheme == ColorScheme::kUnknown)
+        return Result::Error(Result::Code::kDecodeError,
+                             "Unsupported color scheme");
+      frame->set_color_scheme(color_scheme);
+      frame->set_status(ImageFrame::Status::kHeaderComplete);
+      frame->Init();
+
+      if (!CreateFrameDecoder(frame.get()))
+        return Result::Error(Result::Code::kDecodeError,
+                             "Failed to create WebP decoder");
+
+      image_frames.push_back(std::move(frame));
+    }
+
+    auto* frame = image_frames[next_frame_].get();
+    auto status =
+        WebPIUpdate(frame_decoder_, iter.fragment.bytes, iter.fragment.size);
+    switch (status) {
+      case VP8_STATUS_OK:
+        DeleteFrameDecoder();
+        frame->set_status(ImageFrame::Status::kComplete);
+        next_frame_++;
+        return Result::Ok();
+      case VP8_STATUS_SUSPENDED:
+        if (iter.complete)
+          return Result::Error(Result::Code::kDecodeError,
+                               "Truncated WebP frame");
+        frame->set_status(ImageFrame::Status::kPartial);
+        return Result::Pending();
+      default:
+        return Result::Error(Result::Code::kDecodeError,
+                             "WebP bitstream error");
+    }
+  }
+
+  // YUV is preferred for lossy frames as it is the native VP8 output, lossless
+  // ones are decoded as RGB(A) to avoid lossy color conversion.
+  ColorScheme SelectColorScheme(bool has_alpha, bool lossless) const {
+    const auto& params = decoder_->params_;
+    auto yuv = has_alpha ? ColorScheme::kYUVA : ColorScheme::kYUV;
+    auto rgb = has_alpha ? ColorScheme::kRGBA : ColorScheme::kRGB;
+    if (!lossless && params.color_scheme_allowed(yuv))
+      return yuv;
+    if (params.color_scheme_allowed(rgb))
+      return rgb;
+    if (params.color_scheme_allowed(yuv))
+      return yuv;
+    return ColorScheme::kUnknown;
+  }
+
+  bool CreateFrameDecoder(ImageFrame* frame) {
+    DCHECK(!frame_decoder_);
+    WebPInitDecBuffer(&decoder_buffer_);
+    decoder_buffer_.is_external_memory = 1;
+    decoder_buffer_.width = frame->width();
+    decoder_buffer_.height = frame->height();
+
+    switch (frame->color_scheme()) {
+      case ColorScheme::kRGB:
+      case ColorScheme::kRGBA: {
+        decoder_buffer_.colorspace =
+            frame->has_alpha() ? MODE_RGBA : MODE_RGB;
+        auto& rgba = decoder_buffer_.u.RGBA;
+        rgba.rgba = frame->GetData(0);
+        rgba.stride = frame->stride();
+        rgba.size = frame->stride() * frame->height();
+        break;
+      }
+      case ColorScheme::kYUV:
+      case ColorScheme::kYUVA: {
+        decoder_buffer_.colorspace =
+            frame->has_alpha() ? MODE_YUVA : MODE_YUV;
+        YUVAReader reader(frame);
+        const size_t uv_height = (frame->height() + 1) >> 1;
+        auto& yuva = decoder_buffer_.u.YUVA;
+        yuva.y = reader.y();
+        yuva.y_stride = reader.y_stride();
+        yuva.y_size = reader.y_stride() * frame->height();
+        yuva.u = reader.u();
+        yuva.v = reader.v();
+        yuva.u_stride = yuva.v_stride = reader.uv_stride();
+        yuva.u_size = yuva.v_size = reader.uv_stride() * uv_height;
+        yuva.a = reader.a();
+        yuva.a_stride = reader.a_stride();
+        yuva.a_size = reader.a_stride() * frame->height();
+        break;
+      }
+      default:
+        NOTREACHED();
+        return false;
+    }
+
+    frame_decoder_ = WebPINewDecoder(&decoder_buffer_);
+    return frame_decoder_ != nullptr;
+  }
+
+  void DeleteFrameDecoder() {
+    if (!frame_decoder_)
+      return;
+    WebPIDelete(frame_decoder_);
+    frame_decoder_ = nullptr;
+    WebPFreeDecBuffer(&decoder_buffer_);
+  }
+
+  void UpdateMetadata() {
+    auto& metadata = decoder_->metadata_;
+
+    // ICCP chunk must precede the image data.
+    if (!metadata.IsCompleted(ImageMetadata::Type::kICC)) {
+      AppendMetadataChunk("ICCP", ImageMetadata::Type::kICC);
+      metadata.Freeze(ImageMetadata::Type::kICC);
+    }
+
+    // EXIF and XMP chunks follow the image data.
+    if (demux_state_ == WEBP_DEMUX_DONE && frames_complete_ &&
+        !metadata.IsAllCompleted()) {
+      AppendMetadataChunk("EXIF", ImageMetadata::Type::kEXIF);
+      AppendMetadataChunk("XMP ", ImageMetadata::Type::kXMP);
+      metadata.FreezeAll();
+    }
+  }
+
+  void AppendMetadataChunk(const char fourcc[4], ImageMetadata::Type type) {
+    WebPChunkIterator chunk_iter;
+    if (WebPDemuxGetChunk(demuxer_, fourcc, 1, &chunk_iter)) {
+      decoder_->metadata_.Append(
+          type, io::Chunk::Copy(chunk_iter.chunk.bytes, chunk_iter.chunk.size));
+    }
+    WebPDemuxReleaseChunkIterator(&chunk_iter);
+  }
+
+  // Everything is copied out of the input, it is no longer needed.
+  void ReleaseData() {
+    if (demuxer_) {
+      WebPDemuxDelete(demuxer_);
+      demuxer_ = nullptr;
+    }
+    std::vector<uint8_t>().swap(data_);
+  }
 
-  bool ImageComplete() const { return true; }
+  WebPDecoder* decoder_;
 
-  bool DecodingComplete() const { return true; }
+  std::vector<uint8_t> data_;
+  bool data_changed_ = false;
+  bool eof_ = false;
 
- private:
-  void UpdateDemuxer() {}
+  WebPDemuxer* demuxer_ = nullptr;
+  WebPDemuxState demux_state_ = WEBP_DEMUX_PARSING_HEADER;
+  bool header_complete_ = false;
 
-  WebPIDecoder* webp_decoder_;
+  WebPIDecoder* frame_decoder_ = nullptr;
   WebPDecBuffer decoder_buffer_;
-
-  WebPDecoder* decoder_;
+  size_t next_frame_ = 0;
+  bool frames_complete_ = false;
 };
 
 WebPDecoder::WebPDecoder(Params params, std::unique_ptr<io::BufReader> source)
@@ -92,6 +428,12 @@ ImageFrame* WebPDecoder::GetFrameAtIndex(size_t index) {
   return image_frames_[index].get();
 }
 
+void WebPDecoder::ReleaseFrameAtIndex(size_t index) {
+  CHECK_GT(image_frames_.size(), index);
+  DCHECK(IsFrameCompleteAtIndex(index));
+  image_frames_[index]->ReleasePixels();
+}
+
 size_t WebPDecoder::GetFrameCount() const {
   return image_frames_.size();
 }
@@ -115,12 +457,20 @@ bool WebPDecoder::IsImageComplete() const {
 Result WebPDecoder::Decode() {
   if (HasError())
     return decode_error_;
+
+  if (impl_->DecodingComplete())
+    return Result::Ok();
+
   return ProcessDecodeResult(impl_->Decode(false));
 }
 
 Result WebPDecoder::DecodeImageInfo() {
   if (HasError())
     return decode_error_;
+
+  if (impl_->HeaderComplete())
+    return Result::Ok();
+
   return ProcessDecodeResult(impl_->Decode(true));
 }
 
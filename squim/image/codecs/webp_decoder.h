@@ -50,6 +50,7 @@ class WebPDecoder : public ImageDecoder {
   bool IsFrameHeaderCompleteAtIndex(size_t index) const override;
   bool IsFrameCompleteAtIndex(size_t index) const override;
   ImageFrame* GetFrameAtIndex(size_t index) override;
+  void ReleaseFrameAtIndex(size_t index) override;
   size_t GetFrameCount() const override;
   ImageMetadata* GetMetadata() override;
   bool IsAllMetadataComplete() const override;
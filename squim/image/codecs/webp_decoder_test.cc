@@ -16,6 +16,7 @@
 
 #include "squim/image/codecs/webp_decoder.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -73,6 +74,137 @@ class WebPDecoderTest : public testing::Test {
   }
 };
 
-TEST_F(WebPDecoderTest, ReadSuccessAll) {}
+TEST_F(WebPDecoderTest, ReadSuccessAll) {
+  const char* kFiles[] = {"opaque_32x20", "alpha_32x32", "gray_saved_as_rgb"};
+  for (auto file : kFiles) {
+    for (auto chunk_size : {0, 1, 7, 100}) {
+      std::vector<uint8_t> data;
+      ASSERT_TRUE(ReadTestFile(kWebPTestDir, file, "webp", &data));
+      auto source = base::make_unique<io::BufReader>(
+          base::make_unique<io::BufferedSource>());
+      auto* source_raw = source.get();
+      auto testee = CreateDecoder(std::move(source));
+      auto read_spec = GenerateSyncFuzzyReads(data.size(), chunk_size);
+      size_t offset = 0;
+      for (auto read_slices : read_spec) {
+        for (auto size : read_slices) {
+          source_raw->source()->AddChunk(
+              base::make_unique<io::Chunk>(&data[offset], size));
+          offset += size;
+        }
+        auto result = testee->Decode();
+        if (offset < data.size()) {
+          ASSERT_EQ(Result::Code::kPending, result.code()) << file;
+        } else {
+          ASSERT_EQ(Result::Code::kOk, result.code()) << file;
+        }
+      }
+
+      EXPECT_TRUE(testee->IsImageComplete()) << file;
+      EXPECT_FALSE(testee->GetImageInfo().multiframe) << file;
+      ASSERT_EQ(1, testee->GetFrameCount()) << file;
+      ASSERT_TRUE(testee->IsFrameCompleteAtIndex(0)) << file;
+      auto* frame = testee->GetFrameAtIndex(0);
+      EXPECT_TRUE(frame->is_yuv()) << file;
+      EXPECT_EQ(testee->GetImageInfo().width, frame->width()) << file;
+      EXPECT_EQ(testee->GetImageInfo().height, frame->height()) << file;
+    }
+  }
+}
+
+TEST_F(WebPDecoderTest, ReadRGBMatchesReference) {
+  const char* kFiles[] = {"opaque_32x20", "alpha_32x32"};
+  WebPDecoder::Params params;
+  params.allowed_color_schemes.insert(ColorScheme::kRGB);
+  params.allowed_color_schemes.insert(ColorScheme::kRGBA);
+  for (auto file : kFiles) {
+    std::vector<uint8_t> webp_data;
+    std::vector<uint8_t> png_data;
+    ASSERT_TRUE(ReadTestFile(kWebPTestDir, file, "webp", &webp_data));
+    ASSERT_TRUE(ReadTestFile(kWebPTestDir, file, "png", &png_data));
+    ImageInfo ref_info;
+    ImageFrame ref_frame;
+    ASSERT_TRUE(LoadReferencePng(file, png_data, &ref_info, &ref_frame));
+
+    auto source = base::make_unique<io::BufReader>(
+        base::make_unique<io::BufferedSource>());
+    source->source()->AddChunk(
+        base::make_unique<io::Chunk>(&webp_data[0], webp_data.size()));
+    source->source()->SendEof();
+    WebPDecoder testee(params, std::move(source));
+    ASSERT_TRUE(testee.Decode().ok()) << file;
+    ASSERT_EQ(1, testee.GetFrameCount()) << file;
+    auto* frame = testee.GetFrameAtIndex(0);
+    EXPECT_EQ(ref_frame.color_scheme(), frame->color_scheme()) << file;
+    CheckImageFrameByPSNR(file, &ref_frame, frame, 30);
+  }
+}
+
+TEST_F(WebPDecoderTest, ReadAnimated) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kWebPTestDir, "animated", "webp", &data));
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  auto* source_raw = source.get();
+  auto testee = CreateDecoder(std::move(source));
+  size_t offset = 0;
+  const size_t kChunkSize = 64;
+  while (offset < data.size()) {
+    auto size = std::min(kChunkSize, data.size() - offset);
+    source_raw->source()->AddChunk(
+        base::make_unique<io::Chunk>(&data[offset], size));
+    offset += size;
+    auto result = testee->Decode();
+    ASSERT_TRUE(result.ok() || result.pending());
+  }
+
+  EXPECT_TRUE(testee->IsImageComplete());
+  EXPECT_TRUE(testee->GetImageInfo().multiframe);
+  EXPECT_TRUE(testee->GetImageInfo().bg_color);
+  ASSERT_EQ(8, testee->GetFrameCount());
+  for (size_t i = 0; i < testee->GetFrameCount(); ++i) {
+    EXPECT_TRUE(testee->IsFrameCompleteAtIndex(i)) << i;
+    auto* frame = testee->GetFrameAtIndex(i);
+    // Lossless frames should not be converted to YUV.
+    EXPECT_TRUE(frame->is_rgb()) << i;
+    EXPECT_LE(frame->x_offset() + frame->width(),
+              testee->GetImageInfo().width);
+    EXPECT_LE(frame->y_offset() + frame->height(),
+              testee->GetImageInfo().height);
+  }
+}
+
+TEST_F(WebPDecoderTest, ReadMetadata) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kWebPTestDir, "icc_xmp_ex", "webp", &data));
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(
+      base::make_unique<io::Chunk>(&data[0], data.size()));
+  source->source()->SendEof();
+  auto testee = CreateDecoder(std::move(source));
+  ASSERT_TRUE(testee->Decode().ok());
+  EXPECT_TRUE(testee->IsAllMetadataComplete());
+  EXPECT_TRUE(testee->GetMetadata()->Has(ImageMetadata::Type::kICC));
+  EXPECT_TRUE(testee->GetMetadata()->Has(ImageMetadata::Type::kXMP));
+  EXPECT_FALSE(testee->GetMetadata()->Has(ImageMetadata::Type::kEXIF));
+}
+
+TEST_F(WebPDecoderTest, DecoderError) {
+  CheckInvalidRead("corrupt_header.webp");
+  CheckInvalidRead("corrupt_body.webp");
+}
+
+TEST_F(WebPDecoderTest, UnexpectedEof) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFile(kWebPTestDir, "opaque_32x20", "webp", &data));
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(
+      base::make_unique<io::Chunk>(&data[0], data.size() / 2));
+  source->source()->SendEof();
+  auto testee = CreateDecoder(std::move(source));
+  EXPECT_EQ(Result::Code::kUnexpectedEof, testee->Decode().code());
+}
 
 }  // namespace image
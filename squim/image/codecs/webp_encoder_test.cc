@@ -89,6 +89,44 @@ bool ReadWebP(const std::vector<uint8_t>& data,
 
 class WebPEncoderTest : public testing::Test {
  protected:
+  void EncodeGif(const std::string& filename,
+                 GifDecoder::Params decoder_params,
+                 std::vector<uint8_t>* webp) {
+    std::vector<uint8_t> gif_image;
+    ASSERT_TRUE(ReadTestFile(kGifTestDir, filename, "gif", &gif_image));
+    auto source = base::make_unique<io::BufReader>(
+        base::make_unique<io::BufferedSource>());
+    source->source()->AddChunk(
+        base::make_unique<io::Chunk>(&gif_image[0], gif_image.size()));
+    source->source()->SendEof();
+    auto gif_decoder =
+        base::make_unique<GifDecoder>(decoder_params, std::move(source));
+    auto result = gif_decoder->Decode();
+    ASSERT_TRUE(result.ok());
+    auto writer = base::make_unique<TestWriter>();
+    auto* writer_raw = writer.get();
+
+    WebPEncoder::Params params;
+    params.quality = 50;
+    auto testee = base::make_unique<WebPEncoder>(params, std::move(writer));
+
+    ASSERT_TRUE(testee->Initialize(&gif_decoder->GetImageInfo()).ok());
+    size_t frame_count = gif_decoder->GetFrameCount();
+    for (size_t i = 0; i < frame_count; ++i) {
+      ASSERT_TRUE(testee
+                      ->EncodeFrame(gif_decoder->GetFrameAtIndex(i),
+                                    frame_count == 1)
+                      .ok());
+    }
+
+    if (frame_count > 1) {
+      ASSERT_TRUE(testee->EncodeFrame(nullptr, true).ok());
+    }
+    ImageOptimizationStats stats;
+    ASSERT_TRUE(testee->FinishWrite(&stats).ok());
+    *webp = writer_raw->data();
+  }
+
   void ValidateEncoding(const std::string filename) {
     auto writer = base::make_unique<TestWriter>();
     auto* writer_raw = writer.get();
@@ -130,32 +168,33 @@ TEST_F(WebPEncoderTest, Success) {
 }
 
 TEST_F(WebPEncoderTest, EncodeMultiframe) {
-  std::vector<uint8_t> gif_image;
+  std::vector<uint8_t> webp;
+  EncodeGif("animated_interlaced", GifDecoder::Params::Default(), &webp);
+  EXPECT_FALSE(webp.empty());
+  LOG(INFO) << webp.size();
+}
+
+TEST_F(WebPEncoderTest, EncodePaletteFrames) {
+  auto palette_params = GifDecoder::Params::Default();
+  palette_params.allowed_color_schemes.insert(ColorScheme::kPalette);
+
+  // Animation frames are expanded into exactly the same ARGB canvas.
+  std::vector<uint8_t> rgb_webp;
+  std::vector<uint8_t> palette_webp;
+  EncodeGif("animated_interlaced", GifDecoder::Params::Default(), &rgb_webp);
+  EncodeGif("animated_interlaced", palette_params, &palette_webp);
+  EXPECT_FALSE(rgb_webp.empty());
+  EXPECT_EQ(rgb_webp, palette_webp);
+
+  // Single frame goes through a different import path, compare pixels.
+  EncodeGif("transparent", GifDecoder::Params::Default(), &rgb_webp);
+  EncodeGif("transparent", palette_params, &palette_webp);
+  ImageFrame rgb_frame;
+  ImageFrame palette_frame;
+  ASSERT_TRUE(ReadWebP(rgb_webp, 320, 320, ColorScheme::kRGBA, &rgb_frame));
   ASSERT_TRUE(
-      ReadTestFile(kGifTestDir, "animated_interlaced", "gif", &gif_image));
-  auto source =
-      base::make_unique<io::BufReader>(base::make_unique<io::BufferedSource>());
-  source->source()->AddChunk(
-      base::make_unique<io::Chunk>(&gif_image[0], gif_image.size()));
-  source->source()->SendEof();
-  auto gif_decoder = base::make_unique<GifDecoder>(
-      GifDecoder::Params::Default(), std::move(source));
-  auto result = gif_decoder->Decode();
-  ASSERT_TRUE(result.ok());
-  auto writer = base::make_unique<TestWriter>();
-  auto* writer_raw = writer.get();
-
-  WebPEncoder::Params params;
-  params.quality = 50;
-  auto testee = base::make_unique<WebPEncoder>(params, std::move(writer));
-
-  ASSERT_TRUE(testee->Initialize(&gif_decoder->GetImageInfo()).ok());
-  for (size_t i = 0; i < gif_decoder->GetFrameCount(); ++i)
-    ASSERT_TRUE(
-        testee->EncodeFrame(gif_decoder->GetFrameAtIndex(i), false).ok());
-
-  ASSERT_TRUE(testee->EncodeFrame(nullptr, true).ok());
-  LOG(INFO) << writer_raw->data().size();
+      ReadWebP(palette_webp, 320, 320, ColorScheme::kRGBA, &palette_frame));
+  CheckImageFrameByPSNR("transparent", &rgb_frame, &palette_frame, 45);
 }
 
 }  // namespace image
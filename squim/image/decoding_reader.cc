@@ -97,6 +97,11 @@ Result DecodingReader::GetFrameAtIndex(size_t index, ImageFrame** frame) {
   return Result::Ok();
 }
 
+void DecodingReader::ReleaseFrameAtIndex(size_t index) {
+  DCHECK_LT(index, num_frames_read_);
+  decoder_->ReleaseFrameAtIndex(index);
+}
+
 Result DecodingReader::ReadTillTheEnd() {
   while (!decoder_->IsImageComplete()) {
     auto result = AdvanceDecode(false);
@@ -98,6 +98,9 @@ TEST_F(DecodingReaderTest, ReadOneFrame) {
   EXPECT_TRUE(result.ok());
   EXPECT_EQ(&frame, out_frame);
   EXPECT_EQ(1, testee_->GetNumberOfFramesRead());
+
+  EXPECT_CALL(*decoder_, ReleaseFrameAtIndex(0));
+  testee_->ReleaseFrameAtIndex(0);
 }
 
 TEST_F(DecodingReaderTest, HasMoreFrames) {
@@ -30,6 +30,7 @@ namespace image {
 
 class ImageDecoder;
 class ImageEncoder;
+class ImageTranscoder;
 
 // Abstract codec factory interface.
 class ImageCodecFactory {
@@ -40,6 +41,9 @@ class ImageCodecFactory {
   virtual std::unique_ptr<ImageEncoder> CreateEncoder(
       ImageType type,
       std::unique_ptr<io::VectorWriter> writer) = 0;
+  virtual std::unique_ptr<ImageTranscoder> CreateTranscoder(
+      ImageType type,
+      std::unique_ptr<io::BufReader> reader) = 0;
 
   virtual ~ImageCodecFactory() {}
 };
@@ -30,6 +30,13 @@ size_t GetBytesPerPixel(ColorScheme scheme) {
       return 3;
     case ColorScheme::kRGBA:
       return 4;
+    // YUV frames are planar, the value is for the luma plane only.
+    case ColorScheme::kYUV:
+    case ColorScheme::kYUVA:
+      return 1;
+    // Palette frames store one byte index per pixel.
+    case ColorScheme::kPalette:
+      return 1;
     default:
       NOTREACHED();
       return 0;
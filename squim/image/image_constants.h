@@ -28,6 +28,7 @@ enum class ColorScheme {
   kRGBA,
   kYUV,
   kYUVA,
+  kPalette,
   kUnknown,
 };
 
@@ -50,6 +50,11 @@ class ImageDecoder {
   // to ensure it using IsFrameCompleteAtIndex().
   virtual ImageFrame* GetFrameAtIndex(size_t index) = 0;
 
+  // Frees pixel data of the complete frame at |index| once the client is done
+  // with it. Frame header stays available, but GetFrameAtIndex() must not be
+  // called for the frame anymore.
+  virtual void ReleaseFrameAtIndex(size_t index) = 0;
+
   // Returns number of frames *decoded so far*. 1 does not generally mean that
   // image is single frame, other may not be decoded yet
   virtual size_t GetFrameCount() const = 0;
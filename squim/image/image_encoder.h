@@ -33,6 +33,7 @@ class ImageEncoder {
   virtual Result Initialize(const ImageInfo* image_info) = 0;
 
   // Encodes single frame. |frame| can be null iff |last_frame| is true.
+  // Frames other than the last one must not be referenced after the call.
   virtual Result EncodeFrame(ImageFrame* frame, bool last_frame) = 0;
 
   // Sets metadata for the image. It can be empty at the beginning, but the
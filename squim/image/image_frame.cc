@@ -25,7 +25,34 @@ ImageFrame::~ImageFrame() {}
 void ImageFrame::Init() {
   DCHECK(!data_);
   DCHECK(color_scheme_ != ColorScheme::kUnknown);
-  data_.reset(new uint8_t[height_ * stride()]);
+  size_t size = height_ * stride();
+  if (is_yuv()) {
+    // 4:2:0 planar layout: Y plane, U and V planes subsampled by two in both
+    // dimensions, followed by the full resolution alpha plane (if any).
+    size_t uv_size = ((width_ + 1) >> 1) * ((height_ + 1) >> 1);
+    size += 2 * uv_size;
+    if (has_alpha())
+      size += height_ * width_;
+  }
+  data_.reset(new uint8_t[size]);
+}
+
+void ImageFrame::ReleasePixels() {
+  data_.reset();
+  palette_ = std::vector<PaletteEntry>();
+  palette_has_alpha_ = false;
+}
+
+void ImageFrame::set_palette(std::vector<PaletteEntry> palette) {
+  DCHECK_GE(256u, palette.size());
+  palette_ = std::move(palette);
+  palette_has_alpha_ = false;
+  for (const auto& entry : palette_) {
+    if (entry[3] != 0xFF) {
+      palette_has_alpha_ = true;
+      break;
+    }
+  }
 }
 
 }  // namespace image
@@ -17,8 +17,10 @@
 #ifndef SQUIM_IMAGE_IMAGE_FRAME_H_
 #define SQUIM_IMAGE_IMAGE_FRAME_H_
 
+#include <array>
 #include <memory>
 #include <cstdint>
+#include <vector>
 
 #include "squim/base/logging.h"
 #include "squim/base/make_noncopyable.h"
@@ -33,6 +35,9 @@ class ImageFrame {
   static const size_t kNoPreviousFrameIndex = 0xFFFFFFFF;
   static const uint32_t kUnknownQuality = 0xFFFFFFFF;
 
+  // Palette entry, RGBA.
+  using PaletteEntry = std::array<uint8_t, 4>;
+
   enum class Status {
     kEmpty,
     kHeaderComplete,
@@ -87,10 +92,15 @@ class ImageFrame {
   uint32_t quality() const { return quality_; }
   void set_quality(uint32_t quality) { quality_ = quality; }
 
+  // Pixels of kPalette frames are indices into this palette.
+  const std::vector<PaletteEntry>& palette() const { return palette_; }
+  void set_palette(std::vector<PaletteEntry> palette);
+
   bool has_alpha() const {
     return color_scheme_ == ColorScheme::kRGBA ||
            color_scheme_ == ColorScheme::kGrayScaleAlpha ||
-           color_scheme_ == ColorScheme::kYUVA;
+           color_scheme_ == ColorScheme::kYUVA ||
+           (color_scheme_ == ColorScheme::kPalette && palette_has_alpha_);
   }
 
   bool is_grayscale() const {
@@ -108,6 +118,8 @@ class ImageFrame {
            color_scheme_ == ColorScheme::kYUVA;
   }
 
+  bool is_palette() const { return color_scheme_ == ColorScheme::kPalette; }
+
   uint8_t* GetPixel(uint32_t x, uint32_t y) {
     return GetData(stride() * y + bpp() * x);
   }
@@ -119,6 +131,10 @@ class ImageFrame {
 
   void Init();
 
+  // Frees pixel data and palette. Everything else (geometry, timing, disposal)
+  // is kept, pixels must not be accessed anymore.
+  void ReleasePixels();
+
  private:
   Status status_ = Status::kEmpty;
   uint32_t width_ = 0;
@@ -131,6 +147,8 @@ class ImageFrame {
   DisposalMethod disposal_method_ = DisposalMethod::kNone;
   bool is_progressive_ = false;
   uint32_t quality_ = 100;
+  std::vector<PaletteEntry> palette_;
+  bool palette_has_alpha_ = false;
   std::unique_ptr<uint8_t[]> data_;
 };
 
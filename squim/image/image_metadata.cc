@@ -21,7 +21,8 @@
 namespace image {
 
 void ImageMetadata::Holder::AddChunk(io::ChunkPtr chunk) {
-  data_.push_back(std::move(chunk));
+  // Shared, so that encoders and caches get the data without copying.
+  data_.push_back(io::Chunk::Share(std::move(chunk)));
 }
 
 void ImageMetadata::Holder::Freeze() {
@@ -70,7 +71,7 @@ const io::ChunkList& ImageMetadata::Get(Type type) const {
 }
 
 bool ImageMetadata::Has(Type type) const {
-  return GetHolder(type).data().empty();
+  return !GetHolder(type).data().empty();
 }
 
 void ImageMetadata::Append(Type type, io::ChunkPtr data) {
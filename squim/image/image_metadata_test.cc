@@ -0,0 +1,54 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/image_metadata.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+TEST(ImageMetadataTest, ShouldBeEmptyByDefault) {
+  ImageMetadata metadata;
+  EXPECT_TRUE(metadata.Empty());
+  EXPECT_FALSE(metadata.Has(ImageMetadata::Type::kICC));
+  EXPECT_FALSE(metadata.Has(ImageMetadata::Type::kEXIF));
+  EXPECT_FALSE(metadata.Has(ImageMetadata::Type::kXMP));
+  EXPECT_FALSE(metadata.IsAllCompleted());
+}
+
+TEST(ImageMetadataTest, ShouldHaveAppendedType) {
+  ImageMetadata metadata;
+  metadata.Append(ImageMetadata::Type::kEXIF, io::Chunk::FromString("exif"));
+  EXPECT_FALSE(metadata.Empty());
+  EXPECT_TRUE(metadata.Has(ImageMetadata::Type::kEXIF));
+  EXPECT_FALSE(metadata.Has(ImageMetadata::Type::kICC));
+  EXPECT_FALSE(metadata.Has(ImageMetadata::Type::kXMP));
+  ASSERT_EQ(1u, metadata.Get(ImageMetadata::Type::kEXIF).size());
+  EXPECT_EQ(4u, metadata.Get(ImageMetadata::Type::kEXIF).front()->size());
+}
+
+TEST(ImageMetadataTest, ShouldCompleteFrozenTypes) {
+  ImageMetadata metadata;
+  metadata.Freeze(ImageMetadata::Type::kICC);
+  EXPECT_TRUE(metadata.IsCompleted(ImageMetadata::Type::kICC));
+  EXPECT_FALSE(metadata.IsCompleted(ImageMetadata::Type::kXMP));
+  EXPECT_FALSE(metadata.IsAllCompleted());
+  metadata.FreezeAll();
+  EXPECT_TRUE(metadata.IsAllCompleted());
+  EXPECT_TRUE(metadata.Empty());
+}
+
+}  // namespace image
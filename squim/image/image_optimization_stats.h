@@ -17,11 +17,17 @@
 #ifndef SQUIM_IMAGE_IMAGE_OPTIMIZATION_STATS_H_
 #define SQUIM_IMAGE_IMAGE_OPTIMIZATION_STATS_H_
 
+#include <cstddef>
+
 namespace image {
 
 struct ImageOptimizationStats {
   double psnr = 0;
   size_t coded_size = 0;
+  // Number of times processing was attempted and how many of them suspended
+  // waiting for more input.
+  size_t num_process_calls = 0;
+  size_t num_suspensions = 0;
 };
 
 }  // namespace image
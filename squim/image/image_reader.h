@@ -42,6 +42,11 @@ class ImageReader {
   // GetNumberOfFramesRead(). |frame| must not be null.
   virtual Result GetFrameAtIndex(size_t index, ImageFrame** frame) = 0;
 
+  // Lets the reader free pixels of the frame at |index| once the client is
+  // done with it. |index| must be smaller than GetNumberOfFramesRead(), the
+  // frame cannot be accessed after that.
+  virtual void ReleaseFrameAtIndex(size_t index) = 0;
+
   // Read all the image till the end. Can used to get the information after
   // frames data, e.g. webp exif/xmp metadata chunks are after frames.
   virtual Result ReadTillTheEnd() = 0;
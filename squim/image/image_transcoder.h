@@ -0,0 +1,68 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_IMAGE_TRANSCODER_H_
+#define SQUIM_IMAGE_IMAGE_TRANSCODER_H_
+
+#include "squim/image/image_constants.h"
+#include "squim/image/result.h"
+
+namespace io {
+class VectorWriter;
+}
+
+namespace image {
+
+struct ImageInfo;
+class ImageMetadata;
+struct ImageOptimizationStats;
+
+// Transcoder interface. Transcoder rewrites the image into the same format
+// without full pixel decode, e.g. by re-encoding entropy coded data only.
+class ImageTranscoder {
+ public:
+  // Should try to read only basic image info (usually from image header).
+  virtual Result ReadImageInfo() = 0;
+
+  // Should return true if image header has been parsed.
+  virtual bool IsImageInfoComplete() const = 0;
+
+  // Returns ImageInfo info for image being transcoded. Returned structure is
+  // valid iff IsImageInfoComplete() return true.
+  virtual const ImageInfo& GetImageInfo() const = 0;
+
+  // Returns image metadata. It's complete only after IsReadComplete().
+  virtual ImageMetadata* GetMetadata() = 0;
+
+  // Should read more if data available. Returns pending result if more data
+  // is needed.
+  virtual Result Read() = 0;
+
+  // Should return true if the whole input has been read and the image can be
+  // written.
+  virtual bool IsReadComplete() const = 0;
+
+  // Writes transcoded image to |dest|. Must be called only once, after
+  // IsReadComplete() returns true. |stats| can be null.
+  virtual Result Write(io::VectorWriter* dest,
+                       ImageOptimizationStats* stats) = 0;
+
+  virtual ~ImageTranscoder() {}
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_IMAGE_TRANSCODER_H_
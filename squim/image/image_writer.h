@@ -33,6 +33,11 @@ class ImageWriter {
   virtual Result WriteFrame(ImageFrame* frame) = 0;
   virtual Result FinishWrite(ImageOptimizationStats* stats) = 0;
 
+  // Returns how many of the frames passed to WriteFrame() the writer won't
+  // access anymore, so that the caller may release them. Frames are consumed
+  // in the order they were written.
+  virtual size_t GetNumberOfFramesConsumed() const = 0;
+
   virtual ~ImageWriter() {}
 };
 
@@ -34,7 +34,10 @@ void MultiFrameWriter::SetMetadata(const ImageMetadata* metadata) {
 }
 
 Result MultiFrameWriter::WriteFrame(ImageFrame* frame) {
-  return encoder_->EncodeFrame(frame, false);
+  auto result = encoder_->EncodeFrame(frame, false);
+  if (result.ok())
+    frames_consumed_++;
+  return result;
 }
 
 Result MultiFrameWriter::FinishWrite(ImageOptimizationStats* stats) {
@@ -49,4 +52,8 @@ Result MultiFrameWriter::FinishWrite(ImageOptimizationStats* stats) {
   return encoder_->FinishWrite(stats);
 }
 
+size_t MultiFrameWriter::GetNumberOfFramesConsumed() const {
+  return frames_consumed_;
+}
+
 }  // namespace image
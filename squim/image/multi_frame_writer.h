@@ -37,9 +37,13 @@ class MultiFrameWriter : public ImageWriter {
   void SetMetadata(const ImageMetadata* metadata) override;
   Result WriteFrame(ImageFrame* frame) override;
   Result FinishWrite(ImageOptimizationStats* stats) override;
+  size_t GetNumberOfFramesConsumed() const override;
 
  private:
   std::unique_ptr<ImageEncoder> encoder_;
+  // Non-last frames are encoded right away, so every successfully written
+  // frame is consumed.
+  size_t frames_consumed_ = 0;
 };
 
 }  // namespace image
@@ -38,8 +38,20 @@ WebPDecoder::Params CodecConfigurator::GetWebPDecoderParams() {
   return WebPDecoder::Params::Default();
 }
 
+GifEncoder::Params CodecConfigurator::GetGifEncoderParams() {
+  return GifEncoder::Params::Default();
+}
+
+PngEncoder::Params CodecConfigurator::GetPngEncoderParams() {
+  return PngEncoder::Params::Default();
+}
+
 WebPEncoder::Params CodecConfigurator::GetWebPEncoderParams() {
   return WebPEncoder::Params::Default();
 }
 
+JpegTranscoder::Params CodecConfigurator::GetJpegTranscoderParams() {
+  return JpegTranscoder::Params::Default();
+}
+
 }  // namespace image
@@ -18,8 +18,11 @@
 #define SQUIM_IMAGE_OPTIMIZATION_CODEC_CONFIGURATOR_H_
 
 #include "squim/image/codecs/gif_decoder.h"
+#include "squim/image/codecs/gif_encoder.h"
 #include "squim/image/codecs/jpeg_decoder.h"
+#include "squim/image/codecs/jpeg_transcoder.h"
 #include "squim/image/codecs/png_decoder.h"
+#include "squim/image/codecs/png_encoder.h"
 #include "squim/image/codecs/webp_decoder.h"
 #include "squim/image/codecs/webp_encoder.h"
 
@@ -35,7 +38,11 @@ class CodecConfigurator {
   virtual PngDecoder::Params GetPngDecoderParams();
   virtual WebPDecoder::Params GetWebPDecoderParams();
 
+  virtual GifEncoder::Params GetGifEncoderParams();
+  virtual PngEncoder::Params GetPngEncoderParams();
   virtual WebPEncoder::Params GetWebPEncoderParams();
+
+  virtual JpegTranscoder::Params GetJpegTranscoderParams();
 };
 
 }  // namespace image
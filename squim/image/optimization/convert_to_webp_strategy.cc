@@ -17,9 +17,11 @@
 #include "squim/image/optimization/convert_to_webp_strategy.h"
 
 #include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
 #include "squim/image/decoding_reader.h"
 #include "squim/image/image_codec_factory.h"
 #include "squim/image/optimization/lazy_webp_writer.h"
+#include "squim/image/optimization/size_limited_writer.h"
 #include "squim/io/buf_reader.h"
 #include "squim/io/writer.h"
 
@@ -27,6 +29,9 @@ namespace image {
 
 namespace {
 
+// GIF frames waiting for or being encoded while the next ones are decoded.
+const size_t kMaxQueuedGifFrames = 4;
+
 template <typename Params>
 void AddSupportedColorSchemes(Params* params) {
   DCHECK(params);
@@ -35,7 +40,16 @@ void AddSupportedColorSchemes(Params* params) {
 }
 }
 
-ConvertToWebPStrategy::ConvertToWebPStrategy() {}
+constexpr double ConvertToWebPStrategy::kDefaultMinRecompressionGain;
+
+ConvertToWebPStrategy::ConvertToWebPStrategy()
+    : ConvertToWebPStrategy(kDefaultMinRecompressionGain) {}
+
+ConvertToWebPStrategy::ConvertToWebPStrategy(double min_recompression_gain)
+    : min_recompression_gain_(min_recompression_gain) {
+  DCHECK_LE(0.0, min_recompression_gain_);
+  DCHECK_GT(1.0, min_recompression_gain_);
+}
 
 ConvertToWebPStrategy::~ConvertToWebPStrategy() {}
 
@@ -65,14 +79,38 @@ Result ConvertToWebPStrategy::CreateImageWriter(
   auto result = reader->GetImageInfo(&image_info);
   DCHECK(result.ok());
   if (image_info->type == ImageType::kWebP)
-    return Result::Error(Result::Code::kDunnoHowToEncode,
-                         "WebP is not supported yet");
+    return CreateWebPRecompressingWriter(std::move(dest), image_info, writer);
 
   if (image_info->type == ImageType::kGif)
     allow_mixed_ = true;
 
+  writer->reset(new LazyWebPWriter(std::move(dest), codec_factory_, image_info,
+                                   kMaxQueuedGifFrames));
+  return Result::Ok();
+}
+
+Result ConvertToWebPStrategy::CreateWebPRecompressingWriter(
+    std::unique_ptr<io::VectorWriter> dest,
+    const ImageInfo* image_info,
+    std::unique_ptr<ImageWriter>* writer) {
+  if (image_info->multiframe)
+    return Result::Error(Result::Code::kDunnoHowToEncode,
+                         "Animated WebP is not supported yet");
+
+  if (image_info->size == 0)
+    return Result::Error(Result::Code::kDunnoHowToEncode,
+                         "Unknown WebP size");
+
+  auto max_size = static_cast<uint64_t>(image_info->size *
+                                        (1.0 - min_recompression_gain_));
+  auto* codec_factory = codec_factory_;
+  auto inner_builder = [codec_factory, image_info](
+      std::unique_ptr<io::VectorWriter> buffer) {
+    return base::make_unique<LazyWebPWriter>(std::move(buffer), codec_factory,
+                                             image_info);
+  };
   writer->reset(
-      new LazyWebPWriter(std::move(dest), codec_factory_, image_info));
+      new SizeLimitedWriter(std::move(dest), max_size, inner_builder));
   return Result::Ok();
 }
 
@@ -88,6 +126,10 @@ bool ConvertToWebPStrategy::ShouldWaitForMetadata() {
 GifDecoder::Params ConvertToWebPStrategy::GetGifDecoderParams() {
   GifDecoder::Params params;
   AddSupportedColorSchemes(&params);
+  // Both WebP encoders expand palette frames right into their ARGB buffers.
+  params.allowed_color_schemes.insert(ColorScheme::kPalette);
+  // Frames that are already buffered are decoded on the shared thread pool.
+  params.max_decode_threads = 0;
   return params;
 }
 
@@ -23,12 +23,20 @@
 namespace image {
 
 class ImageCodecFactory;
+struct ImageInfo;
 
 class ConvertToWebPStrategy : public CodecAwareStrategy {
   MAKE_NONCOPYABLE(ConvertToWebPStrategy);
 
  public:
+  // Re-encoding a WebP is lossy, so the result is only worth it if it is
+  // noticeably smaller than the original.
+  static constexpr double kDefaultMinRecompressionGain = 0.05;
+
   ConvertToWebPStrategy();
+  // |min_recompression_gain| is the minimal relative size reduction required
+  // to emit an image re-encoded from WebP into WebP.
+  explicit ConvertToWebPStrategy(double min_recompression_gain);
   ~ConvertToWebPStrategy() override;
 
   // CodecAwareStrategy implementation:
@@ -50,10 +58,17 @@ class ConvertToWebPStrategy : public CodecAwareStrategy {
   void SetCodecFactory(ImageCodecFactory* factory) override;
 
  private:
+  // WebP input is re-encoded only if the result beats the original size.
+  Result CreateWebPRecompressingWriter(std::unique_ptr<io::VectorWriter> dest,
+                                       const ImageInfo* image_info,
+                                       std::unique_ptr<ImageWriter>* writer);
+
   ImageCodecFactory* codec_factory_ = nullptr;
 
   // Allow mixed lossy/lossless compression for multiframe images.
   bool allow_mixed_ = false;
+
+  double min_recompression_gain_;
 };
 
 }  // namespace image
@@ -19,6 +19,7 @@
 #include "squim/base/memory/make_unique.h"
 #include "squim/image/image_codec_factory.h"
 #include "squim/image/image_reader.h"
+#include "squim/image/image_transcoder.h"
 #include "squim/image/image_writer.h"
 #include "squim/image/test/mock_decoder.h"
 #include "squim/image/test/mock_encoder.h"
@@ -51,8 +52,17 @@ class MockCodecFactory : public ImageCodecFactory {
     return std::unique_ptr<ImageEncoder>(CreateEncoderImpl(type, writer.get()));
   }
 
+  std::unique_ptr<ImageTranscoder> CreateTranscoder(
+      ImageType type,
+      std::unique_ptr<io::BufReader> reader) override {
+    return std::unique_ptr<ImageTranscoder>(
+        CreateTranscoderImpl(type, reader.get()));
+  }
+
   MOCK_METHOD2(CreateDecoderImpl, ImageDecoder*(ImageType, io::BufReader*));
   MOCK_METHOD2(CreateEncoderImpl, ImageEncoder*(ImageType, io::VectorWriter*));
+  MOCK_METHOD2(CreateTranscoderImpl,
+               ImageTranscoder*(ImageType, io::BufReader*));
 };
 
 MockDecoder* CreateDecoder(ImageType type, io::BufReader* reader) {
@@ -109,7 +119,34 @@ TEST_F(ConvertToWebPStrategyTest, ShouldCreateDecoder) {
   EXPECT_TRUE(result.ok());
 }
 
-TEST_F(ConvertToWebPStrategyTest, ShouldReturnErrorIfWebP) {
+TEST_F(ConvertToWebPStrategyTest, ShouldCreateWriterForWebP) {
+  auto dest = base::make_unique<io::DevNull>();
+  MockImageReader reader;
+  std::unique_ptr<ImageWriter> writer;
+  EXPECT_CALL(reader, GetImageInfo(_))
+      .WillRepeatedly(Invoke(&reader, &MockImageReader::GetFakeImageInfo));
+
+  reader.image_info.type = ImageType::kWebP;
+  reader.image_info.size = 1000;
+  auto result = testee_->CreateImageWriter(std::move(dest), &reader, &writer);
+  EXPECT_TRUE(writer);
+  EXPECT_TRUE(result.ok());
+}
+
+TEST_F(ConvertToWebPStrategyTest, ShouldReturnErrorIfWebPSizeUnknown) {
+  auto dest = base::make_unique<io::DevNull>();
+  MockImageReader reader;
+  std::unique_ptr<ImageWriter> writer;
+  EXPECT_CALL(reader, GetImageInfo(_))
+      .WillRepeatedly(Invoke(&reader, &MockImageReader::GetFakeImageInfo));
+
+  reader.image_info.type = ImageType::kWebP;
+  auto result = testee_->CreateImageWriter(std::move(dest), &reader, &writer);
+  EXPECT_FALSE(writer);
+  EXPECT_EQ(Result::Code::kDunnoHowToEncode, result.code());
+}
+
+TEST_F(ConvertToWebPStrategyTest, ShouldReturnErrorIfAnimatedWebP) {
   auto dest = base::make_unique<io::DevNull>();
   MockImageReader reader;
   std::unique_ptr<ImageWriter> writer;
@@ -117,6 +154,8 @@ TEST_F(ConvertToWebPStrategyTest, ShouldReturnErrorIfWebP) {
       .WillRepeatedly(Invoke(&reader, &MockImageReader::GetFakeImageInfo));
 
   reader.image_info.type = ImageType::kWebP;
+  reader.image_info.size = 1000;
+  reader.image_info.multiframe = true;
   auto result = testee_->CreateImageWriter(std::move(dest), &reader, &writer);
   EXPECT_FALSE(writer);
   EXPECT_EQ(Result::Code::kDunnoHowToEncode, result.code());
@@ -135,7 +174,7 @@ TEST_F(ConvertToWebPStrategyTest, ShouldCreateWriter) {
 }
 
 TEST_F(ConvertToWebPStrategyTest, CodecConfigurations) {
-  // Only RGB(A) is allowed.
+  // Only RGB(A) is allowed, plus palette frames for GIF.
 
   auto gif_params = testee_->GetGifDecoderParams();
   EXPECT_TRUE(gif_params.color_scheme_allowed(ColorScheme::kRGB));
@@ -144,6 +183,8 @@ TEST_F(ConvertToWebPStrategyTest, CodecConfigurations) {
   EXPECT_FALSE(gif_params.color_scheme_allowed(ColorScheme::kGrayScaleAlpha));
   EXPECT_FALSE(gif_params.color_scheme_allowed(ColorScheme::kYUV));
   EXPECT_FALSE(gif_params.color_scheme_allowed(ColorScheme::kYUVA));
+  EXPECT_TRUE(gif_params.color_scheme_allowed(ColorScheme::kPalette));
+  EXPECT_EQ(0, gif_params.max_decode_threads);
 
   auto jpeg_params = testee_->GetJpegDecoderParams();
   EXPECT_TRUE(jpeg_params.color_scheme_allowed(ColorScheme::kRGB));
@@ -152,6 +193,7 @@ TEST_F(ConvertToWebPStrategyTest, CodecConfigurations) {
   EXPECT_FALSE(jpeg_params.color_scheme_allowed(ColorScheme::kGrayScaleAlpha));
   EXPECT_FALSE(jpeg_params.color_scheme_allowed(ColorScheme::kYUV));
   EXPECT_FALSE(jpeg_params.color_scheme_allowed(ColorScheme::kYUVA));
+  EXPECT_FALSE(jpeg_params.color_scheme_allowed(ColorScheme::kPalette));
 
   auto png_params = testee_->GetPngDecoderParams();
   EXPECT_TRUE(png_params.color_scheme_allowed(ColorScheme::kRGB));
@@ -160,6 +202,7 @@ TEST_F(ConvertToWebPStrategyTest, CodecConfigurations) {
   EXPECT_FALSE(png_params.color_scheme_allowed(ColorScheme::kGrayScaleAlpha));
   EXPECT_FALSE(png_params.color_scheme_allowed(ColorScheme::kYUV));
   EXPECT_FALSE(png_params.color_scheme_allowed(ColorScheme::kYUVA));
+  EXPECT_FALSE(png_params.color_scheme_allowed(ColorScheme::kPalette));
 }
 
 }  // namespace image
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/decode_trigger.h"
+
+#include <algorithm>
+
+namespace image {
+
+namespace {
+
+size_t ChooseStep(uint64_t content_length, size_t min_step) {
+  if (content_length == 0)
+    return min_step;
+  auto step = content_length / DecodeTrigger::kStepsPerInput;
+  return std::max<uint64_t>(
+      min_step, std::min<uint64_t>(step, DecodeTrigger::kMaxStep));
+}
+
+}  // namespace
+
+const size_t DecodeTrigger::kDefaultMinStep;
+const size_t DecodeTrigger::kMaxStep;
+const size_t DecodeTrigger::kStepsPerInput;
+
+DecodeTrigger::DecodeTrigger(uint64_t content_length, size_t min_step)
+    : content_length_(content_length),
+      step_(ChooseStep(content_length, min_step)),
+      next_attempt_at_(0) {}
+
+bool DecodeTrigger::AddInput(size_t size) {
+  received_ += size;
+  if (content_length_ > 0 && received_ >= content_length_)
+    return true;
+
+  if (received_ < next_attempt_at_)
+    return false;
+
+  next_attempt_at_ = received_ + step_;
+  return true;
+}
+
+}  // namespace image
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_OPTIMIZATION_DECODE_TRIGGER_H_
+#define SQUIM_IMAGE_OPTIMIZATION_DECODE_TRIGGER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "squim/base/make_noncopyable.h"
+
+namespace image {
+
+// Decides when the input received so far is worth a decoding attempt.
+//
+// Decoders suspend when they run out of data, and the next attempt redoes
+// some of the work, e.g. libjpeg restarts the marker or the row of MCUs it was
+// in the middle of. Attempting after every small network chunk repeats that
+// over and over, so attempts are made only after a step of new data. The step
+// is a fraction of the content length when it's known. An attempt is always
+// made on the first data, so that unsupported input is rejected early, and
+// once all of the content is received.
+class DecodeTrigger {
+  MAKE_NONCOPYABLE(DecodeTrigger);
+
+ public:
+  static const size_t kDefaultMinStep = 16 * 1024;
+  static const size_t kMaxStep = 1024 * 1024;
+  // Number of attempts to spread an input of known length over.
+  static const size_t kStepsPerInput = 16;
+
+  // |content_length| is the expected size of the input, 0 if unknown.
+  explicit DecodeTrigger(uint64_t content_length,
+                         size_t min_step = kDefaultMinStep);
+
+  // Records |size| more bytes received. Returns true if decoding should be
+  // attempted now.
+  bool AddInput(size_t size);
+
+  uint64_t received() const { return received_; }
+  size_t step() const { return step_; }
+
+ private:
+  const uint64_t content_length_;
+  const size_t step_;
+  uint64_t received_ = 0;
+  uint64_t next_attempt_at_;
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_OPTIMIZATION_DECODE_TRIGGER_H_
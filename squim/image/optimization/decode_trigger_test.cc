@@ -0,0 +1,122 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/decode_trigger.h"
+
+#include <memory>
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/jpeg_decoder.h"
+#include "squim/image/test/image_test_util.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/buffered_source.h"
+#include "squim/io/chunk.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+const char kJpegTestDir[] = "jpeg";
+
+const char* kJpegImages[] = {
+    "test411", "test420", "test422", "test444", "progressive",
+};
+
+// Feeds |data| to a JPEG decoder in chunks of |sizes|. Decoding is attempted
+// when |trigger| allows it, or after every chunk if there's no |trigger|.
+// Returns the number of attempts which suspended.
+size_t DecodeInChunks(const std::vector<uint8_t>& data,
+                      const std::vector<size_t>& sizes,
+                      DecodeTrigger* trigger) {
+  auto reader =
+      base::make_unique<io::BufReader>(base::make_unique<io::BufferedSource>());
+  auto* source = reader->source();
+  JpegDecoder decoder(JpegDecoder::Params::Default(), std::move(reader));
+
+  size_t offset = 0;
+  size_t num_suspensions = 0;
+  for (auto size : sizes) {
+    source->AddChunk(base::make_unique<io::Chunk>(&data[offset], size));
+    offset += size;
+    if (offset == data.size())
+      source->SendEof();
+    if (trigger && !trigger->AddInput(size))
+      continue;
+
+    auto result = decoder.Decode();
+    if (result.pending()) {
+      ++num_suspensions;
+    } else {
+      EXPECT_TRUE(result.ok());
+    }
+  }
+  EXPECT_TRUE(decoder.IsImageComplete());
+  return num_suspensions;
+}
+
+}  // namespace
+
+TEST(DecodeTriggerTest, UnknownLength) {
+  DecodeTrigger testee(0, 100);
+  EXPECT_EQ(100u, testee.step());
+  EXPECT_TRUE(testee.AddInput(10));
+  EXPECT_FALSE(testee.AddInput(60));
+  EXPECT_TRUE(testee.AddInput(60));
+  // The next step is counted from the last attempt.
+  EXPECT_FALSE(testee.AddInput(99));
+  EXPECT_TRUE(testee.AddInput(1));
+  EXPECT_TRUE(testee.AddInput(100));
+  EXPECT_EQ(330u, testee.received());
+}
+
+TEST(DecodeTriggerTest, KnownLength) {
+  DecodeTrigger testee(DecodeTrigger::kStepsPerInput * 1000, 100);
+  EXPECT_EQ(1000u, testee.step());
+
+  DecodeTrigger small(1000, 100);
+  EXPECT_EQ(100u, small.step());
+  EXPECT_TRUE(small.AddInput(1));
+  EXPECT_FALSE(small.AddInput(99));
+  EXPECT_TRUE(small.AddInput(1));
+  EXPECT_FALSE(small.AddInput(50));
+  // The end of input triggers an attempt regardless of the step.
+  EXPECT_TRUE(small.AddInput(850));
+  EXPECT_TRUE(small.AddInput(10));
+
+  DecodeTrigger large(1ull << 40, 100);
+  EXPECT_EQ(DecodeTrigger::kMaxStep, large.step());
+}
+
+TEST(DecodeTriggerTest, FewerSuspensionsOnFuzzyReads) {
+  for (auto pic : kJpegImages) {
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadTestFile(kJpegTestDir, pic, "jpg", &data));
+    std::vector<size_t> sizes;
+    for (const auto& group : GenerateFuzzyReads(data.size(), 64))
+      sizes.insert(sizes.end(), group.begin(), group.end());
+
+    auto every_chunk = DecodeInChunks(data, sizes, nullptr);
+    DecodeTrigger trigger(data.size(), 512);
+    auto triggered = DecodeInChunks(data, sizes, &trigger);
+    EXPECT_GE(DecodeTrigger::kStepsPerInput + 1, triggered) << pic;
+    EXPECT_LT(triggered * 4, every_chunk) << pic;
+  }
+}
+
+}  // namespace image
@@ -61,6 +61,12 @@ std::unique_ptr<ImageEncoder> DefaultCodecFactory::CreateEncoder(
     ImageType type,
     std::unique_ptr<io::VectorWriter> writer) {
   switch (type) {
+    case ImageType::kGif:
+      return base::make_unique<GifEncoder>(
+          configurator()->GetGifEncoderParams(), std::move(writer));
+    case ImageType::kPng:
+      return base::make_unique<PngEncoder>(
+          configurator()->GetPngEncoderParams(), std::move(writer));
     case ImageType::kWebP:
       return base::make_unique<WebPEncoder>(
           configurator()->GetWebPEncoderParams(), std::move(writer));
@@ -70,4 +76,17 @@ std::unique_ptr<ImageEncoder> DefaultCodecFactory::CreateEncoder(
   }
 }
 
+std::unique_ptr<ImageTranscoder> DefaultCodecFactory::CreateTranscoder(
+    ImageType type,
+    std::unique_ptr<io::BufReader> reader) {
+  switch (type) {
+    case ImageType::kJpeg:
+      return base::make_unique<JpegTranscoder>(
+          configurator()->GetJpegTranscoderParams(), std::move(reader));
+    default:
+      NOTREACHED();
+      return std::unique_ptr<ImageTranscoder>();
+  }
+}
+
 }  // namespace image
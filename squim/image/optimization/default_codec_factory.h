@@ -35,6 +35,9 @@ class DefaultCodecFactory : public CodecFactoryWithConfigurator {
   std::unique_ptr<ImageEncoder> CreateEncoder(
       ImageType type,
       std::unique_ptr<io::VectorWriter> writer) override;
+  std::unique_ptr<ImageTranscoder> CreateTranscoder(
+      ImageType type,
+      std::unique_ptr<io::BufReader> reader) override;
 };
 
 }  // namespace image
@@ -121,7 +121,14 @@ ImageOptimizer::ImageOptimizer(ImageTypeSelector input_type_selector,
 ImageOptimizer::~ImageOptimizer() {}
 
 Result ImageOptimizer::Process() {
-  return DoLoop(Result::Ok());
+  if (state_ == State::kNone)
+    return last_result_;
+
+  auto result = DoLoop(Result::Ok());
+  ++stats_.num_process_calls;
+  if (result.pending())
+    ++stats_.num_suspensions;
+  return result;
 }
 
 bool ImageOptimizer::Finished() const {
@@ -280,7 +287,10 @@ Result ImageOptimizer::DoWriteFrame() {
 
   CHECK(current_frame_);
   state_ = State::kReadFrame;
-  return writer_->WriteFrame(current_frame_);
+  auto result = writer_->WriteFrame(current_frame_);
+  if (result.ok())
+    ReleaseConsumedFrames();
+  return result;
 }
 
 Result ImageOptimizer::DoDrain() {
@@ -303,6 +313,14 @@ Result ImageOptimizer::DoComplete() {
   return Result::Finish(Result::Code::kOk);
 }
 
+void ImageOptimizer::ReleaseConsumedFrames() {
+  // Nothing reads frames after they are written, and keeping all of them
+  // makes memory usage grow with the length of an animation.
+  auto num_frames_consumed = writer_->GetNumberOfFramesConsumed();
+  while (num_frames_released_ < num_frames_consumed)
+    reader_->ReleaseFrameAtIndex(num_frames_released_++);
+}
+
 std::ostream& operator<<(std::ostream& os, ImageOptimizer::State state) {
   os << ImageOptimizer::StateToString(state);
   return os;
@@ -89,6 +89,9 @@ class ImageOptimizer {
   Result DoFinish();
   Result DoComplete();
 
+  // Lets the reader free frames the writer is done with.
+  void ReleaseConsumedFrames();
+
   friend std::ostream& operator<<(std::ostream& os,
                                   ImageOptimizer::State state);
   static const char* StateToString(State state);
@@ -102,6 +105,7 @@ class ImageOptimizer {
   std::unique_ptr<io::BufReader> source_;
   std::unique_ptr<io::VectorWriter> dest_;
   ImageFrame* current_frame_ = nullptr;
+  size_t num_frames_released_ = 0;
   Result last_result_ = Result::Ok();
   ImageOptimizationStats stats_;
 };
@@ -77,6 +77,7 @@ class MockWriter : public ImageWriter {
   MOCK_METHOD1(SetMetadata, void(const ImageMetadata*));
   MOCK_METHOD1(WriteFrame, Result(ImageFrame*));
   MOCK_METHOD1(FinishWrite, Result(ImageOptimizationStats*));
+  MOCK_CONST_METHOD0(GetNumberOfFramesConsumed, size_t());
 };
 
 Result TestImageTypeSelector(io::BufReader* reader, ImageType* image_type) {
@@ -221,6 +222,10 @@ class ImageOptimizerTest : public testing::Test {
           if (current_stage < int_stage) {
             EXPECT_CALL(*image_writer_, WriteFrame(_))
                 .WillOnce(Return(Result::Ok()));
+            // The frame is consumed and released right away.
+            EXPECT_CALL(*image_writer_, GetNumberOfFramesConsumed())
+                .WillOnce(Return(1));
+            EXPECT_CALL(*image_reader_, ReleaseFrameAtIndex(0));
           } else if (code == Result::Code::kPending) {
             EXPECT_CALL(*image_writer_, WriteFrame(_))
                 .WillOnce(Return(Result::Pending()));
@@ -373,6 +378,15 @@ TEST_F(ImageOptimizerTest, ShouldPendOnImageInfo) {
   RunTestCaseUntil(Stage::kReadImageInfo, Result::Code::kPending);
 }
 
+TEST_F(ImageOptimizerTest, ShouldCountSuspensions) {
+  auto data = std::vector<std::string>({std::string("test")});
+  testee_ = CreateOptimizerWithData(data, false);
+  RunTestCaseUntil(Stage::kReadSignature, Result::Code::kPending);
+  EXPECT_TRUE(testee_->Process().pending());
+  EXPECT_EQ(2u, testee_->stats().num_process_calls);
+  EXPECT_EQ(2u, testee_->stats().num_suspensions);
+}
+
 TEST_F(ImageOptimizerTest, ShouldReturnErrorIfWriterCreationFailed) {
   testee_ = CreateOptimizer();
   RunTestCaseUntil(Stage::kCreateWriter, Result::Code::kDunnoHowToEncode);
@@ -55,9 +55,18 @@ void LayeredAdjuster::Layer::AdjustPngDecoderParams(
 void LayeredAdjuster::Layer::AdjustWebPDecoderParams(
     WebPDecoder::Params* params) {}
 
+void LayeredAdjuster::Layer::AdjustGifEncoderParams(
+    GifEncoder::Params* params) {}
+
+void LayeredAdjuster::Layer::AdjustPngEncoderParams(
+    PngEncoder::Params* params) {}
+
 void LayeredAdjuster::Layer::AdjustWebPEncoderParams(
     WebPEncoder::Params* params) {}
 
+void LayeredAdjuster::Layer::AdjustJpegTranscoderParams(
+    JpegTranscoder::Params* params) {}
+
 LayeredAdjuster::LayeredAdjuster(std::unique_ptr<Layer> impl,
                                  std::unique_ptr<LayeredAdjuster> next)
     : impl_(std::move(impl)), next_(std::move(next)) {}
@@ -126,10 +135,29 @@ void LayeredAdjuster::AdjustWebPDecoderParams(WebPDecoder::Params* params) {
     next_->AdjustWebPDecoderParams(params);
 }
 
+void LayeredAdjuster::AdjustGifEncoderParams(GifEncoder::Params* params) {
+  impl_->AdjustGifEncoderParams(params);
+  if (next_)
+    next_->AdjustGifEncoderParams(params);
+}
+
+void LayeredAdjuster::AdjustPngEncoderParams(PngEncoder::Params* params) {
+  impl_->AdjustPngEncoderParams(params);
+  if (next_)
+    next_->AdjustPngEncoderParams(params);
+}
+
 void LayeredAdjuster::AdjustWebPEncoderParams(WebPEncoder::Params* params) {
   impl_->AdjustWebPEncoderParams(params);
   if (next_)
     next_->AdjustWebPEncoderParams(params);
 }
 
+void LayeredAdjuster::AdjustJpegTranscoderParams(
+    JpegTranscoder::Params* params) {
+  impl_->AdjustJpegTranscoderParams(params);
+  if (next_)
+    next_->AdjustJpegTranscoderParams(params);
+}
+
 }  // namespace image
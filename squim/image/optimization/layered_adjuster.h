@@ -39,7 +39,10 @@ class LayeredAdjuster : public RootStrategy::Adjuster {
     void AdjustJpegDecoderParams(JpegDecoder::Params* params) override;
     void AdjustPngDecoderParams(PngDecoder::Params* params) override;
     void AdjustWebPDecoderParams(WebPDecoder::Params* params) override;
+    void AdjustGifEncoderParams(GifEncoder::Params* params) override;
+    void AdjustPngEncoderParams(PngEncoder::Params* params) override;
     void AdjustWebPEncoderParams(WebPEncoder::Params* params) override;
+    void AdjustJpegTranscoderParams(JpegTranscoder::Params* params) override;
   };
 
   LayeredAdjuster(std::unique_ptr<Layer> impl,
@@ -58,7 +61,10 @@ class LayeredAdjuster : public RootStrategy::Adjuster {
   void AdjustJpegDecoderParams(JpegDecoder::Params* params) override;
   void AdjustPngDecoderParams(PngDecoder::Params* params) override;
   void AdjustWebPDecoderParams(WebPDecoder::Params* params) override;
+  void AdjustGifEncoderParams(GifEncoder::Params* params) override;
+  void AdjustPngEncoderParams(PngEncoder::Params* params) override;
   void AdjustWebPEncoderParams(WebPEncoder::Params* params) override;
+  void AdjustJpegTranscoderParams(JpegTranscoder::Params* params) override;
 
  private:
   std::unique_ptr<Layer> impl_;
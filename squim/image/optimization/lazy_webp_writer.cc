@@ -17,10 +17,13 @@
 #include "squim/image/optimization/lazy_webp_writer.h"
 
 #include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
 #include "squim/image/image_codec_factory.h"
 #include "squim/image/image_encoder.h"
+#include "squim/image/image_frame.h"
 #include "squim/image/image_info.h"
 #include "squim/image/multi_frame_writer.h"
+#include "squim/image/pipelined_writer.h"
 #include "squim/image/single_frame_writer.h"
 #include "squim/io/writer.h"
 
@@ -29,9 +32,16 @@ namespace image {
 LazyWebPWriter::LazyWebPWriter(std::unique_ptr<io::VectorWriter> dest,
                                ImageCodecFactory* codec_factory,
                                const ImageInfo* image_info)
+    : LazyWebPWriter(std::move(dest), codec_factory, image_info, 0) {}
+
+LazyWebPWriter::LazyWebPWriter(std::unique_ptr<io::VectorWriter> dest,
+                               ImageCodecFactory* codec_factory,
+                               const ImageInfo* image_info,
+                               size_t max_queued_frames)
     : dest_(std::move(dest)),
       codec_factory_(codec_factory),
-      image_info_(image_info) {}
+      image_info_(image_info),
+      max_queued_frames_(max_queued_frames) {}
 
 Result LazyWebPWriter::Initialize(const ImageInfo* image_info) {
   DCHECK_EQ(image_info, image_info_);
@@ -43,35 +53,78 @@ void LazyWebPWriter::SetMetadata(const ImageMetadata* metadata) {
 }
 
 Result LazyWebPWriter::WriteFrame(ImageFrame* frame) {
+  if (!inner_ && !held_frame_ && image_info_->type == ImageType::kGif) {
+    held_frame_ = frame;
+    return Result::Ok();
+  }
+
   if (!inner_) {
-    auto encoder =
-        codec_factory_->CreateEncoder(ImageType::kWebP, std::move(dest_));
-    if (!encoder)
-      return Result::Error(Result::Code::kDunnoHowToEncode);
-
-    if (image_info_->type == ImageType::kGif) {
-      inner_.reset(new MultiFrameWriter(std::move(encoder)));
-    } else {
-      inner_.reset(new SingleFrameWriter(std::move(encoder)));
-    }
-
-    auto result = inner_->Initialize(image_info_);
-    DCHECK(!result.pending());
+    auto result = CreateInnerWriter(image_info_->type != ImageType::kGif);
     if (!result.ok())
       return result;
+  }
 
-    if (image_metadata_)
-      inner_->SetMetadata(image_metadata_);
+  if (held_frame_) {
+    auto result = inner_->WriteFrame(held_frame_);
+    held_frame_ = nullptr;
+    if (!result.ok())
+      return result;
   }
 
   return inner_->WriteFrame(frame);
 }
 
 Result LazyWebPWriter::FinishWrite(ImageOptimizationStats* stats) {
+  if (held_frame_) {
+    // The only frame of a GIF. If it doesn't cover the canvas, the animation
+    // encoder takes care of the offset.
+    bool still_image = held_frame_->x_offset() == 0 &&
+                       held_frame_->y_offset() == 0 &&
+                       held_frame_->width() == image_info_->width &&
+                       held_frame_->height() == image_info_->height;
+    auto result = CreateInnerWriter(still_image);
+    if (result.ok())
+      result = inner_->WriteFrame(held_frame_);
+    held_frame_ = nullptr;
+    if (!result.ok())
+      return result;
+  }
+
   if (inner_)
     return inner_->FinishWrite(stats);
 
   return Result::Ok();
 }
 
+size_t LazyWebPWriter::GetNumberOfFramesConsumed() const {
+  return inner_ ? inner_->GetNumberOfFramesConsumed() : 0;
+}
+
+Result LazyWebPWriter::CreateInnerWriter(bool still_image) {
+  DCHECK(!inner_);
+  auto encoder =
+      codec_factory_->CreateEncoder(ImageType::kWebP, std::move(dest_));
+  if (!encoder)
+    return Result::Error(Result::Code::kDunnoHowToEncode);
+
+  if (still_image) {
+    inner_.reset(new SingleFrameWriter(std::move(encoder)));
+  } else if (max_queued_frames_ > 0) {
+    inner_.reset(new PipelinedWriter(
+        base::make_unique<MultiFrameWriter>(std::move(encoder)),
+        max_queued_frames_));
+  } else {
+    inner_.reset(new MultiFrameWriter(std::move(encoder)));
+  }
+
+  auto result = inner_->Initialize(image_info_);
+  DCHECK(!result.pending());
+  if (!result.ok())
+    return result;
+
+  if (image_metadata_)
+    inner_->SetMetadata(image_metadata_);
+  return Result::Ok();
+}
+
 }  // namespace image
@@ -34,24 +34,38 @@ class ImageMetadata;
 // Writer that delays WebP encoder creation until first image frame is ready.
 // This gives the opportunity for the higher-level writers to analyze the image
 // and prepare to tweak yet-to-be-created encoder params based on that analysis.
+// With non-zero |max_queued_frames| GIF frames are encoded on a separate
+// thread, see PipelinedWriter. The first GIF frame is held until the second
+// one arrives: a GIF turning out to have a single frame covering the whole
+// canvas is encoded as a still image, which is much cheaper than an animation.
 class LazyWebPWriter : public ImageWriter {
  public:
   LazyWebPWriter(std::unique_ptr<io::VectorWriter> dest,
                  ImageCodecFactory* codec_factory,
                  const ImageInfo* image_info);
+  LazyWebPWriter(std::unique_ptr<io::VectorWriter> dest,
+                 ImageCodecFactory* codec_factory,
+                 const ImageInfo* image_info,
+                 size_t max_queued_frames);
 
   Result Initialize(const ImageInfo* image_info) override;
   void SetMetadata(const ImageMetadata* metadata) override;
   Result WriteFrame(ImageFrame* frame) override;
   Result FinishWrite(ImageOptimizationStats* stats) override;
+  size_t GetNumberOfFramesConsumed() const override;
 
  private:
+  Result CreateInnerWriter(bool still_image);
+
   std::unique_ptr<io::VectorWriter> dest_;
   ImageCodecFactory* codec_factory_;
   const ImageInfo* image_info_;
+  const size_t max_queued_frames_;
   const ImageMetadata* image_metadata_ = nullptr;
 
   std::unique_ptr<ImageWriter> inner_;
+  // First GIF frame, not written to |inner_| yet.
+  ImageFrame* held_frame_ = nullptr;
 };
 
 }  // namespace image
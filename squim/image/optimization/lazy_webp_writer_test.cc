@@ -23,6 +23,7 @@
 #include "squim/image/image_info.h"
 #include "squim/image/image_metadata.h"
 #include "squim/image/image_optimization_stats.h"
+#include "squim/image/image_transcoder.h"
 #include "squim/image/test/mock_encoder.h"
 #include "squim/io/writer.h"
 
@@ -51,8 +52,17 @@ class MockCodecFactory : public ImageCodecFactory {
     return std::unique_ptr<ImageEncoder>(CreateEncoderImpl(type, writer.get()));
   }
 
+  std::unique_ptr<ImageTranscoder> CreateTranscoder(
+      ImageType type,
+      std::unique_ptr<io::BufReader> reader) override {
+    return std::unique_ptr<ImageTranscoder>(
+        CreateTranscoderImpl(type, reader.get()));
+  }
+
   MOCK_METHOD2(CreateDecoderImpl, ImageDecoder*(ImageType, io::BufReader*));
   MOCK_METHOD2(CreateEncoderImpl, ImageEncoder*(ImageType, io::VectorWriter*));
+  MOCK_METHOD2(CreateTranscoderImpl,
+               ImageTranscoder*(ImageType, io::BufReader*));
 };
 
 }  // namespace
@@ -117,6 +127,86 @@ TEST_F(LazyWebPWriterTest, CreateAndWriteNoMetadata) {
   EXPECT_TRUE(result.ok());
 }
 
+TEST_F(LazyWebPWriterTest, PipelinedGif) {
+  CreateEncoder();
+  image_info_.type = ImageType::kGif;
+  testee_.reset(new LazyWebPWriter(base::make_unique<io::DevNull>(),
+                                   &codec_factory_, &image_info_, 2));
+  ImageFrame frames[3];
+  ImageOptimizationStats stats;
+  EXPECT_CALL(codec_factory_, CreateEncoderImpl(ImageType::kWebP, _))
+      .WillOnce(Invoke(this, &LazyWebPWriterTest::GetEncoder));
+  EXPECT_CALL(*mock_encoder_, Initialize(&image_info_))
+      .WillOnce(Return(Result::Ok()));
+  {
+    testing::InSequence s;
+    for (auto& frame : frames) {
+      EXPECT_CALL(*mock_encoder_, EncodeFrame(&frame, false))
+          .WillOnce(Return(Result::Ok()));
+    }
+    EXPECT_CALL(*mock_encoder_, EncodeFrame(nullptr, true))
+        .WillOnce(Return(Result::Ok()));
+    EXPECT_CALL(*mock_encoder_, FinishWrite(&stats))
+        .WillOnce(Return(Result::Ok()));
+  }
+  for (auto& frame : frames)
+    EXPECT_TRUE(testee_->WriteFrame(&frame).ok());
+  EXPECT_TRUE(testee_->FinishWrite(&stats).ok());
+}
+
+TEST_F(LazyWebPWriterTest, SingleFrameGifAsStillImage) {
+  CreateEncoder();
+  image_info_.type = ImageType::kGif;
+  image_info_.width = 10;
+  image_info_.height = 20;
+  ImageFrame frame;
+  frame.set_size(10, 20);
+  ImageOptimizationStats stats;
+  EXPECT_CALL(codec_factory_, CreateEncoderImpl(_, _)).Times(0);
+  EXPECT_TRUE(testee_->WriteFrame(&frame).ok());
+  EXPECT_EQ(0u, testee_->GetNumberOfFramesConsumed());
+
+  testing::Mock::VerifyAndClearExpectations(&codec_factory_);
+  EXPECT_CALL(codec_factory_, CreateEncoderImpl(ImageType::kWebP, _))
+      .WillOnce(Invoke(this, &LazyWebPWriterTest::GetEncoder));
+  EXPECT_CALL(*mock_encoder_, Initialize(&image_info_))
+      .WillOnce(Return(Result::Ok()));
+  {
+    testing::InSequence s;
+    EXPECT_CALL(*mock_encoder_, EncodeFrame(&frame, true))
+        .WillOnce(Return(Result::Ok()));
+    EXPECT_CALL(*mock_encoder_, FinishWrite(&stats))
+        .WillOnce(Return(Result::Ok()));
+  }
+  EXPECT_TRUE(testee_->FinishWrite(&stats).ok());
+}
+
+TEST_F(LazyWebPWriterTest, SingleFrameGifWithOffsetAsAnimation) {
+  CreateEncoder();
+  image_info_.type = ImageType::kGif;
+  image_info_.width = 10;
+  image_info_.height = 20;
+  ImageFrame frame;
+  frame.set_size(5, 5);
+  frame.set_offset(1, 2);
+  ImageOptimizationStats stats;
+  EXPECT_CALL(codec_factory_, CreateEncoderImpl(ImageType::kWebP, _))
+      .WillOnce(Invoke(this, &LazyWebPWriterTest::GetEncoder));
+  EXPECT_CALL(*mock_encoder_, Initialize(&image_info_))
+      .WillOnce(Return(Result::Ok()));
+  {
+    testing::InSequence s;
+    EXPECT_CALL(*mock_encoder_, EncodeFrame(&frame, false))
+        .WillOnce(Return(Result::Ok()));
+    EXPECT_CALL(*mock_encoder_, EncodeFrame(nullptr, true))
+        .WillOnce(Return(Result::Ok()));
+    EXPECT_CALL(*mock_encoder_, FinishWrite(&stats))
+        .WillOnce(Return(Result::Ok()));
+  }
+  EXPECT_TRUE(testee_->WriteFrame(&frame).ok());
+  EXPECT_TRUE(testee_->FinishWrite(&stats).ok());
+}
+
 TEST_F(LazyWebPWriterTest, FinishNoInner) {
   ImageOptimizationStats stats;
   auto result = testee_->FinishWrite(&stats);
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/recompress_gif_strategy.h"
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/decoding_reader.h"
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/image_decoder.h"
+#include "squim/image/image_encoder.h"
+#include "squim/image/multi_frame_writer.h"
+#include "squim/image/optimization/size_limited_writer.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/writer.h"
+
+namespace image {
+
+RecompressGifStrategy::RecompressGifStrategy() {}
+
+RecompressGifStrategy::~RecompressGifStrategy() {}
+
+Result RecompressGifStrategy::ShouldEvenBother() {
+  return Result::Ok();
+}
+
+Result RecompressGifStrategy::CreateImageReader(
+    ImageType image_type,
+    std::unique_ptr<io::BufReader> src,
+    std::unique_ptr<ImageReader>* reader) {
+  if (!codec_factory_)
+    return Result::Error(Result::Code::kFailed, "Not yet configured");
+
+  if (image_type != ImageType::kGif)
+    return Result::Error(Result::Code::kUnsupportedFormat);
+
+  auto decoder = codec_factory_->CreateDecoder(image_type, std::move(src));
+  if (!decoder)
+    return Result::Error(Result::Code::kUnsupportedFormat);
+
+  decoder_ = decoder.get();
+  reader->reset(new DecodingReader(std::move(decoder)));
+  return Result::Ok();
+}
+
+Result RecompressGifStrategy::CreateImageWriter(
+    std::unique_ptr<io::VectorWriter> dest,
+    ImageReader* reader,
+    std::unique_ptr<ImageWriter>* writer) {
+  if (!decoder_)
+    return Result::Error(Result::Code::kFailed, "No decoder");
+
+  // Size of GIF is known only when the trailer is read, which happens before
+  // FinishWrite() since the strategy waits for metadata.
+  auto* decoder = decoder_;
+  auto max_size = [decoder]() -> uint64_t {
+    auto size = decoder->GetImageInfo().size;
+    return size > 0 ? size - 1 : 0;
+  };
+
+  auto* codec_factory = codec_factory_;
+  auto inner_builder = [codec_factory](
+      std::unique_ptr<io::VectorWriter> buffer) {
+    return base::make_unique<MultiFrameWriter>(
+        codec_factory->CreateEncoder(ImageType::kGif, std::move(buffer)));
+  };
+  writer->reset(
+      new SizeLimitedWriter(std::move(dest), max_size, inner_builder));
+  return Result::Ok();
+}
+
+Result RecompressGifStrategy::AdjustImageReaderAfterInfoReady(
+    std::unique_ptr<ImageReader>* reader) {
+  return Result::Ok();
+}
+
+bool RecompressGifStrategy::ShouldWaitForMetadata() {
+  // Extensions may follow the last frame.
+  return true;
+}
+
+GifDecoder::Params RecompressGifStrategy::GetGifDecoderParams() {
+  auto params = GifDecoder::Params::Default();
+  // GifEncoder composites palette frames right into its canvas.
+  params.allowed_color_schemes.insert(ColorScheme::kPalette);
+  // Frames that are already buffered are decoded on the shared thread pool.
+  params.max_decode_threads = 0;
+  return params;
+}
+
+void RecompressGifStrategy::SetCodecFactory(ImageCodecFactory* factory) {
+  codec_factory_ = factory;
+}
+
+}  // namespace image
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/recompress_gif_strategy.h"
+
+#include <array>
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/gif/gif_image.h"
+#include "squim/image/codecs/gif/lzw_writer.h"
+#include "squim/image/codecs/gif_decoder.h"
+#include "squim/image/codecs/gif_encoder.h"
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/image/image_reader.h"
+#include "squim/image/test/image_test_util.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/buffered_source.h"
+#include "squim/io/writer.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+using RGB = std::array<uint8_t, 3>;
+
+std::unique_ptr<ImageCodecFactory> CreateGifCodecFactory(
+    CodecConfigurator* configurator) {
+  return base::make_unique<TestCodecFactory>(
+      [configurator](std::unique_ptr<io::BufReader> reader) {
+        return base::make_unique<GifDecoder>(
+            configurator->GetGifDecoderParams(), std::move(reader));
+      },
+      [configurator](std::unique_ptr<io::VectorWriter> writer) {
+        return base::make_unique<GifEncoder>(
+            configurator->GetGifEncoderParams(), std::move(writer));
+      });
+}
+
+void PutUint16(uint32_t value, std::vector<uint8_t>* out) {
+  out->push_back(value & 0xFF);
+  out->push_back((value >> 8) & 0xFF);
+}
+
+// Writes GIFs the way a naive encoder does: every frame has a full 256 entry
+// local color table and nothing is cropped or merged.
+class TestGifBuilder {
+ public:
+  TestGifBuilder(uint32_t width, uint32_t height) {
+    const char kSignature[] = "GIF89a";
+    data_.insert(data_.end(), kSignature, kSignature + 6);
+    PutUint16(width, &data_);
+    PutUint16(height, &data_);
+    data_.push_back(0x70);
+    data_.push_back(0);
+    data_.push_back(0);
+  }
+
+  // |pixels| are indices into |colors|, which may hold up to 256 entries.
+  void AddFrame(uint32_t x,
+                uint32_t y,
+                uint32_t width,
+                uint32_t height,
+                const std::vector<RGB>& colors,
+                const std::vector<uint8_t>& pixels,
+                GifImage::DisposalMethod disposal,
+                uint32_t duration) {
+    ASSERT_EQ(width * height, pixels.size());
+    ASSERT_LE(colors.size(), 256u);
+
+    data_.insert(data_.end(), {0x21, 0xF9, 4});
+    data_.push_back(static_cast<uint8_t>(disposal) << 2);
+    PutUint16(duration / 10, &data_);
+    data_.insert(data_.end(), {0, 0});
+
+    data_.push_back(0x2C);
+    PutUint16(x, &data_);
+    PutUint16(y, &data_);
+    PutUint16(width, &data_);
+    PutUint16(height, &data_);
+    data_.push_back(0x87);
+    for (size_t i = 0; i < 256; ++i) {
+      RGB color = i < colors.size() ? colors[i] : RGB{{0, 0, 0}};
+      data_.insert(data_.end(), color.begin(), color.end());
+    }
+
+    data_.push_back(8);
+    auto output = [this](uint8_t* data, size_t size) -> bool {
+      data_.push_back(size);
+      data_.insert(data_.end(), data, data + size);
+      return true;
+    };
+    LZWWriter lzw_writer;
+    ASSERT_TRUE(lzw_writer.Init(8, 255, output));
+    ASSERT_FALSE(lzw_writer.Write(&pixels[0], pixels.size()).error());
+    ASSERT_FALSE(lzw_writer.Finish().error());
+    data_.push_back(0);
+  }
+
+  std::vector<uint8_t> Finish() {
+    data_.push_back(0x3B);
+    return data_;
+  }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+// |count| distinct colors, different for every |seed|.
+std::vector<RGB> MakeColors(size_t count, uint8_t seed) {
+  std::vector<RGB> colors;
+  for (size_t i = 0; i < count; ++i)
+    colors.push_back(RGB{{static_cast<uint8_t>(i), seed, 0x80}});
+  return colors;
+}
+
+std::unique_ptr<GifDecoder> Decode(const std::vector<uint8_t>& data) {
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  source->source()->AddChunk(io::Chunk::Copy(&data[0], data.size()));
+  source->source()->SendEof();
+  auto params = GifDecoder::Params::Default();
+  params.allowed_color_schemes.insert(ColorScheme::kPalette);
+  auto decoder = base::make_unique<GifDecoder>(params, std::move(source));
+  EXPECT_TRUE(decoder->Decode().ok());
+  EXPECT_TRUE(decoder->IsImageComplete());
+  return decoder;
+}
+
+}  // namespace
+
+class RecompressGifStrategyTest : public testing::Test {
+ protected:
+  static const uint32_t kWidth = 32;
+  static const uint32_t kHeight = 16;
+
+  RecompressGifStrategyTest()
+      : codec_factory_(CreateGifCodecFactory(&testee_)) {}
+
+  void SetUp() override { testee_.SetCodecFactory(codec_factory_.get()); }
+
+  Result Optimize(const std::vector<uint8_t>& data,
+                  std::vector<uint8_t>* out,
+                  ImageOptimizationStats* stats) {
+    auto strategy = base::make_unique<RecompressGifStrategy>();
+    auto codec_factory = CreateGifCodecFactory(strategy.get());
+    strategy->SetCodecFactory(codec_factory.get());
+    return OptimizeWithStrategy(std::move(strategy), data, 1000, out, stats);
+  }
+
+  // Optimizes |data| and decodes the result.
+  std::unique_ptr<GifDecoder> Recompress(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> out;
+    ImageOptimizationStats stats;
+    auto result = Optimize(data, &out, &stats);
+    EXPECT_TRUE(result.ok()) << result.code();
+    EXPECT_LT(out.size(), data.size());
+    if (out.empty())
+      return std::unique_ptr<GifDecoder>();
+    return Decode(out);
+  }
+
+  // Full screen frame of a four color stripe pattern.
+  void AddStripes(TestGifBuilder* builder, uint32_t duration) {
+    std::vector<uint8_t> pixels(kWidth * kHeight);
+    for (size_t i = 0; i < pixels.size(); ++i)
+      pixels[i] = (i / 3) % 4;
+    builder->AddFrame(0, 0, kWidth, kHeight, MakeColors(4, 0), pixels,
+                      GifImage::DisposalMethod::kKeep, duration);
+  }
+
+  RecompressGifStrategy testee_;
+  std::unique_ptr<ImageCodecFactory> codec_factory_;
+};
+
+TEST_F(RecompressGifStrategyTest, ShouldRejectNonGif) {
+  std::unique_ptr<ImageReader> reader;
+  auto result = testee_.CreateImageReader(
+      ImageType::kPng, io::BufReader::CreateEmpty(), &reader);
+  EXPECT_EQ(Result::Code::kUnsupportedFormat, result.code());
+  EXPECT_FALSE(reader);
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldWaitForWholeImage) {
+  EXPECT_TRUE(testee_.ShouldWaitForMetadata());
+  auto params = testee_.GetGifDecoderParams();
+  EXPECT_TRUE(params.color_scheme_allowed(ColorScheme::kPalette));
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldRecompressWithOptimizer) {
+  for (auto* name : {"animated.gif", "transparent.gif"}) {
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadTestFileWithExt("gif", name, &data)) << name;
+    std::vector<uint8_t> out;
+    ImageOptimizationStats stats;
+    auto result = Optimize(data, &out, &stats);
+    EXPECT_TRUE(result.finished()) << name;
+    ASSERT_TRUE(result.ok()) << name << " " << result.code();
+
+    EXPECT_LT(out.size(), data.size()) << name;
+    EXPECT_EQ(out.size(), stats.coded_size) << name;
+  }
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldMergeDuplicateFrames) {
+  TestGifBuilder builder(kWidth, kHeight);
+  AddStripes(&builder, 100);
+  AddStripes(&builder, 50);
+  std::vector<uint8_t> pixels(kWidth * kHeight, 1);
+  builder.AddFrame(0, 0, kWidth, kHeight, MakeColors(4, 0), pixels,
+                   GifImage::DisposalMethod::kKeep, 70);
+
+  auto decoder = Recompress(builder.Finish());
+  ASSERT_TRUE(decoder);
+  ASSERT_EQ(2u, decoder->GetFrameCount());
+  EXPECT_EQ(150u, decoder->GetFrameAtIndex(0)->duration());
+  EXPECT_EQ(70u, decoder->GetFrameAtIndex(1)->duration());
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldCropToChangedArea) {
+  TestGifBuilder builder(kWidth, kHeight);
+  AddStripes(&builder, 100);
+  // Full screen frame which changes only pixels in [5, 9) x [3, 5).
+  std::vector<uint8_t> pixels(kWidth * kHeight);
+  for (size_t i = 0; i < pixels.size(); ++i)
+    pixels[i] = (i / 3) % 4;
+  for (uint32_t y = 3; y < 5; ++y) {
+    for (uint32_t x = 5; x < 9; ++x)
+      pixels[y * kWidth + x] = 4;
+  }
+  builder.AddFrame(0, 0, kWidth, kHeight, MakeColors(5, 0), pixels,
+                   GifImage::DisposalMethod::kKeep, 100);
+
+  auto decoder = Recompress(builder.Finish());
+  ASSERT_TRUE(decoder);
+  ASSERT_EQ(2u, decoder->GetFrameCount());
+  auto* frame = decoder->GetFrameAtIndex(1);
+  EXPECT_EQ(5u, frame->x_offset());
+  EXPECT_EQ(3u, frame->y_offset());
+  EXPECT_EQ(4u, frame->width());
+  EXPECT_EQ(2u, frame->height());
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldTrimColorTables) {
+  TestGifBuilder builder(kWidth, kHeight);
+  // Three of 256 colors are used.
+  std::vector<uint8_t> pixels(kWidth * kHeight);
+  for (size_t i = 0; i < pixels.size(); ++i)
+    pixels[i] = i % 3;
+  builder.AddFrame(0, 0, kWidth, kHeight, MakeColors(256, 0), pixels,
+                   GifImage::DisposalMethod::kKeep, 100);
+
+  auto decoder = Recompress(builder.Finish());
+  ASSERT_TRUE(decoder);
+  ASSERT_EQ(1u, decoder->GetFrameCount());
+  auto* frame = decoder->GetFrameAtIndex(0);
+  ASSERT_TRUE(frame->is_palette());
+  EXPECT_EQ(4u, frame->palette().size());
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldFailOnTooManyColors) {
+  // The last frame is drawn over the screen restored to the first frame, the
+  // result has 512 colors and every pixel differs from the shown screen.
+  TestGifBuilder builder(kWidth, kHeight);
+  std::vector<uint8_t> pixels(kWidth * kHeight, 0);
+  for (uint32_t y = 0; y < kHeight; ++y) {
+    for (uint32_t x = 0; x < kWidth / 2; ++x)
+      pixels[y * kWidth + x] = y * kWidth / 2 + x;
+  }
+  builder.AddFrame(0, 0, kWidth, kHeight, MakeColors(256, 1), pixels,
+                   GifImage::DisposalMethod::kKeep, 100);
+  std::vector<uint8_t> fill(kWidth * kHeight, 0);
+  builder.AddFrame(0, 0, kWidth, kHeight, MakeColors(1, 2), fill,
+                   GifImage::DisposalMethod::kOverwritePrevious, 100);
+  std::vector<uint8_t> half(kWidth / 2 * kHeight);
+  for (size_t i = 0; i < half.size(); ++i)
+    half[i] = i;
+  builder.AddFrame(kWidth / 2, 0, kWidth / 2, kHeight, MakeColors(256, 3),
+                   half, GifImage::DisposalMethod::kKeep, 100);
+  auto data = builder.Finish();
+
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize(data, &out, &stats);
+  EXPECT_EQ(Result::Code::kDunnoHowToEncode, result.code());
+  EXPECT_TRUE(out.empty());
+}
+
+TEST_F(RecompressGifStrategyTest, ShouldNotWriteLargerOutput) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt("gif", "zero_size_animation.gif", &data));
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize(data, &out, &stats);
+  EXPECT_TRUE(result.finished());
+  EXPECT_EQ(Result::Code::kImageTooLarge, result.code());
+  EXPECT_TRUE(out.empty());
+}
+
+}  // namespace image
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/recompress_png_strategy.h"
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/decoding_reader.h"
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/image_decoder.h"
+#include "squim/image/image_encoder.h"
+#include "squim/image/optimization/size_limited_writer.h"
+#include "squim/image/single_frame_writer.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/writer.h"
+
+namespace image {
+
+RecompressPngStrategy::RecompressPngStrategy() {}
+
+RecompressPngStrategy::~RecompressPngStrategy() {}
+
+Result RecompressPngStrategy::ShouldEvenBother() {
+  return Result::Ok();
+}
+
+Result RecompressPngStrategy::CreateImageReader(
+    ImageType image_type,
+    std::unique_ptr<io::BufReader> src,
+    std::unique_ptr<ImageReader>* reader) {
+  if (!codec_factory_)
+    return Result::Error(Result::Code::kFailed, "Not yet configured");
+
+  if (image_type != ImageType::kPng)
+    return Result::Error(Result::Code::kUnsupportedFormat);
+
+  auto decoder = codec_factory_->CreateDecoder(image_type, std::move(src));
+  if (!decoder)
+    return Result::Error(Result::Code::kUnsupportedFormat);
+
+  decoder_ = decoder.get();
+  reader->reset(new DecodingReader(std::move(decoder)));
+  return Result::Ok();
+}
+
+Result RecompressPngStrategy::CreateImageWriter(
+    std::unique_ptr<io::VectorWriter> dest,
+    ImageReader* reader,
+    std::unique_ptr<ImageWriter>* writer) {
+  if (!decoder_)
+    return Result::Error(Result::Code::kFailed, "No decoder");
+
+  // Size of PNG is known only when it is completely read, which happens
+  // before FinishWrite() since the strategy waits for metadata.
+  auto* decoder = decoder_;
+  auto max_size = [decoder]() -> uint64_t {
+    auto size = decoder->GetImageInfo().size;
+    return size > 0 ? size - 1 : 0;
+  };
+
+  auto* codec_factory = codec_factory_;
+  auto inner_builder = [codec_factory](
+      std::unique_ptr<io::VectorWriter> buffer) {
+    return base::make_unique<SingleFrameWriter>(
+        codec_factory->CreateEncoder(ImageType::kPng, std::move(buffer)));
+  };
+  writer->reset(
+      new SizeLimitedWriter(std::move(dest), max_size, inner_builder));
+  return Result::Ok();
+}
+
+Result RecompressPngStrategy::AdjustImageReaderAfterInfoReady(
+    std::unique_ptr<ImageReader>* reader) {
+  return Result::Ok();
+}
+
+bool RecompressPngStrategy::ShouldWaitForMetadata() {
+  // Text chunks with metadata may follow the image data.
+  return true;
+}
+
+PngDecoder::Params RecompressPngStrategy::GetPngDecoderParams() {
+  auto params = PngDecoder::Params::Default();
+  params.scale_16_bit = false;
+  return params;
+}
+
+void RecompressPngStrategy::SetCodecFactory(ImageCodecFactory* factory) {
+  codec_factory_ = factory;
+}
+
+}  // namespace image
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/recompress_png_strategy.h"
+
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/png_decoder.h"
+#include "squim/image/codecs/png_encoder.h"
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/image/image_reader.h"
+#include "squim/image/test/image_test_util.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/writer.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+std::unique_ptr<ImageCodecFactory> CreatePngCodecFactory(
+    CodecConfigurator* configurator) {
+  return base::make_unique<TestCodecFactory>(
+      [configurator](std::unique_ptr<io::BufReader> reader) {
+        return base::make_unique<PngDecoder>(
+            configurator->GetPngDecoderParams(), std::move(reader));
+      },
+      [configurator](std::unique_ptr<io::VectorWriter> writer) {
+        return base::make_unique<PngEncoder>(
+            configurator->GetPngEncoderParams(), std::move(writer));
+      });
+}
+
+}  // namespace
+
+class RecompressPngStrategyTest : public testing::Test {
+ protected:
+  RecompressPngStrategyTest()
+      : codec_factory_(CreatePngCodecFactory(&testee_)) {}
+
+  void SetUp() override { testee_.SetCodecFactory(codec_factory_.get()); }
+
+  Result Optimize(const std::string& dir,
+                  const std::string& filename,
+                  std::vector<uint8_t>* data,
+                  std::vector<uint8_t>* out,
+                  ImageOptimizationStats* stats) {
+    EXPECT_TRUE(ReadTestFileWithExt(dir, filename, data));
+
+    auto strategy = base::make_unique<RecompressPngStrategy>();
+    auto codec_factory = CreatePngCodecFactory(strategy.get());
+    strategy->SetCodecFactory(codec_factory.get());
+    return OptimizeWithStrategy(std::move(strategy), *data, 1000, out, stats);
+  }
+
+  RecompressPngStrategy testee_;
+  std::unique_ptr<ImageCodecFactory> codec_factory_;
+};
+
+TEST_F(RecompressPngStrategyTest, ShouldRejectNonPng) {
+  std::unique_ptr<ImageReader> reader;
+  auto result = testee_.CreateImageReader(
+      ImageType::kJpeg, io::BufReader::CreateEmpty(), &reader);
+  EXPECT_EQ(Result::Code::kUnsupportedFormat, result.code());
+  EXPECT_FALSE(reader);
+}
+
+TEST_F(RecompressPngStrategyTest, ShouldWaitForWholeImage) {
+  EXPECT_TRUE(testee_.ShouldWaitForMetadata());
+  EXPECT_FALSE(testee_.GetPngDecoderParams().scale_16_bit);
+}
+
+TEST_F(RecompressPngStrategyTest, ShouldRecompressWithOptimizer) {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize("png", "this_is_a_test.png", &data, &out, &stats);
+  EXPECT_TRUE(result.finished());
+  ASSERT_TRUE(result.ok()) << result.code();
+
+  EXPECT_FALSE(out.empty());
+  EXPECT_LT(out.size(), data.size());
+  EXPECT_EQ(out.size(), stats.coded_size);
+}
+
+TEST_F(RecompressPngStrategyTest, ShouldNotWriteLargerOutput) {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize("png", "pagespeed-128.png", &data, &out, &stats);
+  EXPECT_TRUE(result.finished());
+  EXPECT_EQ(Result::Code::kImageTooLarge, result.code());
+  EXPECT_TRUE(out.empty());
+}
+
+TEST_F(RecompressPngStrategyTest, ShouldReject16Bit) {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize("pngsuite", "basn2c16.png", &data, &out, &stats);
+  EXPECT_EQ(Result::Code::kUnsupportedFormat, result.code());
+  EXPECT_TRUE(out.empty());
+}
+
+}  // namespace image
@@ -102,12 +102,30 @@ WebPDecoder::Params RootStrategy::GetWebPDecoderParams() {
   return params;
 }
 
+GifEncoder::Params RootStrategy::GetGifEncoderParams() {
+  auto params = base_strategy_->GetGifEncoderParams();
+  adjuster_->AdjustGifEncoderParams(&params);
+  return params;
+}
+
+PngEncoder::Params RootStrategy::GetPngEncoderParams() {
+  auto params = base_strategy_->GetPngEncoderParams();
+  adjuster_->AdjustPngEncoderParams(&params);
+  return params;
+}
+
 WebPEncoder::Params RootStrategy::GetWebPEncoderParams() {
   auto params = base_strategy_->GetWebPEncoderParams();
   adjuster_->AdjustWebPEncoderParams(&params);
   return params;
 }
 
+JpegTranscoder::Params RootStrategy::GetJpegTranscoderParams() {
+  auto params = base_strategy_->GetJpegTranscoderParams();
+  adjuster_->AdjustJpegTranscoderParams(&params);
+  return params;
+}
+
 void RootStrategy::SetCodecFactory(ImageCodecFactory* factory) {
   NOTREACHED();
 }
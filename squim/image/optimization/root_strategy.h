@@ -44,7 +44,11 @@ class RootStrategy : public CodecAwareStrategy {
     virtual void AdjustJpegDecoderParams(JpegDecoder::Params* params) = 0;
     virtual void AdjustPngDecoderParams(PngDecoder::Params* params) = 0;
     virtual void AdjustWebPDecoderParams(WebPDecoder::Params* params) = 0;
+    virtual void AdjustGifEncoderParams(GifEncoder::Params* params) = 0;
+    virtual void AdjustPngEncoderParams(PngEncoder::Params* params) = 0;
     virtual void AdjustWebPEncoderParams(WebPEncoder::Params* params) = 0;
+    virtual void AdjustJpegTranscoderParams(
+        JpegTranscoder::Params* params) = 0;
 
     virtual ~Adjuster() {}
   };
@@ -69,7 +73,10 @@ class RootStrategy : public CodecAwareStrategy {
   JpegDecoder::Params GetJpegDecoderParams() override;
   PngDecoder::Params GetPngDecoderParams() override;
   WebPDecoder::Params GetWebPDecoderParams() override;
+  GifEncoder::Params GetGifEncoderParams() override;
+  PngEncoder::Params GetPngEncoderParams() override;
   WebPEncoder::Params GetWebPEncoderParams() override;
+  JpegTranscoder::Params GetJpegTranscoderParams() override;
   void SetCodecFactory(ImageCodecFactory* factory) override;
 
  private:
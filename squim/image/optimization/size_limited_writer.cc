@@ -0,0 +1,99 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/size_limited_writer.h"
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/io/chunk.h"
+#include "squim/io/writer.h"
+
+namespace image {
+
+class SizeLimitedWriter::Buffer : public io::VectorWriter {
+ public:
+  io::IoResult WriteV(io::ChunkList chunks) override {
+    size_t nwrite = 0;
+    for (auto& chunk : chunks) {
+      nwrite += chunk->size();
+      chunks_.push_back(std::move(chunk));
+    }
+    size_ += nwrite;
+    return io::IoResult::Write(nwrite);
+  }
+
+  uint64_t size() const { return size_; }
+  io::ChunkList& chunks() { return chunks_; }
+
+ private:
+  io::ChunkList chunks_;
+  uint64_t size_ = 0;
+};
+
+SizeLimitedWriter::SizeLimitedWriter(std::unique_ptr<io::VectorWriter> dest,
+                                     uint64_t max_size,
+                                     WriterBuilder inner_builder)
+    : SizeLimitedWriter(std::move(dest),
+                        [max_size]() { return max_size; },
+                        std::move(inner_builder)) {}
+
+SizeLimitedWriter::SizeLimitedWriter(std::unique_ptr<io::VectorWriter> dest,
+                                     MaxSizeGetter max_size_getter,
+                                     WriterBuilder inner_builder)
+    : dest_(std::move(dest)), max_size_getter_(std::move(max_size_getter)) {
+  auto buffer = base::make_unique<Buffer>();
+  buffer_ = buffer.get();
+  inner_ = inner_builder(std::move(buffer));
+  CHECK(inner_);
+}
+
+SizeLimitedWriter::~SizeLimitedWriter() {}
+
+Result SizeLimitedWriter::Initialize(const ImageInfo* image_info) {
+  return inner_->Initialize(image_info);
+}
+
+void SizeLimitedWriter::SetMetadata(const ImageMetadata* metadata) {
+  inner_->SetMetadata(metadata);
+}
+
+Result SizeLimitedWriter::WriteFrame(ImageFrame* frame) {
+  return inner_->WriteFrame(frame);
+}
+
+Result SizeLimitedWriter::FinishWrite(ImageOptimizationStats* stats) {
+  auto result = inner_->FinishWrite(stats);
+  if (!result.ok())
+    return result;
+
+  auto max_size = max_size_getter_();
+  if (buffer_->size() > max_size) {
+    VLOG(1) << "Output is too large: " << buffer_->size() << " > "
+            << max_size;
+    return Result::Finish(Result::Code::kImageTooLarge,
+                          "Output is not smaller than the input");
+  }
+
+  auto io_result = dest_->WriteV(std::move(buffer_->chunks()));
+  return Result::FromIoResult(io_result, false);
+}
+
+size_t SizeLimitedWriter::GetNumberOfFramesConsumed() const {
+  return inner_->GetNumberOfFramesConsumed();
+}
+
+}  // namespace image
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_OPTIMIZATION_SIZE_LIMITED_WRITER_H_
+#define SQUIM_IMAGE_OPTIMIZATION_SIZE_LIMITED_WRITER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "squim/base/make_noncopyable.h"
+#include "squim/image/image_writer.h"
+
+namespace io {
+class VectorWriter;
+}
+
+namespace image {
+
+// Writer which holds the whole output of the |inner_| writer in memory and
+// passes it to |dest_| only if its size does not exceed |max_size|. Otherwise
+// writing finishes with kImageTooLarge and nothing is written to |dest_|.
+// Used when re-encoding an image into its own format, where output larger than
+// the input makes no sense.
+class SizeLimitedWriter : public ImageWriter {
+  MAKE_NONCOPYABLE(SizeLimitedWriter);
+
+ public:
+  using WriterBuilder = std::function<std::unique_ptr<ImageWriter>(
+      std::unique_ptr<io::VectorWriter>)>;
+  using MaxSizeGetter = std::function<uint64_t()>;
+
+  SizeLimitedWriter(std::unique_ptr<io::VectorWriter> dest,
+                    uint64_t max_size,
+                    WriterBuilder inner_builder);
+  // Same as above, but the limit is requested in FinishWrite(), e.g. when the
+  // size of the input is known only after it is completely read.
+  SizeLimitedWriter(std::unique_ptr<io::VectorWriter> dest,
+                    MaxSizeGetter max_size_getter,
+                    WriterBuilder inner_builder);
+  ~SizeLimitedWriter() override;
+
+  Result Initialize(const ImageInfo* image_info) override;
+  void SetMetadata(const ImageMetadata* metadata) override;
+  Result WriteFrame(ImageFrame* frame) override;
+  Result FinishWrite(ImageOptimizationStats* stats) override;
+  size_t GetNumberOfFramesConsumed() const override;
+
+ private:
+  class Buffer;
+
+  std::unique_ptr<io::VectorWriter> dest_;
+  MaxSizeGetter max_size_getter_;
+  Buffer* buffer_;
+  std::unique_ptr<ImageWriter> inner_;
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_OPTIMIZATION_SIZE_LIMITED_WRITER_H_
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/size_limited_writer.h"
+
+#include <string>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/io/chunk.h"
+#include "squim/io/writer.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+// Writes |output| on FinishWrite.
+class FakeWriter : public ImageWriter {
+ public:
+  FakeWriter(std::unique_ptr<io::VectorWriter> dest, std::string output)
+      : dest_(std::move(dest)), output_(output) {}
+
+  Result Initialize(const ImageInfo* image_info) override {
+    return Result::Ok();
+  }
+  void SetMetadata(const ImageMetadata* metadata) override {}
+  Result WriteFrame(ImageFrame* frame) override { return Result::Ok(); }
+  Result FinishWrite(ImageOptimizationStats* stats) override {
+    io::ChunkList chunks;
+    chunks.push_back(io::Chunk::Copy(
+        reinterpret_cast<const uint8_t*>(output_.data()), output_.size()));
+    return Result::FromIoResult(dest_->WriteV(std::move(chunks)), false);
+  }
+  size_t GetNumberOfFramesConsumed() const override { return 0; }
+
+ private:
+  std::unique_ptr<io::VectorWriter> dest_;
+  std::string output_;
+};
+
+class StringVectorWriter : public io::VectorWriter {
+ public:
+  explicit StringVectorWriter(std::string* out) : out_(out) {}
+
+  io::IoResult WriteV(io::ChunkList chunks) override {
+    size_t nwrite = 0;
+    for (auto& chunk : chunks) {
+      out_->append(reinterpret_cast<const char*>(chunk->data()),
+                   chunk->size());
+      nwrite += chunk->size();
+    }
+    return io::IoResult::Write(nwrite);
+  }
+
+ private:
+  std::string* out_;
+};
+
+std::unique_ptr<SizeLimitedWriter> CreateWriter(std::string* out,
+                                                uint64_t max_size,
+                                                const std::string& output) {
+  return base::make_unique<SizeLimitedWriter>(
+      base::make_unique<StringVectorWriter>(out), max_size,
+      [output](std::unique_ptr<io::VectorWriter> buffer) {
+        return base::make_unique<FakeWriter>(std::move(buffer), output);
+      });
+}
+
+}  // namespace
+
+TEST(SizeLimitedWriterTest, ShouldWriteIfFits) {
+  std::string out;
+  auto testee = CreateWriter(&out, 5, "12345");
+  ImageOptimizationStats stats;
+  EXPECT_TRUE(testee->FinishWrite(&stats).ok());
+  EXPECT_EQ("12345", out);
+}
+
+TEST(SizeLimitedWriterTest, ShouldNotWriteIfTooLarge) {
+  std::string out;
+  auto testee = CreateWriter(&out, 4, "12345");
+  ImageOptimizationStats stats;
+  auto result = testee->FinishWrite(&stats);
+  EXPECT_TRUE(result.finished());
+  EXPECT_EQ(Result::Code::kImageTooLarge, result.code());
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(SizeLimitedWriterTest, ShouldGetMaxSizeOnFinish) {
+  std::string out;
+  uint64_t max_size = 0;
+  SizeLimitedWriter testee(
+      base::make_unique<StringVectorWriter>(&out),
+      [&max_size]() { return max_size; },
+      [](std::unique_ptr<io::VectorWriter> buffer) {
+        return base::make_unique<FakeWriter>(std::move(buffer), "12345");
+      });
+  max_size = 5;
+  ImageOptimizationStats stats;
+  EXPECT_TRUE(testee.FinishWrite(&stats).ok());
+  EXPECT_EQ("12345", out);
+}
+
+}  // namespace image
@@ -45,6 +45,10 @@ Result SkipMetadataReader::GetFrameAtIndex(size_t index, ImageFrame** frame) {
   return inner_->GetFrameAtIndex(index, frame);
 }
 
+void SkipMetadataReader::ReleaseFrameAtIndex(size_t index) {
+  inner_->ReleaseFrameAtIndex(index);
+}
+
 Result SkipMetadataReader::ReadTillTheEnd() {
   while (HasMoreFrames()) {
     auto result = GetNextFrame(nullptr);
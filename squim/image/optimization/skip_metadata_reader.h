@@ -38,6 +38,7 @@ class SkipMetadataReader : public ImageReader {
   Result GetImageInfo(const ImageInfo** info) override;
   Result GetNextFrame(ImageFrame** frame) override;
   Result GetFrameAtIndex(size_t index, ImageFrame** frame) override;
+  void ReleaseFrameAtIndex(size_t index) override;
   Result ReadTillTheEnd() override;
 
  private:
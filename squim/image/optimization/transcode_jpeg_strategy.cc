@@ -0,0 +1,96 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/transcode_jpeg_strategy.h"
+
+#include "squim/base/logging.h"
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/image_transcoder.h"
+#include "squim/image/optimization/size_limited_writer.h"
+#include "squim/image/transcoding_reader.h"
+#include "squim/image/transcoding_writer.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/writer.h"
+
+namespace image {
+
+TranscodeJpegStrategy::TranscodeJpegStrategy() {}
+
+TranscodeJpegStrategy::~TranscodeJpegStrategy() {}
+
+Result TranscodeJpegStrategy::ShouldEvenBother() {
+  return Result::Ok();
+}
+
+Result TranscodeJpegStrategy::CreateImageReader(
+    ImageType image_type,
+    std::unique_ptr<io::BufReader> src,
+    std::unique_ptr<ImageReader>* reader) {
+  if (!codec_factory_)
+    return Result::Error(Result::Code::kFailed, "Not yet configured");
+
+  if (image_type != ImageType::kJpeg)
+    return Result::Error(Result::Code::kUnsupportedFormat);
+
+  auto transcoder =
+      codec_factory_->CreateTranscoder(image_type, std::move(src));
+  if (!transcoder)
+    return Result::Error(Result::Code::kUnsupportedFormat);
+
+  transcoder_ = transcoder.get();
+  reader->reset(new TranscodingReader(std::move(transcoder)));
+  return Result::Ok();
+}
+
+Result TranscodeJpegStrategy::CreateImageWriter(
+    std::unique_ptr<io::VectorWriter> dest,
+    ImageReader* reader,
+    std::unique_ptr<ImageWriter>* writer) {
+  if (!transcoder_)
+    return Result::Error(Result::Code::kFailed, "No transcoder");
+
+  // Lossless transcoding gains nothing if the output is not smaller than the
+  // input, so such output is dropped.
+  auto* transcoder = transcoder_;
+  auto max_size = [transcoder]() -> uint64_t {
+    auto size = transcoder->GetImageInfo().size;
+    return size > 0 ? size - 1 : 0;
+  };
+
+  auto inner_builder = [transcoder](std::unique_ptr<io::VectorWriter> buffer) {
+    return base::make_unique<TranscodingWriter>(std::move(buffer), transcoder);
+  };
+  writer->reset(
+      new SizeLimitedWriter(std::move(dest), max_size, inner_builder));
+  return Result::Ok();
+}
+
+Result TranscodeJpegStrategy::AdjustImageReaderAfterInfoReady(
+    std::unique_ptr<ImageReader>* reader) {
+  return Result::Ok();
+}
+
+bool TranscodeJpegStrategy::ShouldWaitForMetadata() {
+  // Transcoder needs all the coefficients before it can write anything.
+  return true;
+}
+
+void TranscodeJpegStrategy::SetCodecFactory(ImageCodecFactory* factory) {
+  codec_factory_ = factory;
+}
+
+}  // namespace image
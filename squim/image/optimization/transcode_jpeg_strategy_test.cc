@@ -0,0 +1,105 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/optimization/transcode_jpeg_strategy.h"
+
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/codecs/jpeg_transcoder.h"
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/image/image_reader.h"
+#include "squim/image/test/image_test_util.h"
+#include "squim/io/buf_reader.h"
+#include "squim/io/writer.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+std::unique_ptr<ImageCodecFactory> CreateTranscoderOnlyFactory() {
+  return base::make_unique<TestCodecFactory>(
+      nullptr, nullptr, [](std::unique_ptr<io::BufReader> reader) {
+        return base::make_unique<JpegTranscoder>(
+            JpegTranscoder::Params::Default(), std::move(reader));
+      });
+}
+
+}  // namespace
+
+class TranscodeJpegStrategyTest : public testing::Test {
+ protected:
+  TranscodeJpegStrategyTest()
+      : codec_factory_(CreateTranscoderOnlyFactory()) {}
+
+  void SetUp() override { testee_.SetCodecFactory(codec_factory_.get()); }
+
+  // Runs ImageOptimizer with TranscodeJpegStrategy over |data| fed in 1000
+  // byte chunks.
+  Result Optimize(const std::vector<uint8_t>& data,
+                  std::vector<uint8_t>* out,
+                  ImageOptimizationStats* stats) {
+    auto strategy = base::make_unique<TranscodeJpegStrategy>();
+    strategy->SetCodecFactory(codec_factory_.get());
+    return OptimizeWithStrategy(std::move(strategy), data, 1000, out, stats);
+  }
+
+  std::unique_ptr<ImageCodecFactory> codec_factory_;
+  TranscodeJpegStrategy testee_;
+};
+
+TEST_F(TranscodeJpegStrategyTest, ShouldRejectNonJpeg) {
+  std::unique_ptr<ImageReader> reader;
+  auto result = testee_.CreateImageReader(
+      ImageType::kPng, io::BufReader::CreateEmpty(), &reader);
+  EXPECT_EQ(Result::Code::kUnsupportedFormat, result.code());
+  EXPECT_FALSE(reader);
+}
+
+TEST_F(TranscodeJpegStrategyTest, ShouldWaitForWholeImage) {
+  EXPECT_TRUE(testee_.ShouldWaitForMetadata());
+}
+
+TEST_F(TranscodeJpegStrategyTest, ShouldTranscodeWithOptimizer) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt("jpeg", "sjpeg3.jpg", &data));
+
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize(data, &out, &stats);
+  EXPECT_TRUE(result.finished());
+  EXPECT_TRUE(result.ok()) << result.code();
+
+  EXPECT_FALSE(out.empty());
+  EXPECT_LT(out.size(), data.size());
+  EXPECT_EQ(out.size(), stats.coded_size);
+}
+
+TEST_F(TranscodeJpegStrategyTest, ShouldRejectOutputWhichIsNotSmaller) {
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(ReadTestFileWithExt("jpeg", "already_optimized.jpg", &data));
+
+  std::vector<uint8_t> out;
+  ImageOptimizationStats stats;
+  auto result = Optimize(data, &out, &stats);
+  EXPECT_EQ(Result::Code::kImageTooLarge, result.code());
+  EXPECT_TRUE(out.empty());
+}
+
+}  // namespace image
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/pipelined_writer.h"
+
+#include "squim/base/logging.h"
+
+namespace image {
+
+PipelinedWriter::PipelinedWriter(std::unique_ptr<ImageWriter> inner,
+                                 size_t max_queued_frames)
+    : inner_(std::move(inner)), max_queued_frames_(max_queued_frames) {
+  DCHECK(inner_);
+  DCHECK_LT(0u, max_queued_frames_);
+}
+
+PipelinedWriter::~PipelinedWriter() {
+  Stop(true);
+}
+
+Result PipelinedWriter::Initialize(const ImageInfo* image_info) {
+  return inner_->Initialize(image_info);
+}
+
+void PipelinedWriter::SetMetadata(const ImageMetadata* metadata) {
+  inner_->SetMetadata(metadata);
+}
+
+Result PipelinedWriter::WriteFrame(ImageFrame* frame) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (encoder_thread_.joinable()) {
+    frame_encoded_.wait(lock, [this]() {
+      return queue_.size() < max_queued_frames_ || !error_.ok();
+    });
+  }
+  if (!error_.ok())
+    return error_;
+  DCHECK(!closed_);
+
+  queue_.push_back(frame);
+  if (encoder_thread_.joinable()) {
+    frame_queued_.notify_one();
+  } else if (queue_.size() > 1) {
+    // More than one frame, worth a thread.
+    encoder_thread_ = std::thread(&PipelinedWriter::EncodeLoop, this);
+  }
+  return Result::Ok();
+}
+
+Result PipelinedWriter::FinishWrite(ImageOptimizationStats* stats) {
+  Stop(false);
+
+  // The thread was never started, write whatever is queued right here.
+  while (error_.ok() && !queue_.empty()) {
+    auto result = inner_->WriteFrame(queue_.front());
+    DCHECK(!result.pending());
+    queue_.pop_front();
+    frames_consumed_ = inner_->GetNumberOfFramesConsumed();
+    if (!result.ok())
+      error_ = result;
+  }
+
+  if (!error_.ok())
+    return error_;
+
+  return inner_->FinishWrite(stats);
+}
+
+size_t PipelinedWriter::GetNumberOfFramesConsumed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frames_consumed_;
+}
+
+void PipelinedWriter::EncodeLoop() {
+  for (;;) {
+    ImageFrame* frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      frame_queued_.wait(lock, [this]() { return !queue_.empty() || closed_; });
+      if (queue_.empty())
+        return;
+      frame = queue_.front();
+    }
+
+    auto result = inner_->WriteFrame(frame);
+    DCHECK(!result.pending());
+    size_t frames_consumed = inner_->GetNumberOfFramesConsumed();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.pop_front();
+    frames_consumed_ = frames_consumed;
+    if (!result.ok()) {
+      // Nothing else will be encoded. Wake up the writer, it will return the
+      // error instead of queueing frames.
+      error_ = result;
+      queue_.clear();
+      frame_encoded_.notify_one();
+      return;
+    }
+    frame_encoded_.notify_one();
+  }
+}
+
+void PipelinedWriter::Stop(bool drop_queued) {
+  if (!encoder_thread_.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    // Keep the frame being encoded, the encoding thread pops it.
+    if (drop_queued && queue_.size() > 1)
+      queue_.erase(queue_.begin() + 1, queue_.end());
+  }
+  frame_queued_.notify_one();
+  encoder_thread_.join();
+}
+
+}  // namespace image
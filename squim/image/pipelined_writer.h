@@ -0,0 +1,86 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SQUIM_IMAGE_PIPELINED_WRITER_H_
+#define SQUIM_IMAGE_PIPELINED_WRITER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "squim/base/make_noncopyable.h"
+#include "squim/image/image_writer.h"
+
+namespace image {
+
+// Writer that runs frame encoding of the |inner| writer on its own thread, so
+// that decoding of frame N+1 (on the caller's thread) overlaps with encoding
+// of frame N. For long animations this brings the wall-clock time close to
+// max(decode, encode) instead of their sum.
+//
+// Frames are handed over through a bounded queue: at most |max_queued_frames|
+// frames may be waiting or being encoded, WriteFrame() blocks while the queue
+// is full. Frames stay owned by the reader and must be valid until they are
+// reported by GetNumberOfFramesConsumed(), FinishWrite() returns or the writer
+// is destroyed.
+//
+// The encoding thread is started only when the second frame arrives, single
+// frame images are encoded on the caller's thread in FinishWrite().
+class PipelinedWriter : public ImageWriter {
+  MAKE_NONCOPYABLE(PipelinedWriter);
+
+ public:
+  PipelinedWriter(std::unique_ptr<ImageWriter> inner,
+                  size_t max_queued_frames);
+  ~PipelinedWriter() override;
+
+  Result Initialize(const ImageInfo* image_info) override;
+  void SetMetadata(const ImageMetadata* metadata) override;
+  Result WriteFrame(ImageFrame* frame) override;
+  Result FinishWrite(ImageOptimizationStats* stats) override;
+  size_t GetNumberOfFramesConsumed() const override;
+
+ private:
+  void EncodeLoop();
+
+  // Signals the encoding thread to stop after |queue_| is empty and waits for
+  // it. When |drop_queued| is true, frames not yet being encoded are
+  // discarded.
+  void Stop(bool drop_queued);
+
+  std::unique_ptr<ImageWriter> inner_;
+  const size_t max_queued_frames_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable frame_queued_;
+  std::condition_variable frame_encoded_;
+  // The front frame is the one being encoded.
+  std::deque<ImageFrame*> queue_;
+  bool closed_ = false;
+  // The first error returned by |inner_|.
+  Result error_ = Result::Ok();
+  // Copy of |inner_|'s counter, which can't be read while the encoding thread
+  // runs.
+  size_t frames_consumed_ = 0;
+
+  std::thread encoder_thread_;
+};
+
+}  // namespace image
+
+#endif  // SQUIM_IMAGE_PIPELINED_WRITER_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/pipelined_writer.h"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "squim/base/memory/make_unique.h"
+#include "squim/image/image_frame.h"
+#include "squim/image/image_optimization_stats.h"
+
+#include "gtest/gtest.h"
+
+namespace image {
+
+namespace {
+
+class FakeWriter : public ImageWriter {
+ public:
+  Result Initialize(const ImageInfo* image_info) override {
+    return Result::Ok();
+  }
+
+  void SetMetadata(const ImageMetadata* metadata) override {}
+
+  Result WriteFrame(ImageFrame* frame) override {
+    if (gate_.valid())
+      gate_.wait();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frames_.size() == fail_at_)
+      return Result::Error(Result::Code::kEncodeError, "Failed");
+    frames_.push_back(frame);
+    threads_.push_back(std::this_thread::get_id());
+    return Result::Ok();
+  }
+
+  Result FinishWrite(ImageOptimizationStats* stats) override {
+    finished_ = true;
+    return Result::Ok();
+  }
+
+  size_t GetNumberOfFramesConsumed() const override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_.size();
+  }
+
+  std::vector<ImageFrame*> frames() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_;
+  }
+
+  std::vector<std::thread::id> threads() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return threads_;
+  }
+
+  bool finished() const { return finished_; }
+
+  void set_fail_at(size_t n) { fail_at_ = n; }
+  void set_gate(std::shared_future<void> gate) { gate_ = gate; }
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<ImageFrame*> frames_;
+  std::vector<std::thread::id> threads_;
+  size_t fail_at_ = ~0u;
+  bool finished_ = false;
+  std::shared_future<void> gate_;
+};
+
+}  // namespace
+
+class PipelinedWriterTest : public testing::Test {
+ protected:
+  void CreateTestee(size_t max_queued_frames) {
+    auto inner = base::make_unique<FakeWriter>();
+    inner_ = inner.get();
+    testee_ = base::make_unique<PipelinedWriter>(std::move(inner),
+                                                 max_queued_frames);
+  }
+
+  ImageFrame frames_[50];
+  FakeWriter* inner_ = nullptr;
+  std::unique_ptr<PipelinedWriter> testee_;
+};
+
+TEST_F(PipelinedWriterTest, SingleFrameIsWrittenOnFinish) {
+  CreateTestee(2);
+  ASSERT_TRUE(testee_->WriteFrame(&frames_[0]).ok());
+  EXPECT_TRUE(inner_->frames().empty());
+
+  ImageOptimizationStats stats;
+  ASSERT_TRUE(testee_->FinishWrite(&stats).ok());
+  EXPECT_TRUE(inner_->finished());
+  ASSERT_EQ(1u, inner_->frames().size());
+  EXPECT_EQ(&frames_[0], inner_->frames()[0]);
+  EXPECT_EQ(std::this_thread::get_id(), inner_->threads()[0]);
+}
+
+TEST_F(PipelinedWriterTest, WritesAllFramesInOrder) {
+  CreateTestee(2);
+  for (auto& frame : frames_)
+    ASSERT_TRUE(testee_->WriteFrame(&frame).ok());
+
+  ImageOptimizationStats stats;
+  ASSERT_TRUE(testee_->FinishWrite(&stats).ok());
+  EXPECT_TRUE(inner_->finished());
+  auto frames = inner_->frames();
+  ASSERT_EQ(50u, frames.size());
+  for (size_t i = 0; i < frames.size(); ++i)
+    EXPECT_EQ(&frames_[i], frames[i]);
+  for (auto id : inner_->threads())
+    EXPECT_NE(std::this_thread::get_id(), id);
+  EXPECT_EQ(50u, testee_->GetNumberOfFramesConsumed());
+}
+
+TEST_F(PipelinedWriterTest, QueueIsBounded) {
+  CreateTestee(2);
+  std::promise<void> gate;
+  inner_->set_gate(gate.get_future().share());
+
+  // The first frame is being encoded, the second one waits.
+  ASSERT_TRUE(testee_->WriteFrame(&frames_[0]).ok());
+  ASSERT_TRUE(testee_->WriteFrame(&frames_[1]).ok());
+  auto third = std::async(std::launch::async, [this]() {
+    return testee_->WriteFrame(&frames_[2]);
+  });
+  EXPECT_EQ(std::future_status::timeout,
+            third.wait_for(std::chrono::milliseconds(50)));
+  EXPECT_EQ(0u, testee_->GetNumberOfFramesConsumed());
+
+  gate.set_value();
+  EXPECT_TRUE(third.get().ok());
+  ImageOptimizationStats stats;
+  ASSERT_TRUE(testee_->FinishWrite(&stats).ok());
+  EXPECT_EQ(3u, inner_->frames().size());
+}
+
+TEST_F(PipelinedWriterTest, ErrorStopsPipeline) {
+  CreateTestee(1);
+  inner_->set_fail_at(3);
+
+  auto result = Result::Ok();
+  size_t written = 0;
+  for (; written < 50 && result.ok(); ++written)
+    result = testee_->WriteFrame(&frames_[written]);
+
+  ImageOptimizationStats stats;
+  auto finish_result = testee_->FinishWrite(&stats);
+  EXPECT_EQ(Result::Code::kEncodeError, finish_result.code());
+  EXPECT_FALSE(inner_->finished());
+  EXPECT_EQ(3u, inner_->frames().size());
+  if (!result.ok()) {
+    EXPECT_EQ(Result::Code::kEncodeError, result.code());
+    EXPECT_GT(50u, written);
+  }
+}
+
+TEST_F(PipelinedWriterTest, DestroyWithoutFinish) {
+  CreateTestee(4);
+  for (size_t i = 0; i < 10; ++i)
+    ASSERT_TRUE(testee_->WriteFrame(&frames_[i]).ok());
+  testee_.reset();
+}
+
+}  // namespace image
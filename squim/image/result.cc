@@ -78,6 +78,11 @@ Result Result::Finish(Code code) {
   return Result(code, std::string(), true);
 }
 
+// static
+Result Result::Finish(Code code, std::string custom_message) {
+  return Result(code, custom_message, true);
+}
+
 // static
 Result Result::FromIoResult(io::IoResult io_result, bool eof_ok) {
   if (io_result.ok())
@@ -47,4 +47,9 @@ Result SingleFrameWriter::FinishWrite(ImageOptimizationStats* stats) {
   return encoder_->FinishWrite(stats);
 }
 
+size_t SingleFrameWriter::GetNumberOfFramesConsumed() const {
+  // The encoder may hold the frame till FinishWrite().
+  return 0;
+}
+
 }  // namespace image
@@ -37,6 +37,7 @@ class SingleFrameWriter : public ImageWriter {
   void SetMetadata(const ImageMetadata* metadata) override;
   Result WriteFrame(ImageFrame* frame) override;
   Result FinishWrite(ImageOptimizationStats* stats) override;
+  size_t GetNumberOfFramesConsumed() const override;
 
  private:
   std::unique_ptr<ImageEncoder> encoder_;
@@ -16,6 +16,7 @@
 
 #include "squim/image/test/image_test_util.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iterator>
 #include <memory>
@@ -29,8 +30,13 @@ extern "C" {
 
 #include "squim/base/memory/make_unique.h"
 #include "squim/image/image_decoder.h"
+#include "squim/image/image_encoder.h"
 #include "squim/image/image_frame.h"
 #include "squim/image/image_info.h"
+#include "squim/image/image_optimization_stats.h"
+#include "squim/image/image_transcoder.h"
+#include "squim/image/optimization/image_optimizer.h"
+#include "squim/image/optimization/optimization_strategy.h"
 #include "squim/image/scanline_reader.h"
 
 extern "C" {
@@ -386,4 +392,94 @@ void ValidateDecodeWithReadSpec(
   CheckDecodedFrame(filename, &ref_frame, testee.get());
 }
 
+io::IoResult VectorTestWriter::WriteV(io::ChunkList chunks) {
+  size_t nwrite = 0;
+  for (auto& chunk : chunks) {
+    out_->insert(out_->end(), chunk->data(), chunk->data() + chunk->size());
+    nwrite += chunk->size();
+  }
+  return io::IoResult::Write(nwrite);
+}
+
+Result EncodeFrames(ImageEncoder* encoder,
+                    const ImageInfo* image_info,
+                    const ImageMetadata* metadata,
+                    const std::vector<ImageFrame*>& frames,
+                    const std::vector<uint8_t>& out) {
+  auto result = encoder->Initialize(image_info);
+  if (!result.ok())
+    return result;
+  if (metadata)
+    encoder->SetMetadata(metadata);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    result = encoder->EncodeFrame(frames[i], i + 1 == frames.size());
+    if (!result.ok())
+      return result;
+  }
+
+  ImageOptimizationStats stats;
+  result = encoder->FinishWrite(&stats);
+  if (result.ok()) {
+    EXPECT_EQ(out.size(), stats.coded_size);
+  }
+  return result;
+}
+
+TestCodecFactory::TestCodecFactory(DecoderBuilder decoder_builder,
+                                   EncoderBuilder encoder_builder,
+                                   TranscoderBuilder transcoder_builder)
+    : decoder_builder_(decoder_builder),
+      encoder_builder_(encoder_builder),
+      transcoder_builder_(transcoder_builder) {}
+
+std::unique_ptr<ImageDecoder> TestCodecFactory::CreateDecoder(
+    ImageType type,
+    std::unique_ptr<io::BufReader> reader) {
+  if (!decoder_builder_)
+    return std::unique_ptr<ImageDecoder>();
+  return decoder_builder_(std::move(reader));
+}
+
+std::unique_ptr<ImageEncoder> TestCodecFactory::CreateEncoder(
+    ImageType type,
+    std::unique_ptr<io::VectorWriter> writer) {
+  if (!encoder_builder_)
+    return std::unique_ptr<ImageEncoder>();
+  return encoder_builder_(std::move(writer));
+}
+
+std::unique_ptr<ImageTranscoder> TestCodecFactory::CreateTranscoder(
+    ImageType type,
+    std::unique_ptr<io::BufReader> reader) {
+  if (!transcoder_builder_)
+    return std::unique_ptr<ImageTranscoder>();
+  return transcoder_builder_(std::move(reader));
+}
+
+Result OptimizeWithStrategy(std::unique_ptr<OptimizationStrategy> strategy,
+                            const std::vector<uint8_t>& data,
+                            size_t chunk_size,
+                            std::vector<uint8_t>* out,
+                            ImageOptimizationStats* stats) {
+  auto source = base::make_unique<io::BufReader>(
+      base::make_unique<io::BufferedSource>());
+  auto* buffered_source = source->source();
+  ImageOptimizer optimizer(ImageOptimizer::DefaultImageTypeSelector,
+                           std::move(strategy), std::move(source),
+                           base::make_unique<VectorTestWriter>(out));
+
+  Result result = Result::Ok();
+  for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+    size_t size = std::min(chunk_size, data.size() - offset);
+    buffered_source->AddChunk(io::Chunk::Copy(&data[offset], size));
+    result = optimizer.Process();
+    if (result.error())
+      return result;
+  }
+  buffered_source->SendEof();
+  result = optimizer.Process();
+  *stats = optimizer.stats();
+  return result;
+}
+
 }  // namespace image
@@ -23,14 +23,22 @@
 #include <string>
 #include <vector>
 
+#include "squim/image/image_codec_factory.h"
+#include "squim/image/result.h"
 #include "squim/io/buf_reader.h"
 #include "squim/io/buffered_source.h"
+#include "squim/io/writer.h"
 
 namespace image {
 
 class ImageDecoder;
+class ImageEncoder;
 class ImageFrame;
 struct ImageInfo;
+class ImageMetadata;
+struct ImageOptimizationStats;
+class ImageTranscoder;
+class OptimizationStrategy;
 
 // Specifies how the image should be read.
 enum ReadType {
@@ -47,6 +55,10 @@ enum ReadType {
 using RefReader = std::function<bool(ImageInfo*, ImageFrame*)>;
 using DecoderBuilder = std::function<std::unique_ptr<ImageDecoder>(
     std::unique_ptr<io::BufReader>)>;
+using EncoderBuilder = std::function<std::unique_ptr<ImageEncoder>(
+    std::unique_ptr<io::VectorWriter>)>;
+using TranscoderBuilder = std::function<std::unique_ptr<ImageTranscoder>(
+    std::unique_ptr<io::BufReader>)>;
 
 bool ReadFile(const std::string& full_path, std::vector<uint8_t>* contents);
 
@@ -137,6 +149,62 @@ void ValidateDecodeWithReadSpec(
     const std::vector<std::vector<size_t>>& read_spec,
     ReadType read_type);
 
+// Writer which appends everything to |out|.
+class VectorTestWriter : public io::VectorWriter {
+ public:
+  explicit VectorTestWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+  io::IoResult WriteV(io::ChunkList chunks) override;
+
+ private:
+  std::vector<uint8_t>* out_;
+};
+
+// Encodes |frames| with |encoder| and finishes writing. |metadata| is set
+// unless it's null. |out| is where |encoder| writes, its size is checked
+// against the coded size reported in the stats.
+Result EncodeFrames(ImageEncoder* encoder,
+                    const ImageInfo* image_info,
+                    const ImageMetadata* metadata,
+                    const std::vector<ImageFrame*>& frames,
+                    const std::vector<uint8_t>& out);
+
+// Codec factory for testing a strategy on its own. Codecs are created by the
+// given builders whatever type is requested, codecs without a builder are not
+// created at all.
+class TestCodecFactory : public ImageCodecFactory {
+ public:
+  TestCodecFactory(DecoderBuilder decoder_builder,
+                   EncoderBuilder encoder_builder,
+                   TranscoderBuilder transcoder_builder = nullptr);
+
+  // ImageCodecFactory implementation:
+  std::unique_ptr<ImageDecoder> CreateDecoder(
+      ImageType type,
+      std::unique_ptr<io::BufReader> reader) override;
+  std::unique_ptr<ImageEncoder> CreateEncoder(
+      ImageType type,
+      std::unique_ptr<io::VectorWriter> writer) override;
+  std::unique_ptr<ImageTranscoder> CreateTranscoder(
+      ImageType type,
+      std::unique_ptr<io::BufReader> reader) override;
+
+ private:
+  DecoderBuilder decoder_builder_;
+  EncoderBuilder encoder_builder_;
+  TranscoderBuilder transcoder_builder_;
+};
+
+// Runs ImageOptimizer with |strategy| over |data| fed by |chunk_size| byte
+// chunks and then EOF, as the server does. The strategy must already have its
+// codec factory set. Output goes to |out|, |stats| are filled in the end.
+// Stops at the first error.
+Result OptimizeWithStrategy(std::unique_ptr<OptimizationStrategy> strategy,
+                            const std::vector<uint8_t>& data,
+                            size_t chunk_size,
+                            std::vector<uint8_t>* out,
+                            ImageOptimizationStats* stats);
+
 }  // namespace image
 
 #endif  // SQUIM_IMAGE_IMAGE_TEST_UTIL_H_
@@ -30,6 +30,7 @@ class MockDecoder : public ImageDecoder {
   MOCK_CONST_METHOD1(IsFrameHeaderCompleteAtIndex, bool(size_t));
   MOCK_CONST_METHOD1(IsFrameCompleteAtIndex, bool(size_t));
   MOCK_METHOD1(GetFrameAtIndex, ImageFrame*(size_t));
+  MOCK_METHOD1(ReleaseFrameAtIndex, void(size_t));
   MOCK_CONST_METHOD0(GetFrameCount, size_t());
   MOCK_METHOD0(GetMetadata, ImageMetadata*());
   MOCK_CONST_METHOD0(IsAllMetadataComplete, bool());
@@ -33,6 +33,7 @@ class MockImageReader : public ImageReader {
   MOCK_METHOD1(GetImageInfo, Result(const ImageInfo**));
   MOCK_METHOD1(GetNextFrame, Result(ImageFrame**));
   MOCK_METHOD2(GetFrameAtIndex, Result(size_t, ImageFrame**));
+  MOCK_METHOD1(ReleaseFrameAtIndex, void(size_t));
   MOCK_METHOD0(ReadTillTheEnd, Result());
 
   Result GetFakeImageInfo(const ImageInfo** info) {
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/transcoding_reader.h"
+
+#include "squim/base/logging.h"
+#include "squim/image/image_transcoder.h"
+
+namespace image {
+
+TranscodingReader::TranscodingReader(
+    std::unique_ptr<ImageTranscoder> transcoder)
+    : transcoder_(std::move(transcoder)) {}
+
+TranscodingReader::~TranscodingReader() {}
+
+bool TranscodingReader::HasMoreFrames() const {
+  return false;
+}
+
+const ImageMetadata* TranscodingReader::GetMetadata() const {
+  return transcoder_->GetMetadata();
+}
+
+size_t TranscodingReader::GetNumberOfFramesRead() const {
+  return 0;
+}
+
+Result TranscodingReader::GetImageInfo(const ImageInfo** info) {
+  if (!transcoder_->IsImageInfoComplete()) {
+    auto result = transcoder_->ReadImageInfo();
+    if (!result.ok())
+      return result;
+  }
+
+  if (info)
+    *info = &transcoder_->GetImageInfo();
+
+  return Result::Ok();
+}
+
+Result TranscodingReader::GetNextFrame(ImageFrame** frame) {
+  return Result::Error(Result::Code::kReadFrameError,
+                       "Transcoding reader provides no frames");
+}
+
+Result TranscodingReader::GetFrameAtIndex(size_t index, ImageFrame** frame) {
+  return Result::Error(Result::Code::kReadFrameError,
+                       "Transcoding reader provides no frames");
+}
+
+void TranscodingReader::ReleaseFrameAtIndex(size_t index) {
+  // No frames are ever read.
+  NOTREACHED();
+}
+
+Result TranscodingReader::ReadTillTheEnd() {
+  if (transcoder_->IsReadComplete())
+    return Result::Ok();
+
+  return transcoder_->Read();
+}
+
+}  // namespace image
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2015 Alexey Baranov <me@kotiki.cc>. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "squim/image/transcoding_writer.h"
+
+#include "squim/image/image_transcoder.h"
+#include "squim/io/writer.h"
+
+namespace image {
+
+TranscodingWriter::TranscodingWriter(std::unique_ptr<io::VectorWriter> dest,
+                                     ImageTranscoder* transcoder)
+    : dest_(std::move(dest)), transcoder_(transcoder) {}
+
+TranscodingWriter::~TranscodingWriter() {}
+
+Result TranscodingWriter::Initialize(const ImageInfo* image_info) {
+  return Result::Ok();
+}
+
+void TranscodingWriter::SetMetadata(const ImageMetadata* metadata) {
+  // Transcoder copies metadata itself according to its params.
+}
+
+Result TranscodingWriter::WriteFrame(ImageFrame* frame) {
+  return Result::Error(Result::Code::kWriteFrameError,
+                       "Transcoding writer accepts no frames");
+}
+
+Result TranscodingWriter::FinishWrite(ImageOptimizationStats* stats) {
+  return transcoder_->Write(dest_.get(), stats);
+}
+
+size_t TranscodingWriter::GetNumberOfFramesConsumed() const {
+  return 0;
+}
+
+}  // namespace image
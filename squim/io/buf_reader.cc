@@ -45,6 +45,17 @@ IoResult BufReader::ReadSome(uint8_t** out) {
   return IoResult::Read(nread);
 }
 
+IoResult BufReader::ReadSomeShared(ChunkPtr* out) {
+  if (source_->EofReached())
+    return IoResult::Eof();
+
+  if (!source_->HaveSome())
+    return IoResult::Pending();
+
+  auto nread = source_->ReadSomeShared(out);
+  return IoResult::Read(nread);
+}
+
 IoResult BufReader::ReadAtMostN(uint8_t** out, size_t n) {
   if (source_->EofReached())
     return IoResult::Eof();
@@ -67,6 +78,26 @@ IoResult BufReader::ReadN(uint8_t** out, size_t n) {
   return IoResult::Read(nread);
 }
 
+IoResult BufReader::ReadV(size_t n, std::vector<Span>* out) {
+  CHECK(out);
+
+  if (source_->EofReached())
+    return IoResult::Eof();
+
+  if (!source_->HaveN(n))
+    return IoResult::Pending();
+
+  out->clear();
+  size_t left = n;
+  while (left > 0) {
+    uint8_t* tmp;
+    auto nread = source_->ReadAtMostN(&tmp, left);
+    out->push_back(Span{tmp, nread});
+    left -= nread;
+  }
+  return IoResult::Read(n);
+}
+
 IoResult BufReader::ReadNInto(uint8_t* out, size_t n) {
   CHECK(out);
 
@@ -117,8 +148,17 @@ IoResult BufReader::SkipN(size_t n) {
   return IoResult::Read(n);
 }
 
+size_t BufReader::FreeBefore(size_t offset) {
+  if (offset <= freed_)
+    return 0;
+
+  auto nfreed = source_->FreeAtMostNBytes(offset - freed_);
+  freed_ += nfreed;
+  return nfreed;
+}
+
 size_t BufReader::offset() const {
-  return source_->offset();
+  return freed_ + source_->offset();
 }
 
 bool BufReader::HaveSome() const {
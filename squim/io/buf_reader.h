@@ -19,7 +19,9 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
+#include "squim/io/chunk.h"
 #include "squim/io/io_result.h"
 
 namespace io {
@@ -31,6 +33,12 @@ class BufReader {
  public:
   static std::unique_ptr<BufReader> CreateEmpty();
 
+  // Continuous piece of data stored in the source.
+  struct Span {
+    uint8_t* data;
+    size_t size;
+  };
+
   BufReader(std::unique_ptr<BufferedSource> source);
   ~BufReader();
 
@@ -39,6 +47,10 @@ class BufReader {
   // Do not copies any data, just returns a pointer.
   IoResult ReadSome(uint8_t** out);
 
+  // Same as ReadSome(), but sets |out| to a chunk sharing the storage with
+  // |source_|, which stays valid after the data is freed from |source_|.
+  IoResult ReadSomeShared(ChunkPtr* out);
+
   // Sets |out| to continuous piece of data of the size |n| or less.
   // Advances the offset for returned IoResult::n() bytes.
   // Do not copies any data, just returns a pointer.
@@ -51,6 +63,12 @@ class BufReader {
   // Returns error if |source_| ended (got EOF) earlier.
   IoResult ReadN(uint8_t** out, size_t n);
 
+  // Sets |out| to the pieces of data of the total size |n|, as they are stored
+  // in |source_|. Unlike ReadN() never merges chunks.
+  // Advances the offset for returned IoResult::n() bytes (which is |n|).
+  // Returns error if |source_| ended (got EOF) earlier.
+  IoResult ReadV(size_t n, std::vector<Span>* out);
+
   // Copies into |out| piece of data of the size |n|.
   // Advances the offset for returned IoResult::n() bytes (which is |n|).
   // Returns error if |source_| ended (got EOF) earlier.
@@ -76,12 +94,20 @@ class BufReader {
   // Unreads n bytes from the buffer. Returns the number of bytes unread.
   size_t UnreadN(size_t n);
 
+  // Frees the chunks of |source_| read completely before |offset| (see
+  // offset()). Data before |offset| must not be unread after that. Decoders
+  // call it with the position they would never need to get back to.
+  // Returns the number of bytes freed.
+  size_t FreeBefore(size_t offset);
+
   BufferedSource* source() { return source_.get(); }
+  // Number of bytes read since the beginning, including the freed ones.
   size_t offset() const;
   bool HaveSome() const;
 
  private:
   std::unique_ptr<BufferedSource> source_;
+  size_t freed_ = 0;
 };
 
 }  // namespace io
@@ -16,7 +16,9 @@
 
 #include "squim/io/buf_reader.h"
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "squim/base/memory/make_unique.h"
 #include "squim/base/strings/string_util.h"
@@ -40,6 +42,8 @@ TEST_F(BufReaderTest, ReadPending) {
   EXPECT_TRUE(testee_->ReadSome(&out).pending());
   EXPECT_TRUE(testee_->ReadAtMostN(&out, 100).pending());
   EXPECT_TRUE(testee_->ReadN(&out, 100).pending());
+  std::vector<BufReader::Span> spans;
+  EXPECT_TRUE(testee_->ReadV(100, &spans).pending());
 
   std::unique_ptr<uint8_t[]> buf(new uint8_t[20]);
   EXPECT_TRUE(testee_->ReadNInto(buf.get(), 20).pending());
@@ -52,6 +56,8 @@ TEST_F(BufReaderTest, ReadEOF) {
   EXPECT_TRUE(testee_->ReadSome(&out).eof());
   EXPECT_TRUE(testee_->ReadAtMostN(&out, 100).eof());
   EXPECT_TRUE(testee_->ReadN(&out, 100).eof());
+  std::vector<BufReader::Span> spans;
+  EXPECT_TRUE(testee_->ReadV(100, &spans).eof());
 
   std::unique_ptr<uint8_t[]> buf(new uint8_t[20]);
   EXPECT_TRUE(testee_->ReadNInto(buf.get(), 20).eof());
@@ -81,4 +87,66 @@ TEST_F(BufReaderTest, Reading) {
   EXPECT_EQ("test1", base::StringFromBytes(out, 5));
 }
 
+TEST_F(BufReaderTest, ReadVDoesNotMerge) {
+  testee_->source()->AddChunk(Chunk::FromString("test1"));
+  testee_->source()->AddChunk(Chunk::FromString("test2"));
+  testee_->source()->AddChunk(Chunk::FromString("test3"));
+  uint8_t* out;
+  EXPECT_EQ(2, testee_->ReadN(&out, 2).n());
+
+  std::vector<BufReader::Span> spans;
+  EXPECT_EQ(9, testee_->ReadV(9, &spans).n());
+  ASSERT_EQ(3u, spans.size());
+  EXPECT_EQ("st1", base::StringFromBytes(spans[0].data, spans[0].size));
+  EXPECT_EQ("test2", base::StringFromBytes(spans[1].data, spans[1].size));
+  EXPECT_EQ("t", base::StringFromBytes(spans[2].data, spans[2].size));
+  EXPECT_EQ(11, testee_->offset());
+
+  EXPECT_EQ(4, testee_->ReadSome(&out).n());
+  EXPECT_EQ("est3", base::StringFromBytes(out, 4));
+}
+
+TEST_F(BufReaderTest, FreeBefore) {
+  testee_->source()->AddChunk(Chunk::FromString("test1"));
+  testee_->source()->AddChunk(Chunk::FromString("test2"));
+  testee_->source()->AddChunk(Chunk::FromString("test3"));
+  uint8_t* out;
+  EXPECT_EQ(5, testee_->ReadSome(&out).n());
+  EXPECT_EQ(2, testee_->ReadAtMostN(&out, 2).n());
+  EXPECT_EQ(0u, testee_->FreeBefore(4));
+
+  EXPECT_EQ(5u, testee_->FreeBefore(testee_->offset()));
+  EXPECT_EQ(7u, testee_->offset());
+  EXPECT_EQ(10u, testee_->source()->size());
+  EXPECT_EQ(2u, testee_->UnreadN(10));
+  EXPECT_EQ(5u, testee_->offset());
+
+  EXPECT_EQ(5, testee_->ReadSome(&out).n());
+  EXPECT_EQ(5, testee_->ReadSome(&out).n());
+  EXPECT_EQ(15u, testee_->offset());
+  EXPECT_EQ(10u, testee_->FreeBefore(testee_->offset()));
+  EXPECT_EQ(15u, testee_->offset());
+  EXPECT_EQ(0u, testee_->source()->size());
+}
+
+TEST_F(BufReaderTest, FreeBeforeReleasesReservedInput) {
+  // As the service receives an image with content_length set.
+  const size_t kMessageSize = 16 * 1024;
+  const size_t kNumMessages = 256;
+  auto* source = testee_->source();
+  source->Reserve(kMessageSize * kNumMessages);
+  std::vector<uint8_t> message(kMessageSize, 'x');
+  size_t max_buffered = 0;
+  for (size_t i = 0; i < kNumMessages; ++i) {
+    ASSERT_TRUE(source->AppendToReserved(&message[0], message.size()));
+    max_buffered = std::max(max_buffered, source->size());
+    std::vector<BufReader::Span> spans;
+    ASSERT_TRUE(testee_->ReadV(kMessageSize, &spans).ok());
+    testee_->FreeBefore(testee_->offset());
+  }
+  EXPECT_EQ(kMessageSize * kNumMessages, testee_->offset());
+  EXPECT_EQ(kMessageSize, max_buffered);
+  EXPECT_EQ(0u, source->size());
+}
+
 }  // namespace io
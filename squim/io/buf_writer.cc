@@ -32,11 +32,11 @@ IoResult BufWriter::Write(Chunk* chunk) {
   if (flushing_)
     return IoResult::Pending();
 
-  if (!buffer_)
-    buffer_ = Chunk::New(buf_size_);
-
   size_t nwrite = 0;
   for (;;) {
+    if (!buffer_)
+      buffer_ = Chunk::Share(Chunk::New(buf_size_));
+
     auto slice = chunk->Slice(nwrite);
     auto effective_len = std::min(available(), slice->size());
     auto to_copy = slice->Slice(0, effective_len);
@@ -93,6 +93,9 @@ IoResult BufWriter::Flush() {
       start_ = 0;
       offset_ = 0;
       flushing_ = false;
+      // The underlying writer holds the data, don't overwrite it.
+      if (!buffer_->unique())
+        buffer_.reset();
       return IoResult::Write(nwrite);
     }
   }
@@ -102,6 +105,9 @@ IoResult BufWriter::Flush() {
 }
 
 ChunkPtr BufWriter::ReleaseBuffer() {
+  if (!buffer_)
+    return Chunk::New(0);
+
   auto ret = Chunk::Wrap(std::move(buffer_), start_, offset_ - start_);
   start_ = 0;
   offset_ = 0;
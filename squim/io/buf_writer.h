@@ -25,6 +25,9 @@
 
 namespace io {
 
+// Buffers small writes into |buf_size| blocks passed to |underlying|. The
+// blocks are shared chunks: the underlying writer may keep them with Clone()
+// without copying, in which case a new block is allocated for further writes.
 class BufWriter : public Writer, public Flusher {
  public:
   BufWriter(size_t buf_size, std::unique_ptr<Writer> underlying);
@@ -40,6 +43,9 @@ class BufWriter : public Writer, public Flusher {
     if (flushing_)
       return 0;
 
+    if (!buffer_)
+      return buf_size_;
+
     return buffer_->size() - offset_;
   }
   size_t buffered() const { return offset_; }
@@ -50,7 +56,7 @@ class BufWriter : public Writer, public Flusher {
 
  private:
   size_t buf_size_;
-  ChunkPtr buffer_;
+  std::unique_ptr<SharedChunk> buffer_;
   size_t start_ = 0;
   size_t offset_ = 0;
   bool flushing_ = false;
@@ -16,13 +16,44 @@
 
 #include "squim/io/buffered_source.h"
 
+#include <algorithm>
 #include <cstring>
+#include <iterator>
 
 #include "squim/base/logging.h"
 #include "squim/base/memory/make_unique.h"
 
 namespace io {
 
+const size_t BufferedSource::kMinReservedChunkSize;
+const size_t BufferedSource::kMaxReservedChunkSize;
+
+// Chunk of the reserved storage, which grows while data is appended.
+class BufferedSource::GrowingChunk : public Chunk {
+ public:
+  explicit GrowingChunk(size_t capacity)
+      : Chunk(nullptr, 0),
+        storage_(new uint8_t[capacity]),
+        capacity_(capacity) {
+    Reset(storage_.get(), 0);
+  }
+
+  size_t available() const { return capacity_ - size(); }
+
+  void Append(const uint8_t* data, size_t size) {
+    DCHECK_LE(size, available());
+    std::memcpy(storage_.get() + this->size(), data, size);
+    Reset(storage_.get(), this->size() + size);
+  }
+
+  // Makes the chunk empty, the storage is reused by the following data.
+  void Rewind() { Reset(storage_.get(), 0); }
+
+ private:
+  std::unique_ptr<uint8_t[]> storage_;
+  size_t capacity_;
+};
+
 BufferedSource::BufferedSource() : current_chunk_(chunks_.end()) {}
 
 BufferedSource::BufferedSource(ChunkList chunks)
@@ -49,12 +80,79 @@ void BufferedSource::AddChunk(ChunkPtr chunk) {
   if (eof_received_ || chunk->size() == 0)
     return;
 
+  // Appending to the reserved storage after this chunk would reorder data.
+  reserved_size_ = 0;
+  reserved_received_ = false;
+  growing_ = nullptr;
+
   total_size_ += chunk->size();
   chunks_.push_back(std::move(chunk));
   if (current_chunk_ == chunks_.end())
     current_chunk_ = std::prev(chunks_.end());
 }
 
+void BufferedSource::Reserve(size_t size) {
+  if (eof_received_ || size == 0)
+    return;
+
+  growing_ = nullptr;
+  reserved_size_ = size;
+  reserved_received_ = false;
+  next_reserved_chunk_size_ = kMinReservedChunkSize;
+}
+
+bool BufferedSource::AppendToReserved(const uint8_t* data, size_t size) {
+  if (eof_received_)
+    return true;
+
+  if (reserved_size_ == 0 || size > reserved_size_) {
+    reserved_size_ = 0;
+    reserved_received_ = false;
+    growing_ = nullptr;
+    return false;
+  }
+
+  while (size > 0) {
+    if (!growing_ || growing_->available() == 0)
+      AddReservedChunk();
+
+    auto n = std::min(size, growing_->available());
+    auto old_size = growing_->size();
+    growing_->Append(data, n);
+    total_size_ += n;
+    reserved_size_ -= n;
+    data += n;
+    size -= n;
+    if (current_chunk_ == chunks_.end()) {
+      // Everything has been read, continue from the appended data.
+      DCHECK(chunks_.back().get() == growing_);
+      current_chunk_ = std::prev(chunks_.end());
+      offset_in_chunk_ = old_size;
+    }
+  }
+  reserved_received_ = reserved_size_ == 0;
+  return true;
+}
+
+void BufferedSource::AddReservedChunk() {
+  auto capacity = std::min(next_reserved_chunk_size_, reserved_size_);
+  next_reserved_chunk_size_ =
+      std::min(next_reserved_chunk_size_ * 2, kMaxReservedChunkSize);
+  auto chunk = base::make_unique<GrowingChunk>(capacity);
+  growing_ = chunk.get();
+  // Empty until the caller appends to it, which also makes it current if
+  // everything before it has been read.
+  chunks_.push_back(std::move(chunk));
+}
+
+void BufferedSource::ForgetGrowingChunk(ChunkList::iterator first,
+                                        ChunkList::iterator last) {
+  for (auto it = first; it != last; ++it) {
+    if (it->get() == growing_)
+      growing_ = nullptr;
+  }
+}
+
 size_t BufferedSource::ReadSome(uint8_t** out) {
   if (!out)
     return 0;
@@ -70,6 +168,25 @@ size_t BufferedSource::ReadSome(uint8_t** out) {
   return nread;
 }
 
+size_t BufferedSource::ReadSomeShared(ChunkPtr* out) {
+  if (!out)
+    return 0;
+
+  CHECK(HaveSome());
+
+  auto& chunk = *current_chunk_;
+  // The shared chunk has the size the chunk has now, so data is never
+  // appended to it again.
+  ForgetGrowingChunk(current_chunk_, std::next(current_chunk_));
+  chunk = Chunk::Share(std::move(chunk));
+  auto nread = chunk->size() - offset_in_chunk_;
+  *out = chunk->Slice(offset_in_chunk_, nread);
+  offset_in_chunk_ = 0;
+  total_offset_ += nread;
+  current_chunk_++;
+  return nread;
+}
+
 size_t BufferedSource::ReadAtMostN(uint8_t** out, size_t desired) {
   if (!out || desired == 0)
     return 0;
@@ -198,6 +315,7 @@ size_t BufferedSource::ReadN(uint8_t** out, size_t n) {
   }
 
   // Now, remove old chunks from |chunks_|.
+  ForgetGrowingChunk(start, end);
   auto where = chunks_.erase(start, end);
 
   // Finally, insert new one instead.
@@ -209,26 +327,22 @@ size_t BufferedSource::ReadN(uint8_t** out, size_t n) {
 }
 
 size_t BufferedSource::FreeAtMostNBytes(size_t n) {
-  if (current_chunk_ == chunks_.begin())
-    return 0;
-
-  auto start = chunks_.begin();
-  auto end = start;
+  auto end = chunks_.begin();
   size_t accumulated = 0;
-  size_t accumulated_next = 0;
-  for (auto it = start; it != current_chunk_; ++it) {
-    const auto& chunk = *it;
-    accumulated_next += chunk->size();
-    if (accumulated_next >= n) {
-      break;
-    } else {
-      accumulated = accumulated_next;
-      end = it;
-    }
+  while (end != current_chunk_ && accumulated + (*end)->size() <= n) {
+    accumulated += (*end)->size();
+    ++end;
   }
-  ++end;
 
-  chunks_.erase(start, end);
+  // The chunk being appended to is always the last one. If it has been read
+  // completely, it is emptied instead of freed, so that slowly arriving data
+  // doesn't allocate a new chunk every time the reader catches up.
+  bool rewind_growing = growing_ && end == chunks_.end();
+  if (rewind_growing)
+    --end;
+  chunks_.erase(chunks_.begin(), end);
+  if (rewind_growing)
+    growing_->Rewind();
   total_size_ -= accumulated;
   total_offset_ -= accumulated;
   return accumulated;
@@ -239,9 +353,12 @@ size_t BufferedSource::FreeAsMuchAsPossible() {
 }
 
 ChunkList BufferedSource::ReleaseRest() {
+  reserved_size_ = 0;
+  growing_ = nullptr;
   ChunkPtr head;
   if (offset_in_chunk_ != 0) {
-    head = (*current_chunk_)->Slice(offset_in_chunk_)->Clone();
+    auto size = (*current_chunk_)->size() - offset_in_chunk_;
+    head = Chunk::Wrap(std::move(*current_chunk_), offset_in_chunk_, size);
     current_chunk_++;
   }
   chunks_.erase(chunks_.begin(), current_chunk_);
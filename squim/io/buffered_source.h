@@ -36,6 +36,10 @@ class BufferedSource {
   // Checks if EOF was received and all data has been read.
   bool EofReached() const;
 
+  // Checks if all the data is already here: EOF was received, or all the data
+  // expected by Reserve() has been appended.
+  bool AllDataReceived() const { return eof_received_ || reserved_received_; }
+
   // Checks if there are |n| bytes immediately available.
   bool HaveN(size_t n);
 
@@ -44,6 +48,11 @@ class BufferedSource {
   // Returns number of bytes read.
   size_t ReadSome(uint8_t** out);
 
+  // Same as ReadSome(), but returns the data as a chunk sharing the storage
+  // with the source. It stays valid after the source frees or merges the
+  // chunk, so the data can be kept without copying.
+  size_t ReadSomeShared(ChunkPtr* out);
+
   // Returns continuous chunk not more than |desired| size. You MUST check
   // that HasSome returned |true| before calling this.
   // Returns number of bytes read.
@@ -56,8 +65,25 @@ class BufferedSource {
 
   void AddChunk(ChunkPtr chunk);
 
+  // Expects |size| bytes of incoming data, e.g. when the input size is known
+  // in advance. Data added with AppendToReserved() is copied into large
+  // chunks, so readers see it as a few continuous pieces. Chunks are
+  // allocated as the data arrives, starting at kMinReservedChunkSize and
+  // doubling up to kMaxReservedChunkSize, so memory follows the amount of
+  // data received rather than |size|. They are freed once read, as any other
+  // chunks.
+  void Reserve(size_t size);
+
+  // Copies |data| into the reserved storage. Returns false if nothing is
+  // reserved or the data exceeds the reserved size. The reservation is dropped
+  // then, and the data must be added with AddChunk(). AddChunk() drops it as
+  // well.
+  bool AppendToReserved(const uint8_t* data, size_t size);
+
   // Tries to remove already consumed data from the front of the data. Does
-  // not reallocate, removes chunks only if they fully fit |n|.
+  // not reallocate, removes chunks only if they fully fit |n|. The reserved
+  // chunk which is still being appended to is emptied instead, and the
+  // following data reuses its storage.
   // Returns number of bytes freed.
   size_t FreeAtMostNBytes(size_t n);
 
@@ -77,13 +103,30 @@ class BufferedSource {
   size_t offset() const { return total_offset_; }
   size_t size() const { return total_size_; }
 
+  static const size_t kMinReservedChunkSize = 64 * 1024;
+  static const size_t kMaxReservedChunkSize = 1024 * 1024;
+
  private:
+  class GrowingChunk;
+
+  // Stops appending to the reserved chunk if it is in [first, last).
+  void ForgetGrowingChunk(ChunkList::iterator first, ChunkList::iterator last);
+  // Starts the next chunk of the reserved storage.
+  void AddReservedChunk();
+
   ChunkList chunks_;
   ChunkList::iterator current_chunk_;
   bool eof_received_ = false;
   size_t total_offset_ = 0u;
   size_t offset_in_chunk_ = 0u;
   size_t total_size_ = 0u;
+  // Bytes the reservation still expects.
+  size_t reserved_size_ = 0u;
+  // Set once all the reserved bytes have been appended.
+  bool reserved_received_ = false;
+  size_t next_reserved_chunk_size_ = 0u;
+  // The last chunk of the reserved storage in |chunks_|, being appended to.
+  GrowingChunk* growing_ = nullptr;
 };
 
 }  // namespace io
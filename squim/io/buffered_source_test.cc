@@ -16,6 +16,8 @@
 
 #include "squim/io/buffered_source.h"
 
+#include <vector>
+
 #include "squim/base/memory/make_unique.h"
 #include "squim/base/strings/string_util.h"
 #include "squim/io/chunk.h"
@@ -277,4 +279,139 @@ TEST_F(BufferedSourceTest, Freeing) {
   EXPECT_EQ(5, testee_.size());
 }
 
+TEST_F(BufferedSourceTest, AppendToReserved) {
+  const uint8_t kData[] = "0123456789";
+  testee_.Reserve(10);
+  EXPECT_FALSE(testee_.HaveSome());
+  EXPECT_TRUE(testee_.AppendToReserved(kData, 3));
+  EXPECT_TRUE(testee_.AppendToReserved(kData + 3, 3));
+  EXPECT_EQ(6, testee_.size());
+
+  uint8_t* out;
+  EXPECT_EQ(6, testee_.ReadSome(&out));
+  EXPECT_EQ("012345", base::StringFromBytes(out, 6));
+  EXPECT_FALSE(testee_.HaveSome());
+  EXPECT_EQ(2, testee_.UnreadN(2));
+
+  // Appended data continues the same piece of memory.
+  EXPECT_TRUE(testee_.AppendToReserved(kData + 6, 4));
+  EXPECT_EQ(6, testee_.ReadSome(&out));
+  EXPECT_EQ("456789", base::StringFromBytes(out, 6));
+  EXPECT_EQ(10, testee_.offset());
+
+  // Overflow falls back to chunks.
+  EXPECT_FALSE(testee_.AppendToReserved(kData, 1));
+  EXPECT_FALSE(testee_.AppendToReserved(kData, 0));
+  testee_.AddChunk(Chunk::FromString("ab"));
+  EXPECT_EQ(2, testee_.ReadSome(&out));
+  EXPECT_EQ("ab", base::StringFromBytes(out, 2));
+  EXPECT_EQ(12, testee_.size());
+}
+
+TEST_F(BufferedSourceTest, ReservedStorageGrowsWithData) {
+  // Nothing is allocated up front, so a bogus size costs nothing.
+  testee_.Reserve(size_t(1) << 50);
+  const uint8_t kData[] = "0123456789";
+  EXPECT_TRUE(testee_.AppendToReserved(kData, 10));
+  EXPECT_EQ(10, testee_.size());
+
+  // Storage grows in chunks starting at kMinReservedChunkSize.
+  const size_t kChunkSize = BufferedSource::kMinReservedChunkSize;
+  std::vector<uint8_t> data(kChunkSize * 2, 'x');
+  EXPECT_TRUE(testee_.AppendToReserved(&data[0], data.size()));
+  uint8_t* out;
+  EXPECT_EQ(kChunkSize, testee_.ReadSome(&out));
+  EXPECT_EQ("0123456789", base::StringFromBytes(out, 10));
+  EXPECT_EQ(kChunkSize + 10, testee_.ReadSome(&out));
+  EXPECT_FALSE(testee_.HaveSome());
+  EXPECT_EQ(kChunkSize * 2 + 10, testee_.size());
+}
+
+TEST_F(BufferedSourceTest, ReservedStorageIsFreedOnceRead) {
+  const size_t kMaxChunkSize = BufferedSource::kMaxReservedChunkSize;
+  const size_t kSize = kMaxChunkSize * 4;
+  testee_.Reserve(kSize);
+  std::vector<uint8_t> data(kSize, 'x');
+  EXPECT_TRUE(testee_.AppendToReserved(&data[0], kSize - kMaxChunkSize));
+
+  // Chunks which are full are freed as any other ones.
+  uint8_t* out;
+  while (testee_.HaveN(2))
+    testee_.ReadAtMostN(&out, testee_.size() - testee_.offset() - 1);
+  EXPECT_LT(kSize - 3 * kMaxChunkSize, testee_.FreeAsMuchAsPossible());
+  EXPECT_GT(kMaxChunkSize, testee_.size());
+
+  // The one being appended to is emptied once read completely.
+  EXPECT_TRUE(testee_.HaveSome());
+  testee_.ReadSome(&out);
+  testee_.FreeAsMuchAsPossible();
+  EXPECT_EQ(0, testee_.size());
+  EXPECT_EQ(0, testee_.offset());
+
+  // And takes the rest of the data.
+  data[kSize - 1] = 'y';
+  EXPECT_TRUE(
+      testee_.AppendToReserved(&data[kSize - kMaxChunkSize], kMaxChunkSize));
+  EXPECT_EQ(kMaxChunkSize, testee_.size());
+  EXPECT_EQ(kMaxChunkSize, testee_.ReadSome(&out));
+  EXPECT_EQ('y', out[kMaxChunkSize - 1]);
+  EXPECT_EQ(kMaxChunkSize, testee_.FreeAsMuchAsPossible());
+  EXPECT_FALSE(testee_.AppendToReserved(&data[0], 1));
+}
+
+TEST_F(BufferedSourceTest, AddChunkDropsReservation) {
+  const uint8_t kData[] = "0123456789";
+  EXPECT_FALSE(testee_.AppendToReserved(kData, 1));
+
+  testee_.Reserve(10);
+  testee_.AddChunk(Chunk::FromString("ab"));
+  EXPECT_FALSE(testee_.AppendToReserved(kData, 1));
+  EXPECT_EQ(2, testee_.size());
+}
+
+TEST_F(BufferedSourceTest, AllDataReceived) {
+  const uint8_t kData[] = "0123456789";
+  EXPECT_FALSE(testee_.AllDataReceived());
+
+  // Reserved input is complete once all of it is appended.
+  testee_.Reserve(10);
+  EXPECT_TRUE(testee_.AppendToReserved(kData, 6));
+  EXPECT_FALSE(testee_.AllDataReceived());
+  EXPECT_TRUE(testee_.AppendToReserved(kData + 6, 4));
+  EXPECT_TRUE(testee_.AllDataReceived());
+
+  // Unless the size was wrong.
+  EXPECT_FALSE(testee_.AppendToReserved(kData, 1));
+  EXPECT_FALSE(testee_.AllDataReceived());
+
+  testee_.SendEof();
+  EXPECT_TRUE(testee_.AllDataReceived());
+}
+
+TEST_F(BufferedSourceTest, ReadSomeShared) {
+  const uint8_t kData[] = "0123456789";
+  testee_.Reserve(10);
+  EXPECT_TRUE(testee_.AppendToReserved(kData, 4));
+  uint8_t* out;
+  EXPECT_EQ(1, testee_.ReadAtMostN(&out, 1));
+
+  ChunkPtr shared;
+  EXPECT_EQ(3, testee_.ReadSomeShared(&shared));
+  EXPECT_EQ("123", shared->ToString());
+  EXPECT_EQ(out + 1, shared->data());
+
+  // The rest of the data doesn't go to the shared chunk.
+  EXPECT_TRUE(testee_.AppendToReserved(kData + 4, 6));
+  EXPECT_EQ(6, testee_.ReadSome(&out));
+  EXPECT_EQ("456789", base::StringFromBytes(out, 6));
+  EXPECT_EQ("123", shared->ToString());
+
+  // Shared data survives merging and freeing of its chunk.
+  EXPECT_EQ(10, testee_.UnreadN(10));
+  EXPECT_EQ(10, testee_.ReadN(&out, 10));
+  EXPECT_EQ("0123456789", base::StringFromBytes(out, 10));
+  EXPECT_EQ(10, testee_.FreeAsMuchAsPossible());
+  EXPECT_EQ("123", shared->ToString());
+}
+
 }  // namespace io
@@ -56,7 +56,23 @@ ChunkPtr Chunk::Wrap(ChunkPtr to_wrap, size_t start, size_t size) {
   return base::make_unique<WrappingChunk>(std::move(to_wrap), start, size);
 }
 
+// static
+std::unique_ptr<SharedChunk> Chunk::Share(ChunkPtr chunk) {
+  if (auto* shared = chunk->AsShared()) {
+    chunk.release();
+    return std::unique_ptr<SharedChunk>(shared);
+  }
+
+  auto size = chunk->size();
+  std::shared_ptr<Chunk> storage(std::move(chunk));
+  return base::make_unique<SharedChunk>(std::move(storage), 0, size);
+}
+
 ChunkPtr Chunk::Merge(const ChunkList& chunks) {
+  // Nothing to merge, shared chunks are not copied then.
+  if (chunks.size() == 1)
+    return chunks.front()->Clone();
+
   size_t total_size = 0;
   for (const auto& chunk : chunks)
     total_size += chunk->size();
@@ -73,6 +89,11 @@ ChunkPtr Chunk::Merge(const ChunkList& chunks) {
 Chunk::Chunk(const uint8_t* data, size_t size)
     : data_(const_cast<uint8_t*>(data)), size_(size) {}
 
+void Chunk::Reset(const uint8_t* data, size_t size) {
+  data_ = const_cast<uint8_t*>(data);
+  size_ = size;
+}
+
 base::StringPiece Chunk::ToString() const {
   return base::StringFromBytes(data_, size_);
 }
@@ -90,8 +111,11 @@ ChunkPtr Chunk::Slice(size_t start, size_t size) {
 }
 
 StringChunk::StringChunk(std::string data)
-    : Chunk(reinterpret_cast<const uint8_t*>(data.data()), data.size()),
-      holder_(std::move(data)) {}
+    : Chunk(nullptr, 0), holder_(std::move(data)) {
+  // Moving may relocate the characters (small string optimization), so the
+  // data is taken from the holder.
+  Reset(reinterpret_cast<const uint8_t*>(holder_.data()), holder_.size());
+}
 
 StringChunk::~StringChunk() {}
 
@@ -105,4 +129,21 @@ WrappingChunk::WrappingChunk(ChunkPtr wrapped, size_t start, size_t size)
 
 WrappingChunk::~WrappingChunk() {}
 
+SharedChunk::SharedChunk(std::shared_ptr<Chunk> storage,
+                         size_t start,
+                         size_t size)
+    : Chunk(storage->data() + start, size), storage_(std::move(storage)) {}
+
+SharedChunk::~SharedChunk() {}
+
+ChunkPtr SharedChunk::Clone() {
+  return base::make_unique<SharedChunk>(storage_, data() - storage_->data(),
+                                        size());
+}
+
+ChunkPtr SharedChunk::Slice(size_t start, size_t size) {
+  return base::make_unique<SharedChunk>(
+      storage_, data() - storage_->data() + start, size);
+}
+
 }  // namespace io
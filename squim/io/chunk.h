@@ -26,6 +26,7 @@
 namespace io {
 
 class Chunk;
+class SharedChunk;
 using ChunkPtr = std::unique_ptr<Chunk>;
 using ChunkList = std::list<ChunkPtr>;
 
@@ -41,8 +42,11 @@ class Chunk {
 
   base::StringPiece ToString() const;
 
-  ChunkPtr Clone();
-  ChunkPtr Slice(size_t start, size_t size);
+  // Copies the data. Shared chunks only add a reference to their storage.
+  virtual ChunkPtr Clone();
+  // Returns a view which must not outlive this chunk. Slices of shared chunks
+  // keep the storage alive.
+  virtual ChunkPtr Slice(size_t start, size_t size);
   ChunkPtr Slice(size_t start);
 
   static ChunkPtr FromString(std::string data);
@@ -52,6 +56,15 @@ class Chunk {
   static ChunkPtr New(size_t size);
   static ChunkPtr Wrap(ChunkPtr to_wrap, size_t start, size_t size);
   static ChunkPtr Merge(const ChunkList& chunks);
+  // Turns |chunk| into refcounted storage of a SharedChunk. Shared chunks are
+  // returned as they are.
+  static std::unique_ptr<SharedChunk> Share(ChunkPtr chunk);
+
+ protected:
+  void Reset(const uint8_t* data, size_t size);
+
+  // Returns this chunk if it is a SharedChunk, nullptr otherwise.
+  virtual SharedChunk* AsShared() { return nullptr; }
 
  private:
   uint8_t* data_;
@@ -85,6 +98,29 @@ class WrappingChunk : public Chunk {
   ChunkPtr wrapped_;
 };
 
+// Chunk referencing a part of refcounted storage. Clone() and Slice() of it
+// never copy, so the same bytes can be handed over to several consumers.
+// Mutating the data is visible through all the chunks sharing the storage.
+class SharedChunk : public Chunk {
+ public:
+  SharedChunk(std::shared_ptr<Chunk> storage, size_t start, size_t size);
+  ~SharedChunk() override;
+
+  // Chunk implementation:
+  ChunkPtr Clone() override;
+  using Chunk::Slice;
+  ChunkPtr Slice(size_t start, size_t size) override;
+
+  // Checks if the storage is referenced by this chunk only.
+  bool unique() const { return storage_.use_count() == 1; }
+
+ protected:
+  SharedChunk* AsShared() override { return this; }
+
+ private:
+  std::shared_ptr<Chunk> storage_;
+};
+
 }  // namespace io
 
 #endif  // SQUIM_IO_CHUNK_H_
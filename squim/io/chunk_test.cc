@@ -37,4 +37,59 @@ TEST(RawChunkTest, CorrectAssignment) {
   EXPECT_EQ("test", chunk->ToString());
 }
 
+TEST(StringChunkTest, ShortString) {
+  auto chunk = Chunk::FromString(std::string("ab"));
+  EXPECT_EQ(2u, chunk->size());
+  EXPECT_EQ("ab", chunk->ToString());
+}
+
+TEST(ChunkTest, MergeSingleChunk) {
+  ChunkList chunks;
+  chunks.push_back(Chunk::FromString("test"));
+  auto merged = Chunk::Merge(chunks);
+  EXPECT_EQ("test", merged->ToString());
+  EXPECT_NE(chunks.front()->data(), merged->data());
+
+  chunks.front() = Chunk::Share(std::move(chunks.front()));
+  merged = Chunk::Merge(chunks);
+  EXPECT_EQ("test", merged->ToString());
+  EXPECT_EQ(chunks.front()->data(), merged->data());
+}
+
+TEST(SharedChunkTest, CloneAndSliceShareStorage) {
+  auto chunk = Chunk::Share(Chunk::FromString("0123456789"));
+  EXPECT_TRUE(chunk->unique());
+
+  auto clone = chunk->Clone();
+  EXPECT_FALSE(chunk->unique());
+  EXPECT_EQ(chunk->data(), clone->data());
+  EXPECT_EQ("0123456789", clone->ToString());
+
+  auto slice = clone->Slice(2, 5);
+  EXPECT_EQ(chunk->data() + 2, slice->data());
+  EXPECT_EQ("23456", slice->ToString());
+
+  auto slice_of_slice = slice->Slice(3);
+  EXPECT_EQ("56", slice_of_slice->ToString());
+
+  slice_of_slice->data()[0] = 'x';
+  EXPECT_EQ("01234x6789", chunk->ToString());
+}
+
+TEST(SharedChunkTest, SliceKeepsStorageAlive) {
+  auto chunk = Chunk::Share(Chunk::FromString("0123456789"));
+  auto slice = chunk->Slice(4);
+  chunk.reset();
+  EXPECT_EQ("456789", slice->ToString());
+}
+
+TEST(SharedChunkTest, ShareOfSharedChunkIsTheSame) {
+  auto chunk = Chunk::Share(Chunk::FromString("0123456789"));
+  auto* shared = chunk.get();
+  auto slice = chunk->Slice(4);
+  chunk = Chunk::Share(std::move(chunk));
+  EXPECT_EQ(shared, chunk.get());
+  EXPECT_FALSE(chunk->unique());
+}
+
 }  // namespace io